@@ -0,0 +1,39 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replace operator new and delete to count heap allocations. They live in a
+// file of their own so that the compiler does not see them paired with the
+// default allocation functions. Script buffers that outgrow a prevector's
+// inline storage are malloc()ed and not counted.
+
+static std::atomic<bool> g_count_allocs{false};
+static std::atomic<uint64_t> g_num_allocs{0};
+
+void* operator new(std::size_t size)
+{
+    if (g_count_allocs.load(std::memory_order_relaxed)) g_num_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+void benchmark::StartAllocationCount()
+{
+    g_num_allocs = 0;
+    g_count_allocs = true;
+}
+
+uint64_t benchmark::StopAllocationCount()
+{
+    g_count_allocs = false;
+    return g_num_allocs;
+}
@@ -45,7 +45,14 @@ void benchmark::ConsolePrinter::result(const State& state)
     }
 
     std::cout << std::setprecision(6);
-    std::cout << state.m_name << ", " << state.m_num_evals << ", " << state.m_num_iters << ", " << total << ", " << front << ", " << back << ", " << median << std::endl;
+    std::cout << state.m_name << ", " << state.m_num_evals << ", " << state.m_num_iters << ", " << total << ", " << front << ", " << back << ", " << median;
+    if (state.m_num_bytes_per_iter && median > 0) {
+        std::cout << ", " << state.m_num_bytes_per_iter / median / 1e9 << " GB/s";
+    }
+    if (state.m_num_allocs_per_iter) {
+        std::cout << ", " << state.m_num_allocs_per_iter << " allocs";
+    }
+    std::cout << std::endl;
 }
 
 void benchmark::ConsolePrinter::footer() {}
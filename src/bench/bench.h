@@ -59,6 +59,10 @@ public:
     const uint64_t m_num_evals;
     std::vector<double> m_elapsed_results;
     time_point m_start_time;
+    //! Bytes processed per iteration. If set, the console printer also reports the throughput.
+    uint64_t m_num_bytes_per_iter{0};
+    //! Heap allocations per iteration. If set, the console printer also reports them.
+    uint64_t m_num_allocs_per_iter{0};
 
     bool UpdateTimer(time_point finish_time);
 
@@ -96,6 +100,11 @@ public:
     static void RunAll(Printer& printer, uint64_t num_evals, double scaling, const std::string& filter, bool is_list_only);
 };
 
+/** Start counting the heap allocations made through operator new, on any thread. */
+void StartAllocationCount();
+/** Stop counting heap allocations and return how many were made since StartAllocationCount(). */
+uint64_t StopAllocationCount();
+
 // interface to output benchmark results.
 class Printer
 {
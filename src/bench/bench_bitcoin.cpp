@@ -4,6 +4,8 @@
 
 #include <bench/bench.h>
 
+#include <crypto/chacha20.h>
+#include <crypto/poly1305.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 
@@ -74,6 +76,10 @@ int main(int argc, char** argv)
             argsman.GetArg("-plot-height", DEFAULT_PLOT_HEIGHT)));
     }
 
+    // Use the same ChaCha20 and Poly1305 implementations as bitcoind.
+    ChaCha20AutoDetect();
+    Poly1305AutoDetect();
+
     benchmark::BenchRunner::RunAll(*printer, evaluations, scaling_factor, regex_filter, is_list_only);
 
     return EXIT_SUCCESS;
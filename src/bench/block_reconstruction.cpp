@@ -0,0 +1,79 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <blockencodings.h>
+#include <consensus/merkle.h>
+#include <random.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+
+#include <vector>
+
+// Number of transactions in the compact block, all but one of which are in the mempool.
+static constexpr size_t BLOCK_TXS = 2500;
+
+static CTransactionRef MakeUniqueTx(FastRandomContext& rand)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(rand.rand256(), 0);
+    tx.vin[0].scriptWitness.stack.push_back(std::vector<unsigned char>(72, 1));
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    tx.vout[0].nValue = 10 * COIN;
+    return MakeTransactionRef(tx);
+}
+
+/**
+ * Initialize a PartiallyDownloadedBlock from a compact block against a
+ * mempool of the given size. One transaction of the block is not in the
+ * mempool, so that the whole mempool is scanned, as it is for most blocks
+ * arriving in practice.
+ */
+static void CompactBlockReconstruction(benchmark::State& state, size_t mempool_size)
+{
+    TestingSetup test_setup;
+    FastRandomContext rand(true);
+    TestMemPoolEntryHelper entry;
+    CTxMemPool pool;
+    CBlock block;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(1);
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+
+    {
+        LOCK2(cs_main, pool.cs);
+        for (size_t i = 0; i < mempool_size; ++i) {
+            CTransactionRef tx = MakeUniqueTx(rand);
+            pool.addUnchecked(entry.FromTx(tx));
+            if (i % (mempool_size / BLOCK_TXS) == 0 && block.vtx.size() < BLOCK_TXS) block.vtx.push_back(tx);
+        }
+    }
+    block.vtx.push_back(MakeUniqueTx(rand));
+    block.nBits = 0x207fffff;
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+
+    const CBlockHeaderAndShortTxIDs cmpctblock(block, true);
+    const std::vector<std::pair<uint256, CTransactionRef>> extra_txn;
+
+    while (state.KeepRunning()) {
+        PartiallyDownloadedBlock partial_block(&pool);
+        ReadStatus status = partial_block.InitData(cmpctblock, extra_txn);
+        assert(status == READ_STATUS_OK);
+        assert(!partial_block.IsTxAvailable(block.vtx.size() - 1));
+    }
+}
+
+static void CompactBlockReconstruction10k(benchmark::State& state) { CompactBlockReconstruction(state, 10000); }
+static void CompactBlockReconstruction50k(benchmark::State& state) { CompactBlockReconstruction(state, 50000); }
+static void CompactBlockReconstruction100k(benchmark::State& state) { CompactBlockReconstruction(state, 100000); }
+static void CompactBlockReconstruction500k(benchmark::State& state) { CompactBlockReconstruction(state, 500000); }
+
+BENCHMARK(CompactBlockReconstruction10k, 2000);
+BENCHMARK(CompactBlockReconstruction50k, 400);
+BENCHMARK(CompactBlockReconstruction100k, 200);
+BENCHMARK(CompactBlockReconstruction500k, 40);
@@ -4,8 +4,9 @@
 
 
 #include <bench/bench.h>
+#include <crypto/chacha20.h>
 #include <crypto/chacha_poly_aead.h>
-#include <crypto/poly1305.h> // for the POLY1305_TAGLEN constant
+#include <crypto/poly1305.h>
 #include <hash.h>
 
 #include <assert.h>
@@ -29,6 +30,7 @@ static void CHACHA20_POLY1305_AEAD(benchmark::State& state, size_t buffersize, b
     uint64_t seqnr_aad = 0;
     int aad_pos = 0;
     uint32_t len = 0;
+    state.m_num_bytes_per_iter = include_decryption ? 2 * buffersize : buffersize;
     while (state.KeepRunning()) {
         // encrypt or decrypt the buffer with a static key
         assert(aead.Crypt(seqnr_payload, seqnr_aad, aad_pos, out.data(), out.size(), in.data(), buffersize, true));
@@ -86,12 +88,76 @@ static void CHACHA20_POLY1305_AEAD_1MB_ENCRYPT_DECRYPT(benchmark::State& state)
     CHACHA20_POLY1305_AEAD(state, BUFFER_SIZE_LARGE, true);
 }
 
+// Throughput of the individual ChaCha20 and Poly1305 implementations
+
+// Implementations this CPU does not support are skipped rather than measuring
+// the one selected in their place.
+static void SkipUnavailable(benchmark::State& state, const std::string& impl)
+{
+    state.m_name += " (" + impl + " unavailable, skipped)";
+    while (state.KeepRunning()) {}
+}
+
+static void CHACHA20_KERNEL(benchmark::State& state, const std::string& impl)
+{
+    std::vector<unsigned char> buffer(BUFFER_SIZE_LARGE, 0);
+    ChaCha20 ctx(k1, 32);
+    if (!ChaCha20SelectImplementation(impl)) {
+        return SkipUnavailable(state, impl);
+    }
+    state.m_num_bytes_per_iter = buffer.size();
+    while (state.KeepRunning()) {
+        ctx.Crypt(buffer.data(), buffer.data(), buffer.size());
+    }
+    ChaCha20AutoDetect();
+}
+
+static void POLY1305_KERNEL(benchmark::State& state, const std::string& impl)
+{
+    std::vector<unsigned char> buffer(BUFFER_SIZE_LARGE, 0);
+    unsigned char tag[POLY1305_TAGLEN];
+    if (!Poly1305SelectImplementation(impl)) {
+        return SkipUnavailable(state, impl);
+    }
+    state.m_num_bytes_per_iter = buffer.size();
+    while (state.KeepRunning()) {
+        poly1305_auth(tag, buffer.data(), buffer.size(), k1);
+    }
+    Poly1305AutoDetect();
+}
+
+static void CHACHA20_1MB_STANDARD(benchmark::State& state)
+{
+    CHACHA20_KERNEL(state, "standard");
+}
+
+static void CHACHA20_1MB_SSE2(benchmark::State& state)
+{
+    CHACHA20_KERNEL(state, "sse2");
+}
+
+static void CHACHA20_1MB_AVX2(benchmark::State& state)
+{
+    CHACHA20_KERNEL(state, "avx2");
+}
+
+static void POLY1305_1MB_STANDARD(benchmark::State& state)
+{
+    POLY1305_KERNEL(state, "standard");
+}
+
+static void POLY1305_1MB_AVX2(benchmark::State& state)
+{
+    POLY1305_KERNEL(state, "avx2");
+}
+
 // Add Hash() (dbl-sha256) bench for comparison
 
 static void HASH(benchmark::State& state, size_t buffersize)
 {
     uint8_t hash[CHash256::OUTPUT_SIZE];
     std::vector<uint8_t> in(buffersize,0);
+    state.m_num_bytes_per_iter = buffersize;
     while (state.KeepRunning())
         CHash256().Write(in.data(), in.size()).Finalize(hash);
 }
@@ -117,6 +183,11 @@ BENCHMARK(CHACHA20_POLY1305_AEAD_1MB_ONLY_ENCRYPT, 340);
 BENCHMARK(CHACHA20_POLY1305_AEAD_64BYTES_ENCRYPT_DECRYPT, 500000);
 BENCHMARK(CHACHA20_POLY1305_AEAD_256BYTES_ENCRYPT_DECRYPT, 250000);
 BENCHMARK(CHACHA20_POLY1305_AEAD_1MB_ENCRYPT_DECRYPT, 340);
+BENCHMARK(CHACHA20_1MB_STANDARD, 340);
+BENCHMARK(CHACHA20_1MB_SSE2, 340);
+BENCHMARK(CHACHA20_1MB_AVX2, 340);
+BENCHMARK(POLY1305_1MB_STANDARD, 340);
+BENCHMARK(POLY1305_1MB_AVX2, 340);
 BENCHMARK(HASH_64BYTES, 500000);
 BENCHMARK(HASH_256BYTES, 250000);
 BENCHMARK(HASH_1MB, 340);
@@ -8,27 +8,44 @@
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <streams.h>
+#include <support/allocators/arena.h>
 #include <validation.h>
 
 // These are the two major time-sinks which happen after we have fully received
 // a block off the wire, but before we can relay the block on to peers using
 // compact block relay.
 
-static void DeserializeBlockTest(benchmark::State& state)
+/** Deserialize (and destroy) the block once, returning the number of allocations made. */
+static uint64_t CountBlockAllocations(CDataStream& stream, bool use_arena)
+{
+    benchmark::StartAllocationCount();
+    {
+        CBlock block;
+        if (use_arena) block.m_tx_arena = std::make_shared<MonotonicArena>();
+        stream >> block;
+        bool rewound = stream.Rewind(benchmark::data::block413567.size());
+        assert(rewound);
+    }
+    return benchmark::StopAllocationCount();
+}
+
+static void DeserializeBlock(benchmark::State& state, bool use_arena)
 {
     CDataStream stream(benchmark::data::block413567, SER_NETWORK, PROTOCOL_VERSION);
     char a = '\0';
     stream.write(&a, 1); // Prevent compaction
 
+    state.m_num_allocs_per_iter = CountBlockAllocations(stream, use_arena);
     while (state.KeepRunning()) {
         CBlock block;
+        if (use_arena) block.m_tx_arena = std::make_shared<MonotonicArena>();
         stream >> block;
         bool rewound = stream.Rewind(benchmark::data::block413567.size());
         assert(rewound);
     }
 }
 
-static void DeserializeAndCheckBlockTest(benchmark::State& state)
+static void DeserializeAndCheckBlock(benchmark::State& state, bool use_arena)
 {
     CDataStream stream(benchmark::data::block413567, SER_NETWORK, PROTOCOL_VERSION);
     char a = '\0';
@@ -36,8 +53,10 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
 
     const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
 
+    state.m_num_allocs_per_iter = CountBlockAllocations(stream, use_arena);
     while (state.KeepRunning()) {
         CBlock block; // Note that CBlock caches its checked state, so we need to recreate it here
+        if (use_arena) block.m_tx_arena = std::make_shared<MonotonicArena>();
         stream >> block;
         bool rewound = stream.Rewind(benchmark::data::block413567.size());
         assert(rewound);
@@ -48,5 +67,12 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
     }
 }
 
+static void DeserializeBlockTest(benchmark::State& state) { DeserializeBlock(state, false); }
+static void DeserializeBlockArenaTest(benchmark::State& state) { DeserializeBlock(state, true); }
+static void DeserializeAndCheckBlockTest(benchmark::State& state) { DeserializeAndCheckBlock(state, false); }
+static void DeserializeAndCheckBlockArenaTest(benchmark::State& state) { DeserializeAndCheckBlock(state, true); }
+
 BENCHMARK(DeserializeBlockTest, 130);
+BENCHMARK(DeserializeBlockArenaTest, 130);
 BENCHMARK(DeserializeAndCheckBlockTest, 160);
+BENCHMARK(DeserializeAndCheckBlockArenaTest, 160);
@@ -24,7 +24,7 @@ static const unsigned int QUEUE_BATCH_SIZE = 128;
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
 // and there is a little bit of work done between calls to Add.
-static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+static void CheckQueuePrevectorJob(benchmark::State& state, int threads, bool work_stealing)
 {
     const ECCVerifyHandle verify_handle;
     ECC_Start();
@@ -43,8 +43,9 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
         void swap(PrevectorJob& x){p.swap(x.p);};
     };
     CCheckQueue<PrevectorJob> queue {QUEUE_BATCH_SIZE};
+    if (work_stealing) queue.EnableWorkStealing(threads);
     boost::thread_group tg;
-    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
+    for (auto x = 0; x < threads; ++x) {
        tg.create_thread([&]{queue.Thread();});
     }
     while (state.KeepRunning()) {
@@ -66,4 +67,31 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.join_all();
     ECC_Stop();
 }
+
+static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+{
+    CheckQueuePrevectorJob(state, std::max(MIN_CORES, GetNumCores()), false);
+}
+
+// Scaling curves of the shared queue against the work-stealing queue, by
+// number of worker threads.
+#define CHECKQUEUE_SCALING_BENCH(threads)                                 \
+    static void CCheckQueueShared_##threads##Threads(benchmark::State& state)  \
+    {                                                                     \
+        CheckQueuePrevectorJob(state, threads, false);                    \
+    }                                                                     \
+    static void CCheckQueueStealing_##threads##Threads(benchmark::State& state) \
+    {                                                                     \
+        CheckQueuePrevectorJob(state, threads, true);                     \
+    }                                                                     \
+    BENCHMARK(CCheckQueueShared_##threads##Threads, 1400);                \
+    BENCHMARK(CCheckQueueStealing_##threads##Threads, 1400);
+
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+CHECKQUEUE_SCALING_BENCH(1)
+CHECKQUEUE_SCALING_BENCH(2)
+CHECKQUEUE_SCALING_BENCH(4)
+CHECKQUEUE_SCALING_BENCH(8)
+CHECKQUEUE_SCALING_BENCH(16)
+CHECKQUEUE_SCALING_BENCH(32)
+CHECKQUEUE_SCALING_BENCH(64)
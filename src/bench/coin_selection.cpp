@@ -5,6 +5,10 @@
 #include <bench/bench.h>
 #include <interfaces/chain.h>
 #include <node/context.h>
+#include <test/util/mining.h>
+#include <test/util/setup_common.h>
+#include <test/util/wallet.h>
+#include <validationinterface.h>
 #include <wallet/coinselection.h>
 #include <wallet/wallet.h>
 
@@ -62,6 +66,52 @@ static void CoinSelection(benchmark::State& state)
     }
 }
 
+// Select coins in a wallet with many spent transactions, where listing the
+// available coins takes longer than selecting from them.
+static void CoinSelectionLargeWallet(benchmark::State& state)
+{
+    TestingSetup test_setup{
+        CBaseChainParams::REGTEST,
+        /* extra_args */ {
+            "-nodebuglogfile",
+            "-nodebug",
+        },
+    };
+
+    NodeContext node;
+    std::unique_ptr<interfaces::Chain> chain = interfaces::MakeChain(node);
+    CWallet wallet{chain.get(), WalletLocation(), CreateMockWalletDatabase()};
+    {
+        wallet.SetupLegacyScriptPubKeyMan();
+        bool first_run;
+        if (wallet.LoadWallet(first_run) != DBErrors::LOAD_OK) assert(false);
+    }
+    auto handler = chain->handleNotifications({&wallet, [](CWallet*) {}});
+
+    const std::string address = getnewaddress(wallet);
+    for (int i = 0; i < COINBASE_MATURITY + 10; ++i) {
+        generatetoaddress(test_setup.m_node, address);
+    }
+    SyncWithValidationInterfaceQueue();
+    AddSpentTransactions(wallet, address, 20000);
+
+    const CoinEligibilityFilter filter_standard(1, 6, 0);
+    const CoinSelectionParams coin_selection_params(true, 34, 148, CFeeRate(0), 0);
+    while (state.KeepRunning()) {
+        LOCK(wallet.cs_wallet);
+        std::vector<COutput> coins;
+        wallet.AvailableCoins(coins);
+        // The mature coinbase outputs and the output of the last spent transaction
+        assert(coins.size() == 11);
+        std::vector<OutputGroup> groups = wallet.GroupOutputs(coins, /* single_coin */ true, /* max_ancestors */ 0);
+        std::set<CInputCoin> setCoinsRet;
+        CAmount nValueRet;
+        bool bnb_used;
+        bool success = wallet.SelectCoinsMinConf(100 * COIN, filter_standard, groups, setCoinsRet, nValueRet, coin_selection_params, bnb_used);
+        assert(success);
+    }
+}
+
 typedef std::set<CInputCoin> CoinSet;
 static NodeContext testNode;
 static auto testChain = interfaces::MakeChain(testNode);
@@ -112,4 +162,5 @@ static void BnBExhaustion(benchmark::State& state)
 }
 
 BENCHMARK(CoinSelection, 650);
+BENCHMARK(CoinSelectionLargeWallet, 650);
 BENCHMARK(BnBExhaustion, 650);
@@ -39,5 +39,32 @@ static void MatchGCSFilter(benchmark::State& state)
     }
 }
 
+// Match a wallet's worth of scriptPubKeys against a block's worth of filter elements
+static void MatchAnyGCSFilter(benchmark::State& state)
+{
+    GCSFilter::ElementSet block_elements;
+    for (int i = 0; i < 5000; ++i) {
+        GCSFilter::Element element(25);
+        element[0] = static_cast<unsigned char>(i);
+        element[1] = static_cast<unsigned char>(i >> 8);
+        block_elements.insert(std::move(element));
+    }
+    GCSFilter filter({0, 0, BASIC_FILTER_P, BASIC_FILTER_M}, block_elements);
+
+    GCSFilter::ElementSet wallet_elements;
+    for (int i = 0; i < 100000; ++i) {
+        GCSFilter::Element element(25);
+        element[2] = static_cast<unsigned char>(i);
+        element[3] = static_cast<unsigned char>(i >> 8);
+        element[4] = static_cast<unsigned char>(i >> 16);
+        wallet_elements.insert(std::move(element));
+    }
+
+    while (state.KeepRunning()) {
+        filter.MatchAny(wallet_elements);
+    }
+}
+
 BENCHMARK(ConstructGCSFilter, 1000);
 BENCHMARK(MatchGCSFilter, 50 * 1000);
+BENCHMARK(MatchAnyGCSFilter, 10);
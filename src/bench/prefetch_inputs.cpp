@@ -0,0 +1,88 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <checkqueue.h>
+#include <coins.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <txdb.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <boost/thread/thread.hpp>
+
+#include <vector>
+
+static const size_t PREFETCH_INPUTS = 4000;
+static const unsigned int PREFETCH_BATCH_SIZE = 16;
+
+// Fill an in-memory coins database with the outputs spent by a synthetic
+// block, and return that block.
+static CBlock SetupPrefetchBlock(CCoinsViewDB& db)
+{
+    FastRandomContext rng(true);
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.emplace_back(50 * COIN, CScript() << OP_TRUE);
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+
+    CCoinsViewCache writer(&db);
+    CMutableTransaction spend;
+    for (size_t i = 0; i < PREFETCH_INPUTS; ++i) {
+        const COutPoint outpoint(rng.rand256(), rng.randrange(4));
+        writer.AddCoin(outpoint, Coin(CTxOut(COIN, CScript() << OP_DUP << OP_HASH160 << rng.randbytes(20) << OP_EQUALVERIFY << OP_CHECKSIG), 1, false), false);
+        spend.vin.emplace_back(outpoint);
+        // Spread the inputs over transactions of a realistic size.
+        if (spend.vin.size() == 8) {
+            spend.vout.emplace_back(COIN, CScript() << OP_TRUE);
+            block.vtx.push_back(MakeTransactionRef(spend));
+            spend = CMutableTransaction();
+        }
+    }
+    writer.SetBestBlock(rng.rand256());
+    bool flushed = writer.Flush();
+    assert(flushed);
+    return block;
+}
+
+// Baseline: the inputs are pulled into an empty cache one by one, as
+// ConnectBlock does on cache misses.
+static void PrefetchInputsSerial(benchmark::State& state)
+{
+    CCoinsViewDB db("bench_prefetch", 8 << 20, true, false);
+    const CBlock block = SetupPrefetchBlock(db);
+    while (state.KeepRunning()) {
+        CCoinsViewCache cache(&db);
+        for (const auto& tx : block.vtx) {
+            if (tx->IsCoinBase()) continue;
+            for (const CTxIn& txin : tx->vin) {
+                bool found = !cache.AccessCoin(txin.prevout).IsSpent();
+                assert(found);
+            }
+        }
+    }
+}
+
+static void PrefetchInputsParallel(benchmark::State& state)
+{
+    CCoinsViewDB db("bench_prefetch", 8 << 20, true, false);
+    const CBlock block = SetupPrefetchBlock(db);
+    CCheckQueue<CInputPrefetchCheck> queue{PREFETCH_BATCH_SIZE};
+    boost::thread_group tg;
+    for (int x = 0; x < std::max(1, GetNumCores() - 1); ++x) {
+        tg.create_thread([&] { queue.Thread(); });
+    }
+    while (state.KeepRunning()) {
+        CCoinsViewCache cache(&db);
+        PrefetchBlockInputs(block, cache, db, &queue);
+        assert(cache.GetCacheSize() == PREFETCH_INPUTS);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+BENCHMARK(PrefetchInputsSerial, 20);
+BENCHMARK(PrefetchInputsParallel, 20);
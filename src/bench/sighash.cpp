@@ -0,0 +1,55 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/interpreter.h>
+#include <script/script.h>
+
+static const size_t SIGHASH_TX_INPUTS = 1000;
+
+// A transaction with many inputs and outputs, as found in consolidations and
+// payouts, for which every input gets signed.
+static CMutableTransaction LargeTransaction(bool witness)
+{
+    FastRandomContext rng(/* deterministic */ true);
+    CMutableTransaction tx;
+    tx.vin.resize(SIGHASH_TX_INPUTS);
+    for (auto& txin : tx.vin) {
+        txin.prevout = COutPoint(rng.rand256(), rng.randbits(2));
+        txin.scriptSig = CScript() << std::vector<unsigned char>(72) << std::vector<unsigned char>(33);
+        if (witness) txin.scriptWitness.stack = {std::vector<unsigned char>(72), std::vector<unsigned char>(33)};
+    }
+    tx.vout.resize(SIGHASH_TX_INPUTS / 10);
+    for (auto& txout : tx.vout) {
+        txout.nValue = rng.randrange(100000000);
+        txout.scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+    return tx;
+}
+
+static void SignatureHashAllInputs(benchmark::State& state, SigVersion sigversion, bool precomputed)
+{
+    const CMutableTransaction tx = LargeTransaction(sigversion == SigVersion::WITNESS_V0);
+    const CScript script_code = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    while (state.KeepRunning()) {
+        PrecomputedTransactionData txdata;
+        if (precomputed) txdata.Init(tx);
+        for (unsigned int i = 0; i < tx.vin.size(); ++i) {
+            SignatureHash(script_code, tx, i, SIGHASH_ALL, 0, sigversion, precomputed ? &txdata : nullptr);
+        }
+    }
+}
+
+static void SignatureHashLegacy(benchmark::State& state) { SignatureHashAllInputs(state, SigVersion::BASE, false); }
+static void SignatureHashLegacyPrecomputed(benchmark::State& state) { SignatureHashAllInputs(state, SigVersion::BASE, true); }
+static void SignatureHashWitnessV0(benchmark::State& state) { SignatureHashAllInputs(state, SigVersion::WITNESS_V0, false); }
+static void SignatureHashWitnessV0Precomputed(benchmark::State& state) { SignatureHashAllInputs(state, SigVersion::WITNESS_V0, true); }
+
+BENCHMARK(SignatureHashLegacy, 1);
+BENCHMARK(SignatureHashLegacyPrecomputed, 2);
+BENCHMARK(SignatureHashWitnessV0, 2);
+BENCHMARK(SignatureHashWitnessV0Precomputed, 20);
@@ -12,7 +12,7 @@
 #include <validationinterface.h>
 #include <wallet/wallet.h>
 
-static void WalletBalance(benchmark::State& state, const bool set_dirty, const bool add_watchonly, const bool add_mine)
+static void WalletBalance(benchmark::State& state, const bool set_dirty, const bool add_watchonly, const bool add_mine, const int spent_txs = 0)
 {
     TestingSetup test_setup{
         CBaseChainParams::REGTEST,
@@ -42,6 +42,7 @@ static void WalletBalance(benchmark::State& state, const bool set_dirty, const b
         generatetoaddress(test_setup.m_node, ADDRESS_WATCHONLY);
     }
     SyncWithValidationInterfaceQueue();
+    if (address_mine) AddSpentTransactions(wallet, *address_mine, spent_txs);
 
     auto bal = wallet.GetBalance(); // Cache
 
@@ -57,8 +58,10 @@ static void WalletBalanceDirty(benchmark::State& state) { WalletBalance(state, /
 static void WalletBalanceClean(benchmark::State& state) { WalletBalance(state, /* set_dirty */ false, /* add_watchonly */ true, /* add_mine */ true); }
 static void WalletBalanceMine(benchmark::State& state) { WalletBalance(state, /* set_dirty */ false, /* add_watchonly */ false, /* add_mine */ true); }
 static void WalletBalanceWatch(benchmark::State& state) { WalletBalance(state, /* set_dirty */ false, /* add_watchonly */ true, /* add_mine */ false); }
+static void WalletBalanceLarge(benchmark::State& state) { WalletBalance(state, /* set_dirty */ false, /* add_watchonly */ false, /* add_mine */ true, /* spent_txs */ 20000); }
 
 BENCHMARK(WalletBalanceDirty, 2500);
 BENCHMARK(WalletBalanceClean, 8000);
 BENCHMARK(WalletBalanceMine, 16000);
 BENCHMARK(WalletBalanceWatch, 8000);
+BENCHMARK(WalletBalanceLarge, 8000);
@@ -14,7 +14,71 @@
 #include <validation.h>
 #include <util/system.h>
 
-#include <unordered_map>
+#include <vector>
+
+namespace {
+
+/**
+ * Open-addressing hash table from the short IDs of a compact block to the
+ * position of their transaction in the block. It is probed once for every
+ * transaction in the mempool, so it is kept flat and sparse: a lookup is a
+ * mask and usually a single cache line access.
+ */
+class ShortTxIdTable
+{
+    //! Marks a slot as occupied; short IDs are only 48 bits wide.
+    static constexpr uint64_t OCCUPIED = uint64_t{1} << 63;
+    //! No short ID may be stored further than this from its home slot. Short IDs
+    //! of well-formed compact blocks are uniformly distributed, and with a load
+    //! factor of at most 1/4 exceeding this is vanishingly unlikely even for
+    //! blocks of 16000 transactions. Clustered short IDs are treated as
+    //! READ_STATUS_FAILED, which also bounds the cost of every lookup.
+    static constexpr size_t MAX_PROBE = 64;
+
+    std::vector<uint64_t> m_keys;
+    std::vector<uint16_t> m_positions;
+    uint64_t m_mask;
+
+public:
+    explicit ShortTxIdTable(size_t count)
+    {
+        size_t size = 16;
+        while (size < 4 * count) size *= 2;
+        m_keys.assign(size, 0);
+        m_positions.resize(size);
+        m_mask = size - 1;
+    }
+
+    /** Add a short ID. Returns false if it is already present or its probe sequence is too long. */
+    bool Insert(uint64_t shortid, uint16_t position)
+    {
+        const uint64_t key = shortid | OCCUPIED;
+        for (size_t i = 0; i <= MAX_PROBE; ++i) {
+            const size_t slot = (shortid + i) & m_mask;
+            if (m_keys[slot] == key) return false;
+            if (m_keys[slot] == 0) {
+                m_keys[slot] = key;
+                m_positions[slot] = position;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Look up a short ID, returning a pointer to its position or nullptr. */
+    const uint16_t* Find(uint64_t shortid) const
+    {
+        const uint64_t key = shortid | OCCUPIED;
+        for (size_t i = 0; i <= MAX_PROBE; ++i) {
+            const size_t slot = (shortid + i) & m_mask;
+            if (m_keys[slot] == key) return &m_positions[slot];
+            if (m_keys[slot] == 0) return nullptr;
+        }
+        return nullptr;
+    }
+};
+
+} // namespace
 
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID) :
         nonce(GetRand(std::numeric_limits<uint64_t>::max())),
@@ -78,47 +142,33 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
     // Because well-formed cmpctblock messages will have a (relatively) uniform distribution
     // of short IDs, any highly-uneven distribution of elements can be safely treated as a
     // READ_STATUS_FAILED.
-    std::unordered_map<uint64_t, uint16_t> shorttxids(cmpctblock.shorttxids.size());
+    ShortTxIdTable shorttxids(cmpctblock.shorttxids.size());
     uint16_t index_offset = 0;
     for (size_t i = 0; i < cmpctblock.shorttxids.size(); i++) {
         while (txn_available[i + index_offset])
             index_offset++;
-        shorttxids[cmpctblock.shorttxids[i]] = i + index_offset;
-        // To determine the chance that the number of entries in a bucket exceeds N,
-        // we use the fact that the number of elements in a single bucket is
-        // binomially distributed (with n = the number of shorttxids S, and p =
-        // 1 / the number of buckets), that in the worst case the number of buckets is
-        // equal to S (due to std::unordered_map having a default load factor of 1.0),
-        // and that the chance for any bucket to exceed N elements is at most
-        // buckets * (the chance that any given bucket is above N elements).
-        // Thus: P(max_elements_per_bucket > N) <= S * (1 - cdf(binomial(n=S,p=1/S), N)).
-        // If we assume blocks of up to 16000, allowing 12 elements per bucket should
-        // only fail once per ~1 million block transfers (per peer and connection).
-        if (shorttxids.bucket_size(shorttxids.bucket(cmpctblock.shorttxids[i])) > 12)
-            return READ_STATUS_FAILED;
+        // TODO: in the shortid-collision case, we should instead request both transactions
+        // which collided. Falling back to full-block-request here is overkill.
+        if (!shorttxids.Insert(cmpctblock.shorttxids[i], i + index_offset))
+            return READ_STATUS_FAILED; // Short ID collision or uneven distribution
     }
-    // TODO: in the shortid-collision case, we should instead request both transactions
-    // which collided. Falling back to full-block-request here is overkill.
-    if (shorttxids.size() != cmpctblock.shorttxids.size())
-        return READ_STATUS_FAILED; // Short ID collision
 
     std::vector<bool> have_txn(txn_available.size());
     {
     LOCK(pool->cs);
     for (size_t i = 0; i < pool->vTxHashes.size(); i++) {
         uint64_t shortid = cmpctblock.GetShortID(pool->vTxHashes[i].first);
-        std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
-        if (idit != shorttxids.end()) {
-            if (!have_txn[idit->second]) {
-                txn_available[idit->second] = pool->vTxHashes[i].second->GetSharedTx();
-                have_txn[idit->second]  = true;
+        if (const uint16_t* idit = shorttxids.Find(shortid)) {
+            if (!have_txn[*idit]) {
+                txn_available[*idit] = pool->vTxHashes[i].second->GetSharedTx();
+                have_txn[*idit]  = true;
                 mempool_count++;
             } else {
                 // If we find two mempool txn that match the short id, just request it.
                 // This should be rare enough that the extra bandwidth doesn't matter,
                 // but eating a round-trip due to FillBlock failure would be annoying
-                if (txn_available[idit->second]) {
-                    txn_available[idit->second].reset();
+                if (txn_available[*idit]) {
+                    txn_available[*idit].reset();
                     mempool_count--;
                 }
             }
@@ -126,18 +176,17 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
         // Though ideally we'd continue scanning for the two-txn-match-shortid case,
         // the performance win of an early exit here is too good to pass up and worth
         // the extra risk.
-        if (mempool_count == shorttxids.size())
+        if (mempool_count == cmpctblock.shorttxids.size())
             break;
     }
     }
 
     for (size_t i = 0; i < extra_txn.size(); i++) {
         uint64_t shortid = cmpctblock.GetShortID(extra_txn[i].first);
-        std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
-        if (idit != shorttxids.end()) {
-            if (!have_txn[idit->second]) {
-                txn_available[idit->second] = extra_txn[i].second;
-                have_txn[idit->second]  = true;
+        if (const uint16_t* idit = shorttxids.Find(shortid)) {
+            if (!have_txn[*idit]) {
+                txn_available[*idit] = extra_txn[i].second;
+                have_txn[*idit]  = true;
                 mempool_count++;
                 extra_count++;
             } else {
@@ -147,9 +196,9 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
                 // but eating a round-trip due to FillBlock failure would be annoying
                 // Note that we don't want duplication between extra_txn and mempool to
                 // trigger this case, so we compare witness hashes first
-                if (txn_available[idit->second] &&
-                        txn_available[idit->second]->GetWitnessHash() != extra_txn[i].second->GetWitnessHash()) {
-                    txn_available[idit->second].reset();
+                if (txn_available[*idit] &&
+                        txn_available[*idit]->GetWitnessHash() != extra_txn[i].second->GetWitnessHash()) {
+                    txn_available[*idit].reset();
                     mempool_count--;
                     extra_count--;
                 }
@@ -158,7 +207,7 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
         // Though ideally we'd continue scanning for the two-txn-match-shortid case,
         // the performance win of an early exit here is too good to pass up and worth
         // the extra risk.
-        if (mempool_count == shorttxids.size())
+        if (mempool_count == cmpctblock.shorttxids.size())
             break;
     }
 
@@ -216,3 +265,73 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
 
     return READ_STATUS_OK;
 }
+
+bool StripRawBlockWitness(Span<const uint8_t> block, std::vector<uint8_t>& stripped)
+{
+    SpanReader s(SER_NETWORK, PROTOCOL_VERSION, block);
+    // Bytes are copied to the output in runs that end where witness data starts.
+    size_t run_start = 0;
+    const auto pos = [&] { return block.size() - s.size(); };
+    const auto copy_run = [&](size_t end) { stripped.insert(stripped.end(), block.begin() + run_start, block.begin() + end); };
+
+    stripped.clear();
+    stripped.reserve(block.size());
+    try {
+        s.ignore(80); // header
+        const uint64_t tx_count = ReadCompactSize(s);
+        for (uint64_t i = 0; i < tx_count; ++i) {
+            // Walk the transaction as UnserializeTransaction does
+            s.ignore(4); // nVersion
+            const size_t dummy_pos = pos();
+            uint64_t vin_count = ReadCompactSize(s);
+            unsigned char flags = 0;
+            bool have_vout = true;
+            if (vin_count == 0) {
+                s >> flags;
+                if (flags != 0) {
+                    // Drop the dummy vin and the flags of the extended format
+                    copy_run(dummy_pos);
+                    run_start = pos();
+                    vin_count = ReadCompactSize(s);
+                } else {
+                    have_vout = false;
+                }
+            }
+            for (uint64_t in = 0; in < vin_count; ++in) {
+                s.ignore(36); // prevout
+                s.ignore(ReadCompactSize(s)); // scriptSig
+                s.ignore(4); // nSequence
+            }
+            if (have_vout) {
+                const uint64_t vout_count = ReadCompactSize(s);
+                for (uint64_t out = 0; out < vout_count; ++out) {
+                    s.ignore(8); // nValue
+                    s.ignore(ReadCompactSize(s)); // scriptPubKey
+                }
+            }
+            if (flags & 1) {
+                flags ^= 1;
+                copy_run(pos());
+                bool has_witness = false;
+                for (uint64_t in = 0; in < vin_count; ++in) {
+                    const uint64_t stack_size = ReadCompactSize(s);
+                    has_witness |= stack_size > 0;
+                    for (uint64_t item = 0; item < stack_size; ++item) {
+                        s.ignore(ReadCompactSize(s));
+                    }
+                }
+                // It's illegal to encode witnesses when all witness stacks are empty.
+                if (!has_witness) return false;
+                run_start = pos();
+            }
+            // Unknown flag in the serialization
+            if (flags) return false;
+            s.ignore(4); // nLockTime
+        }
+    } catch (const std::ios_base::failure&) {
+        return false;
+    }
+    if (!s.empty()) return false;
+    copy_run(pos());
+    return true;
+}
@@ -137,4 +137,13 @@ public:
     ReadStatus FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing);
 };
 
+/**
+ * Convert a block serialized with witness data, as stored on disk, into its
+ * serialization without witness data by copying all other bytes through,
+ * without deserializing its transactions.
+ *
+ * @returns false if the block is not a valid serialization.
+ */
+bool StripRawBlockWitness(Span<const uint8_t> block, std::vector<uint8_t>& stripped);
+
 #endif // BITCOIN_BLOCKENCODINGS_H
@@ -169,8 +169,48 @@ bool GCSFilter::Match(const Element& element) const
     return MatchInternal(&query, 1);
 }
 
+bool GCSFilter::MatchDecoded(const ElementSet& elements) const
+{
+    if (m_N == 0) return false;
+
+    VectorReader stream(GCS_SER_TYPE, GCS_SER_VERSION, m_encoded, 0);
+
+    // Seek forward by size of N
+    uint64_t N = ReadCompactSize(stream);
+    assert(N == m_N);
+
+    BitStreamReader<VectorReader> bitreader(stream);
+
+    // The decoded values are sorted and uniformly distributed in [0, N * M),
+    // so dividing by M maps them to N buckets holding one value on average.
+    auto bucket = [this](uint64_t value) { return std::min<uint64_t>(value / m_params.m_M, m_N - 1); };
+    std::vector<uint64_t> values(m_N);
+    std::vector<uint32_t> bucket_start(m_N + 1);
+    uint64_t value = 0;
+    uint32_t next_bucket = 0;
+    for (uint32_t i = 0; i < m_N; ++i) {
+        value += GolombRiceDecode(bitreader, m_params.m_P);
+        values[i] = value;
+        while (next_bucket <= bucket(value)) bucket_start[next_bucket++] = i;
+    }
+    while (next_bucket <= m_N) bucket_start[next_bucket++] = m_N;
+
+    for (const Element& element : elements) {
+        const uint64_t query = HashToRange(element);
+        const uint64_t b = bucket(query);
+        for (uint32_t i = bucket_start[b]; i < bucket_start[b + 1]; ++i) {
+            if (values[i] == query) return true;
+        }
+    }
+    return false;
+}
+
 bool GCSFilter::MatchAny(const ElementSet& elements) const
 {
+    // Merging with the filter requires sorting the hashed elements. When there
+    // are more of them than there are values in the filter, it is cheaper to
+    // decode the filter and look the elements up in it.
+    if (elements.size() > m_N) return MatchDecoded(elements);
     const std::vector<uint64_t> queries = BuildHashedSet(elements);
     return MatchInternal(queries.data(), queries.size());
 }
@@ -53,6 +53,9 @@ private:
     /** Helper method used to implement Match and MatchAny */
     bool MatchInternal(const uint64_t* sorted_element_hashes, size_t size) const;
 
+    /** Helper method used to implement MatchAny for more elements than the filter holds */
+    bool MatchDecoded(const ElementSet& elements) const;
+
 public:
 
     /** Constructs an empty filter. */
@@ -77,7 +80,8 @@ public:
     /**
      * Checks if any of the given elements may be in the set. False positives
      * are possible with probability 1/M per element checked. This is more
-     * efficient that checking Match on multiple elements separately.
+     * efficient that checking Match on multiple elements separately, and
+     * linear in the number of elements when there are more of them than N.
      */
     bool MatchAny(const ElementSet& elements) const;
 };
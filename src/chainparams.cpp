@@ -313,6 +313,13 @@ public:
             }
         };
 
+        m_assumeutxo_data = MapAssumeutxo{
+            {
+                110,
+                {uint256S("0x783d3dc731c58d17bcf77524ff3c3228ea2b44f6c95d7cc20c74c273cbe6c6d4"), 111},
+            },
+        };
+
         chainTxData = ChainTxData{
             0,
             0,
@@ -11,6 +11,7 @@
 #include <primitives/block.h>
 #include <protocol.h>
 
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -25,6 +26,26 @@ struct CCheckpointData {
     MapCheckpoints mapCheckpoints;
 };
 
+/**
+ * Holds configuration for use during UTXO snapshot load and validation. The contents
+ * here are security critical, since they dictate which UTXO snapshots are recognized
+ * as valid.
+ */
+struct AssumeutxoData {
+    //! The expected MuHash3072 of the deserialized UTXO set, as reported by
+    //! gettxoutsetinfo "muhash".
+    const uint256 muhash;
+
+    //! Used to populate the nChainTx value of the snapshot base block, which
+    //! is used to estimate verification progress.
+    const unsigned int nChainTx;
+};
+
+/**
+ * Mapping from height to the assumeutxo data of the snapshot at that height.
+ */
+using MapAssumeutxo = std::map<int, const AssumeutxoData>;
+
 /**
  * Holds various statistics on transactions within a chain. Used to estimate
  * verification progress during chain sync.
@@ -85,6 +106,12 @@ public:
     const std::string& Bech32HRP() const { return bech32_hrp; }
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
+
+    //! Get allowed assumeutxo configuration. Only regtest has any, so UTXO
+    //! snapshots can't be loaded on the other chains yet.
+    //! @see ChainstateManager
+    const MapAssumeutxo& Assumeutxo() const { return m_assumeutxo_data; }
+
     const ChainTxData& TxData() const { return chainTxData; }
 protected:
     CChainParams() {}
@@ -106,6 +133,7 @@ protected:
     bool m_is_test_chain;
     bool m_is_mockable_chain;
     CCheckpointData checkpointData;
+    MapAssumeutxo m_assumeutxo_data;
     ChainTxData chainTxData;
 };
 
@@ -8,6 +8,10 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -25,6 +29,12 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * By default all workers take their batches from one shared vector. With
+  * EnableWorkStealing(), every worker owns a deque instead: it takes work
+  * from the back of its own deque and, once that is empty, steals from the
+  * front of the others, so the shared mutex is only touched to sleep and
+  * wake up.
   */
 template <typename T>
 class CCheckQueue
@@ -62,6 +72,101 @@ private:
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! A worker's own deque of checks in work-stealing mode
+    struct WorkerQueue {
+        boost::mutex mutex;
+        std::deque<T> checks;
+    };
+
+    //! Per-worker deques; the last one belongs to the master. Empty unless work stealing is enabled.
+    std::vector<std::unique_ptr<WorkerQueue>> m_worker_queues;
+
+    //! Next deque to hand to a thread calling Thread()
+    std::atomic<unsigned int> m_next_worker{0};
+
+    //! Next deque to receive a batch from Add()
+    unsigned int m_next_add{0};
+
+    //! Work-stealing counterparts of nTodo, nIdle and fAllOk, kept outside the shared mutex
+    std::atomic<unsigned int> m_todo{0};
+    std::atomic<unsigned int> m_pending{0};
+    std::atomic<int> m_idle{0};
+    std::atomic<bool> m_all_ok{true};
+
+    /**
+     * Move up to nBatchSize checks into vChecks, preferring the back of the
+     * worker's own deque and otherwise stealing half of another deque from
+     * its front. Returns false if no work was found.
+     */
+    bool TakeWork(unsigned int worker, std::vector<T>& vChecks)
+    {
+        const size_t n_queues = m_worker_queues.size();
+        for (size_t i = 0; i < n_queues; ++i) {
+            const bool own = i == 0;
+            WorkerQueue& wq = *m_worker_queues[(worker + i) % n_queues];
+            boost::unique_lock<boost::mutex> lock(wq.mutex);
+            if (wq.checks.empty()) continue;
+            size_t n = std::min<size_t>(nBatchSize, own ? wq.checks.size() : std::max<size_t>(1, wq.checks.size() / 2));
+            vChecks.resize(n);
+            for (size_t k = 0; k < n; ++k) {
+                if (own) {
+                    vChecks[k].swap(wq.checks.back());
+                    wq.checks.pop_back();
+                } else {
+                    vChecks[k].swap(wq.checks.front());
+                    wq.checks.pop_front();
+                }
+            }
+            m_pending -= n;
+            return true;
+        }
+        return false;
+    }
+
+    /** Work-stealing equivalent of Loop(). */
+    bool LoopStealing(unsigned int worker, bool fMaster = false)
+    {
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        do {
+            if (!TakeWork(worker, vChecks)) {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                if (fMaster) {
+                    // Only the master adds work, so nothing new can show up
+                    // here; wait for the checks other workers still hold.
+                    while (m_todo > 0 && m_pending == 0) {
+                        condMaster.wait(lock);
+                    }
+                    if (m_todo == 0) {
+                        // reset the status for new work later
+                        return m_all_ok.exchange(true);
+                    }
+                } else {
+                    m_idle++;
+                    while (m_pending == 0) {
+                        condWorker.wait(lock);
+                    }
+                    m_idle--;
+                }
+                continue;
+            }
+            // execute work
+            bool fOk = m_all_ok;
+            for (T& check : vChecks)
+                if (fOk)
+                    fOk = check();
+            if (!fOk) m_all_ok = false;
+            // Destroy the checks before reporting them done, like Loop() does.
+            const unsigned int nNow = vChecks.size();
+            vChecks.clear();
+            if (m_todo.fetch_sub(nNow) == nNow && !fMaster) {
+                // We processed the last element; inform the master it can exit and return the result
+                boost::unique_lock<boost::mutex> lock(mutex);
+                condMaster.notify_one();
+            }
+        } while (true);
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
@@ -129,21 +234,67 @@ public:
     //! Create a new check queue
     explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
 
+    /**
+     * Give every worker its own deque and let idle workers steal from the
+     * others. Must be called before any thread enters Thread(); num_workers
+     * is the number of threads that will.
+     */
+    void EnableWorkStealing(int num_workers)
+    {
+        assert(m_worker_queues.empty() && num_workers >= 0);
+        for (int i = 0; i <= num_workers; ++i) {
+            m_worker_queues.emplace_back(new WorkerQueue());
+        }
+    }
+
     //! Worker thread
     void Thread()
     {
+        if (!m_worker_queues.empty()) {
+            // The last deque is reserved for the master.
+            const unsigned int n_workers = m_worker_queues.size() - 1;
+            LoopStealing(n_workers ? m_next_worker++ % n_workers : 0);
+            return;
+        }
         Loop();
     }
 
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
+        if (!m_worker_queues.empty()) {
+            return LoopStealing(m_worker_queues.size() - 1, true);
+        }
         return Loop(true);
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
+        if (!m_worker_queues.empty()) {
+            if (vChecks.empty()) return;
+            // Count the checks before publishing them, so that no worker can
+            // finish one that is not yet accounted for.
+            m_todo += vChecks.size();
+            m_pending += vChecks.size();
+            // Hand each batch to the next worker in turn; stealing evens out the rest.
+            WorkerQueue& wq = *m_worker_queues[m_next_add++ % m_worker_queues.size()];
+            {
+                boost::unique_lock<boost::mutex> lock(wq.mutex);
+                for (T& check : vChecks) {
+                    wq.checks.emplace_back();
+                    check.swap(wq.checks.back());
+                }
+            }
+            if (m_idle > 0) {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                if (vChecks.size() == 1)
+                    condWorker.notify_one();
+                else
+                    condWorker.notify_all();
+            }
+            return;
+        }
         boost::unique_lock<boost::mutex> lock(mutex);
         for (T& check : vChecks) {
             queue.push_back(T());
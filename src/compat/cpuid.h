@@ -20,5 +20,25 @@ void static inline GetCPUID(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32
 #endif
 }
 
+/** Check whether the OS has enabled AVX registers. Requires XSAVE support. */
+bool static inline AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+
+/** Check whether the CPU supports AVX2 and the OS has enabled the AVX registers. */
+bool static inline HaveAVX2()
+{
+    uint32_t a, b, c, d;
+    GetCPUID(1, 0, a, b, c, d);
+    const bool have_xsave = (c >> 27) & 1;
+    const bool have_avx = (c >> 28) & 1;
+    if (!have_xsave || !have_avx || !AVXEnabled()) return false;
+    GetCPUID(7, 0, a, b, c, d);
+    return (b >> 5) & 1;
+}
+
 #endif // defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
 #endif // BITCOIN_COMPAT_CPUID_H
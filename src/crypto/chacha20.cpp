@@ -10,6 +10,64 @@
 
 #include <string.h>
 
+#include <compat/cpuid.h>
+
+namespace chacha20_sse2
+{
+void Crypt_4way(const uint32_t* input, const unsigned char* m, unsigned char* c);
+}
+
+namespace chacha20_avx2
+{
+void Crypt_8way(const uint32_t* input, const unsigned char* m, unsigned char* c);
+}
+
+namespace
+{
+/** A multi-block kernel computes a fixed number of consecutive blocks, starting at
+ *  the block counter in input[12..13], and XORs them into m (or outputs the plain
+ *  keystream if m is nullptr). It does not advance the block counter. */
+typedef void (*CryptBlocksFn)(const uint32_t* input, const unsigned char* m, unsigned char* c);
+
+#if defined(__SSE2__)
+// SSE2 is part of the x86_64 baseline, so it does not need runtime detection.
+CryptBlocksFn CryptBlocks4 = chacha20_sse2::Crypt_4way;
+#else
+CryptBlocksFn CryptBlocks4 = nullptr;
+#endif
+CryptBlocksFn CryptBlocks8 = nullptr;
+
+void inline Advance(uint32_t* input, uint64_t blocks)
+{
+    uint64_t pos = (input[12] | ((uint64_t)input[13] << 32)) + blocks;
+    input[12] = pos;
+    input[13] = pos >> 32;
+}
+
+/** Process as many whole groups of blocks as the multi-block kernels allow. */
+void CryptMultiBlock(uint32_t* input, const unsigned char*& m, unsigned char*& c, size_t& bytes)
+{
+    if (CryptBlocks8) {
+        while (bytes >= 512) {
+            CryptBlocks8(input, m, c);
+            Advance(input, 8);
+            if (m) m += 512;
+            c += 512;
+            bytes -= 512;
+        }
+    }
+    if (CryptBlocks4) {
+        while (bytes >= 256) {
+            CryptBlocks4(input, m, c);
+            Advance(input, 4);
+            if (m) m += 256;
+            c += 256;
+            bytes -= 256;
+        }
+    }
+}
+} // namespace
+
 constexpr static inline uint32_t rotl32(uint32_t v, int c) { return (v << c) | (v >> (32 - c)); }
 
 #define QUARTERROUND(a,b,c,d) \
@@ -79,6 +137,8 @@ void ChaCha20::Keystream(unsigned char* c, size_t bytes)
     unsigned char tmp[64];
     unsigned int i;
 
+    const unsigned char* m = nullptr;
+    CryptMultiBlock(input, m, c, bytes);
     if (!bytes) return;
 
     j0 = input[0];
@@ -187,6 +247,7 @@ void ChaCha20::Crypt(const unsigned char* m, unsigned char* c, size_t bytes)
     unsigned char tmp[64];
     unsigned int i;
 
+    CryptMultiBlock(input, m, c, bytes);
     if (!bytes) return;
 
     j0 = input[0];
@@ -308,3 +369,38 @@ void ChaCha20::Crypt(const unsigned char* m, unsigned char* c, size_t bytes)
         m += 64;
     }
 }
+
+bool ChaCha20SelectImplementation(const std::string& name)
+{
+    if (name == "standard") {
+        CryptBlocks4 = nullptr;
+        CryptBlocks8 = nullptr;
+        return true;
+    }
+#if defined(__SSE2__)
+    if (name == "sse2") {
+        CryptBlocks4 = chacha20_sse2::Crypt_4way;
+        CryptBlocks8 = nullptr;
+        return true;
+    }
+#endif
+#if defined(USE_ASM) && defined(HAVE_GETCPUID) && defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (name == "avx2" && HaveAVX2()) {
+#if defined(__SSE2__)
+        CryptBlocks4 = chacha20_sse2::Crypt_4way;
+#endif
+        CryptBlocks8 = chacha20_avx2::Crypt_8way;
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::string ChaCha20AutoDetect()
+{
+    for (const char* name : {"avx2", "sse2"}) {
+        if (ChaCha20SelectImplementation(name)) return name;
+    }
+    ChaCha20SelectImplementation("standard");
+    return "standard";
+}
@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 /** A class for ChaCha20 256-bit stream cipher developed by Daniel J. Bernstein
     https://cr.yp.to/chacha/chacha-20080128.pdf */
@@ -31,4 +32,15 @@ public:
     void Crypt(const unsigned char* input, unsigned char* output, size_t bytes);
 };
 
+/** Autodetect the best available multi-block ChaCha20 implementation.
+ *  Returns the name of the implementation.
+ */
+std::string ChaCha20AutoDetect();
+
+/** Use the named ChaCha20 implementation ("standard", "sse2" or "avx2").
+ *  Returns false if it is not available in this build or on this CPU.
+ *  Intended for tests and benchmarks that compare the implementations.
+ */
+bool ChaCha20SelectImplementation(const std::string& name);
+
 #endif // BITCOIN_CRYPTO_CHACHA20_H
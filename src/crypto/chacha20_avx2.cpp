@@ -0,0 +1,91 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// This is a translation to AVX2 intrinsics of the ChaCha20 block function,
+// computing eight consecutive blocks in parallel.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace chacha20_avx2 {
+namespace {
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+template <int n> __m256i inline Rotl(__m256i x) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+template <> __m256i inline Rotl<16>(__m256i x) { return _mm256_shuffle_epi8(x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2, 13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2)); }
+template <> __m256i inline Rotl<8>(__m256i x) { return _mm256_shuffle_epi8(x, _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3, 14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3)); }
+
+void inline __attribute__((always_inline)) QuarterRound(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    a = Add(a, b); d = Rotl<16>(Xor(d, a));
+    c = Add(c, d); b = Rotl<12>(Xor(b, c));
+    a = Add(a, b); d = Rotl<8>(Xor(d, a));
+    c = Add(c, d); b = Rotl<7>(Xor(b, c));
+}
+
+/** Transpose four state words of eight blocks. Afterwards the lower 128 bits of
+ *  t[i] hold the words of block i, the upper 128 bits those of block i + 4. */
+void inline __attribute__((always_inline)) Transpose(__m256i t[4], __m256i a, __m256i b, __m256i c, __m256i d)
+{
+    __m256i t0 = _mm256_unpacklo_epi32(a, b);
+    __m256i t1 = _mm256_unpacklo_epi32(c, d);
+    __m256i t2 = _mm256_unpackhi_epi32(a, b);
+    __m256i t3 = _mm256_unpackhi_epi32(c, d);
+    t[0] = _mm256_unpacklo_epi64(t0, t1);
+    t[1] = _mm256_unpackhi_epi64(t0, t1);
+    t[2] = _mm256_unpacklo_epi64(t2, t3);
+    t[3] = _mm256_unpackhi_epi64(t2, t3);
+}
+
+/** Write eight state words of eight blocks to offset 'off' of each block. */
+void inline __attribute__((always_inline)) Write(unsigned char* out, const unsigned char* in, int off, __m256i x0, __m256i x1, __m256i x2, __m256i x3, __m256i x4, __m256i x5, __m256i x6, __m256i x7)
+{
+    __m256i lo[4], hi[4];
+    Transpose(lo, x0, x1, x2, x3);
+    Transpose(hi, x4, x5, x6, x7);
+    for (int i = 0; i < 4; ++i) {
+        __m256i block[2] = {_mm256_permute2x128_si256(lo[i], hi[i], 0x20), _mm256_permute2x128_si256(lo[i], hi[i], 0x31)};
+        for (int k = 0; k < 2; ++k) {
+            const int pos = 64 * (i + 4 * k) + off;
+            if (in) block[k] = Xor(block[k], _mm256_loadu_si256((const __m256i*)(in + pos)));
+            _mm256_storeu_si256((__m256i*)(out + pos), block[k]);
+        }
+    }
+}
+
+}
+
+void Crypt_8way(const uint32_t* input, const unsigned char* m, unsigned char* c)
+{
+    const uint64_t pos = input[12] | ((uint64_t)input[13] << 32);
+    __m256i j[16];
+    for (int i = 0; i < 16; ++i) j[i] = _mm256_set1_epi32(input[i]);
+    j[12] = _mm256_set_epi32((uint32_t)(pos + 7), (uint32_t)(pos + 6), (uint32_t)(pos + 5), (uint32_t)(pos + 4),
+                             (uint32_t)(pos + 3), (uint32_t)(pos + 2), (uint32_t)(pos + 1), (uint32_t)pos);
+    j[13] = _mm256_set_epi32((pos + 7) >> 32, (pos + 6) >> 32, (pos + 5) >> 32, (pos + 4) >> 32,
+                             (pos + 3) >> 32, (pos + 2) >> 32, (pos + 1) >> 32, pos >> 32);
+
+    __m256i x0 = j[0], x1 = j[1], x2 = j[2], x3 = j[3], x4 = j[4], x5 = j[5], x6 = j[6], x7 = j[7];
+    __m256i x8 = j[8], x9 = j[9], x10 = j[10], x11 = j[11], x12 = j[12], x13 = j[13], x14 = j[14], x15 = j[15];
+    for (int i = 0; i < 10; ++i) {
+        QuarterRound(x0, x4, x8, x12);
+        QuarterRound(x1, x5, x9, x13);
+        QuarterRound(x2, x6, x10, x14);
+        QuarterRound(x3, x7, x11, x15);
+        QuarterRound(x0, x5, x10, x15);
+        QuarterRound(x1, x6, x11, x12);
+        QuarterRound(x2, x7, x8, x13);
+        QuarterRound(x3, x4, x9, x14);
+    }
+
+    Write(c, m, 0, Add(x0, j[0]), Add(x1, j[1]), Add(x2, j[2]), Add(x3, j[3]), Add(x4, j[4]), Add(x5, j[5]), Add(x6, j[6]), Add(x7, j[7]));
+    Write(c, m, 32, Add(x8, j[8]), Add(x9, j[9]), Add(x10, j[10]), Add(x11, j[11]), Add(x12, j[12]), Add(x13, j[13]), Add(x14, j[14]), Add(x15, j[15]));
+}
+
+}
+
+#endif
@@ -0,0 +1,74 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// This is a translation to SSE2 intrinsics of the ChaCha20 block function,
+// computing four consecutive blocks in parallel.
+
+#if defined(__SSE2__)
+
+#include <stdint.h>
+#include <emmintrin.h>
+
+namespace chacha20_sse2 {
+namespace {
+
+__m128i inline Add(__m128i x, __m128i y) { return _mm_add_epi32(x, y); }
+__m128i inline Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+template <int n> __m128i inline Rotl(__m128i x) { return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n)); }
+template <> __m128i inline Rotl<16>(__m128i x) { return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1); }
+
+void inline __attribute__((always_inline)) QuarterRound(__m128i& a, __m128i& b, __m128i& c, __m128i& d)
+{
+    a = Add(a, b); d = Rotl<16>(Xor(d, a));
+    c = Add(c, d); b = Rotl<12>(Xor(b, c));
+    a = Add(a, b); d = Rotl<8>(Xor(d, a));
+    c = Add(c, d); b = Rotl<7>(Xor(b, c));
+}
+
+/** Transpose four state words of four blocks and write them to offset 'off' of each block. */
+void inline __attribute__((always_inline)) Write(unsigned char* out, const unsigned char* in, int off, __m128i a, __m128i b, __m128i c, __m128i d)
+{
+    __m128i t0 = _mm_unpacklo_epi32(a, b);
+    __m128i t1 = _mm_unpacklo_epi32(c, d);
+    __m128i t2 = _mm_unpackhi_epi32(a, b);
+    __m128i t3 = _mm_unpackhi_epi32(c, d);
+    __m128i block[4] = {_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1), _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)};
+    for (int i = 0; i < 4; ++i) {
+        if (in) block[i] = Xor(block[i], _mm_loadu_si128((const __m128i*)(in + 64 * i + off)));
+        _mm_storeu_si128((__m128i*)(out + 64 * i + off), block[i]);
+    }
+}
+
+}
+
+void Crypt_4way(const uint32_t* input, const unsigned char* m, unsigned char* c)
+{
+    const uint64_t pos = input[12] | ((uint64_t)input[13] << 32);
+    __m128i j[16];
+    for (int i = 0; i < 16; ++i) j[i] = _mm_set1_epi32(input[i]);
+    j[12] = _mm_set_epi32((uint32_t)(pos + 3), (uint32_t)(pos + 2), (uint32_t)(pos + 1), (uint32_t)pos);
+    j[13] = _mm_set_epi32((pos + 3) >> 32, (pos + 2) >> 32, (pos + 1) >> 32, pos >> 32);
+
+    __m128i x0 = j[0], x1 = j[1], x2 = j[2], x3 = j[3], x4 = j[4], x5 = j[5], x6 = j[6], x7 = j[7];
+    __m128i x8 = j[8], x9 = j[9], x10 = j[10], x11 = j[11], x12 = j[12], x13 = j[13], x14 = j[14], x15 = j[15];
+    for (int i = 0; i < 10; ++i) {
+        QuarterRound(x0, x4, x8, x12);
+        QuarterRound(x1, x5, x9, x13);
+        QuarterRound(x2, x6, x10, x14);
+        QuarterRound(x3, x7, x11, x15);
+        QuarterRound(x0, x5, x10, x15);
+        QuarterRound(x1, x6, x11, x12);
+        QuarterRound(x2, x7, x8, x13);
+        QuarterRound(x3, x4, x9, x14);
+    }
+
+    Write(c, m, 0, Add(x0, j[0]), Add(x1, j[1]), Add(x2, j[2]), Add(x3, j[3]));
+    Write(c, m, 16, Add(x4, j[4]), Add(x5, j[5]), Add(x6, j[6]), Add(x7, j[7]));
+    Write(c, m, 32, Add(x8, j[8]), Add(x9, j[9]), Add(x10, j[10]), Add(x11, j[11]));
+    Write(c, m, 48, Add(x12, j[12]), Add(x13, j[13]), Add(x14, j[14]), Add(x15, j[15]));
+}
+
+}
+
+#endif
@@ -0,0 +1,190 @@
+// Copyright (c) 2017-2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/muhash.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+
+#include <assert.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+using limb_t = Num3072::limb_t;
+using double_limb_t = Num3072::double_limb_t;
+constexpr int LIMB_SIZE = Num3072::LIMB_SIZE;
+constexpr int LIMBS = Num3072::LIMBS;
+/** 2^3072 - 1103717 is the largest 3072-bit safe prime number, is used as the modulus. */
+constexpr limb_t MAX_PRIME_DIFF = 1103717;
+
+/** Add a to limbs in place, propagating the carry. Returns the carry out of the top limb. */
+inline limb_t AddSmall(limb_t (&limbs)[LIMBS], double_limb_t a)
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        a += limbs[i];
+        limbs[i] = (limb_t)a;
+        a >>= LIMB_SIZE;
+    }
+    return (limb_t)a;
+}
+
+} // namespace
+
+/** Indicates whether this is not fully reduced, i.e. at least the modulus. */
+bool Num3072::IsOverflow() const
+{
+    if (this->limbs[0] <= std::numeric_limits<limb_t>::max() - MAX_PRIME_DIFF) return false;
+    for (int i = 1; i < LIMBS; ++i) {
+        if (this->limbs[i] != std::numeric_limits<limb_t>::max()) return false;
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // Subtracting the modulus is the same as adding 2^3072 - modulus and
+    // dropping the 2^3072 bit.
+    AddSmall(this->limbs, MAX_PRIME_DIFF);
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    // Schoolbook multiplication into a double-width product.
+    limb_t prod[2 * LIMBS] = {0};
+    for (int i = 0; i < LIMBS; ++i) {
+        double_limb_t carry = 0;
+        for (int j = 0; j < LIMBS; ++j) {
+            double_limb_t t = (double_limb_t)this->limbs[i] * a.limbs[j] + prod[i + j] + carry;
+            prod[i + j] = (limb_t)t;
+            carry = t >> LIMB_SIZE;
+        }
+        prod[i + LIMBS] = (limb_t)carry;
+    }
+
+    // As 2^3072 is congruent to MAX_PRIME_DIFF, fold the high half onto the
+    // low half multiplied by MAX_PRIME_DIFF.
+    limb_t res[LIMBS];
+    double_limb_t c = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        c += (double_limb_t)prod[i + LIMBS] * MAX_PRIME_DIFF + prod[i];
+        res[i] = (limb_t)c;
+        c >>= LIMB_SIZE;
+    }
+    // Fold the remaining top bits twice; the second fold can only be needed
+    // when the first one wrapped around, so after it nothing is left.
+    limb_t top = AddSmall(res, c * MAX_PRIME_DIFF);
+    top = AddSmall(res, (double_limb_t)top * MAX_PRIME_DIFF);
+    assert(top == 0);
+
+    std::copy(res, res + LIMBS, this->limbs);
+    if (this->IsOverflow()) this->FullReduce();
+}
+
+void Num3072::SetToOne()
+{
+    this->limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i) {
+        this->limbs[i] = 0;
+    }
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // By Fermat's little theorem, the inverse is this^(p-2), computed here by
+    // square-and-multiply. The exponent p-2 has every bit set except for a
+    // few in its lowest limb.
+    Num3072 out;
+    for (int i = LIMBS - 1; i >= 0; --i) {
+        const limb_t exp = i == 0 ? std::numeric_limits<limb_t>::max() - MAX_PRIME_DIFF - 1 : std::numeric_limits<limb_t>::max();
+        for (int bit = LIMB_SIZE - 1; bit >= 0; --bit) {
+            out.Multiply(out);
+            if ((exp >> bit) & 1) out.Multiply(*this);
+        }
+    }
+    return out;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    this->Multiply(a.GetInverse());
+}
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            this->limbs[i] = ReadLE32(data + 4 * i);
+        } else if (sizeof(limb_t) == 8) {
+            this->limbs[i] = ReadLE64(data + 8 * i);
+        }
+    }
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE])
+{
+    if (this->IsOverflow()) this->FullReduce();
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            WriteLE32(out + i * 4, this->limbs[i]);
+        } else if (sizeof(limb_t) == 8) {
+            WriteLE64(out + i * 8, this->limbs[i]);
+        }
+    }
+}
+
+Num3072 MuHash3072::ToNum3072(Span<const unsigned char> in)
+{
+    unsigned char tmp[Num3072::BYTE_SIZE];
+
+    uint256 hashed_in;
+    CSHA256().Write(in.data(), in.size()).Finalize(hashed_in.begin());
+    ChaCha20(hashed_in.begin(), hashed_in.size()).Keystream(tmp, Num3072::BYTE_SIZE);
+    Num3072 out{tmp};
+
+    return out;
+}
+
+MuHash3072::MuHash3072(Span<const unsigned char> in) noexcept
+{
+    m_numerator = ToNum3072(in);
+}
+
+void MuHash3072::Finalize(uint256& out) noexcept
+{
+    m_numerator.Divide(m_denominator);
+    m_denominator.SetToOne();  // Needed to keep the MuHash object valid
+
+    unsigned char data[Num3072::BYTE_SIZE];
+    m_numerator.ToBytes(data);
+
+    CSHA256().Write(data, Num3072::BYTE_SIZE).Finalize(out.begin());
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul) noexcept
+{
+    m_numerator.Multiply(mul.m_numerator);
+    m_denominator.Multiply(mul.m_denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div) noexcept
+{
+    m_numerator.Multiply(div.m_denominator);
+    m_denominator.Multiply(div.m_numerator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::Insert(Span<const unsigned char> in) noexcept {
+    m_numerator.Multiply(ToNum3072(in));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(Span<const unsigned char> in) noexcept {
+    m_denominator.Multiply(ToNum3072(in));
+    return *this;
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2017-2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <serialize.h>
+#include <span.h>
+#include <uint256.h>
+
+#include <stdint.h>
+
+/** An integer modulo the prime 2^3072 - 1103717, the largest 3072-bit safe prime. */
+class Num3072
+{
+private:
+    void FullReduce();
+    bool IsOverflow() const;
+    Num3072 GetInverse() const;
+
+public:
+    static constexpr size_t BYTE_SIZE = 384;
+
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static constexpr int LIMBS = 48;
+    static constexpr int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static constexpr int LIMBS = 96;
+    static constexpr int LIMB_SIZE = 32;
+#endif
+    limb_t limbs[LIMBS];
+
+    // Sanity check for Num3072 constants
+    static_assert(LIMB_SIZE * LIMBS == 3072, "Num3072 isn't 3072 bits");
+    static_assert(sizeof(double_limb_t) == sizeof(limb_t) * 2, "bad size for double_limb_t");
+    static_assert(sizeof(limb_t) * 8 == LIMB_SIZE, "LIMB_SIZE is incorrect");
+
+    /** Set this to a * this mod p. */
+    void Multiply(const Num3072& a);
+    /** Set this to this / a mod p. a must not be zero. */
+    void Divide(const Num3072& a);
+    void SetToOne();
+    /** Write the fully reduced value as 384 little-endian bytes. */
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]);
+
+    Num3072() { this->SetToOne(); };
+    /** Construct from 384 little-endian bytes. The value may exceed the modulus. */
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    SERIALIZE_METHODS(Num3072, obj)
+    {
+        for (auto& limb : obj.limbs) {
+            READWRITE(limb);
+        }
+    }
+};
+
+/** A hash of a multiset of byte strings, which can be updated incrementally.
+ *
+ * Every element is hashed with SHA256, expanded to 3072 bits with ChaCha20
+ * and interpreted as a number modulo a 3072-bit prime. The multiset is the
+ * product of all its elements, so adding an element is a multiplication and
+ * removing it is a division, and the order of updates does not matter.
+ *
+ * To keep updates cheap, additions and removals are accumulated in a
+ * separate numerator and denominator; the single modular inversion this
+ * requires is only performed by Finalize().
+ *
+ * The final result is the SHA256 of the 384-byte little-endian encoding of
+ * the product. As the group is only used as a multiset hash, the security
+ * relies on the hardness of the discrete logarithm problem in it; see
+ * https://cseweb.ucsd.edu/~mihir/papers/inchash.pdf for the construction and
+ * https://lists.linuxfoundation.org/pipermail/bitcoin-dev/2017-May/014337.html
+ * for its use on the UTXO set.
+ */
+class MuHash3072
+{
+private:
+    Num3072 m_numerator;
+    Num3072 m_denominator;
+
+    Num3072 ToNum3072(Span<const unsigned char> in);
+
+public:
+    /* The empty set. */
+    MuHash3072() noexcept {};
+
+    /* A singleton with variable sized data in it. */
+    explicit MuHash3072(Span<const unsigned char> in) noexcept;
+
+    /* Insert a single piece of data into the set. */
+    MuHash3072& Insert(Span<const unsigned char> in) noexcept;
+
+    /* Remove a single piece of data from the set. */
+    MuHash3072& Remove(Span<const unsigned char> in) noexcept;
+
+    /* Multiply (resulting in a hash for the union of the sets) */
+    MuHash3072& operator*=(const MuHash3072& mul) noexcept;
+
+    /* Divide (resulting in a hash for the difference of the sets) */
+    MuHash3072& operator/=(const MuHash3072& div) noexcept;
+
+    /* Finalize into a 32-byte hash. Does not change this object's value. */
+    void Finalize(uint256& out) noexcept;
+
+    SERIALIZE_METHODS(MuHash3072, obj)
+    {
+        READWRITE(obj.m_numerator);
+        READWRITE(obj.m_denominator);
+    }
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
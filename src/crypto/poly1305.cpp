@@ -10,6 +10,23 @@
 
 #include <string.h>
 
+#include <compat/cpuid.h>
+
+namespace poly1305_avx2
+{
+void Blocks_4way(uint32_t h[5], const uint32_t r[5], const unsigned char* m, size_t groups);
+}
+
+namespace
+{
+/** Multi-block kernel; absorbs groups of four full 16-byte blocks into the accumulator h. */
+typedef void (*BlocksFn)(uint32_t h[5], const uint32_t r[5], const unsigned char* m, size_t groups);
+BlocksFn Blocks4 = nullptr;
+
+/** Below this message length computing the powers of r costs more than the kernel saves. */
+constexpr size_t MULTI_BLOCK_MIN_LEN = 256;
+} // namespace
+
 #define mul32x32_64(a,b) ((uint64_t)(a) * (b))
 
 void poly1305_auth(unsigned char out[POLY1305_TAGLEN], const unsigned char *m, size_t inlen, const unsigned char key[POLY1305_KEYLEN]) {
@@ -50,6 +67,16 @@ void poly1305_auth(unsigned char out[POLY1305_TAGLEN], const unsigned char *m, s
     h3 = 0;
     h4 = 0;
 
+    if (Blocks4 && inlen >= MULTI_BLOCK_MIN_LEN) {
+        uint32_t h[5] = {h0, h1, h2, h3, h4};
+        const uint32_t r[5] = {r0, r1, r2, r3, r4};
+        const size_t groups = inlen / 64;
+        Blocks4(h, r, m, groups);
+        h0 = h[0]; h1 = h[1]; h2 = h[2]; h3 = h[3]; h4 = h[4];
+        m += groups * 64;
+        inlen -= groups * 64;
+    }
+
     /* full blocks */
     if (inlen < 16) goto poly1305_donna_atmost15bytes;
 poly1305_donna_16bytes:
@@ -139,3 +166,25 @@ poly1305_donna_finish:
     WriteLE32(&out[ 8], f2); f3 += (f2 >> 32);
     WriteLE32(&out[12], f3);
 }
+
+bool Poly1305SelectImplementation(const std::string& name)
+{
+    if (name == "standard") {
+        Blocks4 = nullptr;
+        return true;
+    }
+#if defined(USE_ASM) && defined(HAVE_GETCPUID) && defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (name == "avx2" && HaveAVX2()) {
+        Blocks4 = poly1305_avx2::Blocks_4way;
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::string Poly1305AutoDetect()
+{
+    if (Poly1305SelectImplementation("avx2")) return "avx2";
+    Poly1305SelectImplementation("standard");
+    return "standard";
+}
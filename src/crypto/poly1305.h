@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 #define POLY1305_KEYLEN 32
 #define POLY1305_TAGLEN 16
@@ -14,4 +15,15 @@
 void poly1305_auth(unsigned char out[POLY1305_TAGLEN], const unsigned char *m, size_t inlen,
     const unsigned char key[POLY1305_KEYLEN]);
 
+/** Autodetect the best available Poly1305 implementation.
+ *  Returns the name of the implementation.
+ */
+std::string Poly1305AutoDetect();
+
+/** Use the named Poly1305 implementation ("standard" or "avx2").
+ *  Returns false if it is not available in this build or on this CPU.
+ *  Intended for tests and benchmarks that compare the implementations.
+ */
+bool Poly1305SelectImplementation(const std::string& name);
+
 #endif // BITCOIN_CRYPTO_POLY1305_H
@@ -0,0 +1,124 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Poly1305 over four interleaved streams of 16-byte blocks using AVX2 intrinsics.
+// Each 64-bit lane holds one accumulator in five 26-bit limbs, like the scalar
+// implementation. Lane i accumulates blocks i, i + 4, i + 8, ... multiplied by r^4,
+// and the last group of blocks is multiplied by r^4, r^3, r^2 and r respectively,
+// after which the four lanes sum up to the sequential result.
+
+#ifdef ENABLE_AVX2
+
+#include <stddef.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace poly1305_avx2 {
+namespace {
+
+/** Multiply a and b modulo 2^130 - 5, in 26-bit limbs. */
+void Mul(uint32_t out[5], const uint32_t a[5], const uint32_t b[5])
+{
+    const uint64_t s1 = b[1] * 5, s2 = b[2] * 5, s3 = b[3] * 5, s4 = b[4] * 5;
+    uint64_t t0 = (uint64_t)a[0] * b[0] + a[1] * s4 + a[2] * s3 + a[3] * s2 + a[4] * s1;
+    uint64_t t1 = (uint64_t)a[0] * b[1] + (uint64_t)a[1] * b[0] + a[2] * s4 + a[3] * s3 + a[4] * s2;
+    uint64_t t2 = (uint64_t)a[0] * b[2] + (uint64_t)a[1] * b[1] + (uint64_t)a[2] * b[0] + a[3] * s4 + a[4] * s3;
+    uint64_t t3 = (uint64_t)a[0] * b[3] + (uint64_t)a[1] * b[2] + (uint64_t)a[2] * b[1] + (uint64_t)a[3] * b[0] + a[4] * s4;
+    uint64_t t4 = (uint64_t)a[0] * b[4] + (uint64_t)a[1] * b[3] + (uint64_t)a[2] * b[2] + (uint64_t)a[3] * b[1] + (uint64_t)a[4] * b[0];
+
+    t1 += t0 >> 26; out[0] = t0 & 0x3ffffff;
+    t2 += t1 >> 26; out[1] = t1 & 0x3ffffff;
+    t3 += t2 >> 26; out[2] = t2 & 0x3ffffff;
+    t4 += t3 >> 26; out[3] = t3 & 0x3ffffff;
+    out[4] = t4 & 0x3ffffff;
+    uint64_t c = out[0] + (t4 >> 26) * 5;
+    out[0] = c & 0x3ffffff;
+    out[1] += c >> 26;
+}
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi64(x, y); }
+__m256i inline Mul(__m256i x, __m256i y) { return _mm256_mul_epu32(x, y); }
+__m256i inline Times5(__m256i x) { return Add(x, _mm256_slli_epi64(x, 2)); }
+
+/** h = h * r (mod 2^130 - 5) with partial carry propagation, in every lane. */
+void inline __attribute__((always_inline)) MulR(__m256i h[5], const __m256i r[5], const __m256i s[5])
+{
+    const __m256i mask = _mm256_set1_epi64x(0x3ffffff);
+    __m256i t0 = Add(Add(Mul(h[0], r[0]), Mul(h[1], s[4])), Add(Add(Mul(h[2], s[3]), Mul(h[3], s[2])), Mul(h[4], s[1])));
+    __m256i t1 = Add(Add(Mul(h[0], r[1]), Mul(h[1], r[0])), Add(Add(Mul(h[2], s[4]), Mul(h[3], s[3])), Mul(h[4], s[2])));
+    __m256i t2 = Add(Add(Mul(h[0], r[2]), Mul(h[1], r[1])), Add(Add(Mul(h[2], r[0]), Mul(h[3], s[4])), Mul(h[4], s[3])));
+    __m256i t3 = Add(Add(Mul(h[0], r[3]), Mul(h[1], r[2])), Add(Add(Mul(h[2], r[1]), Mul(h[3], r[0])), Mul(h[4], s[4])));
+    __m256i t4 = Add(Add(Mul(h[0], r[4]), Mul(h[1], r[3])), Add(Add(Mul(h[2], r[2]), Mul(h[3], r[1])), Mul(h[4], r[0])));
+
+    t1 = Add(t1, _mm256_srli_epi64(t0, 26)); h[0] = _mm256_and_si256(t0, mask);
+    t2 = Add(t2, _mm256_srli_epi64(t1, 26)); h[1] = _mm256_and_si256(t1, mask);
+    t3 = Add(t3, _mm256_srli_epi64(t2, 26)); h[2] = _mm256_and_si256(t2, mask);
+    t4 = Add(t4, _mm256_srli_epi64(t3, 26)); h[3] = _mm256_and_si256(t3, mask);
+    h[4] = _mm256_and_si256(t4, mask);
+    h[0] = Add(h[0], Times5(_mm256_srli_epi64(t4, 26)));
+    h[1] = Add(h[1], _mm256_srli_epi64(h[0], 26));
+    h[0] = _mm256_and_si256(h[0], mask);
+}
+
+/** Add four consecutive 16-byte blocks, one per lane, to the accumulators. */
+void inline __attribute__((always_inline)) AddBlocks(__m256i h[5], const unsigned char* m)
+{
+    const __m256i mask = _mm256_set1_epi64x(0x3ffffff);
+    const __m256i a = _mm256_loadu_si256((const __m256i*)m);
+    const __m256i b = _mm256_loadu_si256((const __m256i*)(m + 32));
+    // Gather the low and high 8 bytes of each block, in block order.
+    const __m256i lo = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0xd8);
+    const __m256i hi = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0xd8);
+    h[0] = Add(h[0], _mm256_and_si256(lo, mask));
+    h[1] = Add(h[1], _mm256_and_si256(_mm256_srli_epi64(lo, 26), mask));
+    h[2] = Add(h[2], _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi64(lo, 52), _mm256_slli_epi64(hi, 12)), mask));
+    h[3] = Add(h[3], _mm256_and_si256(_mm256_srli_epi64(hi, 14), mask));
+    h[4] = Add(h[4], _mm256_or_si256(_mm256_srli_epi64(hi, 40), _mm256_set1_epi64x(1 << 24)));
+}
+
+}
+
+void Blocks_4way(uint32_t h[5], const uint32_t r[5], const unsigned char* m, size_t groups)
+{
+    uint32_t r2[5], r3[5], r4[5];
+    Mul(r2, r, r);
+    Mul(r3, r2, r);
+    Mul(r4, r2, r2);
+
+    __m256i vh[5], vr[5], vs[5], vr_last[5], vs_last[5];
+    for (int i = 0; i < 5; ++i) {
+        vh[i] = _mm256_set_epi64x(0, 0, 0, h[i]);
+        vr[i] = _mm256_set1_epi64x(r4[i]);
+        vs[i] = Times5(vr[i]);
+        vr_last[i] = _mm256_set_epi64x(r[i], r2[i], r3[i], r4[i]);
+        vs_last[i] = Times5(vr_last[i]);
+    }
+
+    for (; groups > 1; --groups, m += 64) {
+        AddBlocks(vh, m);
+        MulR(vh, vr, vs);
+    }
+    AddBlocks(vh, m);
+    MulR(vh, vr_last, vs_last);
+
+    // Sum the lanes and carry the result back into 26-bit limbs.
+    uint64_t t[5];
+    for (int i = 0; i < 5; ++i) {
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256((__m256i*)lanes, vh[i]);
+        t[i] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    t[1] += t[0] >> 26; h[0] = t[0] & 0x3ffffff;
+    t[2] += t[1] >> 26; h[1] = t[1] & 0x3ffffff;
+    t[3] += t[2] >> 26; h[2] = t[2] & 0x3ffffff;
+    t[4] += t[3] >> 26; h[3] = t[3] & 0x3ffffff;
+    h[4] = t[4] & 0x3ffffff;
+    uint64_t c = h[0] + (t[4] >> 26) * 5;
+    h[0] = c & 0x3ffffff;
+    h[1] += c >> 26;
+}
+
+}
+
+#endif
@@ -546,16 +546,6 @@ bool SelfTest() {
 
     return true;
 }
-
-#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
-/** Check whether the OS has enabled AVX registers. */
-bool AVXEnabled()
-{
-    uint32_t a, d;
-    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
-    return (a & 6) == 6;
-}
-#endif
 } // namespace
 
 
@@ -564,32 +554,20 @@ std::string SHA256AutoDetect()
     std::string ret = "standard";
 #if defined(USE_ASM) && defined(HAVE_GETCPUID)
     bool have_sse4 = false;
-    bool have_xsave = false;
-    bool have_avx = false;
     bool have_avx2 = false;
     bool have_shani = false;
-    bool enabled_avx = false;
 
-    (void)AVXEnabled;
     (void)have_sse4;
-    (void)have_avx;
-    (void)have_xsave;
     (void)have_avx2;
     (void)have_shani;
-    (void)enabled_avx;
 
     uint32_t eax, ebx, ecx, edx;
     GetCPUID(1, 0, eax, ebx, ecx, edx);
     have_sse4 = (ecx >> 19) & 1;
-    have_xsave = (ecx >> 27) & 1;
-    have_avx = (ecx >> 28) & 1;
-    if (have_xsave && have_avx) {
-        enabled_avx = AVXEnabled();
-    }
     if (have_sse4) {
         GetCPUID(7, 0, eax, ebx, ecx, edx);
-        have_avx2 = (ebx >> 5) & 1;
         have_shani = (ebx >> 29) & 1;
+        have_avx2 = HaveAVX2();
     }
 
 #if defined(ENABLE_SHANI) && !defined(BUILD_BITCOIN_INTERNAL)
@@ -616,7 +594,7 @@ std::string SHA256AutoDetect()
     }
 
 #if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
-    if (have_avx2 && have_avx && enabled_avx) {
+    if (have_avx2) {
         TransformD64_8way = sha256d64_avx2::Transform_8way;
         ret += ",avx2(8way)";
     }
@@ -6,6 +6,8 @@
 
 #include <memory>
 #include <random.h>
+#include <sync.h>
+#include <tinyformat.h>
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -13,6 +15,140 @@
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+#include <map>
+#include <set>
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+
+const std::vector<std::string> DB_PROFILE_NAMES{"chainstate", "blockindex", "txindex", "blockfilterindex"};
+
+static Mutex g_db_profiles_mutex;
+static std::map<std::string, DBProfile> g_db_profiles GUARDED_BY(g_db_profiles_mutex);
+
+bool DBCompressionAvailable()
+{
+#ifdef USE_SNAPPY
+    return true;
+#else
+    return false;
+#endif
+}
+
+DBProfile GetDBProfile(const std::string& name)
+{
+    LOCK(g_db_profiles_mutex);
+    auto it = g_db_profiles.find(name);
+    return it == g_db_profiles.end() ? DBProfile() : it->second;
+}
+
+static bool ParseDBProfileOption(DBProfile& profile, const std::string& option)
+{
+    const size_t eq = option.find('=');
+    if (eq == std::string::npos) return false;
+    const std::string key = option.substr(0, eq);
+    const std::string value = option.substr(eq + 1);
+    int32_t n;
+    if (key == "compression") {
+        if (value != "none" && value != "snappy") return false;
+        profile.compression = value == "snappy";
+    } else if (key == "bloombits") {
+        if (!ParseInt32(value, &n) || n < 0 || n > 32) return false;
+        profile.bloom_bits = n;
+    } else if (key == "blocksize") {
+        if (!ParseInt32(value, &n) || n < 1024 || n > 4 * 1024 * 1024) return false;
+        profile.block_size = n;
+    } else if (key == "blockcache") {
+        if (!ParseInt32(value, &n) || n < 10 || n > 90) return false;
+        profile.block_cache_percent = n;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool SetDBProfiles(const std::vector<std::string>& args, std::string& error)
+{
+    std::map<std::string, DBProfile> profiles;
+    for (const std::string& arg : args) {
+        const size_t colon = arg.find(':');
+        const std::string name = arg.substr(0, colon);
+        if (colon == std::string::npos || std::find(DB_PROFILE_NAMES.begin(), DB_PROFILE_NAMES.end(), name) == DB_PROFILE_NAMES.end()) {
+            error = strprintf("Unknown database in -dbprofile=%s", arg);
+            return false;
+        }
+        DBProfile& profile = profiles[name];
+        std::vector<std::string> options;
+        boost::split(options, arg.substr(colon + 1), boost::is_any_of(","));
+        for (const std::string& option : options) {
+            if (!ParseDBProfileOption(profile, option)) {
+                error = strprintf("Invalid option '%s' in -dbprofile=%s", option, arg);
+                return false;
+            }
+        }
+        if (profile.compression && !DBCompressionAvailable()) {
+            error = strprintf("Compression requested in -dbprofile=%s, but this build does not support Snappy", arg);
+            return false;
+        }
+    }
+    LOCK(g_db_profiles_mutex);
+    g_db_profiles = std::move(profiles);
+    return true;
+}
+
+/** Stats of the lookup running on this thread, if any; see DBReadStats. */
+static thread_local DBReadStats* g_lookup_stats{nullptr};
+
+class CountingRandomAccessFile : public leveldb::RandomAccessFile
+{
+private:
+    const std::unique_ptr<leveldb::RandomAccessFile> m_file;
+
+public:
+    explicit CountingRandomAccessFile(leveldb::RandomAccessFile* file) : m_file(file) {}
+
+    leveldb::Status Read(uint64_t offset, size_t n, leveldb::Slice* result, char* scratch) const override
+    {
+        leveldb::Status status = m_file->Read(offset, n, result, scratch);
+        if (DBReadStats* stats = g_lookup_stats) {
+            ++stats->table_reads;
+            stats->table_read_bytes += result->size();
+        }
+        return status;
+    }
+
+    std::string GetName() const override { return m_file->GetName(); }
+};
+
+/** Environment counting the table reads lookups do, see DBReadStats. Compactions are not counted. */
+class CountingEnv : public leveldb::EnvWrapper
+{
+public:
+    explicit CountingEnv(leveldb::Env* target) : leveldb::EnvWrapper(target) {}
+
+    leveldb::Status NewRandomAccessFile(const std::string& fname, leveldb::RandomAccessFile** result) override
+    {
+        leveldb::Status status = target()->NewRandomAccessFile(fname, result);
+        if (status.ok()) *result = new CountingRandomAccessFile(*result);
+        return status;
+    }
+};
+
+static Mutex g_dbs_mutex;
+static std::set<const CDBWrapper*> g_dbs GUARDED_BY(g_dbs_mutex);
+
+std::vector<DBStats> GetDBStats()
+{
+    std::vector<DBStats> stats;
+    {
+        LOCK(g_dbs_mutex);
+        for (const CDBWrapper* db : g_dbs) {
+            stats.push_back(db->GetStats());
+        }
+    }
+    std::sort(stats.begin(), stats.end(), [](const DBStats& a, const DBStats& b) { return a.name < b.name; });
+    return stats;
+}
 
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
@@ -97,13 +233,25 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static size_t GetBlockCacheSize(size_t nCacheSize, const DBProfile& profile)
+{
+    return nCacheSize / 100 * profile.block_cache_percent;
+}
+
+static size_t GetWriteBufferSize(size_t nCacheSize, const DBProfile& profile)
+{
+    // up to two write buffers may be held in memory simultaneously
+    return (nCacheSize - GetBlockCacheSize(nCacheSize, profile)) / 2;
+}
+
+static leveldb::Options GetOptions(size_t nCacheSize, const DBProfile& profile)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
+    options.block_cache = leveldb::NewLRUCache(GetBlockCacheSize(nCacheSize, profile));
+    options.write_buffer_size = GetWriteBufferSize(nCacheSize, profile);
+    options.filter_policy = profile.bloom_bits > 0 ? leveldb::NewBloomFilterPolicy(profile.bloom_bits) : nullptr;
+    options.block_size = profile.block_size;
+    options.compression = profile.compression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -114,20 +262,22 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
-    : m_name{path.stem().string()}
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const std::string& profile)
+    : m_name{path.stem().string()}, m_path{fMemory ? fs::path() : path}, m_profile_name{profile}, m_profile{GetDBProfile(profile)}, m_cache_size{nCacheSize}
 {
     penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, m_profile);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
-        options.env = penv;
-    } else {
+    }
+    m_counting_env = MakeUnique<CountingEnv>(penv ? penv : leveldb::Env::Default());
+    options.env = m_counting_env.get();
+    if (!fMemory) {
         if (fWipe) {
             LogPrintf("Wiping LevelDB in %s\n", path.string());
             leveldb::Status result = leveldb::DestroyDB(path.string(), options);
@@ -164,10 +314,17 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     }
 
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
+
+    LOCK(g_dbs_mutex);
+    g_dbs.insert(this);
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    {
+        LOCK(g_dbs_mutex);
+        g_dbs.erase(this);
+    }
     delete pdb;
     pdb = nullptr;
     delete options.filter_policy;
@@ -176,10 +333,52 @@ CDBWrapper::~CDBWrapper()
     options.info_log = nullptr;
     delete options.block_cache;
     options.block_cache = nullptr;
+    m_counting_env.reset();
     delete penv;
     options.env = nullptr;
 }
 
+bool CDBWrapper::ReadValue(const leveldb::Slice& key, std::string& value) const
+{
+    ++m_read_stats.lookups;
+    g_lookup_stats = &m_read_stats;
+    leveldb::Status status = pdb->Get(readoptions, key, &value);
+    g_lookup_stats = nullptr;
+    if (!status.ok()) {
+        if (status.IsNotFound())
+            return false;
+        LogPrintf("LevelDB read failure: %s\n", status.ToString());
+        dbwrapper_private::HandleError(status);
+    }
+    m_read_stats.lookup_bytes += value.size();
+    return true;
+}
+
+DBStats CDBWrapper::GetStats() const
+{
+    DBStats stats;
+    stats.name = m_name;
+    stats.profile_name = m_profile_name;
+    stats.profile = m_profile;
+    stats.block_cache_size = GetBlockCacheSize(m_cache_size, m_profile);
+    stats.write_buffer_size = GetWriteBufferSize(m_cache_size, m_profile);
+    stats.disk_size = 0;
+    if (!m_path.empty()) {
+        // Files may come and go while compactions run; count what can be seen.
+        boost::system::error_code ec;
+        for (fs::directory_iterator it(m_path, ec), end; !ec && it != end; it.increment(ec)) {
+            boost::system::error_code size_ec;
+            const uintmax_t size = fs::file_size(it->path(), size_ec);
+            if (!size_ec) stats.disk_size += size;
+        }
+    }
+    stats.lookups = m_read_stats.lookups;
+    stats.lookup_bytes = m_read_stats.lookup_bytes;
+    stats.table_reads = m_read_stats.table_reads;
+    stats.table_read_bytes = m_read_stats.table_read_bytes;
+    return stats;
+}
+
 bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 {
     const bool log_memory = LogAcceptCategory(BCLog::LEVELDB);
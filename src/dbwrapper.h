@@ -15,9 +15,70 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+#include <atomic>
+#include <memory>
+
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 
+/** LevelDB tuning of one kind of database, see -dbprofile */
+struct DBProfile {
+    //! Compress table blocks with Snappy; only takes effect if built with Snappy support
+    bool compression{false};
+    //! Bits per key of the bloom filters, 0 for none
+    int bloom_bits{10};
+    //! Approximate size of the user data packed into each table block
+    size_t block_size{4 * 1024};
+    //! Percentage of the cache size used for the block cache, the rest is split between the two write buffers
+    int block_cache_percent{50};
+};
+
+/** Names of the databases that can be tuned with -dbprofile */
+extern const std::vector<std::string> DB_PROFILE_NAMES;
+
+/** Get the profile configured for the named database, or the default profile. */
+DBProfile GetDBProfile(const std::string& name);
+
+/**
+ * Configure database profiles from -dbprofile arguments of the form
+ * <name>:<option>=<value>[,<option>=<value>...]. Returns false and sets
+ * error if one of them cannot be parsed.
+ */
+bool SetDBProfiles(const std::vector<std::string>& args, std::string& error);
+
+/** Whether LevelDB tables can be compressed in this build. */
+bool DBCompressionAvailable();
+
+/** Reads from a database, counted to measure its read amplification. */
+struct DBReadStats {
+    //! Point lookups (Read and Exists)
+    std::atomic<uint64_t> lookups{0};
+    //! Bytes of the values found by the lookups
+    std::atomic<uint64_t> lookup_bytes{0};
+    //! Table block reads done by the lookups that missed the block cache
+    std::atomic<uint64_t> table_reads{0};
+    //! Bytes of those table block reads
+    std::atomic<uint64_t> table_read_bytes{0};
+};
+
+/** Statistics of an open database, reported by getdbstats. */
+struct DBStats {
+    std::string name;
+    std::string profile_name;
+    DBProfile profile;
+    size_t block_cache_size;
+    size_t write_buffer_size;
+    //! Bytes in the database directory, 0 for an in-memory database
+    uint64_t disk_size;
+    uint64_t lookups;
+    uint64_t lookup_bytes;
+    uint64_t table_reads;
+    uint64_t table_read_bytes;
+};
+
+/** Get the statistics of all open databases. */
+std::vector<DBStats> GetDBStats();
+
 class dbwrapper_error : public std::runtime_error
 {
 public:
@@ -179,6 +240,9 @@ private:
     //! custom environment this database is using (may be nullptr in case of default environment)
     leveldb::Env* penv;
 
+    //! environment wrapper counting table reads, used for all file access of this database
+    std::unique_ptr<leveldb::Env> m_counting_env;
+
     //! database options used
     leveldb::Options options;
 
@@ -200,6 +264,19 @@ private:
     //! the name of this database
     std::string m_name;
 
+    //! location of this database, empty if it is in memory
+    fs::path m_path;
+
+    //! the profile this database was opened with
+    std::string m_profile_name;
+    DBProfile m_profile;
+
+    //! the cache size this database was opened with
+    size_t m_cache_size;
+
+    //! lookups done on this database
+    mutable DBReadStats m_read_stats;
+
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
@@ -211,6 +288,9 @@ private:
 
     std::vector<unsigned char> CreateObfuscateKey() const;
 
+    //! Look up a raw value, counting the reads it takes. Returns false if the key is not found.
+    bool ReadValue(const leveldb::Slice& key, std::string& value) const;
+
 public:
     /**
      * @param[in] path        Location in the filesystem where leveldb data will be stored.
@@ -219,10 +299,14 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] profile     Name of the -dbprofile to tune the database with, empty for the default.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const std::string& profile = "");
     ~CDBWrapper();
 
+    //! Get the statistics of this database.
+    DBStats GetStats() const;
+
     CDBWrapper(const CDBWrapper&) = delete;
     CDBWrapper& operator=(const CDBWrapper&) = delete;
 
@@ -235,12 +319,8 @@ public:
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound())
-                return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
+        if (!ReadValue(slKey, strValue)) {
+            return false;
         }
         try {
             CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
@@ -269,14 +349,7 @@ public:
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound())
-                return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
-        }
-        return true;
+        return ReadValue(slKey, strValue);
     }
 
     template <typename K>
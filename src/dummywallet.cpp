@@ -39,6 +39,7 @@ void DummyWalletInit::AddWalletOptions() const
         "-mintxfee=<amt>",
         "-paytxfee=<amt>",
         "-rescan",
+        "-rescanthreads=<n>",
         "-salvagewallet",
         "-spendzeroconfchange",
         "-txconfirmtarget=<n>",
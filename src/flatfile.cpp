@@ -10,6 +10,13 @@
 #include <tinyformat.h>
 #include <util/system.h>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 FlatFileSeq::FlatFileSeq(fs::path dir, const char* prefix, size_t chunk_size) :
     m_dir(std::move(dir)),
     m_prefix(prefix),
@@ -96,3 +103,85 @@ bool FlatFileSeq::Flush(const FlatFilePos& pos, bool finalize)
     fclose(file);
     return true;
 }
+
+MappedFlatFile::~MappedFlatFile()
+{
+#ifndef WIN32
+    munmap(m_data, m_size);
+#endif
+}
+
+/** Map the whole file at path read-only, or return nullptr. */
+static std::shared_ptr<const MappedFlatFile> MapFile(const fs::path& path)
+{
+#ifdef WIN32
+    return nullptr;
+#else
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (data == MAP_FAILED) {
+        LogPrintf("Unable to map file %s\n", path.string());
+        return nullptr;
+    }
+    return std::make_shared<MappedFlatFile>(data, st.st_size);
+#endif
+}
+
+void FlatFileMapPool::SetMaxMaps(size_t max_maps)
+{
+    LOCK(m_mutex);
+    m_max_maps = max_maps;
+    while (m_maps.size() > m_max_maps) {
+        m_maps.pop_back();
+    }
+}
+
+std::shared_ptr<const MappedFlatFile> FlatFileMapPool::Map(const FlatFileSeq& seq, const FlatFilePos& pos, size_t size)
+{
+    LOCK(m_mutex);
+    if (m_max_maps == 0 || pos.IsNull()) {
+        return nullptr;
+    }
+    const size_t end = size_t{pos.nPos} + size;
+    for (auto it = m_maps.begin(); it != m_maps.end(); ++it) {
+        if (it->first != pos.nFile) continue;
+        if (it->second->Data().size() >= end) {
+            m_maps.splice(m_maps.begin(), m_maps, it);
+            return it->second;
+        }
+        // Data was appended to the file since it was mapped
+        m_maps.erase(it);
+        break;
+    }
+
+    std::shared_ptr<const MappedFlatFile> mapping = MapFile(seq.FileName(pos));
+    if (!mapping || mapping->Data().size() < end) {
+        return nullptr;
+    }
+    m_maps.emplace_front(pos.nFile, mapping);
+    if (m_maps.size() > m_max_maps) {
+        m_maps.pop_back();
+    }
+    return mapping;
+}
+
+void FlatFileMapPool::Invalidate(const FlatFilePos& pos)
+{
+    LOCK(m_mutex);
+    m_maps.remove_if([&](const std::pair<int, std::shared_ptr<const MappedFlatFile>>& map) { return map.first == pos.nFile; });
+}
+
+void FlatFileMapPool::Clear()
+{
+    LOCK(m_mutex);
+    m_maps.clear();
+}
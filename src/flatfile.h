@@ -6,10 +6,15 @@
 #ifndef BITCOIN_FLATFILE_H
 #define BITCOIN_FLATFILE_H
 
+#include <list>
+#include <memory>
 #include <string>
+#include <utility>
 
 #include <fs.h>
 #include <serialize.h>
+#include <span.h>
+#include <sync.h>
 
 struct FlatFilePos
 {
@@ -87,4 +92,54 @@ public:
     bool Flush(const FlatFilePos& pos, bool finalize = false);
 };
 
+/** A read-only memory mapping of a whole file, unmapped on destruction. */
+class MappedFlatFile
+{
+private:
+    void* const m_data;
+    const size_t m_size;
+
+public:
+    MappedFlatFile(void* data, size_t size) : m_data(data), m_size(size) {}
+    ~MappedFlatFile();
+
+    MappedFlatFile(const MappedFlatFile&) = delete;
+    MappedFlatFile& operator=(const MappedFlatFile&) = delete;
+
+    Span<const unsigned char> Data() const { return {static_cast<const unsigned char*>(m_data), m_size}; }
+};
+
+/**
+ * FlatFileMapPool keeps read-only memory mappings of the files of one FlatFileSeq, so that
+ * reading from them repeatedly needs no open/seek/read syscalls. At most a given number of
+ * files are kept mapped, dropping the least recently used mapping first. A mapping stays valid
+ * for as long as it is referenced, even once dropped from the pool.
+ */
+class FlatFileMapPool
+{
+private:
+    Mutex m_mutex;
+    size_t m_max_maps GUARDED_BY(m_mutex){0};
+    //! Mappings by file number, most recently used first
+    std::list<std::pair<int, std::shared_ptr<const MappedFlatFile>>> m_maps GUARDED_BY(m_mutex);
+
+public:
+    /** Set the maximum number of files kept mapped. 0 disables mapping. */
+    void SetMaxMaps(size_t max_maps);
+
+    /**
+     * Get a mapping of the file at the given position that covers the size bytes starting there,
+     * remapping the file if it grew. Returns nullptr if mapping is disabled or not supported, or
+     * the file is too short or cannot be mapped, in which case the caller should fall back to
+     * FlatFileSeq::Open.
+     */
+    std::shared_ptr<const MappedFlatFile> Map(const FlatFileSeq& seq, const FlatFilePos& pos, size_t size);
+
+    /** Drop the mapping of the file at the given position, e.g. because it was truncated. */
+    void Invalidate(const FlatFilePos& pos);
+
+    /** Drop all mappings, e.g. because files were removed. */
+    void Clear();
+};
+
 #endif // BITCOIN_FLATFILE_H
@@ -27,8 +27,8 @@ static void FatalError(const char* fmt, const Args&... args)
     StartShutdown();
 }
 
-BaseIndex::DB::DB(const fs::path& path, size_t n_cache_size, bool f_memory, bool f_wipe, bool f_obfuscate) :
-    CDBWrapper(path, n_cache_size, f_memory, f_wipe, f_obfuscate)
+BaseIndex::DB::DB(const fs::path& path, size_t n_cache_size, bool f_memory, bool f_wipe, bool f_obfuscate, const std::string& profile) :
+    CDBWrapper(path, n_cache_size, f_memory, f_wipe, f_obfuscate, profile)
 {}
 
 bool BaseIndex::DB::ReadBestBlock(CBlockLocator& locator) const
@@ -134,7 +134,10 @@ void BaseIndex::ThreadSync()
                 Commit();
             }
 
+            // The block is only read to be indexed, so none of its
+            // transactions outlive it.
             CBlock block;
+            block.m_tx_arena = std::make_shared<MonotonicArena>();
             if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
                 FatalError("%s: Failed to read block %s from disk",
                            __func__, pindex->GetBlockHash().ToString());
@@ -17,6 +17,9 @@
 #include <chainparams.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <crypto/chacha20.h>
+#include <crypto/poly1305.h>
+#include <dbwrapper.h>
 #include <fs.h>
 #include <hash.h>
 #include <httprpc.h>
@@ -171,6 +174,9 @@ void Interrupt(NodeContext& node)
         g_txindex->Interrupt();
     }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Interrupt(); });
+    if (node.chainman) {
+        node.chainman->InterruptBackgroundValidation();
+    }
 }
 
 void Shutdown(NodeContext& node)
@@ -220,8 +226,10 @@ void Shutdown(NodeContext& node)
     // CScheduler/checkqueue, threadGroup and load block thread.
     if (node.scheduler) node.scheduler->stop();
     if (g_load_block.joinable()) g_load_block.join();
+    if (node.chainman) node.chainman->StopBackgroundValidation();
     threadGroup.interrupt_all();
     threadGroup.join_all();
+    StopBlockPrecheckThreads();
 
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
@@ -396,14 +404,22 @@ void SetupServerArgs(NodeContext& node)
     gArgs.AddArg("-blocknotify=<cmd>", "Execute command when the best block changes (%s in cmd is replaced by block hash)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #endif
     gArgs.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockfilemaps=<n>", strprintf("Read blocks and undo data through memory mappings of up to <n> recently used blk and rev files each, instead of opening and reading the files every time (0 to %d, 0 = disabled, default: %d)",
+        MAX_BLOCK_FILE_MAPS, DEFAULT_BLOCK_FILE_MAPS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockprecheck=<n>", strprintf("Set the number of threads used to read and check blocks ahead of the tip before connecting them (0 to %d, 0 = disabled, default: %d)",
+        MAX_BLOCK_PRECHECK_THREADS, DEFAULT_BLOCK_PRECHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksonly", strprintf("Whether to reject transactions from network peers. Automatic broadcast and rebroadcast of any transactions from inbound peers is disabled, unless '-whitelistforcerelay' is '1', in which case whitelisted peers' transactions will be relayed. RPC transactions are not affected. (default: %u)", DEFAULT_BLOCKSONLY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbprofile=<db>:<option>=<value>[,...]", strprintf("Tune the LevelDB storage of a database (%s). Options: compression=none|snappy (snappy %s), bloombits=<0-32>, blocksize=<bytes>, blockcache=<10-90> (percentage of the database cache used for reading, the rest buffers writes). Default: compression=none,bloombits=10,blocksize=4096,blockcache=50. Can be specified multiple times",
+        Join(DB_PROFILE_NAMES, std::string(", ")), DBCompressionAvailable() ? "is available" : "is not available in this build"), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-inputprefetch=<n>", strprintf("Set the number of threads used to load the inputs of a block from the coins database before connecting it (0 to %d, 0 = disabled, default: %d)",
+        MAX_INPUT_PREFETCH_THREADS, DEFAULT_INPUT_PREFETCH_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external file on startup", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -411,6 +427,7 @@ void SetupServerArgs(NodeContext& node)
     gArgs.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-parworksteal", strprintf("Give each script verification thread its own work queue and let idle threads steal from the others, instead of sharing one queue (default: %u)", DEFAULT_SCRIPTCHECK_WORK_STEALING), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
@@ -418,6 +435,7 @@ void SetupServerArgs(NodeContext& node)
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks. When in pruning mode or if blocks on disk might be corrupted, use full -reindex instead.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-rollingutxohash", strprintf("Maintain a MuHash3072 of the UTXO set on every block connection, so gettxoutsetinfo can return it without scanning the UTXO set (default: %u)", DEFAULT_ROLLING_UTXO_HASH), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #ifndef WIN32
     gArgs.AddArg("-sysperms", "Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #else
@@ -438,6 +456,11 @@ void SetupServerArgs(NodeContext& node)
     gArgs.AddArg("-discover", "Discover own IP addresses (default: 1 when listening and no -externalip or -proxy)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-dns", strprintf("Allow DNS lookups for -addnode, -seednode and -connect (default: %u)", DEFAULT_NAME_LOOKUP), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-dnsseed", "Query for peer addresses via DNS lookup, if low on addresses (default: 1 unless -connect used)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+#ifdef USE_EPOLL
+    gArgs.AddArg("-epoll", strprintf("Wait for socket events with epoll instead of poll (default: %u)", DEFAULT_USE_EPOLL), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::CONNECTION);
+#else
+    hidden_args.emplace_back("-epoll");
+#endif
     gArgs.AddArg("-externalip=<ip>", "Specify your own public address", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-forcednsseed", strprintf("Always query for peer addresses via DNS lookup (default: %u)", DEFAULT_FORCEDNSSEED), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-listen", "Accept connections from outside (default: 1 if no -proxy or -connect)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
@@ -447,6 +470,7 @@ void SetupServerArgs(NodeContext& node)
     gArgs.AddArg("-maxsendbuffer=<n>", strprintf("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXSENDBUFFER), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxtimeadjustment", strprintf("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)", DEFAULT_MAX_TIME_ADJUSTMENT), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxuploadtarget=<n>", strprintf("Tries to keep outbound traffic under the given target (in MiB per 24h). Limit does not apply to peers with 'download' permission. 0 = no limit (default: %d)", DEFAULT_MAX_UPLOAD_TARGET), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-msgworkerthreads=<n>", strprintf("Number of threads that process ping, addr, getaddr and feefilter messages alongside the message handler thread, 0 to disable (0 to %d, default: %d)", MAX_MSG_WORKER_THREADS, DEFAULT_MSG_WORKER_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onion=<ip:port>", "Use separate SOCKS5 proxy to reach peers via Tor hidden services, set -noonion to disable (default: -proxy)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onlynet=<net>", "Make outgoing connections only through network <net> (ipv4, ipv6 or onion). Incoming connections are not affected by this option. This option can be specified multiple times to allow multiple networks.", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-peerbloomfilters", strprintf("Support filtering of blocks and transaction with bloom filters (default: %u)", DEFAULT_PEERBLOOMFILTERS), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
@@ -456,6 +480,7 @@ void SetupServerArgs(NodeContext& node)
     gArgs.AddArg("-proxy=<ip:port>", "Connect through SOCKS5 proxy, set -noproxy to disable (default: disabled)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-proxyrandomize", strprintf("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)", DEFAULT_PROXYRANDOMIZE), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-seednode=<ip>", "Connect to a node to retrieve peer addresses, and disconnect. This option can be specified multiple times to connect to multiple nodes.", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-socketthreads=<n>", strprintf("Number of threads that send and receive peer messages, each serving a share of the peers (1 to %d, default: %d)", MAX_SOCKET_THREADS, DEFAULT_SOCKET_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-timeout=<n>", strprintf("Specify connection timeout in milliseconds (minimum: 1, default: %d)", DEFAULT_CONNECT_TIMEOUT), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-peertimeout=<n>", strprintf("Specify p2p connection timeout in seconds. This option determines the amount of time a peer may be inactive before the connection to it is dropped. (minimum: 1, default: %d)", DEFAULT_PEER_CONNECT_TIMEOUT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-torcontrol=<ip>:<port>", strprintf("Tor control port to use if onion listening enabled (default: %s)", DEFAULT_TOR_CONTROL), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
@@ -733,14 +758,14 @@ static void ThreadImport(ChainstateManager& chainman, std::vector<fs::path> vImp
 
     // We can't hold cs_main during ActivateBestChain even though we're accessing
     // the chainman unique_ptrs since ABC requires us not to be holding cs_main, so retrieve
-    // the relevant pointers before the ABC call.
-    for (CChainState* chainstate : WITH_LOCK(::cs_main, return chainman.GetAll())) {
-        BlockValidationState state;
-        if (!chainstate->ActivateBestChain(state, chainparams, nullptr)) {
-            LogPrintf("Failed to connect best block (%s)\n", state.ToString());
-            StartShutdown();
-            return;
-        }
+    // the relevant pointer before the ABC call. The chain below a snapshot is left to
+    // the background validation thread.
+    CChainState* chainstate = WITH_LOCK(::cs_main, return &chainman.ActiveChainstate());
+    BlockValidationState state;
+    if (!chainstate->ActivateBestChain(state, chainparams, nullptr)) {
+        LogPrintf("Failed to connect best block (%s)\n", state.ToString());
+        StartShutdown();
+        return;
     }
 
     if (gArgs.GetBoolArg("-stopafterblockimport", DEFAULT_STOPAFTERBLOCKIMPORT)) {
@@ -1089,6 +1114,11 @@ bool AppInitParameterInteraction()
         LogPrintf("Warning: nMinimumChainWork set below default value of %s\n", chainparams.GetConsensus().nMinimumChainWork.GetHex());
     }
 
+    std::string db_profile_error;
+    if (!SetDBProfiles(gArgs.GetArgs("-dbprofile"), db_profile_error)) {
+        return InitError(Untranslated(db_profile_error));
+    }
+
     // mempool limits
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     int64_t nMempoolSizeMin = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) * 1000 * 40;
@@ -1213,6 +1243,7 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    LogPrintf("Using the '%s' ChaCha20 and '%s' Poly1305 implementations\n", ChaCha20AutoDetect(), Poly1305AutoDetect());
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1309,11 +1340,33 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
     LogPrintf("Script verification uses %d additional threads\n", script_threads);
     if (script_threads >= 1) {
         g_parallel_script_checks = true;
+        if (gArgs.GetBoolArg("-parworksteal", DEFAULT_SCRIPTCHECK_WORK_STEALING)) {
+            LogPrintf("Script verification threads use work stealing\n");
+            EnableScriptCheckWorkStealing(script_threads);
+        }
         for (int i = 0; i < script_threads; ++i) {
             threadGroup.create_thread([i]() { return ThreadScriptCheck(i); });
         }
     }
 
+    const int prefetch_threads = std::max(0, std::min<int>(gArgs.GetArg("-inputprefetch", DEFAULT_INPUT_PREFETCH_THREADS), MAX_INPUT_PREFETCH_THREADS));
+    LogPrintf("Input prefetch uses %d threads\n", prefetch_threads);
+    if (prefetch_threads >= 1) {
+        g_parallel_input_prefetch = true;
+        for (int i = 0; i < prefetch_threads; ++i) {
+            threadGroup.create_thread([i]() { return ThreadInputPrefetch(i); });
+        }
+    }
+
+    const int precheck_threads = std::max(0, std::min<int>(gArgs.GetArg("-blockprecheck", DEFAULT_BLOCK_PRECHECK_THREADS), MAX_BLOCK_PRECHECK_THREADS));
+    LogPrintf("Block precheck uses %d threads\n", precheck_threads);
+    if (precheck_threads >= 1) {
+        g_parallel_block_precheck = true;
+        StartBlockPrecheckThreads(precheck_threads);
+    }
+
+    SetBlockFileMapLimit(std::max(0, std::min<int>(gArgs.GetArg("-blockfilemaps", DEFAULT_BLOCK_FILE_MAPS), MAX_BLOCK_FILE_MAPS)));
+
     assert(!node.scheduler);
     node.scheduler = MakeUnique<CScheduler>();
 
@@ -1529,6 +1582,9 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
         filter_index_cache = max_cache / n_indexes;
         nTotalCache -= filter_index_cache * n_indexes;
     }
+    int64_t block_precheck_cache = g_parallel_block_precheck ? std::min(nTotalCache / 8, nMaxBlockPrecheckCache << 20) : 0;
+    nTotalCache -= block_precheck_cache;
+    SetBlockPrecheckCacheSize(block_precheck_cache);
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1543,6 +1599,9 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
         LogPrintf("* Using %.1f MiB for %s block filter index database\n",
                   filter_index_cache * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
     }
+    if (g_parallel_block_precheck) {
+        LogPrintf("* Using %.1f MiB for blocks checked ahead of the tip\n", block_precheck_cache * (1.0 / 1024 / 1024));
+    }
     LogPrintf("* Using %.1f MiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for in-memory UTXO set (plus up to %.1f MiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
@@ -1561,6 +1620,17 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
             try {
                 LOCK(cs_main);
                 chainman.InitializeChainstate();
+                chainman.m_total_coinstip_cache = nCoinCacheUsage;
+
+                // Pick up the UTXO snapshot loaded before the last shutdown,
+                // unless the chainstate is being rebuilt.
+                if (Optional<uint256> snapshot_blockhash = DetectSnapshotChainstate(/* discard */ fReset || fReindexChainState)) {
+                    if (fPruneMode) {
+                        strLoadError = _("A UTXO snapshot is in use, which is not supported in prune mode. Restart with -reindex-chainstate to discard it.");
+                        break;
+                    }
+                    chainman.InitializeChainstate(*snapshot_blockhash);
+                }
                 UnloadBlockIndex();
 
                 // new CBlockTreeDB tries to delete the existing file, which
@@ -1644,7 +1714,7 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
                     }
 
                     // The on-disk coinsdb is now in a good state, create the cache
-                    chainstate->InitCoinsCache();
+                    chainstate->InitCoinsCache(nCoinCacheUsage);
                     assert(chainstate->CanFlushToDisk());
 
                     if (!is_coinsview_empty(chainstate)) {
@@ -1656,11 +1726,21 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
                         }
                         assert(chainstate->m_chain.Tip() != nullptr);
                     }
+
+                    if (gArgs.GetBoolArg("-rollingutxohash", DEFAULT_ROLLING_UTXO_HASH) && !chainstate->LoadUTXOHash()) {
+                        strLoadError = _("Error computing the rolling UTXO set hash");
+                        failed_chainstate_init = true;
+                        break;
+                    }
                 }
 
                 if (failed_chainstate_init) {
                     break; // out of the chainstate activation do-while
                 }
+
+                if (chainman.IsSnapshotActive()) {
+                    chainman.MaybeRebalanceCaches();
+                }
             } catch (const std::exception& e) {
                 LogPrintf("%s\n", e.what());
                 strLoadError = _("Error opening block database");
@@ -1846,6 +1926,10 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
 
     g_load_block = std::thread(&TraceThread<std::function<void()>>, "loadblk", [=, &chainman]{ ThreadImport(chainman, vImportFiles); });
 
+    // Resume validating the chain below a snapshot loaded before the last
+    // shutdown, if any.
+    chainman.StartBackgroundValidation(chainparams);
+
     // Wait for genesis block to be processed
     {
         WAIT_LOCK(g_genesis_wait_mutex, lock);
@@ -1902,6 +1986,15 @@ bool AppInitMain(const util::Ref& context, NodeContext& node)
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
     connOptions.nMaxOutboundLimit = nMaxOutboundLimit;
     connOptions.m_peer_connect_timeout = peer_connect_timeout;
+    connOptions.m_use_epoll = gArgs.GetBoolArg("-epoll", DEFAULT_USE_EPOLL);
+    connOptions.m_socket_threads = gArgs.GetArg("-socketthreads", DEFAULT_SOCKET_THREADS);
+    if (connOptions.m_socket_threads < 1 || connOptions.m_socket_threads > MAX_SOCKET_THREADS) {
+        return InitError(strprintf(_("Invalid -socketthreads value %d (must be between 1 and %d)"), connOptions.m_socket_threads, MAX_SOCKET_THREADS));
+    }
+    connOptions.m_msg_worker_threads = gArgs.GetArg("-msgworkerthreads", DEFAULT_MSG_WORKER_THREADS);
+    if (connOptions.m_msg_worker_threads < 0 || connOptions.m_msg_worker_threads > MAX_MSG_WORKER_THREADS) {
+        return InitError(strprintf(_("Invalid -msgworkerthreads value %d (must be between 0 and %d)"), connOptions.m_msg_worker_threads, MAX_MSG_WORKER_THREADS));
+    }
 
     for (const std::string& strBind : gArgs.GetArgs("-bind")) {
         CService addrBind;
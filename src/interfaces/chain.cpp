@@ -6,6 +6,7 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <index/blockfilterindex.h>
 #include <interfaces/handler.h>
 #include <interfaces/wallet.h>
 #include <net.h>
@@ -274,6 +275,20 @@ public:
         }
         return false;
     }
+    bool hasBlockFilterIndex(BlockFilterType filter_type) override
+    {
+        return GetBlockFilterIndex(filter_type) != nullptr;
+    }
+    Optional<bool> blockFilterMatchesAny(BlockFilterType filter_type, const uint256& block_hash, const GCSFilter::ElementSet& filter_set) override
+    {
+        const BlockFilterIndex* block_filter_index = GetBlockFilterIndex(filter_type);
+        if (!block_filter_index) return nullopt;
+
+        const CBlockIndex* index = WITH_LOCK(::cs_main, return LookupBlockIndex(block_hash));
+        BlockFilter filter;
+        if (!index || !block_filter_index->LookupFilter(index, filter)) return nullopt;
+        return filter.GetFilter().MatchAny(filter_set);
+    }
     RBFTransactionState isRBFOptIn(const CTransaction& tx) override
     {
         LOCK(::mempool.cs);
@@ -33,6 +33,10 @@
 #include <poll.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/upnpcommands.h>
@@ -42,6 +46,7 @@
 static_assert(MINIUPNPC_API_VERSION >= 10, "miniUPnPc API version >= 10 assumed");
 #endif
 
+#include <algorithm>
 #include <cstdint>
 #include <unordered_map>
 
@@ -90,6 +95,11 @@ enum BindFlags {
 // The sleep time needs to be small to avoid new sockets stalling
 static const uint64_t SELECT_TIMEOUT_MILLISECONDS = 50;
 
+#ifdef USE_EPOLL
+// Maximum number of socket events handled per epoll_wait() call
+static const int MAX_EPOLL_EVENTS = 256;
+#endif
+
 const std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
@@ -459,7 +469,7 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
     NodeId id = GetNewNodeId();
     uint64_t nonce = GetDeterministicRandomizer(RANDOMIZER_ID_LOCALHOSTNONCE).Write(id).Finalize();
     CAddress addr_bind = GetBindAddress(hSocket);
-    CNode* pnode = new CNode(id, nLocalServices, GetBestHeight(), hSocket, addrConnect, CalculateKeyedNetGroup(addrConnect), nonce, addr_bind, pszDest ? pszDest : "", false, block_relay_only);
+    CNode* pnode = new CNode(id, nLocalServices, GetBestHeight(), hSocket, addrConnect, CalculateKeyedNetGroup(addrConnect), nonce, addr_bind, pszDest ? pszDest : "", false, block_relay_only, m_recv_buffer_pool);
     pnode->AddRef();
 
     // We're making a new connection, harvest entropy from the time (and our peer count)
@@ -580,6 +590,46 @@ void CNode::copyStats(CNodeStats &stats, const std::vector<bool> &m_asmap)
 }
 #undef X
 
+void RecvBufferPool::Get(CDataStream& stream)
+{
+    CSerializeData buffer;
+    {
+        LOCK(m_mutex);
+        if (m_buffers.empty()) return;
+        buffer = std::move(m_buffers.back());
+        m_buffers.pop_back();
+    }
+    buffer.clear();
+    stream.swap(buffer);
+}
+
+void RecvBufferPool::Put(CDataStream& stream)
+{
+    CSerializeData buffer;
+    stream.swap(buffer);
+    if (buffer.capacity() < MIN_BUFFER_SIZE) return;
+    LOCK(m_mutex);
+    if (m_buffers.size() < MAX_IDLE_BUFFERS) m_buffers.push_back(std::move(buffer));
+}
+
+void CNode::PushCompleteMessage(int64_t nTimeMicros)
+{
+    AssertLockHeld(cs_vRecv);
+    // decompose a transport agnostic CNetMessage from the deserializer
+    CNetMessage msg = m_deserializer->GetMessage(Params().MessageStart(), nTimeMicros);
+
+    //store received bytes per message command
+    //to prevent a memory DOS, only allow valid commands
+    mapMsgCmdSize::iterator i = mapRecvBytesPerMsgCmd.find(msg.m_command);
+    if (i == mapRecvBytesPerMsgCmd.end())
+        i = mapRecvBytesPerMsgCmd.find(NET_MESSAGE_COMMAND_OTHER);
+    assert(i != mapRecvBytesPerMsgCmd.end());
+    i->second += msg.m_raw_message_size;
+
+    // push the message to the process queue,
+    vRecvMsg.push_back(std::move(msg));
+}
+
 bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete)
 {
     complete = false;
@@ -596,20 +646,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
         nBytes -= handled;
 
         if (m_deserializer->Complete()) {
-            // decompose a transport agnostic CNetMessage from the deserializer
-            CNetMessage msg = m_deserializer->GetMessage(Params().MessageStart(), nTimeMicros);
-
-            //store received bytes per message command
-            //to prevent a memory DOS, only allow valid commands
-            mapMsgCmdSize::iterator i = mapRecvBytesPerMsgCmd.find(msg.m_command);
-            if (i == mapRecvBytesPerMsgCmd.end())
-                i = mapRecvBytesPerMsgCmd.find(NET_MESSAGE_COMMAND_OTHER);
-            assert(i != mapRecvBytesPerMsgCmd.end());
-            i->second += msg.m_raw_message_size;
-
-            // push the message to the process queue,
-            vRecvMsg.push_back(std::move(msg));
-
+            PushCompleteMessage(nTimeMicros);
             complete = true;
         }
     }
@@ -617,6 +654,20 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
     return true;
 }
 
+void CNode::ReceiveMsgBytesDirect(unsigned int nBytes, bool& complete)
+{
+    complete = false;
+    int64_t nTimeMicros = GetTimeMicros();
+    LOCK(cs_vRecv);
+    nLastRecv = nTimeMicros / 1000000;
+    nRecvBytes += nBytes;
+    m_deserializer->CommitReceived(nBytes);
+    if (m_deserializer->Complete()) {
+        PushCompleteMessage(nTimeMicros);
+        complete = true;
+    }
+}
+
 void CNode::SetSendVersion(int nVersionIn)
 {
     // Send version may only be changed in the version message, and
@@ -669,12 +720,36 @@ int V1TransportDeserializer::readHeader(const char *pch, unsigned int nBytes)
         return -1;
     }
 
+    // large payloads are received into recycled storage
+    if (m_recv_pool && hdr.nMessageSize >= RecvBufferPool::MIN_BUFFER_SIZE) {
+        m_recv_pool->Get(vRecv);
+    }
+
     // switch state to reading message data
     in_data = true;
 
     return nCopy;
 }
 
+Span<uint8_t> V1TransportDeserializer::GetReceiveBuffer()
+{
+    // Headers and small messages go through Read(), so a single recv() can cover many of them.
+    if (!in_data || hdr.nMessageSize - nDataPos < MIN_DIRECT_RECEIVE_SIZE) return {};
+
+    if (vRecv.size() == nDataPos) {
+        // Allocate up to 256 KiB ahead, but never more than the total message size.
+        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + 256 * 1024));
+    }
+    return Span<uint8_t>((uint8_t*)&vRecv[nDataPos], vRecv.size() - nDataPos);
+}
+
+void V1TransportDeserializer::CommitReceived(unsigned int bytes)
+{
+    assert(in_data && nDataPos + bytes <= vRecv.size());
+    hasher.Write((const unsigned char*)&vRecv[nDataPos], bytes);
+    nDataPos += bytes;
+}
+
 int V1TransportDeserializer::readData(const char *pch, unsigned int nBytes)
 {
     unsigned int nRemaining = hdr.nMessageSize - nDataPos;
@@ -703,6 +778,9 @@ const uint256& V1TransportDeserializer::GetMessageHash() const
 CNetMessage V1TransportDeserializer::GetMessage(const CMessageHeader::MessageStartChars& message_start, int64_t time) {
     // decompose a single CNetMessage from the TransportDeserializer
     CNetMessage msg(std::move(vRecv));
+    if (m_recv_pool && hdr.nMessageSize >= RecvBufferPool::MIN_BUFFER_SIZE) {
+        msg.m_recv_pool = m_recv_pool;
+    }
 
     // store state about valid header, netmagic and checksum
     msg.m_valid_header = hdr.IsValid(message_start);
@@ -1047,7 +1125,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     if (NetPermissions::HasFlag(permissionFlags, PF_BLOOMFILTER)) {
         nodeServices = static_cast<ServiceFlags>(nodeServices | NODE_BLOOM);
     }
-    CNode* pnode = new CNode(id, nodeServices, GetBestHeight(), hSocket, addr, CalculateKeyedNetGroup(addr), nonce, addr_bind, "", true);
+    CNode* pnode = new CNode(id, nodeServices, GetBestHeight(), hSocket, addr, CalculateKeyedNetGroup(addr), nonce, addr_bind, "", true, false, m_recv_buffer_pool);
     pnode->AddRef();
     pnode->m_permissionFlags = permissionFlags;
     // If this flag is present, the user probably expect that RPC and QT report it as whitelisted (backward compatibility)
@@ -1061,6 +1139,13 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
     }
+    // Only now, so that SocketHandler() doesn't drop events for a socket of a node it doesn't know yet.
+    {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket != INVALID_SOCKET && !RegisterSocketEvents(GetSocketShard(pnode), pnode->hSocket, /* edge_triggered */ true)) {
+            pnode->fDisconnect = true;
+        }
+    }
 
     // We received a new connection, harvest entropy from the time (and our peer count)
     RandAddEvent((uint32_t)id);
@@ -1172,16 +1257,20 @@ void CConnman::InactivityCheck(CNode *pnode)
     }
 }
 
-bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
+bool CConnman::GenerateSelectSet(size_t shard, std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
 {
-    for (const ListenSocket& hListenSocket : vhListenSocket) {
-        recv_set.insert(hListenSocket.socket);
+    if (shard == 0) {
+        for (const ListenSocket& hListenSocket : vhListenSocket) {
+            recv_set.insert(hListenSocket.socket);
+        }
     }
 
     {
         LOCK(cs_vNodes);
         for (CNode* pnode : vNodes)
         {
+            if (GetSocketShard(pnode) != shard) continue;
+
             // Implement the following logic:
             // * If there is data to send, select() for sending data. As this only
             //   happens when optimistic write failed, we choose to first drain the
@@ -1218,11 +1307,73 @@ bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &s
     return !recv_set.empty() || !send_set.empty() || !error_set.empty();
 }
 
+size_t CConnman::GetSocketShard(const CNode* pnode) const
+{
+    return pnode->GetId() % m_socket_shards.size();
+}
+
+bool CConnman::RegisterSocketEvents(size_t shard, SOCKET hSocket, bool edge_triggered)
+{
+#ifdef USE_EPOLL
+    const int epoll_fd = m_socket_shards[shard].m_epoll_fd;
+    if (epoll_fd == -1) return true;
+
+    struct epoll_event event;
+    event.data.fd = hSocket;
+    event.events = EPOLLIN;
+    if (edge_triggered) {
+        // Peer sockets are registered for writability as well; see m_epoll_send_ready.
+        event.events |= EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    }
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, hSocket, &event) != 0) {
+        LogPrintf("epoll_ctl failed to add socket: %s\n", NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+#endif
+    return true;
+}
+
+#ifdef USE_EPOLL
+void CConnman::SocketEventsEpoll(SocketShard& shard, std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
+{
+    // Don't block if the last iteration left data to be read.
+    const int timeout = shard.m_epoll_recv_pending ? 0 : SELECT_TIMEOUT_MILLISECONDS;
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nevents = epoll_wait(shard.m_epoll_fd, events, MAX_EPOLL_EVENTS, timeout);
+
+    if (interruptNet) return;
+
+    for (int i = 0; i < nevents; ++i) {
+        const SOCKET hSocket = events[i].data.fd;
+        const uint32_t flags = events[i].events;
+        if (std::any_of(vhListenSocket.begin(), vhListenSocket.end(), [&](const ListenSocket& s) { return s.socket == hSocket; })) {
+            // Listening sockets are level-triggered and reported again until all connections are accepted.
+            if (flags & EPOLLIN) recv_set.insert(hSocket);
+            continue;
+        }
+        if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) shard.m_epoll_recv_ready.insert(hSocket);
+        if (flags & EPOLLOUT)                                     shard.m_epoll_send_ready.insert(hSocket);
+        if (flags & (EPOLLERR | EPOLLHUP))                        error_set.insert(hSocket);
+    }
+
+    recv_set.insert(shard.m_epoll_recv_ready.begin(), shard.m_epoll_recv_ready.end());
+    send_set.insert(shard.m_epoll_send_ready.begin(), shard.m_epoll_send_ready.end());
+}
+#endif
+
 #ifdef USE_POLL
-void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
+void CConnman::SocketEvents(size_t shard, std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
 {
+#ifdef USE_EPOLL
+    if (m_socket_shards[shard].m_epoll_fd != -1) {
+        SocketEventsEpoll(m_socket_shards[shard], recv_set, send_set, error_set);
+        return;
+    }
+#endif
+
     std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
-    if (!GenerateSelectSet(recv_select_set, send_select_set, error_select_set)) {
+    if (!GenerateSelectSet(shard, recv_select_set, send_select_set, error_select_set)) {
         interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
         return;
     }
@@ -1261,10 +1412,10 @@ void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_s
     }
 }
 #else
-void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
+void CConnman::SocketEvents(size_t shard, std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
 {
     std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
-    if (!GenerateSelectSet(recv_select_set, send_select_set, error_select_set)) {
+    if (!GenerateSelectSet(shard, recv_select_set, send_select_set, error_select_set)) {
         interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
         return;
     }
@@ -1336,10 +1487,10 @@ void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_s
 }
 #endif
 
-void CConnman::SocketHandler()
+void CConnman::SocketHandler(size_t shard)
 {
     std::set<SOCKET> recv_set, send_set, error_set;
-    SocketEvents(recv_set, send_set, error_set);
+    SocketEvents(shard, recv_set, send_set, error_set);
 
     if (interruptNet) return;
 
@@ -1360,10 +1511,17 @@ void CConnman::SocketHandler()
     std::vector<CNode*> vNodesCopy;
     {
         LOCK(cs_vNodes);
-        vNodesCopy = vNodes;
-        for (CNode* pnode : vNodesCopy)
+        for (CNode* pnode : vNodes) {
+            if (GetSocketShard(pnode) != shard) continue;
+            vNodesCopy.push_back(pnode);
             pnode->AddRef();
+        }
     }
+#ifdef USE_EPOLL
+    SocketShard& socket_shard = m_socket_shards[shard];
+    socket_shard.m_epoll_recv_pending = false;
+    std::set<SOCKET> open_sockets;
+#endif
     for (CNode* pnode : vNodesCopy)
     {
         if (interruptNet)
@@ -1372,6 +1530,7 @@ void CConnman::SocketHandler()
         //
         // Receive
         //
+        SOCKET hSocket;
         bool recvSet = false;
         bool sendSet = false;
         bool errorSet = false;
@@ -1379,26 +1538,47 @@ void CConnman::SocketHandler()
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            recvSet = recv_set.count(pnode->hSocket) > 0;
-            sendSet = send_set.count(pnode->hSocket) > 0;
-            errorSet = error_set.count(pnode->hSocket) > 0;
+            hSocket = pnode->hSocket;
+            recvSet = recv_set.count(hSocket) > 0;
+            sendSet = send_set.count(hSocket) > 0;
+            errorSet = error_set.count(hSocket) > 0;
+        }
+#ifdef USE_EPOLL
+        open_sockets.insert(hSocket);
+        // epoll reports sockets regardless of their receive buffer and of the
+        // data queued for them, so, like GenerateSelectSet(), leave sockets
+        // unread while receiving is paused or there is data left to send.
+        if (socket_shard.m_epoll_fd != -1 && (pnode->fPauseRecv || WITH_LOCK(pnode->cs_vSend, return !pnode->vSendMsg.empty()))) {
+            recvSet = false;
         }
+#endif
         if (recvSet || errorSet)
         {
             // typical socket buffer is 8K-64K
             char pchBuf[0x10000];
             int nBytes = 0;
+            bool received_direct = false;
             {
-                LOCK(pnode->cs_hSocket);
+                LOCK2(pnode->cs_hSocket, pnode->cs_vRecv);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                // Receive the payload of large messages in place, without the bounce buffer.
+                Span<uint8_t> buffer = pnode->m_deserializer->GetReceiveBuffer();
+                if (buffer.size() > 0) {
+                    nBytes = recv(pnode->hSocket, (char*)buffer.data(), buffer.size(), MSG_DONTWAIT);
+                    received_direct = true;
+                } else {
+                    nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                }
             }
             if (nBytes > 0)
             {
                 bool notify = false;
-                if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
+                if (received_direct) {
+                    pnode->ReceiveMsgBytesDirect(nBytes, notify);
+                } else if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify)) {
                     pnode->CloseSocketDisconnect();
+                }
                 RecordBytesRecv(nBytes);
                 if (notify) {
                     size_t nSizeAdded = 0;
@@ -1408,12 +1588,19 @@ void CConnman::SocketHandler()
                         // the single possible partially deserialized message are held by TransportDeserializer
                         nSizeAdded += it->m_raw_message_size;
                     }
+                    bool queue_parallel = false;
                     {
                         LOCK(pnode->cs_vProcessMsg);
                         pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
                         pnode->nProcessQueueSize += nSizeAdded;
                         pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
+                        // Messages that don't have to wait for the message handler
+                        // thread are handed to a worker once they are next in line.
+                        if (m_num_msg_workers > 0 && !pnode->m_parallel_queued && m_msgproc->IsParallelMessage(pnode, pnode->vProcessMsg.front().m_command)) {
+                            pnode->m_parallel_queued = queue_parallel = true;
+                        }
                     }
+                    if (queue_parallel) QueueParallelMessages(pnode);
                     WakeMessageHandler();
                 }
             }
@@ -1424,6 +1611,10 @@ void CConnman::SocketHandler()
                     LogPrint(BCLog::NET, "socket closed for peer=%d\n", pnode->GetId());
                 }
                 pnode->CloseSocketDisconnect();
+#ifdef USE_EPOLL
+                socket_shard.m_epoll_recv_ready.erase(hSocket);
+                socket_shard.m_epoll_send_ready.erase(hSocket);
+#endif
             }
             else if (nBytes < 0)
             {
@@ -1435,7 +1626,16 @@ void CConnman::SocketHandler()
                         LogPrint(BCLog::NET, "socket recv error for peer=%d: %s\n", pnode->GetId(), NetworkErrorString(nErr));
                     }
                     pnode->CloseSocketDisconnect();
+#ifdef USE_EPOLL
+                    socket_shard.m_epoll_send_ready.erase(hSocket);
+#endif
+                }
+#ifdef USE_EPOLL
+                // The socket stays readable until recv() says otherwise.
+                if (nErr != WSAEINTR) {
+                    socket_shard.m_epoll_recv_ready.erase(hSocket);
                 }
+#endif
             }
         }
 
@@ -1449,10 +1649,36 @@ void CConnman::SocketHandler()
             if (nBytes) {
                 RecordBytesSent(nBytes);
             }
+#ifdef USE_EPOLL
+            // Anything left over did not fit in the socket's send buffer.
+            if (!pnode->vSendMsg.empty()) {
+                socket_shard.m_epoll_send_ready.erase(hSocket);
+            }
+#endif
         }
 
+#ifdef USE_EPOLL
+        if (!pnode->fPauseRecv && socket_shard.m_epoll_recv_ready.count(hSocket) > 0 &&
+            WITH_LOCK(pnode->cs_vSend, return pnode->vSendMsg.empty())) {
+            socket_shard.m_epoll_recv_pending = true;
+        }
+#endif
+
         InactivityCheck(pnode);
     }
+#ifdef USE_EPOLL
+    // Forget the sockets that were closed elsewhere, before their descriptors
+    // are reused for new connections.
+    for (std::set<SOCKET>* ready : {&socket_shard.m_epoll_recv_ready, &socket_shard.m_epoll_send_ready}) {
+        for (auto it = ready->begin(); it != ready->end();) {
+            if (open_sockets.count(*it) > 0) {
+                ++it;
+            } else {
+                it = ready->erase(it);
+            }
+        }
+    }
+#endif
     {
         LOCK(cs_vNodes);
         for (CNode* pnode : vNodesCopy)
@@ -1460,13 +1686,66 @@ void CConnman::SocketHandler()
     }
 }
 
-void CConnman::ThreadSocketHandler()
+void CConnman::ThreadSocketHandler(size_t shard)
 {
     while (!interruptNet)
     {
-        DisconnectNodes();
-        NotifyNumConnectionsChanged();
-        SocketHandler();
+        if (shard == 0) {
+            DisconnectNodes();
+            NotifyNumConnectionsChanged();
+        }
+        SocketHandler(shard);
+    }
+}
+
+void CConnman::QueueParallelMessages(CNode* pnode)
+{
+    pnode->AddRef();
+    {
+        LOCK(m_msg_worker_mutex);
+        m_msg_worker_queue.push_back(pnode);
+    }
+    m_msg_worker_cond.notify_one();
+}
+
+void CConnman::ThreadMessageWorker()
+{
+    while (!flagInterruptMsgProc)
+    {
+        CNode* pnode;
+        {
+            WAIT_LOCK(m_msg_worker_mutex, lock);
+            m_msg_worker_cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_msg_worker_mutex) { return flagInterruptMsgProc || !m_msg_worker_queue.empty(); });
+            if (flagInterruptMsgProc) return;
+            pnode = m_msg_worker_queue.front();
+            m_msg_worker_queue.pop_front();
+        }
+
+        // Leave the peer to the message handler thread if that is already
+        // serving it. Take one message at a time, so that a flood from one
+        // peer doesn't hold up the others.
+        bool processed = false;
+        {
+            TRY_LOCK(pnode->m_msg_process_mutex, lockProcess);
+            if (lockProcess) {
+                processed = m_msgproc->ProcessParallelMessages(pnode, flagInterruptMsgProc);
+            }
+        }
+
+        bool requeue;
+        {
+            LOCK(pnode->cs_vProcessMsg);
+            requeue = processed && !pnode->fDisconnect && !pnode->vProcessMsg.empty() &&
+                      m_msgproc->IsParallelMessage(pnode, pnode->vProcessMsg.front().m_command);
+            pnode->m_parallel_queued = requeue;
+        }
+        if (requeue) {
+            LOCK(m_msg_worker_mutex);
+            m_msg_worker_queue.push_back(pnode);
+        } else {
+            LOCK(cs_vNodes);
+            pnode->Release();
+        }
     }
 }
 
@@ -2075,6 +2354,13 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
     }
+    // See AcceptConnection().
+    {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket != INVALID_SOCKET && !RegisterSocketEvents(GetSocketShard(pnode), pnode->hSocket, /* edge_triggered */ true)) {
+            pnode->fDisconnect = true;
+        }
+    }
 }
 
 void CConnman::ThreadMessageHandler()
@@ -2097,6 +2383,7 @@ void CConnman::ThreadMessageHandler()
             if (pnode->fDisconnect)
                 continue;
 
+            LOCK(pnode->m_msg_process_mutex);
             // Receive messages
             bool fMoreNodeWork = m_msgproc->ProcessMessages(pnode, flagInterruptMsgProc);
             fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
@@ -2191,6 +2478,13 @@ bool CConnman::BindListenPort(const CService& addrBind, bilingual_str& strError,
         return false;
     }
 
+    if (!RegisterSocketEvents(0, hListenSocket, /* edge_triggered */ false)) {
+        strError = strprintf(Untranslated("Error: Couldn't wait for connections on %s (epoll_ctl returned error %s)"), addrBind.ToString(), NetworkErrorString(WSAGetLastError()));
+        LogPrintf("%s\n", strError.original);
+        CloseSocket(hListenSocket);
+        return false;
+    }
+
     vhListenSocket.push_back(ListenSocket(hListenSocket, permissions));
 
     if (addrBind.IsRoutable() && fDiscover && (permissions & PF_NOBAN) == 0)
@@ -2324,6 +2618,18 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         nMaxOutboundCycleStartTime = 0;
     }
 
+    m_socket_shards.resize(std::max(1, std::min(connOptions.m_socket_threads, MAX_SOCKET_THREADS)));
+#ifdef USE_EPOLL
+    for (SocketShard& shard : m_socket_shards) {
+        if (connOptions.m_use_epoll && shard.m_epoll_fd == -1) {
+            shard.m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+            if (shard.m_epoll_fd == -1) {
+                LogPrintf("epoll_create1 failed, falling back to poll(): %s\n", NetworkErrorString(WSAGetLastError()));
+            }
+        }
+    }
+#endif
+
     if (fListen && !InitBinds(connOptions.vBinds, connOptions.vWhiteBinds)) {
         if (clientInterface) {
             clientInterface->ThreadSafeMessageBox(
@@ -2378,9 +2684,15 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         LOCK(mutexMsgProc);
         fMsgProcWake = false;
     }
+    m_num_msg_workers = std::max(0, std::min(connOptions.m_msg_worker_threads, MAX_MSG_WORKER_THREADS));
 
     // Send and receive from sockets, accept connections
-    threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net", std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
+    for (size_t shard = 0; shard < m_socket_shards.size(); ++shard) {
+        m_socket_shards[shard].thread = std::thread([this, shard] {
+            const std::string name = shard == 0 ? "net" : strprintf("net.%u", shard);
+            TraceThread(name.c_str(), [this, shard] { ThreadSocketHandler(shard); });
+        });
+    }
 
     if (!gArgs.GetBoolArg("-dnsseed", true))
         LogPrintf("DNS seeding disabled\n");
@@ -2403,6 +2715,12 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
 
     // Process messages
     threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    for (int i = 0; i < m_num_msg_workers; ++i) {
+        m_msg_worker_threads.emplace_back([this, i] {
+            const std::string name = strprintf("msgworker.%d", i);
+            TraceThread(name.c_str(), [this] { ThreadMessageWorker(); });
+        });
+    }
 
     // Dump network addresses
     scheduler.scheduleEvery([this] { DumpAddresses(); }, DUMP_PEERS_INTERVAL);
@@ -2432,6 +2750,11 @@ void CConnman::Interrupt()
         flagInterruptMsgProc = true;
     }
     condMsgProc.notify_all();
+    {
+        // Don't let a worker miss the interrupt between checking for it and waiting
+        LOCK(m_msg_worker_mutex);
+    }
+    m_msg_worker_cond.notify_all();
 
     interruptNet();
     InterruptSocks5(true);
@@ -2453,14 +2776,20 @@ void CConnman::StopThreads()
 {
     if (threadMessageHandler.joinable())
         threadMessageHandler.join();
+    for (std::thread& thread : m_msg_worker_threads) {
+        thread.join();
+    }
+    m_msg_worker_threads.clear();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
         threadOpenAddedConnections.join();
     if (threadDNSAddressSeed.joinable())
         threadDNSAddressSeed.join();
-    if (threadSocketHandler.joinable())
-        threadSocketHandler.join();
+    for (SocketShard& shard : m_socket_shards) {
+        if (shard.thread.joinable())
+            shard.thread.join();
+    }
 }
 
 void CConnman::StopNodes()
@@ -2479,6 +2808,9 @@ void CConnman::StopNodes()
             if (!CloseSocket(hListenSocket.socket))
                 LogPrintf("CloseSocket(hListenSocket) failed with error %s\n", NetworkErrorString(WSAGetLastError()));
 
+    // Peers left queued for the message workers are deleted below
+    WITH_LOCK(m_msg_worker_mutex, m_msg_worker_queue.clear());
+
     // clean up some globals (to help leak detection)
     for (CNode* pnode : vNodes) {
         DeleteNode(pnode);
@@ -2491,6 +2823,15 @@ void CConnman::StopNodes()
     vhListenSocket.clear();
     semOutbound.reset();
     semAddnode.reset();
+
+#ifdef USE_EPOLL
+    for (SocketShard& shard : m_socket_shards) {
+        if (shard.m_epoll_fd != -1) {
+            close(shard.m_epoll_fd);
+        }
+    }
+#endif
+    m_socket_shards.clear();
 }
 
 void CConnman::DeleteNode(CNode* pnode)
@@ -2750,7 +3091,7 @@ int CConnman::GetBestHeight() const
 
 unsigned int CConnman::GetReceiveFloodSize() const { return nReceiveFloodSize; }
 
-CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn, SOCKET hSocketIn, const CAddress& addrIn, uint64_t nKeyedNetGroupIn, uint64_t nLocalHostNonceIn, const CAddress& addrBindIn, const std::string& addrNameIn, bool fInboundIn, bool block_relay_only)
+CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn, SOCKET hSocketIn, const CAddress& addrIn, uint64_t nKeyedNetGroupIn, uint64_t nLocalHostNonceIn, const CAddress& addrBindIn, const std::string& addrNameIn, bool fInboundIn, bool block_relay_only, std::shared_ptr<RecvBufferPool> recv_pool)
     : nTimeConnected(GetSystemTimeInSeconds()),
     addr(addrIn),
     addrBind(addrBindIn),
@@ -2782,7 +3123,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
         LogPrint(BCLog::NET, "Added connection peer=%d\n", id);
     }
 
-    m_deserializer = MakeUnique<V1TransportDeserializer>(V1TransportDeserializer(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+    m_deserializer = MakeUnique<V1TransportDeserializer>(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION, std::move(recv_pool));
     m_serializer = MakeUnique<V1TransportSerializer>(V1TransportSerializer());
 }
 
@@ -19,6 +19,7 @@
 #include <policy/feerate.h>
 #include <protocol.h>
 #include <random.h>
+#include <span.h>
 #include <streams.h>
 #include <sync.h>
 #include <threadinterrupt.h>
@@ -82,6 +83,16 @@ static const uint64_t MAX_UPLOAD_TIMEFRAME = 60 * 60 * 24;
 static const bool DEFAULT_BLOCKSONLY = false;
 /** -peertimeout default */
 static const int64_t DEFAULT_PEER_CONNECT_TIMEOUT = 60;
+/** -epoll default */
+static const bool DEFAULT_USE_EPOLL = true;
+/** -socketthreads default */
+static const int DEFAULT_SOCKET_THREADS = 1;
+/** Maximum number of socket I/O threads */
+static const int MAX_SOCKET_THREADS = 64;
+/** -msgworkerthreads default */
+static const int DEFAULT_MSG_WORKER_THREADS = 2;
+/** Maximum number of message worker threads */
+static const int MAX_MSG_WORKER_THREADS = 16;
 
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
@@ -113,6 +124,27 @@ struct CSerializedNetMsg
     std::string m_type;
 };
 
+/** Recycles the storage of large received messages, so that receiving one
+ * neither allocates nor faults in a fresh buffer. Messages hold a reference
+ * to the pool and return their storage to it once they have been processed.
+ */
+class RecvBufferPool
+{
+public:
+    //! Messages smaller than this don't use pooled storage.
+    static constexpr size_t MIN_BUFFER_SIZE = 64 * 1024;
+    //! Maximum number of idle buffers kept for reuse.
+    static constexpr size_t MAX_IDLE_BUFFERS = 8;
+
+    //! Replace the (empty) storage of stream with a pooled buffer, if one is idle.
+    void Get(CDataStream& stream);
+    //! Take the storage of stream back into the pool, leaving stream empty.
+    void Put(CDataStream& stream);
+
+private:
+    Mutex m_mutex;
+    std::vector<CSerializeData> m_buffers GUARDED_BY(m_mutex);
+};
 
 class NetEventsInterface;
 class CConnman
@@ -143,6 +175,9 @@ public:
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
         int64_t m_peer_connect_timeout = DEFAULT_PEER_CONNECT_TIMEOUT;
+        bool m_use_epoll = DEFAULT_USE_EPOLL;
+        int m_socket_threads = DEFAULT_SOCKET_THREADS;
+        int m_msg_worker_threads = DEFAULT_MSG_WORKER_THREADS;
         std::vector<std::string> vSeedNodes;
         std::vector<NetWhitelistPermissions> vWhitelistedRange;
         std::vector<NetWhitebindPermissions> vWhiteBinds;
@@ -337,6 +372,29 @@ private:
         NetPermissionFlags m_permissions;
     };
 
+    /**
+     * A socket I/O thread and the state it needs to wait for events on the
+     * sockets of its peers. Every peer is served by exactly one of them, so
+     * its messages are received and handed to the message handler in order.
+     */
+    struct SocketShard {
+        std::thread thread;
+#ifdef USE_EPOLL
+        /**
+         * epoll instance the shard's sockets are registered with once, or -1
+         * when poll() is used instead. Peer sockets are edge-triggered: an
+         * event is only reported when a socket becomes readable or writable,
+         * so the sockets that may still be read from or written to without
+         * blocking are remembered below. Only accessed by the shard's thread.
+         */
+        int m_epoll_fd{-1};
+        std::set<SOCKET> m_epoll_recv_ready;
+        std::set<SOCKET> m_epoll_send_ready;
+        /** Whether a readable peer socket was left unread by the last SocketHandler() call. */
+        bool m_epoll_recv_pending{false};
+#endif
+    };
+
     bool BindListenPort(const CService& bindAddr, bilingual_str& strError, NetPermissionFlags permissions);
     bool Bind(const CService& addr, unsigned int flags, NetPermissionFlags permissions);
     bool InitBinds(const std::vector<CService>& binds, const std::vector<NetWhitebindPermissions>& whiteBinds);
@@ -345,14 +403,24 @@ private:
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
     void ThreadMessageHandler();
+    void ThreadMessageWorker();
+    /** Let the message workers process the peer's next message, see NetEventsInterface::IsParallelMessage. */
+    void QueueParallelMessages(CNode* pnode);
     void AcceptConnection(const ListenSocket& hListenSocket);
     void DisconnectNodes();
     void NotifyNumConnectionsChanged();
     void InactivityCheck(CNode *pnode);
-    bool GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
-    void SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
-    void SocketHandler();
-    void ThreadSocketHandler();
+    bool GenerateSelectSet(size_t shard, std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
+    void SocketEvents(size_t shard, std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
+#ifdef USE_EPOLL
+    void SocketEventsEpoll(SocketShard& shard, std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
+#endif
+    /** Index of the socket I/O thread serving a peer. */
+    size_t GetSocketShard(const CNode* pnode) const;
+    /** Start waiting for events on a newly connected or listening socket. */
+    bool RegisterSocketEvents(size_t shard, SOCKET hSocket, bool edge_triggered);
+    void SocketHandler(size_t shard);
+    void ThreadSocketHandler(size_t shard);
     void ThreadDNSAddressSeed();
 
     uint64_t CalculateKeyedNetGroup(const CAddress& ad) const;
@@ -403,6 +471,14 @@ private:
     unsigned int nReceiveFloodSize{0};
 
     std::vector<ListenSocket> vhListenSocket;
+    /**
+     * Socket I/O threads. The first one also accepts new connections and
+     * cleans up disconnected peers. Only resized while the threads are
+     * stopped.
+     */
+    std::vector<SocketShard> m_socket_shards;
+    //! Storage recycled between the large messages received from all peers.
+    const std::shared_ptr<RecvBufferPool> m_recv_buffer_pool{std::make_shared<RecvBufferPool>()};
     std::atomic<bool> fNetworkActive{true};
     bool fAddressesInitialized{false};
     CAddrMan addrman;
@@ -460,10 +536,20 @@ private:
     Mutex mutexMsgProc;
     std::atomic<bool> flagInterruptMsgProc{false};
 
+    /**
+     * Peers with messages for the message workers, each queued at most once
+     * (see CNode::m_parallel_queued) and holding a reference while queued.
+     */
+    std::deque<CNode*> m_msg_worker_queue GUARDED_BY(m_msg_worker_mutex);
+    std::condition_variable m_msg_worker_cond;
+    Mutex m_msg_worker_mutex;
+    std::vector<std::thread> m_msg_worker_threads;
+    /** Number of message workers, fixed while the network threads run. */
+    int m_num_msg_workers{0};
+
     CThreadInterrupt interruptNet;
 
     std::thread threadDNSAddressSeed;
-    std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadMessageHandler;
@@ -506,6 +592,13 @@ class NetEventsInterface
 {
 public:
     virtual bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) = 0;
+    /**
+     * Whether a message may be processed by a message worker thread instead
+     * of the message handler thread once it is next in line.
+     */
+    virtual bool IsParallelMessage(const CNode* pnode, const std::string& msg_type) = 0;
+    /** Process the peer's next message if IsParallelMessage() allows it. Returns whether it did. */
+    virtual bool ProcessParallelMessages(CNode* pnode, std::atomic<bool>& interrupt) = 0;
     virtual bool SendMessages(CNode* pnode) = 0;
     virtual void InitializeNode(CNode* pnode) = 0;
     virtual void FinalizeNode(NodeId id, bool& update_connection_time) = 0;
@@ -620,8 +713,15 @@ public:
     uint32_t m_message_size = 0;         // size of the payload
     uint32_t m_raw_message_size = 0;     // used wire size of the message (including header/checksum)
     std::string m_command;
+    std::shared_ptr<RecvBufferPool> m_recv_pool; // pool m_recv's storage is returned to, if any
 
     CNetMessage(CDataStream&& recv_in) : m_recv(std::move(recv_in)) {}
+    CNetMessage(CNetMessage&&) = default;
+    CNetMessage& operator=(CNetMessage&&) = default;
+    ~CNetMessage()
+    {
+        if (m_recv_pool) m_recv_pool->Put(m_recv);
+    }
 
     void SetVersion(int nVersionIn)
     {
@@ -643,12 +743,21 @@ public:
     virtual int Read(const char *data, unsigned int bytes) = 0;
     // decomposes a message from the context
     virtual CNetMessage GetMessage(const CMessageHeader::MessageStartChars& message_start, int64_t time) = 0;
+    // buffer the next bytes of the current message can be received into directly,
+    // or an empty span if they have to be passed to Read()
+    virtual Span<uint8_t> GetReceiveBuffer() { return {}; }
+    // account for bytes received into the buffer returned by GetReceiveBuffer()
+    virtual void CommitReceived(unsigned int bytes) { assert(false); }
     virtual ~TransportDeserializer() {}
 };
 
 class V1TransportDeserializer final : public TransportDeserializer
 {
 private:
+    //! Payloads with at least this many bytes outstanding are received in place.
+    static constexpr unsigned int MIN_DIRECT_RECEIVE_SIZE = 16 * 1024;
+
+    const std::shared_ptr<RecvBufferPool> m_recv_pool;
     mutable CHash256 hasher;
     mutable uint256 data_hash;
     bool in_data;                   // parsing header (false) or data (true)
@@ -675,7 +784,7 @@ private:
 
 public:
 
-    V1TransportDeserializer(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
+    V1TransportDeserializer(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn, std::shared_ptr<RecvBufferPool> recv_pool = nullptr) : m_recv_pool(std::move(recv_pool)), hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         Reset();
     }
 
@@ -696,6 +805,8 @@ public:
         return ret;
     }
     CNetMessage GetMessage(const CMessageHeader::MessageStartChars& message_start, int64_t time) override;
+    Span<uint8_t> GetReceiveBuffer() override;
+    void CommitReceived(unsigned int bytes) override;
 };
 
 /** The TransportSerializer prepares messages for the network transport
@@ -735,6 +846,10 @@ public:
 
     RecursiveMutex cs_vProcessMsg;
     std::list<CNetMessage> vProcessMsg GUARDED_BY(cs_vProcessMsg);
+    /** Whether this peer is in CConnman::m_msg_worker_queue or being served by a worker. */
+    bool m_parallel_queued GUARDED_BY(cs_vProcessMsg){false};
+    /** Held while processing the peer's messages, so that at most one thread does so at a time. */
+    Mutex m_msg_process_mutex;
     size_t nProcessQueueSize{0};
 
     RecursiveMutex cs_sendProcessing;
@@ -791,8 +906,10 @@ public:
     std::atomic<int> nStartingHeight{-1};
 
     // flood relay
-    std::vector<CAddress> vAddrToSend;
-    const std::unique_ptr<CRollingBloomFilter> m_addr_known;
+    /** Protects the addresses queued for a peer, which other peers' messages relay to it. */
+    Mutex m_addr_send_mutex;
+    std::vector<CAddress> vAddrToSend GUARDED_BY(m_addr_send_mutex);
+    const std::unique_ptr<CRollingBloomFilter> m_addr_known PT_GUARDED_BY(m_addr_send_mutex);
     bool fGetAddr{false};
     std::chrono::microseconds m_next_addr_send GUARDED_BY(cs_sendProcessing){0};
     std::chrono::microseconds m_next_local_addr_send GUARDED_BY(cs_sendProcessing){0};
@@ -856,7 +973,7 @@ public:
 
     std::set<uint256> orphan_work_set;
 
-    CNode(NodeId id, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn, SOCKET hSocketIn, const CAddress &addrIn, uint64_t nKeyedNetGroupIn, uint64_t nLocalHostNonceIn, const CAddress &addrBindIn, const std::string &addrNameIn = "", bool fInboundIn = false, bool block_relay_only = false);
+    CNode(NodeId id, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn, SOCKET hSocketIn, const CAddress &addrIn, uint64_t nKeyedNetGroupIn, uint64_t nLocalHostNonceIn, const CAddress &addrBindIn, const std::string &addrNameIn = "", bool fInboundIn = false, bool block_relay_only = false, std::shared_ptr<RecvBufferPool> recv_pool = nullptr);
     ~CNode();
     CNode(const CNode&) = delete;
     CNode& operator=(const CNode&) = delete;
@@ -885,7 +1002,7 @@ private:
     const int nMyStartingHeight;
     int nSendVersion{0};
     NetPermissionFlags m_permissionFlags{ PF_NONE };
-    std::list<CNetMessage> vRecvMsg;  // Used only by SocketHandler thread
+    std::list<CNetMessage> vRecvMsg;  // Used only by the peer's SocketHandler thread
 
     mutable RecursiveMutex cs_addrName;
     std::string addrName GUARDED_BY(cs_addrName);
@@ -893,6 +1010,9 @@ private:
     // Our address, as reported by the peer
     CService addrLocal GUARDED_BY(cs_addrLocal);
     mutable RecursiveMutex cs_addrLocal;
+
+    // move the message completed by m_deserializer to vRecvMsg
+    void PushCompleteMessage(int64_t nTimeMicros) EXCLUSIVE_LOCKS_REQUIRED(cs_vRecv);
 public:
 
     NodeId GetId() const {
@@ -914,6 +1034,8 @@ public:
     }
 
     bool ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete);
+    // account for bytes received into m_deserializer->GetReceiveBuffer()
+    void ReceiveMsgBytesDirect(unsigned int nBytes, bool& complete);
 
     void SetRecvVersion(int nVersionIn)
     {
@@ -946,6 +1068,7 @@ public:
     void AddAddressKnown(const CAddress& _addr)
     {
         assert(m_addr_known);
+        LOCK(m_addr_send_mutex);
         m_addr_known->insert(_addr.GetKey());
     }
 
@@ -955,6 +1078,7 @@ public:
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
         assert(m_addr_known);
+        LOCK(m_addr_send_mutex);
         if (_addr.IsValid() && !m_addr_known->contains(_addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand.randrange(vAddrToSend.size())] = _addr;
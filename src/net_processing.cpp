@@ -87,8 +87,14 @@ static_assert(INBOUND_PEER_TX_DELAY >= MAX_GETDATA_RANDOM_DELAY,
 static const unsigned int MAX_GETDATA_SZ = 1000;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Bounds for the number of blocks in transit from a single peer during block download. Peers start out at
+ *  MAX_BLOCKS_IN_TRANSIT_PER_PEER; the limit grows for peers that keep up and is halved whenever a peer stalls. */
+static const int MIN_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER = 2;
+static const int MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER = 64;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
+/** Time a peer whose blocks were reassigned for stalling has to deliver a block again before being disconnected. */
+static constexpr std::chrono::microseconds BLOCK_STALLING_RECOVERY_TIMEOUT{std::chrono::seconds{60}};
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
  *  less than this number, we reached its tip. Changing this value is a protocol upgrade. */
 static const unsigned int MAX_HEADERS_RESULTS = 2000;
@@ -195,6 +201,7 @@ namespace {
         const CBlockIndex* pindex;                               //!< Optional.
         bool fValidatedHeaders;                                  //!< Whether this block has validated headers at the time of request.
         std::unique_ptr<PartiallyDownloadedBlock> partialBlock;  //!< Optional, used for CMPCTBLOCK downloads
+        int64_t m_time_requested;                                //!< When the block was requested (in microseconds).
     };
     std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight GUARDED_BY(cs_main);
 
@@ -274,6 +281,14 @@ struct CNodeState {
     int64_t nDownloadingSince;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! How many blocks we let be in flight from this peer during block download.
+    int m_blocks_in_flight_limit;
+    //! Moving average of the time this peer takes per requested block (in microseconds), or 0 if unknown.
+    int64_t m_block_interval_avg;
+    //! When this peer last delivered a block we requested from it (in microseconds), or 0.
+    int64_t m_last_block_delivered;
+    //! When this peer's blocks were reassigned for stalling if it has not delivered a block since, or 0.
+    std::chrono::microseconds m_block_download_stalled_since;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
@@ -413,6 +428,10 @@ struct CNodeState {
         nDownloadingSince = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        m_blocks_in_flight_limit = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+        m_block_interval_avg = 0;
+        m_last_block_delivered = 0;
+        m_block_download_stalled_since = std::chrono::microseconds{0};
         fPreferredDownload = false;
         fPreferHeaders = false;
         fPreferHeaderAndIDs = false;
@@ -472,13 +491,51 @@ static void PushNodeVersion(CNode& pnode, CConnman* connman, int64_t nTime)
     }
 }
 
+/**
+ * Update a peer's block download rate after it delivered a block we requested
+ * from it, and let it have more blocks in flight if it delivered with its queue
+ * full and is at least as fast as the average peer we have downloaded from.
+ */
+static void UpdateBlockDownloadRate(CNodeState& state, const QueuedBlock& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const int64_t now = GetTimeMicros();
+    // Blocks arrive one after another, so while requests are queued the time
+    // since the previous delivery measures how long the peer takes per block.
+    const int64_t interval = now - std::max(block.m_time_requested, state.m_last_block_delivered);
+    state.m_last_block_delivered = now;
+    state.m_block_interval_avg = state.m_block_interval_avg == 0 ? interval : (7 * state.m_block_interval_avg + interval) / 8;
+
+    if (state.nBlocksInFlight < state.m_blocks_in_flight_limit || state.m_blocks_in_flight_limit >= MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER) return;
+    int64_t total_interval = 0;
+    int peers = 0;
+    for (const auto& entry : mapNodeState) {
+        if (entry.second.m_block_interval_avg > 0) {
+            total_interval += entry.second.m_block_interval_avg;
+            ++peers;
+        }
+    }
+    if (state.m_block_interval_avg * peers <= total_interval) {
+        ++state.m_blocks_in_flight_limit;
+    }
+}
+
+// Returns a bool indicating whether we requested this block from the given peer.
+static bool IsBlockInFlightFrom(const uint256& hash, NodeId nodeid) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    const auto it = mapBlocksInFlight.find(hash);
+    return it != mapBlocksInFlight.end() && it->second.first == nodeid;
+}
+
 // Returns a bool indicating whether we requested this block.
 // Also used if a block was /not/ received and timed out or started with another peer
-static bool MarkBlockAsReceived(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+// If the block was received from the peer we requested it from, pass that peer as from.
+static bool MarkBlockAsReceived(const uint256& hash, NodeId from = -1) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
     if (itInFlight != mapBlocksInFlight.end()) {
         CNodeState *state = State(itInFlight->second.first);
         assert(state != nullptr);
+        if (itInFlight->second.first == from) {
+            UpdateBlockDownloadRate(*state, *itInFlight->second.second);
+        }
         state->nBlocksInFlightValidHeaders -= itInFlight->second.second->fValidatedHeaders;
         if (state->nBlocksInFlightValidHeaders == 0 && itInFlight->second.second->fValidatedHeaders) {
             // Last validated block on the queue was received.
@@ -516,7 +573,7 @@ static bool MarkBlockAsInFlight(CTxMemPool& mempool, NodeId nodeid, const uint25
     MarkBlockAsReceived(hash);
 
     std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(),
-            {hash, pindex, pindex != nullptr, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : nullptr)});
+            {hash, pindex, pindex != nullptr, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : nullptr), GetTimeMicros()});
     state->nBlocksInFlight++;
     state->nBlocksInFlightValidHeaders += it->fValidatedHeaders;
     if (state->nBlocksInFlight == 1) {
@@ -721,6 +778,49 @@ static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vec
     }
 }
 
+/** Add not-in-flight blocks below the snapshot base that background validation still needs
+ *  to vBlocks, until it has at most count entries. */
+static void FindNextHistoricalBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, const ChainstateManager& chainman, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (vBlocks.size() >= count || !chainman.IsBackgroundValidationActive())
+        return;
+
+    CNodeState *state = State(nodeid);
+    assert(state != nullptr);
+
+    // Only ask peers whose chain includes the snapshot base.
+    const CBlockIndex* pindexBase = LookupBlockIndex(*chainman.SnapshotBlockhash());
+    if (pindexBase == nullptr || state->pindexBestKnownBlock == nullptr || state->pindexBestKnownBlock->GetAncestor(pindexBase->nHeight) != pindexBase)
+        return;
+
+    // Stay within BLOCK_DOWNLOAD_WINDOW of the background chainstate's tip, as
+    // blocks can only be connected to it in order.
+    const CBlockIndex* pindexValidatedTip = chainman.ValidatedTip();
+    if (pindexValidatedTip == nullptr)
+        return;
+    const CBlockIndex* pindexFork = LastCommonAncestor(pindexValidatedTip, pindexBase);
+    const int nWindowEnd = std::min<int>(pindexFork->nHeight + BLOCK_DOWNLOAD_WINDOW, pindexBase->nHeight);
+    if (nWindowEnd <= pindexFork->nHeight)
+        return;
+
+    std::vector<const CBlockIndex*> vToFetch(nWindowEnd - pindexFork->nHeight);
+    vToFetch.back() = pindexBase->GetAncestor(nWindowEnd);
+    for (size_t i = vToFetch.size() - 1; i > 0; i--) {
+        vToFetch[i - 1] = vToFetch[i]->pprev;
+    }
+    for (const CBlockIndex* pindex : vToFetch) {
+        if (pindex->nStatus & BLOCK_HAVE_DATA || mapBlocksInFlight.count(pindex->GetBlockHash()))
+            continue;
+        if (!state->fHaveWitness && IsWitnessEnabled(pindex->pprev, consensusParams)) {
+            // We wouldn't download this block or its descendants from this peer.
+            return;
+        }
+        vBlocks.push_back(pindex);
+        if (vBlocks.size() == count)
+            return;
+    }
+}
+
 void EraseTxRequest(const uint256& txid) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     g_already_asked_for.erase(txid);
@@ -1534,14 +1634,24 @@ void static ProcessGetBlockData(CNode& pfrom, const CChainParams& chainparams, c
         std::shared_ptr<const CBlock> pblock;
         if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
             pblock = a_recent_block;
-        } else if (inv.type == MSG_WITNESS_BLOCK) {
+        } else if (inv.type == MSG_WITNESS_BLOCK || inv.type == MSG_BLOCK) {
             // Fast-path: in this case it is possible to serve the block directly from disk,
-            // as the network format matches the format on disk
-            std::vector<uint8_t> block_data;
-            if (!ReadRawBlockFromDisk(block_data, pindex, chainparams.MessageStart())) {
-                assert(!"cannot load block from disk");
+            // as the network format matches the format on disk. Peers that don't want
+            // witnesses get it with the witness data cut out of the serialized block.
+            CSerializedNetMsg msg;
+            msg.m_type = NetMsgType::BLOCK;
+            if (inv.type == MSG_WITNESS_BLOCK) {
+                if (!ReadRawBlockFromDisk(msg.data, pindex, chainparams.MessageStart())) {
+                    assert(!"cannot load block from disk");
+                }
+            } else {
+                std::vector<uint8_t> block_data;
+                if (!ReadRawBlockFromDisk(block_data, pindex, chainparams.MessageStart()) ||
+                    !StripRawBlockWitness(block_data, msg.data)) {
+                    assert(!"cannot load block from disk");
+                }
             }
-            connman->PushMessage(&pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(block_data)));
+            connman->PushMessage(&pfrom, std::move(msg));
             // Don't set pblock as we've sent the block
         } else {
             // Send block from disk
@@ -3209,6 +3319,10 @@ void ProcessMessage(
                 // though the block was successfully read, and rely on the
                 // handling in ProcessNewBlock to ensure the block index is
                 // updated, etc.
+                // Only a block this peer was asked for ends its stall.
+                if (IsBlockInFlightFrom(resp.blockhash, pfrom.GetId())) {
+                    State(pfrom.GetId())->m_block_download_stalled_since = std::chrono::microseconds{0};
+                }
                 MarkBlockAsReceived(resp.blockhash); // it is now an empty pointer
                 fBlockRead = true;
                 // mapBlockSource is used for potentially punishing peers and
@@ -3274,6 +3388,7 @@ void ProcessMessage(
         }
 
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        pblock->m_tx_arena = std::make_shared<MonotonicArena>();
         vRecv >> *pblock;
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom.GetId());
@@ -3282,9 +3397,13 @@ void ProcessMessage(
         const uint256 hash(pblock->GetHash());
         {
             LOCK(cs_main);
+            // Only a block this peer was asked for ends its stall.
+            if (IsBlockInFlightFrom(hash, pfrom.GetId())) {
+                State(pfrom.GetId())->m_block_download_stalled_since = std::chrono::microseconds{0};
+            }
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
-            forceProcessing |= MarkBlockAsReceived(hash);
+            forceProcessing |= MarkBlockAsReceived(hash, pfrom.GetId());
             // mapBlockSource is only used for punishing peers and setting
             // which peers send us compact blocks, so the race between here and
             // cs_main in ProcessNewBlock is fine.
@@ -3324,7 +3443,7 @@ void ProcessMessage(
         }
         pfrom.fSentAddr = true;
 
-        pfrom.vAddrToSend.clear();
+        WITH_LOCK(pfrom.m_addr_send_mutex, pfrom.vAddrToSend.clear());
         std::vector<CAddress> vAddr = connman->GetAddresses();
         FastRandomContext insecure_rand;
         for (const CAddress &addr : vAddr) {
@@ -3591,6 +3710,81 @@ bool PeerLogicValidation::MaybeDiscourageAndDisconnect(CNode& pnode)
     return false;
 }
 
+/** Check the framing of a received message before it is processed. Disconnects the peer on a network magic mismatch. */
+static bool CheckMessage(CNode& pfrom, CNetMessage& msg)
+{
+    msg.SetVersion(pfrom.GetRecvVersion());
+    // Check network magic
+    if (!msg.m_valid_netmagic) {
+        LogPrint(BCLog::NET, "PROCESSMESSAGE: INVALID MESSAGESTART %s peer=%d\n", SanitizeString(msg.m_command), pfrom.GetId());
+        pfrom.fDisconnect = true;
+        return false;
+    }
+
+    // Check header
+    if (!msg.m_valid_header)
+    {
+        LogPrint(BCLog::NET, "PROCESSMESSAGE: ERRORS IN HEADER %s peer=%d\n", SanitizeString(msg.m_command), pfrom.GetId());
+        return false;
+    }
+
+    // Checksum
+    if (!msg.m_valid_checksum)
+    {
+        LogPrint(BCLog::NET, "ProcessMessages(%s, %u bytes): CHECKSUM ERROR peer=%d\n",
+           SanitizeString(msg.m_command), msg.m_message_size, pfrom.GetId());
+        return false;
+    }
+    return true;
+}
+
+bool PeerLogicValidation::IsParallelMessage(const CNode* pnode, const std::string& msg_type)
+{
+    if (!pnode->fSuccessfullyConnected) return false;
+    return msg_type == NetMsgType::PING ||
+           msg_type == NetMsgType::ADDR ||
+           msg_type == NetMsgType::GETADDR ||
+           msg_type == NetMsgType::FEEFILTER;
+}
+
+bool PeerLogicValidation::ProcessParallelMessages(CNode* pfrom, std::atomic<bool>& interruptMsgProc)
+{
+    AssertLockHeld(pfrom->m_msg_process_mutex);
+
+    // Keep the order ProcessMessages() would answer in: getdata requests and
+    // orphans are worked off before the next message is looked at.
+    if (pfrom->fDisconnect || pfrom->fPauseSend) return false;
+    if (!pfrom->vRecvGetData.empty()) return false;
+    if (!pfrom->orphan_work_set.empty()) return false;
+
+    std::list<CNetMessage> msgs;
+    {
+        LOCK(pfrom->cs_vProcessMsg);
+        if (pfrom->vProcessMsg.empty() || !IsParallelMessage(pfrom, pfrom->vProcessMsg.front().m_command))
+            return false;
+        msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
+        pfrom->nProcessQueueSize -= msgs.front().m_raw_message_size;
+        pfrom->fPauseRecv = pfrom->nProcessQueueSize > connman->GetReceiveFloodSize();
+    }
+    CNetMessage& msg(msgs.front());
+
+    if (!CheckMessage(*pfrom, msg)) {
+        return true;
+    }
+
+    // A misbehaving peer is discouraged by the next SendMessages() call
+    // rather than here, which would need cs_main.
+    try {
+        ProcessMessage(*pfrom, msg.m_command, msg.m_recv, msg.m_time, Params(), m_chainman, m_mempool, connman, m_banman, interruptMsgProc);
+    } catch (const std::exception& e) {
+        LogPrint(BCLog::NET, "%s(%s, %u bytes): Exception '%s' (%s) caught\n", __func__, SanitizeString(msg.m_command), msg.m_message_size, e.what(), typeid(e).name());
+    } catch (...) {
+        LogPrint(BCLog::NET, "%s(%s, %u bytes): Unknown exception caught\n", __func__, SanitizeString(msg.m_command), msg.m_message_size);
+    }
+
+    return true;
+}
+
 bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptMsgProc)
 {
     const CChainParams& chainparams = Params();
@@ -3641,33 +3835,12 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     }
     CNetMessage& msg(msgs.front());
 
-    msg.SetVersion(pfrom->GetRecvVersion());
-    // Check network magic
-    if (!msg.m_valid_netmagic) {
-        LogPrint(BCLog::NET, "PROCESSMESSAGE: INVALID MESSAGESTART %s peer=%d\n", SanitizeString(msg.m_command), pfrom->GetId());
-        pfrom->fDisconnect = true;
-        return false;
-    }
-
-    // Check header
-    if (!msg.m_valid_header)
-    {
-        LogPrint(BCLog::NET, "PROCESSMESSAGE: ERRORS IN HEADER %s peer=%d\n", SanitizeString(msg.m_command), pfrom->GetId());
-        return fMoreWork;
+    if (!CheckMessage(*pfrom, msg)) {
+        return msg.m_valid_netmagic && fMoreWork;
     }
     const std::string& msg_type = msg.m_command;
-
-    // Message size
     unsigned int nMessageSize = msg.m_message_size;
-
-    // Checksum
     CDataStream& vRecv = msg.m_recv;
-    if (!msg.m_valid_checksum)
-    {
-        LogPrint(BCLog::NET, "%s(%s, %u bytes): CHECKSUM ERROR peer=%d\n", __func__,
-           SanitizeString(msg_type), nMessageSize, pfrom->GetId());
-        return fMoreWork;
-    }
 
     try {
         ProcessMessage(*pfrom, msg_type, vRecv, msg.m_time, chainparams, m_chainman, m_mempool, connman, m_banman, interruptMsgProc);
@@ -3903,6 +4076,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         //
         if (pto->IsAddrRelayPeer() && pto->m_next_addr_send < current_time) {
             pto->m_next_addr_send = PoissonNextSend(current_time, AVG_ADDRESS_BROADCAST_INTERVAL);
+            LOCK(pto->m_addr_send_mutex);
             std::vector<CAddress> vAddr;
             vAddr.reserve(pto->vAddrToSend.size());
             assert(pto->m_addr_known);
@@ -4241,9 +4415,34 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         nNow = GetTimeMicros();
         if (state.nStallingSince && state.nStallingSince < nNow - 1000000 * BLOCK_STALLING_TIMEOUT) {
             // Stalling only triggers when the block download window cannot move. During normal steady state,
-            // the download window should be much larger than the to-be-downloaded set of blocks, so disconnection
+            // the download window should be much larger than the to-be-downloaded set of blocks, so this
             // should only happen during initial block download.
-            LogPrintf("Peer=%d is stalling block download, disconnecting\n", pto->GetId());
+            if (state.m_blocks_in_flight_limit > MIN_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER) {
+                // Hand the blocks we are waiting for to other peers. Don't request more from this one until it
+                // delivers a block again, and fewer from then on. A peer that keeps stalling ends up at the
+                // minimum and is disconnected.
+                std::vector<uint256> stalled_blocks;
+                for (const QueuedBlock& queued_block : state.vBlocksInFlight) {
+                    stalled_blocks.push_back(queued_block.hash);
+                }
+                for (const uint256& hash : stalled_blocks) {
+                    MarkBlockAsReceived(hash);
+                }
+                state.m_blocks_in_flight_limit = std::max(MIN_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER, state.m_blocks_in_flight_limit / 2);
+                state.m_block_download_stalled_since = current_time;
+                LogPrint(BCLog::NET, "Peer=%d is stalling block download, reassigning %u blocks (limit now %d)\n",
+                    pto->GetId(), stalled_blocks.size(), state.m_blocks_in_flight_limit);
+            } else {
+                LogPrintf("Peer=%d is stalling block download, disconnecting\n", pto->GetId());
+                pto->fDisconnect = true;
+                return true;
+            }
+        }
+        // A peer that stalled gets no new requests until it delivers a block again. Don't keep it around if it
+        // doesn't.
+        if (state.m_block_download_stalled_since.count() != 0 &&
+            current_time > state.m_block_download_stalled_since + BLOCK_STALLING_RECOVERY_TIMEOUT) {
+            LogPrintf("Peer=%d did not deliver a block after stalling block download, disconnecting\n", pto->GetId());
             pto->fDisconnect = true;
             return true;
         }
@@ -4302,10 +4501,16 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !::ChainstateActive().IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !::ChainstateActive().IsInitialBlockDownload()) &&
+            state.nBlocksInFlight < state.m_blocks_in_flight_limit && state.m_block_download_stalled_since.count() == 0) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            FindNextBlocksToDownload(pto->GetId(), state.m_blocks_in_flight_limit - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            // Blocks for the active chain come first, any capacity left goes
+            // to the blocks below a snapshot, which limited peers don't have.
+            if (!pto->m_limited_node) {
+                FindNextHistoricalBlocksToDownload(pto->GetId(), state.m_blocks_in_flight_limit - state.nBlocksInFlight, vToDownload, m_chainman, consensusParams);
+            }
             for (const CBlockIndex *pindex : vToDownload) {
                 uint32_t nFetchFlags = GetFetchFlags(*pto);
                 vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindex->GetBlockHash()));
@@ -66,6 +66,22 @@ public:
     */
     bool ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt) override;
     /**
+    * Whether a message can be processed on a message worker thread. This is
+    * the case for messages of fully connected peers that do not need cs_main:
+    * ping, addr, getaddr and feefilter.
+    */
+    bool IsParallelMessage(const CNode* pnode, const std::string& msg_type) override;
+    /**
+    * Process the next message of a node on a message worker thread, if
+    * IsParallelMessage() allows it and nothing received before it is still
+    * being worked on.
+    *
+    * @param[in]   pfrom           The node which we have received messages from.
+    * @param[in]   interrupt       Interrupt condition for processing threads
+    * @return                      True if a message was taken off the queue
+    */
+    bool ProcessParallelMessages(CNode* pfrom, std::atomic<bool>& interrupt) override;
+    /**
     * Send queued protocol messages to be sent to a give node.
     *
     * @param[in]   pto             The node which we are sending messages to.
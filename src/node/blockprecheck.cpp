@@ -0,0 +1,178 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/blockprecheck.h>
+
+#include <consensus/validation.h>
+#include <core_memusage.h>
+#include <primitives/block.h>
+#include <support/allocators/arena.h>
+#include <tinyformat.h>
+#include <util/threadnames.h>
+#include <validation.h>
+
+BlockPrechecker::~BlockPrechecker()
+{
+    StopWorkers();
+}
+
+void BlockPrechecker::StartWorkers(int threads, const Consensus::Params& params)
+{
+    assert(m_threads.empty());
+    for (int i = 0; i < threads; ++i) {
+        m_threads.emplace_back([this, i, &params]() {
+            util::ThreadRename(strprintf("precheck.%i", i));
+            Thread(params);
+        });
+    }
+}
+
+void BlockPrechecker::StopWorkers()
+{
+    {
+        LOCK(m_mutex);
+        m_stop = true;
+    }
+    m_worker_cond.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+    LOCK(m_mutex);
+    m_stop = false;
+}
+
+void BlockPrechecker::Thread(const Consensus::Params& params)
+{
+    while (true) {
+        uint256 hash;
+        int height;
+        FlatFilePos pos;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            while (true) {
+                m_worker_cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_stop || !m_queue.empty(); });
+                // Blocks still queued are checked before stopping.
+                if (m_queue.empty()) return;
+                hash = m_queue.front();
+                m_queue.pop_front();
+                // Skip blocks that were taken or dropped while queued.
+                auto it = m_blocks.find(hash);
+                if (it != m_blocks.end() && it->second.status == Status::QUEUED) {
+                    it->second.status = Status::CHECKING;
+                    height = it->second.height;
+                    pos = it->second.pos;
+                    break;
+                }
+            }
+        }
+
+        std::shared_ptr<const CBlock> block;
+        {
+            std::shared_ptr<CBlock> read_block = std::make_shared<CBlock>();
+            read_block->m_tx_arena = std::make_shared<MonotonicArena>();
+            BlockValidationState state;
+            if (ReadBlockFromDisk(*read_block, pos, params) && read_block->GetHash() == hash && CheckBlock(*read_block, state, params)) {
+                block = std::move(read_block);
+            }
+        }
+        const size_t usage = RecursiveDynamicUsage(block);
+
+        {
+            LOCK(m_mutex);
+            // Entries being checked are neither taken nor dropped.
+            Entry& entry = m_blocks.at(hash);
+            entry.status = Status::DONE;
+            if (block && MakeRoom(height, usage)) {
+                entry.block = std::move(block);
+                entry.usage = usage;
+                m_usage += usage;
+            }
+        }
+        m_done_cond.notify_all();
+    }
+}
+
+void BlockPrechecker::Erase(std::map<uint256, Entry>::iterator it)
+{
+    assert(it->second.status != Status::CHECKING);
+    m_usage -= it->second.usage;
+    m_blocks.erase(it);
+}
+
+bool BlockPrechecker::MakeRoom(int height, size_t usage)
+{
+    while (m_usage + usage > m_max_usage) {
+        auto furthest = m_blocks.end();
+        for (auto it = m_blocks.begin(); it != m_blocks.end(); ++it) {
+            if (!it->second.block || it->second.height <= height) continue;
+            if (furthest == m_blocks.end() || it->second.height > furthest->second.height) furthest = it;
+        }
+        if (furthest == m_blocks.end()) return false;
+        Erase(furthest);
+    }
+    return true;
+}
+
+void BlockPrechecker::SetMaxUsage(size_t max_usage)
+{
+    LOCK(m_mutex);
+    m_max_usage = max_usage;
+    MakeRoom(-1, 0);
+}
+
+void BlockPrechecker::Schedule(const uint256& hash, int height, const FlatFilePos& pos)
+{
+    {
+        LOCK(m_mutex);
+        if (m_blocks.count(hash)) return;
+        m_blocks.emplace(hash, Entry{Status::QUEUED, height, pos, nullptr, 0});
+        m_queue.push_back(hash);
+    }
+    m_worker_cond.notify_one();
+}
+
+void BlockPrechecker::Add(std::shared_ptr<const CBlock> block, int height)
+{
+    assert(block->fChecked);
+    const uint256 hash = block->GetHash();
+    const size_t usage = RecursiveDynamicUsage(block);
+    LOCK(m_mutex);
+    if (m_blocks.count(hash) || !MakeRoom(height, usage)) return;
+    m_blocks.emplace(hash, Entry{Status::DONE, height, FlatFilePos(), std::move(block), usage});
+    m_usage += usage;
+}
+
+std::shared_ptr<const CBlock> BlockPrechecker::Take(const uint256& hash)
+{
+    WAIT_LOCK(m_mutex, lock);
+    auto it = m_blocks.find(hash);
+    while (it != m_blocks.end() && it->second.status == Status::CHECKING) {
+        m_done_cond.wait(lock);
+        it = m_blocks.find(hash);
+    }
+    if (it == m_blocks.end()) return nullptr;
+    std::shared_ptr<const CBlock> block = std::move(it->second.block);
+    const int height = it->second.height;
+    for (it = m_blocks.begin(); it != m_blocks.end();) {
+        if (it->second.height <= height && it->second.status != Status::CHECKING) {
+            Erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    return block;
+}
+
+size_t BlockPrechecker::Size() const
+{
+    LOCK(m_mutex);
+    return m_blocks.size();
+}
+
+size_t BlockPrechecker::DynamicMemoryUsage() const
+{
+    LOCK(m_mutex);
+    return m_usage;
+}
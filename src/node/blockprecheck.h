@@ -0,0 +1,112 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_BLOCKPRECHECK_H
+#define BITCOIN_NODE_BLOCKPRECHECK_H
+
+#include <flatfile.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class CBlock;
+namespace Consensus {
+struct Params;
+}
+
+/**
+ * Runs the context-free checks of blocks ahead of the tip (CheckBlock: proof of
+ * work, merkle root, size limits and CheckTransaction for every transaction) on
+ * worker threads, while the blocks before them are being connected.
+ *
+ * Blocks are scheduled by their position on disk and read by the workers. Blocks
+ * that already passed CheckBlock in memory, e.g. when they were received, can be
+ * added directly. ConnectTip takes the checked block instead of reading it from
+ * disk, and ConnectBlock skips the checks because the block is marked as checked.
+ *
+ * The memory used by the blocks held on to is limited. When a block does not fit,
+ * the blocks furthest from the tip are dropped to make room for it, or the block
+ * itself is dropped if there are none.
+ */
+class BlockPrechecker
+{
+public:
+    explicit BlockPrechecker(size_t max_usage) : m_max_usage(max_usage) {}
+    ~BlockPrechecker();
+
+    /** Start worker threads reading and checking scheduled blocks. */
+    void StartWorkers(int threads, const Consensus::Params& params);
+
+    /** Stop the worker threads once they have checked the blocks still queued. */
+    void StopWorkers();
+
+    /** Set the memory limit in bytes, dropping blocks furthest from the tip to stay within it. */
+    void SetMaxUsage(size_t max_usage);
+
+    /** Have a worker read the block with the given hash and height from pos and check it. */
+    void Schedule(const uint256& hash, int height, const FlatFilePos& pos);
+
+    /** Hold on to a block at the given height that already passed CheckBlock. */
+    void Add(std::shared_ptr<const CBlock> block, int height);
+
+    /**
+     * Take the checked block with the given hash, waiting for a worker that is
+     * checking it. Returns nullptr if the block is unknown, was not picked up by
+     * a worker yet, or failed to be read or checked; the caller then has to do
+     * the work itself. Blocks at or below the height of this one are forgotten,
+     * as they are not going to be connected next.
+     */
+    std::shared_ptr<const CBlock> Take(const uint256& hash);
+
+    /** Number of blocks queued, being checked or checked. */
+    size_t Size() const;
+
+    /** Memory used by the checked blocks held on to, in bytes. */
+    size_t DynamicMemoryUsage() const;
+
+private:
+    enum class Status {
+        QUEUED,
+        CHECKING,
+        DONE,
+    };
+
+    struct Entry {
+        Status status;
+        int height;
+        FlatFilePos pos;
+        std::shared_ptr<const CBlock> block;
+        size_t usage;
+    };
+
+    void Thread(const Consensus::Params& params);
+
+    /**
+     * Drop the checked blocks furthest from the tip, but above height, until
+     * usage more bytes fit. Returns false if they do not.
+     */
+    bool MakeRoom(int height, size_t usage) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    /** Forget an entry no worker is busy with. */
+    void Erase(std::map<uint256, Entry>::iterator it) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    std::vector<std::thread> m_threads;
+    mutable Mutex m_mutex;
+    std::condition_variable m_worker_cond;
+    std::condition_variable m_done_cond;
+    size_t m_max_usage GUARDED_BY(m_mutex);
+    size_t m_usage GUARDED_BY(m_mutex){0};
+    std::map<uint256, Entry> m_blocks GUARDED_BY(m_mutex);
+    std::deque<uint256> m_queue GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+};
+
+#endif // BITCOIN_NODE_BLOCKPRECHECK_H
@@ -13,9 +13,13 @@
 #include <functional>
 
 class CCoinsView;
+class COutPoint;
+class Coin;
+class MuHash3072;
 
 enum class CoinStatsHashType {
     HASH_SERIALIZED,
+    MUHASH,
     NONE,
 };
 
@@ -26,6 +30,7 @@ struct CCoinsStats
     uint64_t nTransactions{0};
     uint64_t nTransactionOutputs{0};
     uint64_t nBogoSize{0};
+    //! The UTXO set hash of the requested type (hash_serialized_2 or muhash)
     uint256 hashSerialized{};
     uint64_t nDiskSize{0};
     CAmount nTotalAmount{0};
@@ -34,6 +39,11 @@ struct CCoinsStats
     uint64_t coins_count{0};
 };
 
+//! Add a coin to a MuHash3072 of the unspent transaction output set
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+//! Remove a coin from a MuHash3072 of the unspent transaction output set
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+
 //! Calculate statistics about the unspent transaction output set
 bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, const CoinStatsHashType hash_type, const std::function<void()>& interruption_point = {});
 
@@ -8,6 +8,7 @@
 
 #include <primitives/transaction.h>
 #include <serialize.h>
+#include <support/allocators/arena.h>
 #include <uint256.h>
 
 /** Nodes collect new transactions into a block, hash them into a hash tree,
@@ -59,6 +60,22 @@ public:
 };
 
 
+/**
+ * Deserialize a block's transactions, allocating each of them (together with
+ * its shared_ptr control block) from the given arena.
+ */
+template<typename Stream>
+void UnserializeTransactions(Stream& s, std::vector<CTransactionRef>& vtx, const std::shared_ptr<MonotonicArena>& arena)
+{
+    vtx.clear();
+    const uint64_t count = ReadCompactSize(s);
+    // As in the generic vector deserialization, don't let the count alone reserve unbounded memory.
+    vtx.reserve(std::min<uint64_t>(count, MAX_VECTOR_ALLOCATE / sizeof(CTransactionRef)));
+    for (uint64_t i = 0; i < count; ++i) {
+        vtx.push_back(std::allocate_shared<const CTransaction>(arena_allocator<CTransaction>(arena), deserialize, s));
+    }
+}
+
 class CBlock : public CBlockHeader
 {
 public:
@@ -67,6 +84,15 @@ public:
 
     // memory only
     mutable bool fChecked;
+    /**
+     * If set, transactions deserialized into this block are allocated from this
+     * arena, which is released once the last of them is destroyed. This saves
+     * one heap allocation per transaction for blocks that are read to be
+     * validated or indexed. Any one transaction keeps the whole arena alive, so
+     * code that holds on to transactions after the block is gone, like the
+     * wallet, stores copies of them. Not reset by SetNull().
+     */
+    std::shared_ptr<MonotonicArena> m_tx_arena;
 
     CBlock()
     {
@@ -79,10 +105,21 @@ public:
         *(static_cast<CBlockHeader*>(this)) = header;
     }
 
-    SERIALIZE_METHODS(CBlock, obj)
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << *static_cast<const CBlockHeader*>(this) << vtx;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
     {
-        READWRITEAS(CBlockHeader, obj);
-        READWRITE(obj.vtx);
+        s >> *static_cast<CBlockHeader*>(this);
+        if (m_tx_arena) {
+            UnserializeTransactions(s, vtx, m_tx_arena);
+        } else {
+            s >> vtx;
+        }
     }
 
     void SetNull()
@@ -12,6 +12,8 @@
 #include <coins.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <crypto/muhash.h>
+#include <dbwrapper.h>
 #include <hash.h>
 #include <index/blockfilterindex.h>
 #include <node/coinstats.h>
@@ -974,24 +976,28 @@ static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
             RPCHelpMan{"gettxoutsetinfo",
                 "\nReturns statistics about the unspent transaction output set.\n"
-                "Note this call may take some time.\n",
+                "Note this call may take some time, unless the 'muhash' hash_type is chosen and the node\n"
+                "maintains it (see -rollingutxohash). The UTXO set is not scanned then, so the\n"
+                "transactions, txouts, bogosize and total_amount fields are left out.\n",
                 {
-                    {"hash_type", RPCArg::Type::STR, /* default */ "hash_serialized_2", "Which UTXO set hash should be calculated. Options: 'hash_serialized_2' (the legacy algorithm), 'none'."},
+                    {"hash_type", RPCArg::Type::STR, /* default */ "hash_serialized_2", "Which UTXO set hash should be calculated. Options: 'hash_serialized_2' (the legacy algorithm), 'muhash', 'none'."},
                 },
                 RPCResult{
                     RPCResult::Type::OBJ, "", "",
                     {
                         {RPCResult::Type::NUM, "height", "The current block height (index)"},
                         {RPCResult::Type::STR_HEX, "bestblock", "The hash of the block at the tip of the chain"},
-                        {RPCResult::Type::NUM, "transactions", "The number of transactions with unspent outputs"},
-                        {RPCResult::Type::NUM, "txouts", "The number of unspent transaction outputs"},
-                        {RPCResult::Type::NUM, "bogosize", "A meaningless metric for UTXO set size"},
-                        {RPCResult::Type::STR_HEX, "hash_serialized_2", "The serialized hash (only present if 'hash_serialized_2' hash_type is chosen)"},
+                        {RPCResult::Type::NUM, "transactions", /* optional */ true, "The number of transactions with unspent outputs (not present if the rolling hash is returned)"},
+                        {RPCResult::Type::NUM, "txouts", /* optional */ true, "The number of unspent transaction outputs (not present if the rolling hash is returned)"},
+                        {RPCResult::Type::NUM, "bogosize", /* optional */ true, "A meaningless metric for UTXO set size (not present if the rolling hash is returned)"},
+                        {RPCResult::Type::STR_HEX, "hash_serialized_2", /* optional */ true, "The serialized hash (only present if 'hash_serialized_2' hash_type is chosen)"},
+                        {RPCResult::Type::STR_HEX, "muhash", /* optional */ true, "The MuHash3072 of the UTXO set (only present if 'muhash' hash_type is chosen)"},
                         {RPCResult::Type::NUM, "disk_size", "The estimated size of the chainstate on disk"},
-                        {RPCResult::Type::STR_AMOUNT, "total_amount", "The total amount"},
+                        {RPCResult::Type::STR_AMOUNT, "total_amount", /* optional */ true, "The total amount (not present if the rolling hash is returned)"},
                     }},
                 RPCExamples{
                     HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", R"("muhash")")
             + HelpExampleRpc("gettxoutsetinfo", "")
                 },
             }.Check(request);
@@ -999,10 +1005,34 @@ static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
-    ::ChainstateActive().ForceFlushStateToDisk();
-
     const CoinStatsHashType hash_type = ParseHashType(request.params[0], CoinStatsHashType::HASH_SERIALIZED);
 
+    if (hash_type == CoinStatsHashType::MUHASH) {
+        // Use the rolling hash if it is maintained, which avoids both the
+        // flush and the scan of the UTXO set.
+        Optional<MuHash3072> utxo_hash;
+        CCoinsView* coins_view;
+        {
+            LOCK(cs_main);
+            utxo_hash = ::ChainstateActive().m_utxo_hash;
+            coins_view = &::ChainstateActive().CoinsDB();
+            const CBlockIndex* tip = ::ChainActive().Tip();
+            stats.hashBlock = tip->GetBlockHash();
+            stats.nHeight = tip->nHeight;
+        }
+        if (utxo_hash) {
+            uint256 muhash;
+            utxo_hash->Finalize(muhash);
+            ret.pushKV("height", (int64_t)stats.nHeight);
+            ret.pushKV("bestblock", stats.hashBlock.GetHex());
+            ret.pushKV("muhash", muhash.GetHex());
+            ret.pushKV("disk_size", coins_view->EstimateSize());
+            return ret;
+        }
+    }
+
+    ::ChainstateActive().ForceFlushStateToDisk();
+
     CCoinsView* coins_view = WITH_LOCK(cs_main, return &ChainstateActive().CoinsDB());
     if (GetUTXOStats(coins_view, stats, hash_type, RpcInterruptionPoint)) {
         ret.pushKV("height", (int64_t)stats.nHeight);
@@ -1012,6 +1042,8 @@ static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
         ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
         if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
             ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+        } else if (hash_type == CoinStatsHashType::MUHASH) {
+            ret.pushKV("muhash", stats.hashSerialized.GetHex());
         }
         ret.pushKV("disk_size", stats.nDiskSize);
         ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
@@ -2257,6 +2289,67 @@ static UniValue getblockfilter(const JSONRPCRequest& request)
     return ret;
 }
 
+static UniValue getdbstats(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getdbstats",
+                "\nReturns the storage profile, disk footprint and read amplification of each open database.\n"
+                "Lookups are counted since the database was opened. Table reads are the reads of table blocks\n"
+                "that missed the block cache, done by those lookups; reads done by compactions are not counted.\n"
+                "Blocks of memory mapped table files are not cached, so every access to them counts as a read.\n",
+                {},
+                RPCResult{
+                    RPCResult::Type::ARR, "", "",
+                    {
+                        {RPCResult::Type::OBJ, "", "",
+                        {
+                            {RPCResult::Type::STR, "name", "The name of the database"},
+                            {RPCResult::Type::STR, "profile", "The -dbprofile the database was opened with (empty for the default profile)"},
+                            {RPCResult::Type::STR, "compression", "The compression of new table blocks (none or snappy)"},
+                            {RPCResult::Type::NUM, "bloom_bits", "Bits per key of the bloom filters (0 for none)"},
+                            {RPCResult::Type::NUM, "block_size", "The approximate size of a table block in bytes"},
+                            {RPCResult::Type::NUM, "block_cache_size", "The size of the block cache in bytes"},
+                            {RPCResult::Type::NUM, "write_buffer_size", "The size of a write buffer in bytes"},
+                            {RPCResult::Type::NUM, "disk_size", "The size of the database files in bytes (0 for an in-memory database)"},
+                            {RPCResult::Type::NUM, "lookups", "The number of point lookups"},
+                            {RPCResult::Type::NUM, "lookup_bytes", "The size of the values found by the lookups in bytes"},
+                            {RPCResult::Type::NUM, "table_reads", "The number of table block reads done by the lookups"},
+                            {RPCResult::Type::NUM, "table_read_bytes", "The size of those table block reads in bytes"},
+                            {RPCResult::Type::NUM, "table_reads_per_lookup", /* optional */ true, "Table block reads per lookup (only present if there were lookups)"},
+                            {RPCResult::Type::NUM, "read_amplification", /* optional */ true, "Bytes of table blocks read per byte of value found (only present if values were found)"},
+                        }},
+                    }},
+                RPCExamples{
+                    HelpExampleCli("getdbstats", "")
+            + HelpExampleRpc("getdbstats", "")
+                },
+            }.Check(request);
+
+    UniValue ret(UniValue::VARR);
+    for (const DBStats& stats : GetDBStats()) {
+        UniValue db(UniValue::VOBJ);
+        db.pushKV("name", stats.name);
+        db.pushKV("profile", stats.profile_name);
+        db.pushKV("compression", stats.profile.compression ? "snappy" : "none");
+        db.pushKV("bloom_bits", stats.profile.bloom_bits);
+        db.pushKV("block_size", (uint64_t)stats.profile.block_size);
+        db.pushKV("block_cache_size", (uint64_t)stats.block_cache_size);
+        db.pushKV("write_buffer_size", (uint64_t)stats.write_buffer_size);
+        db.pushKV("disk_size", stats.disk_size);
+        db.pushKV("lookups", stats.lookups);
+        db.pushKV("lookup_bytes", stats.lookup_bytes);
+        db.pushKV("table_reads", stats.table_reads);
+        db.pushKV("table_read_bytes", stats.table_read_bytes);
+        if (stats.lookups > 0) {
+            db.pushKV("table_reads_per_lookup", (double)stats.table_reads / stats.lookups);
+        }
+        if (stats.lookup_bytes > 0) {
+            db.pushKV("read_amplification", (double)stats.table_read_bytes / stats.lookup_bytes);
+        }
+        ret.push_back(db);
+    }
+    return ret;
+}
+
 /**
  * Serialize the UTXO set to a file for loading elsewhere.
  *
@@ -2362,6 +2455,84 @@ UniValue dumptxoutset(const JSONRPCRequest& request)
     return result;
 }
 
+static UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    RPCHelpMan{
+        "loadtxoutset",
+        "\nLoad a serialized UTXO set, as written by dumptxoutset, into a new chainstate and make it active.\n"
+        "The snapshot is only used if its base block header is known and ahead of the current tip, and its contents\n"
+        "match the UTXO set hash expected at that height. It is used again after a restart.\n",
+        {
+            {"path",
+                RPCArg::Type::STR,
+                RPCArg::Optional::NO,
+                /* default_val */ "",
+                "path to the snapshot file. If relative, will be prefixed by datadir."},
+        },
+        RPCResult{
+            RPCResult::Type::OBJ, "", "",
+                {
+                    {RPCResult::Type::NUM, "coins_loaded", "the number of coins loaded from the snapshot"},
+                    {RPCResult::Type::STR_HEX, "tip_hash", "the hash of the base of the snapshot"},
+                    {RPCResult::Type::NUM, "base_height", "the height of the base of the snapshot"},
+                    {RPCResult::Type::STR, "path", "the absolute path that the snapshot was loaded from"},
+                }
+        },
+        RPCExamples{
+            HelpExampleCli("loadtxoutset", "utxo.dat")
+        }
+    }.Check(request);
+
+    ChainstateManager& chainman = EnsureChainman(request.context);
+    fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+
+    FILE* file{fsbridge::fopen(path, "rb")};
+    CAutoFile afile{file, SER_DISK, CLIENT_VERSION};
+    if (afile.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Couldn't open file " + path.string() + " for reading.");
+    }
+
+    SnapshotMetadata metadata;
+    try {
+        afile >> metadata;
+    } catch (const std::ios_base::failure&) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Unable to parse snapshot metadata");
+    }
+
+    {
+        LOCK(::cs_main);
+        const CBlockIndex* base = LookupBlockIndex(metadata.m_base_blockhash);
+        if (!base) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "The base block header of the snapshot is not known: " + metadata.m_base_blockhash.ToString());
+        }
+        if (base->nHeight <= chainman.ActiveHeight()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("The snapshot base at height %d is not ahead of the current tip at height %d", base->nHeight, chainman.ActiveHeight()));
+        }
+    }
+
+    if (!chainman.ActivateSnapshot(afile, metadata, Params(), /* in_memory */ false)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to load UTXO snapshot " + path.string());
+    }
+
+    // Connect any blocks building on the snapshot that we already have.
+    BlockValidationState state;
+    if (!chainman.ActiveChainstate().ActivateBestChain(state, Params(), nullptr)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, state.ToString());
+    }
+
+    // Validate the chain below the snapshot as its blocks come in.
+    chainman.StartBackgroundValidation(Params());
+
+    const CBlockIndex* base = WITH_LOCK(::cs_main, return LookupBlockIndex(metadata.m_base_blockhash));
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("coins_loaded", metadata.m_coins_count);
+    result.pushKV("tip_hash", base->GetBlockHash().ToString());
+    result.pushKV("base_height", base->nHeight);
+    result.pushKV("path", path.string());
+    return result;
+}
+
 void RegisterBlockchainRPCCommands(CRPCTable &t)
 {
 // clang-format off
@@ -2392,6 +2563,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
     { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
     { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash", "filtertype"} },
+    { "blockchain",         "getdbstats",             &getdbstats,             {} },
 
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        {"blockhash"} },
@@ -2401,6 +2573,7 @@ static const CRPCCommand commands[] =
     { "hidden",             "waitforblockheight",     &waitforblockheight,     {"height","timeout"} },
     { "hidden",             "syncwithvalidationinterfacequeue", &syncwithvalidationinterfacequeue, {} },
     { "hidden",             "dumptxoutset",           &dumptxoutset,           {"path"} },
+    { "hidden",             "loadtxoutset",           &loadtxoutset,           {"path"} },
 };
 // clang-format on
 
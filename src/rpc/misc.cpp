@@ -13,6 +13,7 @@
 #include <rpc/util.h>
 #include <scheduler.h>
 #include <script/descriptor.h>
+#include <script/sigcache.h>
 #include <util/check.h>
 #include <util/message.h> // For MessageSign(), MessageVerify()
 #include <util/ref.h>
@@ -492,6 +493,66 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+static UniValue getsigcacheinfo(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getsigcacheinfo",
+                "Returns usage statistics of the signature cache since startup, per shard and in total.\n"
+                "Use them to size -maxsigcachesize: evictions mean valid signatures had to be dropped to make room.\n",
+                {},
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::NUM, "capacity", "Number of entries the cache can hold"},
+                        {RPCResult::Type::NUM, "hits", "Number of lookups that found the signature in the cache"},
+                        {RPCResult::Type::NUM, "misses", "Number of lookups that did not find the signature in the cache"},
+                        {RPCResult::Type::NUM, "inserts", "Number of signatures added to the cache"},
+                        {RPCResult::Type::NUM, "evictions", "Number of cached signatures dropped to make room for new ones"},
+                        {RPCResult::Type::ARR, "shards", "Statistics of each shard of the cache",
+                        {
+                            {RPCResult::Type::OBJ, "", "",
+                            {
+                                {RPCResult::Type::NUM, "capacity", "Number of entries the shard can hold"},
+                                {RPCResult::Type::NUM, "hits", "Number of lookups that found the signature in the shard"},
+                                {RPCResult::Type::NUM, "misses", "Number of lookups that did not find the signature in the shard"},
+                                {RPCResult::Type::NUM, "inserts", "Number of signatures added to the shard"},
+                                {RPCResult::Type::NUM, "evictions", "Number of cached signatures dropped from the shard"},
+                            }},
+                        }},
+                    }
+                },
+                RPCExamples{
+                    HelpExampleCli("getsigcacheinfo", "")
+            + HelpExampleRpc("getsigcacheinfo", "")
+                },
+            }.Check(request);
+
+    SignatureCacheShardStats total{};
+    UniValue shards(UniValue::VARR);
+    for (const SignatureCacheShardStats& stats : GetSignatureCacheStats()) {
+        UniValue shard(UniValue::VOBJ);
+        shard.pushKV("capacity", uint64_t(stats.capacity));
+        shard.pushKV("hits", stats.hits);
+        shard.pushKV("misses", stats.misses);
+        shard.pushKV("inserts", stats.inserts);
+        shard.pushKV("evictions", stats.evictions);
+        shards.push_back(shard);
+        total.capacity += stats.capacity;
+        total.hits += stats.hits;
+        total.misses += stats.misses;
+        total.inserts += stats.inserts;
+        total.evictions += stats.evictions;
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("capacity", uint64_t(total.capacity));
+    obj.pushKV("hits", total.hits);
+    obj.pushKV("misses", total.misses);
+    obj.pushKV("inserts", total.inserts);
+    obj.pushKV("evictions", total.evictions);
+    obj.pushKV("shards", shards);
+    return obj;
+}
+
 static void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     cats = cats.get_array();
     for (unsigned int i = 0; i < cats.size(); ++i) {
@@ -604,6 +665,7 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    { "control",            "getsigcacheinfo",        &getsigcacheinfo,        {} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
     { "util",               "validateaddress",        &validateaddress,        {"address"} },
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys","address_type"} },
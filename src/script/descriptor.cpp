@@ -353,7 +353,8 @@ public:
         // We rely on the consumer to check that m_derive isn't HARDENED as above
         // But we can't have already cached something in case we read something from the cache
         // and parent_extkey isn't actually the parent.
-        if (!m_cached_xpub.pubkey.IsValid()) m_cached_xpub = parent_extkey;
+        // Expanding from a read_cache leaves the provider untouched, so that it can be done concurrently.
+        if (!read_cache && !m_cached_xpub.pubkey.IsValid()) m_cached_xpub = parent_extkey;
 
         if (write_cache) {
             // Only cache parent if there is any unhardened derivation
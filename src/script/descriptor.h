@@ -104,6 +104,8 @@ struct Descriptor {
     virtual bool Expand(int pos, const SigningProvider& provider, std::vector<CScript>& output_scripts, FlatSigningProvider& out, DescriptorCache* write_cache = nullptr) const = 0;
 
     /** Expand a descriptor at a specified position using cached expansion data.
+     *
+     * This does not modify the descriptor, so it may be called from several threads at once.
      *
      * @param[in] pos The position at which to expand the descriptor. If IsRange() is false, this is ignored.
      * @param[in] read_cache Cached expansion data.
@@ -10,8 +10,11 @@
 #include <crypto/sha256.h>
 #include <pubkey.h>
 #include <script/script.h>
+#include <streams.h>
 #include <uint256.h>
 
+#include <algorithm>
+
 typedef std::vector<unsigned char> valtype;
 
 namespace {
@@ -1288,6 +1291,9 @@ uint256 GetOutputsHash(const T& txTo)
     return ss.GetHash();
 }
 
+/** Serialized size of an input blanked out in a legacy signature hash: its prevout, an empty script and its nSequence. */
+constexpr size_t LEGACY_BLANK_INPUT_SIZE = 32 + 4 + 1 + 4;
+
 } // namespace
 
 template <class T>
@@ -1300,6 +1306,33 @@ void PrecomputedTransactionData::Init(const T& txTo)
         hashPrevouts = GetPrevoutHash(txTo);
         hashSequence = GetSequenceHash(txTo);
         hashOutputs = GetOutputsHash(txTo);
+        m_bip143_all_prefix << txTo.nVersion << hashPrevouts << hashSequence;
+        m_bip143_prevouts_prefix << txTo.nVersion << hashPrevouts << uint256();
+    }
+
+    // In legacy SIGHASH_ALL signature hashes, all inputs but the one being
+    // signed are blanked out the same way, so the hasher state before each
+    // input and the serialization after it can be shared. Inputs spent with
+    // a witness don't use legacy signature hashes, so this is skipped when
+    // there are no others.
+    const bool has_legacy_input = std::any_of(txTo.vin.begin(), txTo.vin.end(), [](const CTxIn& txin) { return txin.scriptWitness.IsNull(); });
+    if (txTo.vin.size() > 1 && has_legacy_input) {
+        CVectorWriter tail(SER_GETHASH, 0, m_legacy_tail, 0);
+        for (const auto& txin : txTo.vin) {
+            tail << txin.prevout << CScript() << txin.nSequence;
+        }
+        assert(m_legacy_tail.size() == txTo.vin.size() * LEGACY_BLANK_INPUT_SIZE);
+        tail << txTo.vout << txTo.nLockTime;
+
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << txTo.nVersion;
+        ::WriteCompactSize(ss, txTo.vin.size());
+        m_legacy_prefixes.reserve(txTo.vin.size());
+        for (size_t i = 0; i < txTo.vin.size(); ++i) {
+            m_legacy_prefixes.push_back(ss);
+            ss.write((const char*)m_legacy_tail.data() + i * LEGACY_BLANK_INPUT_SIZE, LEGACY_BLANK_INPUT_SIZE);
+        }
+        m_legacy_ready = true;
     }
 
     m_ready = true;
@@ -1345,12 +1378,21 @@ uint256 SignatureHash(const CScript& scriptCode, const T& txTo, unsigned int nIn
             hashOutputs = ss.GetHash();
         }
 
-        CHashWriter ss(SER_GETHASH, 0);
-        // Version
-        ss << txTo.nVersion;
-        // Input prevouts/nSequence (none/all, depending on flags)
-        ss << hashPrevouts;
-        ss << hashSequence;
+        // Resume from a cached hasher when it already holds the version and
+        // input prevouts/nSequence for this hash type.
+        const CHashWriter* prefix = nullptr;
+        if (cacheready && !(nHashType & SIGHASH_ANYONECANPAY)) {
+            const bool all = (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE;
+            prefix = all ? &cache->m_bip143_all_prefix : &cache->m_bip143_prevouts_prefix;
+        }
+        CHashWriter ss = prefix ? *prefix : CHashWriter(SER_GETHASH, 0);
+        if (!prefix) {
+            // Version
+            ss << txTo.nVersion;
+            // Input prevouts/nSequence (none/all, depending on flags)
+            ss << hashPrevouts;
+            ss << hashSequence;
+        }
         // The input being signed (replacing the scriptSig with scriptCode + amount)
         // The prevout may already be contained in hashPrevout, and the nSequence
         // may already be contain in hashSequence.
@@ -1379,6 +1421,16 @@ uint256 SignatureHash(const CScript& scriptCode, const T& txTo, unsigned int nIn
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer<T> txTmp(txTo, scriptCode, nIn, nHashType);
 
+    if (cache && cache->m_legacy_ready && !(nHashType & SIGHASH_ANYONECANPAY) && (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE) {
+        // Only the input being signed differs from the cached serialization
+        CHashWriter ss = cache->m_legacy_prefixes[nIn];
+        txTmp.SerializeInput(ss, nIn);
+        const size_t tail_start = (nIn + 1) * LEGACY_BLANK_INPUT_SIZE;
+        ss.write((const char*)cache->m_legacy_tail.data() + tail_start, cache->m_legacy_tail.size() - tail_start);
+        ss << nHashType;
+        return ss.GetHash();
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_SCRIPT_INTERPRETER_H
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
+#include <hash.h>
 #include <script/script_error.h>
 #include <primitives/transaction.h>
 
@@ -123,6 +124,27 @@ struct PrecomputedTransactionData
     uint256 hashPrevouts, hashSequence, hashOutputs;
     bool m_ready = false;
 
+    /**
+     * BIP143 hashers that already hold nVersion, hashPrevouts and
+     * hashSequence, for the hash types that commit to all prevouts and
+     * sequences (SIGHASH_ALL) and to the prevouts only (SIGHASH_NONE and
+     * SIGHASH_SINGLE). Set together with the hashes above.
+     */
+    CHashWriter m_bip143_all_prefix{SER_GETHASH, 0};
+    CHashWriter m_bip143_prevouts_prefix{SER_GETHASH, 0};
+
+    /**
+     * Cache for legacy SIGHASH_ALL signature hashes, so that signing many
+     * inputs does not serialize and hash the whole transaction each time.
+     * m_legacy_prefixes[i] holds the hasher after nVersion and the blanked
+     * inputs before input i, and m_legacy_tail the serialized blanked inputs
+     * followed by the outputs and nLockTime. Only set for transactions with
+     * more than one input, at least one of which has no witness.
+     */
+    std::vector<CHashWriter> m_legacy_prefixes;
+    std::vector<unsigned char> m_legacy_tail;
+    bool m_legacy_ready = false;
+
     PrecomputedTransactionData() = default;
 
     template <class T>
@@ -13,11 +13,17 @@
 #include <cuckoocache.h>
 #include <boost/thread/shared_mutex.hpp>
 
+#include <array>
+#include <atomic>
+
 namespace {
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
  * twice for every transaction (once when accepted into memory pool, and
  * again when accepted into the block chain)
+ *
+ * Entries are spread over SIGNATURE_CACHE_SHARDS independently locked cuckoo
+ * caches, so that script check threads rarely contend for the same lock.
  */
 class CSignatureCache
 {
@@ -25,8 +31,25 @@ private:
      //! Entries are SHA256(nonce || signature hash || public key || signature):
     CSHA256 m_salted_hasher;
     typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
-    map_type setValid;
-    boost::shared_mutex cs_sigcache;
+
+    struct Shard
+    {
+        map_type setValid;
+        boost::shared_mutex cs_sigcache;
+        uint32_t m_capacity{0};
+        std::atomic<uint64_t> m_hits{0};
+        std::atomic<uint64_t> m_misses{0};
+        std::atomic<uint64_t> m_inserts{0};
+        std::atomic<uint64_t> m_evictions{0};
+    };
+    std::array<Shard, SIGNATURE_CACHE_SHARDS> m_shards;
+
+    Shard& GetShard(const uint256& entry)
+    {
+        // Entries are uniformly distributed. The low bits of the first byte
+        // barely affect the slots SignatureCacheHasher selects within a shard.
+        return m_shards[*entry.begin() % SIGNATURE_CACHE_SHARDS];
+    }
 
 public:
     CSignatureCache()
@@ -49,18 +72,47 @@ public:
     bool
     Get(const uint256& entry, const bool erase)
     {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-        return setValid.contains(entry, erase);
+        Shard& shard = GetShard(entry);
+        bool found;
+        {
+            boost::shared_lock<boost::shared_mutex> lock(shard.cs_sigcache);
+            found = shard.setValid.contains(entry, erase);
+        }
+        ++(found ? shard.m_hits : shard.m_misses);
+        return found;
     }
 
     void Set(uint256& entry)
     {
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        setValid.insert(entry);
+        Shard& shard = GetShard(entry);
+        bool evicted;
+        {
+            boost::unique_lock<boost::shared_mutex> lock(shard.cs_sigcache);
+            evicted = shard.setValid.insert(entry);
+        }
+        ++shard.m_inserts;
+        if (evicted) ++shard.m_evictions;
     }
+
     uint32_t setup_bytes(size_t n)
     {
-        return setValid.setup_bytes(n);
+        uint32_t elems = 0;
+        for (Shard& shard : m_shards) {
+            boost::unique_lock<boost::shared_mutex> lock(shard.cs_sigcache);
+            shard.m_capacity = shard.setValid.setup_bytes(n / SIGNATURE_CACHE_SHARDS);
+            elems += shard.m_capacity;
+        }
+        return elems;
+    }
+
+    std::vector<SignatureCacheShardStats> GetStats()
+    {
+        std::vector<SignatureCacheShardStats> stats;
+        stats.reserve(m_shards.size());
+        for (const Shard& shard : m_shards) {
+            stats.push_back({shard.m_capacity, shard.m_hits, shard.m_misses, shard.m_inserts, shard.m_evictions});
+        }
+        return stats;
     }
 };
 
@@ -85,6 +137,11 @@ void InitSignatureCache()
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+std::vector<SignatureCacheShardStats> GetSignatureCacheStats()
+{
+    return signatureCache.GetStats();
+}
+
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
     uint256 entry;
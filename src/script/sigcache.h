@@ -16,6 +16,8 @@
 static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
+// Number of independently locked parts the signature cache is split into
+static const size_t SIGNATURE_CACHE_SHARDS = 16;
 
 class CPubKey;
 
@@ -53,4 +55,16 @@ public:
 
 void InitSignatureCache();
 
+/** Usage counters of one shard of the signature cache, since startup. */
+struct SignatureCacheShardStats
+{
+    uint32_t capacity; //!< Number of entries the shard can hold
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+    uint64_t evictions; //!< Number of valid entries dropped to make room for new ones
+};
+
+std::vector<SignatureCacheShardStats> GetSignatureCacheStats();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -0,0 +1,96 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_ARENA_H
+#define BITCOIN_SUPPORT_ALLOCATORS_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+/**
+ * Monotonic memory arena. Allocations are carved out of large chunks and are
+ * never freed individually; all chunks are released together when the arena
+ * is destroyed.
+ *
+ * Allocating from an arena is not thread-safe. Objects that live in an arena
+ * hold a reference to it through their arena_allocator, so the arena can be
+ * shared between threads once it is no longer allocated from.
+ */
+class MonotonicArena
+{
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    explicit MonotonicArena(size_t chunk_size = DEFAULT_CHUNK_SIZE) : m_chunk_size(chunk_size) {}
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    void* Allocate(size_t size, size_t align)
+    {
+        uintptr_t pos = (m_pos + align - 1) & ~(uintptr_t)(align - 1);
+        if (pos + size > m_end) {
+            // Oversized requests get a chunk of their own, so that the tail of the current chunk stays usable.
+            const size_t chunk_size = size + align > m_chunk_size ? size + align : m_chunk_size;
+            m_chunks.emplace_back(new char[chunk_size]);
+            const uintptr_t begin = reinterpret_cast<uintptr_t>(m_chunks.back().get());
+            pos = (begin + align - 1) & ~(uintptr_t)(align - 1);
+            if (chunk_size != m_chunk_size) {
+                m_allocated += size;
+                return reinterpret_cast<void*>(pos);
+            }
+            m_end = begin + chunk_size;
+        }
+        m_pos = pos + size;
+        m_allocated += size;
+        return reinterpret_cast<void*>(pos);
+    }
+
+    //! Number of bytes handed out so far.
+    size_t Allocated() const { return m_allocated; }
+    //! Number of chunks obtained from the system allocator.
+    size_t Chunks() const { return m_chunks.size(); }
+
+private:
+    const size_t m_chunk_size;
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+    uintptr_t m_pos{0};
+    uintptr_t m_end{0};
+    size_t m_allocated{0};
+};
+
+/**
+ * Allocator drawing from a MonotonicArena. Deallocation is a no-op; each
+ * allocator keeps the arena alive, which makes it suitable for
+ * std::allocate_shared: the arena is freed once the last object allocated
+ * from it is gone.
+ */
+template <typename T>
+struct arena_allocator {
+    typedef T value_type;
+
+    explicit arena_allocator(std::shared_ptr<MonotonicArena> arena) noexcept : m_arena(std::move(arena)) {}
+    template <typename U>
+    arena_allocator(const arena_allocator<U>& a) noexcept : m_arena(a.m_arena)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_arena->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept {}
+
+    template <typename U>
+    bool operator==(const arena_allocator<U>& a) const noexcept { return m_arena == a.m_arena; }
+    template <typename U>
+    bool operator!=(const arena_allocator<U>& a) const noexcept { return m_arena != a.m_arena; }
+
+    std::shared_ptr<MonotonicArena> m_arena;
+};
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_ARENA_H
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <support/allocators/arena.h>
 #include <util/memory.h>
 #include <util/system.h>
 
@@ -233,4 +234,52 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(monotonic_arena_tests)
+{
+    MonotonicArena arena(1024);
+    BOOST_CHECK_EQUAL(arena.Chunks(), 0U);
+
+    // Allocations are aligned and carved out of a single chunk while they fit.
+    char* a = static_cast<char*>(arena.Allocate(1, 1));
+    uint64_t* b = static_cast<uint64_t*>(arena.Allocate(sizeof(uint64_t), alignof(uint64_t)));
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(b) % alignof(uint64_t), 0U);
+    BOOST_CHECK(reinterpret_cast<char*>(b) > a);
+    BOOST_CHECK(reinterpret_cast<char*>(b) < a + 1024);
+    BOOST_CHECK_EQUAL(arena.Chunks(), 1U);
+
+    // An oversized allocation gets its own chunk and leaves the current one usable.
+    void* big = arena.Allocate(4096, 16);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(big) % 16, 0U);
+    BOOST_CHECK_EQUAL(arena.Chunks(), 2U);
+    char* c = static_cast<char*>(arena.Allocate(8, 1));
+    BOOST_CHECK(c > a && c < a + 1024);
+
+    // Running out of space in the current chunk starts a new one.
+    for (int i = 0; i < 200; ++i) arena.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(arena.Chunks(), 3U);
+    BOOST_CHECK_EQUAL(arena.Allocated(), 1U + 8 + 4096 + 8 + 200 * 8);
+}
+
+BOOST_AUTO_TEST_CASE(arena_allocator_shared_tests)
+{
+    // Objects allocated with allocate_shared keep the arena alive until the last one is gone.
+    std::weak_ptr<MonotonicArena> weak_arena;
+    std::shared_ptr<const std::vector<int>> survivor;
+    {
+        auto arena = std::make_shared<MonotonicArena>();
+        weak_arena = arena;
+        std::vector<std::shared_ptr<const std::vector<int>>> objects;
+        for (int i = 0; i < 100; ++i) {
+            objects.push_back(std::allocate_shared<const std::vector<int>>(arena_allocator<std::vector<int>>(arena), i, i));
+        }
+        survivor = objects[42];
+        BOOST_CHECK_EQUAL(arena->Chunks(), 1U);
+    }
+    BOOST_CHECK(!weak_arena.expired());
+    BOOST_CHECK_EQUAL(survivor->size(), 42U);
+    BOOST_CHECK_EQUAL((*survivor)[0], 42);
+    survivor.reset();
+    BOOST_CHECK(weak_arena.expired());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -369,4 +369,42 @@ BOOST_AUTO_TEST_CASE(TransactionsRequestDeserializationOverflowTest) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(StripRawBlockWitnessTest)
+{
+    CBlock block(BuildBlockTestCase());
+    std::vector<uint8_t> stripped;
+
+    // A block without witness data is left as is.
+    std::vector<uint8_t> no_witness;
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, no_witness, 0, block);
+    BOOST_CHECK(StripRawBlockWitness(no_witness, stripped));
+    BOOST_CHECK(stripped == no_witness);
+
+    // Witnesses are cut out of transactions that have them.
+    CMutableTransaction tx(*block.vtx[2]);
+    tx.vin[3].scriptWitness.stack = {{1, 2, 3}, {}};
+    tx.vin[7].scriptWitness.stack = {std::vector<unsigned char>(300, 4)};
+    block.vtx[2] = MakeTransactionRef(tx);
+    std::vector<uint8_t> with_witness, expected;
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, with_witness, 0, block);
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS, expected, 0, block);
+    BOOST_CHECK(with_witness.size() > expected.size());
+    BOOST_CHECK(StripRawBlockWitness(with_witness, stripped));
+    BOOST_CHECK(stripped == expected);
+
+    // Truncated, padded or otherwise malformed serializations are rejected.
+    BOOST_CHECK(!StripRawBlockWitness(MakeSpan(with_witness).first(with_witness.size() - 1), stripped));
+    std::vector<uint8_t> padded(with_witness);
+    padded.push_back(0);
+    BOOST_CHECK(!StripRawBlockWitness(padded, stripped));
+    tx.vin[3].scriptWitness.SetNull();
+    tx.vin[7].scriptWitness.SetNull();
+    std::vector<uint8_t> superfluous;
+    CVectorWriter writer(SER_NETWORK, PROTOCOL_VERSION, superfluous, 0);
+    writer << block.GetBlockHeader() << COMPACTSIZE(1U) << tx.nVersion << uint8_t{0} << uint8_t{1} << tx.vin << tx.vout;
+    for (size_t i = 0; i < tx.vin.size(); ++i) writer << uint8_t{0};
+    writer << tx.nLockTime;
+    BOOST_CHECK(!StripRawBlockWitness(superfluous, stripped));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -39,6 +39,48 @@ BOOST_AUTO_TEST_CASE(gcsfilter_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(gcsfilter_match_any_test)
+{
+    GCSFilter::ElementSet included_elements;
+    for (int i = 0; i < 1000; ++i) {
+        GCSFilter::Element element(32);
+        element[0] = i;
+        element[1] = i >> 8;
+        included_elements.insert(std::move(element));
+    }
+    GCSFilter filter({0, 0, 10, 1 << 10}, included_elements);
+
+    // Both fewer and more elements than the filter holds, so MatchAny merges
+    // with the filter and looks the elements up in the decoded filter.
+    for (int count : {10, 1000, 1001, 5000}) {
+        GCSFilter::ElementSet excluded_elements;
+        for (int i = 0; i < count; ++i) {
+            GCSFilter::Element element(32);
+            element[2] = i;
+            element[3] = i >> 8;
+            excluded_elements.insert(std::move(element));
+        }
+
+        // The false positives of MatchAny are those of Match.
+        bool any_match = false;
+        for (const auto& element : excluded_elements) {
+            any_match |= filter.Match(element);
+        }
+        BOOST_CHECK_EQUAL(filter.MatchAny(excluded_elements), any_match);
+
+        for (int i = 0; i < 1000; i += 99) {
+            GCSFilter::Element element(32);
+            element[0] = i;
+            element[1] = i >> 8;
+            auto insertion = excluded_elements.insert(element);
+            BOOST_CHECK(filter.MatchAny(excluded_elements));
+            excluded_elements.erase(insertion.first);
+        }
+    }
+
+    BOOST_CHECK(!GCSFilter().MatchAny(included_elements));
+}
+
 BOOST_AUTO_TEST_CASE(gcsfilter_default_constructor)
 {
     GCSFilter filter;
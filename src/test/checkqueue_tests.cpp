@@ -145,9 +145,10 @@ typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
 /** This test case checks that the CCheckQueue works properly
  * with each specified size_t Checks pushed.
  */
-static void Correct_Queue_range(std::vector<size_t> range)
+static void Correct_Queue_range(std::vector<size_t> range, bool work_stealing = false)
 {
     auto small_queue = MakeUnique<Correct_Queue>(QUEUE_BATCH_SIZE);
+    if (work_stealing) small_queue->EnableWorkStealing(SCRIPT_CHECK_THREADS);
     boost::thread_group tg;
     for (auto x = 0; x < SCRIPT_CHECK_THREADS; ++x) {
        tg.create_thread([&]{small_queue->Thread();});
@@ -207,6 +208,17 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Random)
     Correct_Queue_range(range);
 }
 
+/** Test that random numbers of checks are correct with work stealing
+ */
+BOOST_AUTO_TEST_CASE(test_CheckQueue_WorkStealing_Correct_Random)
+{
+    std::vector<size_t> range;
+    range.reserve(100000/1000);
+    for (size_t i = 2; i < 100000; i += std::max((size_t)1, (size_t)InsecureRandRange(std::min((size_t)1000, ((size_t)100000) - i))))
+        range.push_back(i);
+    Correct_Queue_range(range, /* work_stealing */ true);
+}
+
 
 /** Test that failing checks are caught */
 BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure)
@@ -305,6 +317,63 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck)
 }
 
 
+// Test that failures and unique checks are handled the same way by the
+// work-stealing queues.
+BOOST_AUTO_TEST_CASE(test_CheckQueue_WorkStealing_Failure_And_Unique)
+{
+    auto fail_queue = MakeUnique<Failing_Queue>(QUEUE_BATCH_SIZE);
+    fail_queue->EnableWorkStealing(SCRIPT_CHECK_THREADS);
+    auto unique_queue = MakeUnique<Unique_Queue>(QUEUE_BATCH_SIZE);
+    unique_queue->EnableWorkStealing(SCRIPT_CHECK_THREADS);
+    boost::thread_group tg;
+    for (auto x = 0; x < SCRIPT_CHECK_THREADS; ++x) {
+       tg.create_thread([&]{fail_queue->Thread();});
+       tg.create_thread([&]{unique_queue->Thread();});
+    }
+
+    for (auto times = 0; times < 10; ++times) {
+        for (const bool end_fails : {true, false}) {
+            CCheckQueueControl<FailingCheck> control(fail_queue.get());
+            for (size_t i = 0; i < 10; ++i) {
+                std::vector<FailingCheck> vChecks;
+                vChecks.resize(10, false);
+                vChecks[9] = end_fails && i == 9;
+                control.Add(vChecks);
+            }
+            BOOST_REQUIRE(control.Wait() != end_fails);
+        }
+    }
+
+    {
+        LOCK(UniqueCheck::m);
+        UniqueCheck::results.clear();
+    }
+    size_t COUNT = 100000;
+    size_t total = COUNT;
+    {
+        CCheckQueueControl<UniqueCheck> control(unique_queue.get());
+        while (total) {
+            size_t r = InsecureRandRange(10);
+            std::vector<UniqueCheck> vChecks;
+            for (size_t k = 0; k < r && total; k++)
+                vChecks.emplace_back(--total);
+            control.Add(vChecks);
+        }
+    }
+    {
+        LOCK(UniqueCheck::m);
+        bool r = true;
+        BOOST_REQUIRE_EQUAL(UniqueCheck::results.size(), COUNT);
+        for (size_t i = 0; i < COUNT; ++i) {
+            r = r && UniqueCheck::results.count(i) == 1;
+        }
+        BOOST_REQUIRE(r);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+
 // Test that blocks which might allocate lots of memory free their memory aggressively.
 //
 // This test attempts to catch a pathological case where by lazily freeing
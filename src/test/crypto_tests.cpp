@@ -8,12 +8,14 @@
 #include <crypto/hkdf_sha256_32.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <crypto/muhash.h>
 #include <crypto/poly1305.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
 #include <random.h>
+#include <streams.h>
 #include <test/util/setup_common.h>
 #include <util/strencodings.h>
 
@@ -587,6 +589,45 @@ BOOST_AUTO_TEST_CASE(hkdf_hmac_sha256_l32_tests)
                 "8da4e775a563c18f715f802a063c5a31b8a11f5c5ee1879ec3454e5f3c738d2d");
 }
 
+BOOST_AUTO_TEST_CASE(chacha20_poly1305_implementations)
+{
+    // Compare every available multi-block implementation against the standard one,
+    // on messages long enough to use them and with a block counter about to carry.
+    std::vector<unsigned char> key(32), m(3000);
+    for (auto& c : key) c = InsecureRandBits(8);
+    for (auto& c : m) c = InsecureRandBits(8);
+    std::fill(m.begin() + 1000, m.end(), 0xff); // maximal limbs in Poly1305
+    for (size_t len : {0, 1, 64, 255, 256, 511, 512, 767, 1000, 3000}) {
+        std::vector<unsigned char> expected_crypt(len), expected_keystream(len), expected_tag(POLY1305_TAGLEN);
+        BOOST_CHECK(ChaCha20SelectImplementation("standard"));
+        ChaCha20 rng(key.data(), key.size());
+        rng.SetIV(len);
+        rng.Seek(0xfffffffe);
+        rng.Crypt(m.data(), expected_crypt.data(), len);
+        rng.Keystream(expected_keystream.data(), len);
+        BOOST_CHECK(Poly1305SelectImplementation("standard"));
+        poly1305_auth(expected_tag.data(), m.data(), len, key.data());
+
+        for (const char* name : {"sse2", "avx2"}) {
+            if (!ChaCha20SelectImplementation(name)) continue;
+            std::vector<unsigned char> crypt(len), keystream(len);
+            rng.SetIV(len);
+            rng.Seek(0xfffffffe);
+            rng.Crypt(m.data(), crypt.data(), len);
+            rng.Keystream(keystream.data(), len);
+            BOOST_CHECK(crypt == expected_crypt);
+            BOOST_CHECK(keystream == expected_keystream);
+        }
+        if (Poly1305SelectImplementation("avx2")) {
+            std::vector<unsigned char> tag(POLY1305_TAGLEN);
+            poly1305_auth(tag.data(), m.data(), len, key.data());
+            BOOST_CHECK(tag == expected_tag);
+        }
+    }
+    ChaCha20AutoDetect();
+    Poly1305AutoDetect();
+}
+
 static void TestChaCha20Poly1305AEAD(bool must_succeed, unsigned int expected_aad_length, const std::string& hex_m, const std::string& hex_k1, const std::string& hex_k2, const std::string& hex_aad_keystream, const std::string& hex_encrypted_message, const std::string& hex_encrypted_message_seq_999)
 {
     // we need two sequence numbers, one for the payload cipher instance...
@@ -750,4 +791,79 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+static MuHash3072 FromInt(unsigned char i) {
+    unsigned char tmp[32] = {i, 0};
+    return MuHash3072(tmp);
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    uint256 out;
+
+    for (int iter = 0; iter < 10; ++iter) {
+        uint256 res;
+        int table[4];
+        for (int i = 0; i < 4; ++i) {
+            table[i] = g_insecure_rand_ctx.randbits(3);
+        }
+        // The result must not depend on the order of the updates.
+        for (int order = 0; order < 4; ++order) {
+            MuHash3072 acc;
+            for (int i = 0; i < 4; ++i) {
+                int t = table[i ^ order];
+                if (t & 4) {
+                    acc /= FromInt(t & 3);
+                } else {
+                    acc *= FromInt(t & 3);
+                }
+            }
+            acc.Finalize(out);
+            if (order == 0) {
+                res = out;
+            } else {
+                BOOST_CHECK(res == out);
+            }
+        }
+
+        // Removing an element again yields the original set.
+        MuHash3072 x = FromInt(g_insecure_rand_ctx.randbits(4));
+        MuHash3072 y = FromInt(g_insecure_rand_ctx.randbits(4));
+        uint256 out2;
+        x.Finalize(out);
+        x *= y;
+        x /= y;
+        x.Finalize(out2);
+        BOOST_CHECK_EQUAL(out, out2);
+    }
+
+    MuHash3072 acc = FromInt(0);
+    acc *= FromInt(1);
+    acc /= FromInt(2);
+    acc.Finalize(out);
+    BOOST_CHECK_EQUAL(out, uint256S("10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863"));
+
+    // Insert and Remove are equivalent to multiplying and dividing by singletons.
+    MuHash3072 acc2 = FromInt(0);
+    unsigned char tmp[32] = {1, 0};
+    acc2.Insert(tmp);
+    unsigned char tmp2[32] = {2, 0};
+    acc2.Remove(tmp2);
+    uint256 out3;
+    acc2.Finalize(out3);
+    BOOST_CHECK_EQUAL(out, out3);
+
+    // The state round-trips through serialization, even when not finalized.
+    MuHash3072 acc3 = FromInt(0);
+    acc3 *= FromInt(1);
+    acc3 /= FromInt(2);
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << acc3;
+    BOOST_CHECK_EQUAL(ss.size(), 2 * Num3072::BYTE_SIZE);
+    MuHash3072 acc4;
+    ss >> acc4;
+    uint256 out4;
+    acc4.Finalize(out4);
+    BOOST_CHECK_EQUAL(out, out4);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -42,6 +42,25 @@ BOOST_AUTO_TEST_CASE(test_cuckoocache_no_fakes)
     }
 };
 
+/* Test that insert reports when it has to drop an element for lack of room. */
+BOOST_AUTO_TEST_CASE(cuckoocache_insert_evictions)
+{
+    SeedInsecureRand(SeedRand::ZEROS);
+    CuckooCache::cache<uint256, SignatureCacheHasher> cc{};
+    cc.setup_bytes(1 << 20);
+    const uint256 first = InsecureRand256();
+    BOOST_CHECK(!cc.insert(first));
+    BOOST_CHECK(!cc.insert(first));
+
+    // Overfill the cache: elements can only be dropped once all eight
+    // locations of the element being moved around are taken.
+    size_t evictions = 0;
+    for (int x = 0; x < 4 * (1 << 20) / 32; ++x) {
+        evictions += cc.insert(InsecureRand256());
+    }
+    BOOST_CHECK(evictions > 0);
+}
+
 /** This helper returns the hit rate when megabytes*load worth of entries are
  * inserted into a megabytes sized cache
  */
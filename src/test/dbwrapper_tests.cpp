@@ -412,5 +412,61 @@ BOOST_AUTO_TEST_CASE(unicodepath)
     BOOST_CHECK(fs::exists(lockPath));
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_profiles)
+{
+    std::string error;
+    BOOST_CHECK(!SetDBProfiles({"utxos:bloombits=10"}, error));
+    BOOST_CHECK(!SetDBProfiles({"txindex"}, error));
+    BOOST_CHECK(!SetDBProfiles({"txindex:blocksize"}, error));
+    BOOST_CHECK(!SetDBProfiles({"txindex:bloombits=33"}, error));
+    BOOST_CHECK(!SetDBProfiles({"txindex:compression=zstd"}, error));
+    BOOST_CHECK(!SetDBProfiles({"txindex:readahead=1"}, error));
+    BOOST_CHECK_EQUAL(SetDBProfiles({"txindex:compression=snappy"}, error), DBCompressionAvailable());
+
+    // Options of a database may be spread over several arguments.
+    BOOST_REQUIRE(SetDBProfiles({"txindex:bloombits=0,blocksize=16384", "txindex:blockcache=80"}, error));
+    const DBProfile profile = GetDBProfile("txindex");
+    BOOST_CHECK(!profile.compression);
+    BOOST_CHECK_EQUAL(profile.bloom_bits, 0);
+    BOOST_CHECK_EQUAL(profile.block_size, 16384U);
+    BOOST_CHECK_EQUAL(profile.block_cache_percent, 80);
+    BOOST_CHECK_EQUAL(GetDBProfile("chainstate").bloom_bits, DBProfile().bloom_bits);
+
+    {
+        const size_t cache_size = 1 << 20;
+        CDBWrapper dbw(GetDataDir() / "dbwrapper_profile", cache_size, false, true, false, "txindex");
+        for (int i = 0; i < 1000; ++i) {
+            BOOST_CHECK(dbw.Write(i, InsecureRand256()));
+        }
+        // Move the data from the write buffer into tables.
+        dbw.CompactRange(0, 1000);
+
+        uint256 value;
+        for (int i = 0; i < 1000; ++i) {
+            BOOST_CHECK(dbw.Read(i, value));
+        }
+        BOOST_CHECK(!dbw.Exists(1000));
+
+        const DBStats stats = dbw.GetStats();
+        BOOST_CHECK_EQUAL(stats.name, "dbwrapper_profile");
+        BOOST_CHECK_EQUAL(stats.profile_name, "txindex");
+        BOOST_CHECK_EQUAL(stats.profile.block_size, 16384U);
+        BOOST_CHECK_EQUAL(stats.block_cache_size, cache_size / 100 * 80);
+        BOOST_CHECK_EQUAL(stats.write_buffer_size, (cache_size - stats.block_cache_size) / 2);
+        // Opening the database looks up the obfuscation key.
+        BOOST_CHECK_EQUAL(stats.lookups, 1002U);
+        BOOST_CHECK_EQUAL(stats.lookup_bytes, 1000U * 32);
+        BOOST_CHECK(stats.table_reads > 0);
+        BOOST_CHECK(stats.table_read_bytes >= stats.lookup_bytes);
+        BOOST_CHECK(stats.disk_size >= stats.lookup_bytes);
+
+        const std::vector<DBStats> all_stats = GetDBStats();
+        BOOST_CHECK(std::any_of(all_stats.begin(), all_stats.end(), [](const DBStats& s) { return s.name == "dbwrapper_profile"; }));
+    }
+    const std::vector<DBStats> all_stats = GetDBStats();
+    BOOST_CHECK(std::none_of(all_stats.begin(), all_stats.end(), [](const DBStats& s) { return s.name == "dbwrapper_profile"; }));
+    BOOST_CHECK(SetDBProfiles({}, error));
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -272,6 +272,62 @@ BOOST_AUTO_TEST_CASE(DoS_banning)
     peerLogic->FinalizeNode(dummyNode2.GetId(), dummy);
 }
 
+BOOST_AUTO_TEST_CASE(DoS_parallel_messages)
+{
+    auto banman = MakeUnique<BanMan>(GetDataDir() / "banlist.dat", nullptr, DEFAULT_MISBEHAVING_BANTIME);
+    auto connman = MakeUnique<CConnman>(0x1337, 0x1337);
+    auto peerLogic = MakeUnique<PeerLogicValidation>(connman.get(), banman.get(), *m_node.scheduler, *m_node.chainman, *m_node.mempool);
+    std::atomic<bool> interruptDummy(false);
+
+    banman->ClearBanned();
+    CAddress addr1(ip(0xa0b0c001), NODE_NONE);
+    CNode dummyNode1(id++, NODE_NETWORK, 0, INVALID_SOCKET, addr1, 0, 0, CAddress(), "", true);
+    dummyNode1.SetSendVersion(PROTOCOL_VERSION);
+    dummyNode1.SetRecvVersion(PROTOCOL_VERSION);
+    peerLogic->InitializeNode(&dummyNode1);
+    dummyNode1.nVersion = PROTOCOL_VERSION;
+
+    // Only messages of fully connected peers are handed to the message workers
+    BOOST_CHECK(!peerLogic->IsParallelMessage(&dummyNode1, NetMsgType::PING));
+    dummyNode1.fSuccessfullyConnected = true;
+    BOOST_CHECK(peerLogic->IsParallelMessage(&dummyNode1, NetMsgType::PING));
+    BOOST_CHECK(peerLogic->IsParallelMessage(&dummyNode1, NetMsgType::ADDR));
+    BOOST_CHECK(!peerLogic->IsParallelMessage(&dummyNode1, NetMsgType::INV));
+    BOOST_CHECK(!peerLogic->IsParallelMessage(&dummyNode1, NetMsgType::TX));
+
+    // Workers process messages in order and stop at the first one they may not
+    // handle. Misbehavior they see is acted upon by the next SendMessages().
+    {
+        LOCK(dummyNode1.cs_vProcessMsg);
+        for (int i = 0; i < 6; ++i) {
+            CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+            stream << std::vector<CAddress>(1001);
+            dummyNode1.vProcessMsg.emplace_back(std::move(stream));
+            CNetMessage& msg = dummyNode1.vProcessMsg.back();
+            msg.m_valid_netmagic = msg.m_valid_header = msg.m_valid_checksum = true;
+            msg.m_message_size = msg.m_raw_message_size = msg.m_recv.size();
+            msg.m_command = i < 5 ? NetMsgType::ADDR : NetMsgType::INV;
+        }
+    }
+    {
+        LOCK(dummyNode1.m_msg_process_mutex);
+        for (int i = 0; i < 5; ++i) {
+            BOOST_CHECK(peerLogic->ProcessParallelMessages(&dummyNode1, interruptDummy));
+        }
+        BOOST_CHECK(!peerLogic->ProcessParallelMessages(&dummyNode1, interruptDummy));
+    }
+    BOOST_CHECK_EQUAL(WITH_LOCK(dummyNode1.cs_vProcessMsg, return dummyNode1.vProcessMsg.size()), 1U);
+    BOOST_CHECK(!banman->IsDiscouraged(addr1));
+    {
+        LOCK2(cs_main, dummyNode1.cs_sendProcessing);
+        BOOST_CHECK(peerLogic->SendMessages(&dummyNode1));
+    }
+    BOOST_CHECK(banman->IsDiscouraged(addr1));
+
+    bool dummy;
+    peerLogic->FinalizeNode(dummyNode1.GetId(), dummy);
+}
+
 BOOST_AUTO_TEST_CASE(DoS_banscore)
 {
     auto banman = MakeUnique<BanMan>(GetDataDir() / "banlist.dat", nullptr, DEFAULT_MISBEHAVING_BANTIME);
@@ -123,4 +123,46 @@ BOOST_AUTO_TEST_CASE(flatfile_flush)
     BOOST_CHECK_EQUAL(fs::file_size(seq.FileName(FlatFilePos(0, 1))), 1U);
 }
 
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(flatfile_map)
+{
+    const auto data_dir = GetDataDir();
+    FlatFileSeq seq(data_dir, "a", 100);
+    FlatFileMapPool maps;
+
+    const std::vector<unsigned char> data1{1, 2, 3, 4};
+    const std::vector<unsigned char> data2{5, 6, 7};
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, 0)), SER_DISK, CLIENT_VERSION);
+        file.write((const char*)data1.data(), data1.size());
+    }
+
+    // Mapping is disabled by default.
+    BOOST_CHECK(!maps.Map(seq, FlatFilePos(0, 0), data1.size()));
+
+    maps.SetMaxMaps(1);
+    auto mapping = maps.Map(seq, FlatFilePos(0, 1), 3);
+    BOOST_REQUIRE(mapping);
+    BOOST_CHECK(mapping->Data() == MakeSpan(data1));
+    BOOST_CHECK_EQUAL(maps.Map(seq, FlatFilePos(0, 0), 4).get(), mapping.get());
+
+    // Ranges past the end of the file are not mapped.
+    BOOST_CHECK(!maps.Map(seq, FlatFilePos(0, 2), 3));
+    BOOST_CHECK(!maps.Map(seq, FlatFilePos(1, 0), 1));
+
+    // The file is mapped again once it grew.
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, data1.size())), SER_DISK, CLIENT_VERSION);
+        file.write((const char*)data2.data(), data2.size());
+    }
+    auto grown_mapping = maps.Map(seq, FlatFilePos(0, data1.size()), data2.size());
+    BOOST_REQUIRE(grown_mapping);
+    BOOST_CHECK(grown_mapping->Data().subspan(data1.size()) == MakeSpan(data2));
+
+    // Dropped mappings stay valid while referenced.
+    maps.Clear();
+    BOOST_CHECK(mapping->Data() == MakeSpan(data1));
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,7 @@
 #include <netbase.h>
 #include <serialize.h>
 #include <streams.h>
+#include <test/util/net.h>
 #include <test/util/setup_common.h>
 #include <util/memory.h>
 #include <util/string.h>
@@ -321,4 +322,120 @@ BOOST_AUTO_TEST_CASE(PoissonNextSend)
     g_mock_deterministic_tests = false;
 }
 
+BOOST_AUTO_TEST_CASE(v1_transport_direct_receive)
+{
+    const auto pool = std::make_shared<RecvBufferPool>();
+    V1TransportDeserializer deserializer(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION, pool);
+    V1TransportSerializer serializer;
+    const char* last_buffer = nullptr;
+
+    for (size_t size : {100, 1000000, 200000, 1000000}) {
+        CSerializedNetMsg msg;
+        msg.m_type = "block";
+        msg.data.resize(size);
+        for (size_t i = 0; i < size; ++i) msg.data[i] = i % 251;
+        const std::vector<unsigned char> data = msg.data;
+        std::vector<unsigned char> header;
+        serializer.prepareForTransport(msg, header);
+
+        BOOST_CHECK_EQUAL(deserializer.Read((const char*)header.data(), header.size()), (int)header.size());
+        size_t pos = 0;
+        while (!deserializer.Complete()) {
+            Span<uint8_t> buffer = deserializer.GetReceiveBuffer();
+            if (buffer.size() == 0) {
+                // small remainders go through Read()
+                BOOST_REQUIRE(data.size() - pos < 16 * 1024);
+                BOOST_CHECK_EQUAL(deserializer.Read((const char*)data.data() + pos, data.size() - pos), (int)(data.size() - pos));
+                pos = data.size();
+                continue;
+            }
+            // receive a bit less than offered, like a short read from the socket
+            const size_t n = std::min(buffer.size() - buffer.size() / 3, data.size() - pos);
+            memcpy(buffer.data(), data.data() + pos, n);
+            deserializer.CommitReceived(n);
+            pos += n;
+        }
+        BOOST_CHECK_EQUAL(pos, data.size());
+
+        CNetMessage received = deserializer.GetMessage(Params().MessageStart(), 0);
+        BOOST_CHECK(received.m_valid_checksum && received.m_valid_header);
+        BOOST_CHECK_EQUAL(received.m_command, "block");
+        BOOST_CHECK(std::vector<unsigned char>(received.m_recv.begin(), received.m_recv.end()) == data);
+        // large messages reuse the storage of the previous one once it has been processed
+        BOOST_CHECK_EQUAL(received.m_recv_pool != nullptr, size >= RecvBufferPool::MIN_BUFFER_SIZE);
+        if (size >= RecvBufferPool::MIN_BUFFER_SIZE) {
+            if (last_buffer) BOOST_CHECK(received.m_recv.data() == last_buffer);
+            last_buffer = received.m_recv.data();
+        }
+    }
+}
+
+static std::vector<unsigned char> V2Packet(V2TransportSerializer& serializer, const std::string& command, const std::vector<unsigned char>& data)
+{
+    CSerializedNetMsg msg;
+    msg.m_type = command;
+    msg.data = data;
+    std::vector<unsigned char> header;
+    serializer.prepareForTransport(msg, header);
+    BOOST_CHECK(header.empty());
+    return msg.data;
+}
+
+BOOST_AUTO_TEST_CASE(v2_transport_roundtrip)
+{
+    const std::vector<unsigned char> k1(32, 1), k2(32, 2);
+    V2TransportSerializer serializer(k1.data(), k1.size(), k2.data(), k2.size());
+    V2TransportDeserializer deserializer(SER_NETWORK, INIT_PROTO_VERSION, k1.data(), k1.size(), k2.data(), k2.size());
+
+    // Enough messages to wrap around the length keystream, in chunks of odd sizes.
+    for (size_t i = 0; i < 50; ++i) {
+        const std::string command = i % 2 ? "ping" : "block";
+        std::vector<unsigned char> data(i * i * 37);
+        for (size_t j = 0; j < data.size(); ++j) data[j] = j * 7 + i;
+        const std::vector<unsigned char> packet = V2Packet(serializer, command, data);
+        BOOST_CHECK_EQUAL(packet.size(), 3 + 1 + command.size() + data.size() + 16);
+
+        const unsigned int chunk = 1 + i * 13;
+        size_t pos = 0;
+        while (pos < packet.size()) {
+            BOOST_CHECK(!deserializer.Complete());
+            const int ret = deserializer.Read((const char*)packet.data() + pos, std::min<size_t>(chunk, packet.size() - pos));
+            BOOST_REQUIRE(ret > 0);
+            pos += ret;
+        }
+        BOOST_REQUIRE(deserializer.Complete());
+        CNetMessage msg = deserializer.GetMessage(Params().MessageStart(), 0);
+        BOOST_CHECK(msg.m_valid_header && msg.m_valid_netmagic && msg.m_valid_checksum);
+        BOOST_CHECK_EQUAL(msg.m_command, command);
+        BOOST_CHECK_EQUAL(msg.m_message_size, data.size());
+        BOOST_CHECK_EQUAL(msg.m_raw_message_size, packet.size());
+        BOOST_CHECK(std::vector<unsigned char>(msg.m_recv.begin(), msg.m_recv.end()) == data);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(v2_transport_authentication)
+{
+    const std::vector<unsigned char> k1(32, 1), k2(32, 2), k3(32, 3);
+    const std::vector<unsigned char> data(1000, 0xab);
+
+    // A modified packet fails authentication.
+    for (size_t pos : {0, 3, 500, 1003 + 5 + 15}) {
+        V2TransportSerializer serializer(k1.data(), k1.size(), k2.data(), k2.size());
+        V2TransportDeserializer deserializer(SER_NETWORK, INIT_PROTO_VERSION, k1.data(), k1.size(), k2.data(), k2.size());
+        std::vector<unsigned char> packet = V2Packet(serializer, "block", data);
+        packet[pos] ^= 1;
+        int ret = deserializer.Read((const char*)packet.data(), packet.size());
+        if (ret > 0) ret = deserializer.Read((const char*)packet.data() + ret, packet.size() - ret);
+        BOOST_CHECK(ret < 0 || !deserializer.Complete());
+    }
+
+    // A packet encrypted with another key fails authentication.
+    V2TransportSerializer serializer(k3.data(), k3.size(), k2.data(), k2.size());
+    V2TransportDeserializer deserializer(SER_NETWORK, INIT_PROTO_VERSION, k1.data(), k1.size(), k2.data(), k2.size());
+    const std::vector<unsigned char> packet = V2Packet(serializer, "block", data);
+    int ret = deserializer.Read((const char*)packet.data(), packet.size());
+    BOOST_REQUIRE_EQUAL(ret, 3);
+    BOOST_CHECK_EQUAL(deserializer.Read((const char*)packet.data() + ret, packet.size() - ret), -1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -158,6 +158,36 @@ BOOST_AUTO_TEST_CASE(sighash_test)
     #endif
 }
 
+// Goal: check that the signature hashes resumed from PrecomputedTransactionData match the uncached ones
+BOOST_AUTO_TEST_CASE(sighash_precomputed)
+{
+    for (int i = 0; i < 5000; i++) {
+        int nHashType = InsecureRand32();
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, (nHashType & 0x1f) == SIGHASH_SINGLE);
+        // The BIP143 hashes are only precomputed for transactions with witness,
+        // the legacy ones only if some input has none
+        const bool witness = InsecureRandBool();
+        const bool all_witness = witness && InsecureRandBool();
+        for (auto& txin : txTo.vin) {
+            if (all_witness || (witness && &txin == &txTo.vin[0])) txin.scriptWitness.stack.push_back({1});
+        }
+        const PrecomputedTransactionData txdata(txTo);
+        BOOST_CHECK_EQUAL(txdata.m_legacy_ready, txTo.vin.size() > 1 && !all_witness);
+        CScript scriptCode;
+        RandomScript(scriptCode);
+        const CAmount amount = InsecureRandRange(100000000);
+
+        for (unsigned int nIn = 0; nIn < txTo.vin.size(); nIn++) {
+            BOOST_CHECK(SignatureHash(scriptCode, txTo, nIn, nHashType, amount, SigVersion::BASE, &txdata) ==
+                        SignatureHash(scriptCode, txTo, nIn, nHashType, amount, SigVersion::BASE));
+            if (!witness) continue;
+            BOOST_CHECK(SignatureHash(scriptCode, txTo, nIn, nHashType, amount, SigVersion::WITNESS_V0, &txdata) ==
+                        SignatureHash(scriptCode, txTo, nIn, nHashType, amount, SigVersion::WITNESS_V0));
+        }
+    }
+}
+
 // Goal: check that SignatureHash generates correct hash
 BOOST_AUTO_TEST_CASE(sighash_from_data)
 {
@@ -203,6 +233,10 @@ BOOST_AUTO_TEST_CASE(sighash_from_data)
 
         sh = SignatureHash(scriptCode, *tx, nIn, nHashType, 0, SigVersion::BASE);
         BOOST_CHECK_MESSAGE(sh.GetHex() == sigHashHex, strTest);
+
+        const PrecomputedTransactionData txdata(*tx);
+        sh = SignatureHash(scriptCode, *tx, nIn, nHashType, 0, SigVersion::BASE, &txdata);
+        BOOST_CHECK_MESSAGE(sh.GetHex() == sigHashHex, strTest);
     }
 }
 BOOST_AUTO_TEST_SUITE_END()
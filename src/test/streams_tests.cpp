@@ -112,6 +112,30 @@ BOOST_AUTO_TEST_CASE(streams_vector_reader)
     BOOST_CHECK_THROW(new_reader >> d, std::ios_base::failure);
 }
 
+BOOST_AUTO_TEST_CASE(streams_span_reader)
+{
+    const std::vector<unsigned char> vch = {1, 255, 3, 4, 5, 6};
+
+    SpanReader reader(SER_NETWORK, INIT_PROTO_VERSION, MakeSpan(vch).subspan(1));
+    BOOST_CHECK_EQUAL(reader.size(), 5U);
+    BOOST_CHECK(!reader.empty());
+
+    // Read a single byte as a signed char.
+    signed char a;
+    reader >> a;
+    BOOST_CHECK_EQUAL(a, -1);
+    BOOST_CHECK_EQUAL(reader.size(), 4U);
+
+    // Read a 4 bytes as an unsigned int.
+    unsigned int b;
+    reader >> b;
+    BOOST_CHECK_EQUAL(b, 100992003U); // 3,4,5,6 in little-endian base-256
+    BOOST_CHECK(reader.empty());
+
+    // Reading after the end of the span throws an error.
+    BOOST_CHECK_THROW(reader >> a, std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_CASE(bitstream_reader_writer)
 {
     CDataStream data(SER_NETWORK, INIT_PROTO_VERSION);
@@ -5,7 +5,11 @@
 #include <test/util/net.h>
 
 #include <chainparams.h>
+#include <crypto/common.h>
 #include <net.h>
+#include <random.h>
+
+#include <algorithm>
 
 void ConnmanTestMsg::NodeReceiveMsgBytes(CNode& node, const char* pch, unsigned int nBytes, bool& complete) const
 {
@@ -37,3 +41,123 @@ bool ConnmanTestMsg::ReceiveMsgFrom(CNode& node, CSerializedNetMsg& ser_msg) con
     NodeReceiveMsgBytes(node, (const char*)ser_msg.data.data(), ser_msg.data.size(), complete);
     return complete;
 }
+
+int V2TransportDeserializer::readHeader(const char *pch, unsigned int nBytes)
+{
+    // copy data to temporary parsing buffer
+    unsigned int nRemaining = CHACHA20_POLY1305_AEAD_AAD_LEN - m_hdr_pos;
+    unsigned int nCopy = std::min(nRemaining, nBytes);
+
+    memcpy(&vRecv[m_hdr_pos], pch, nCopy);
+    m_hdr_pos += nCopy;
+
+    // if the encrypted length is incomplete, exit
+    if (m_hdr_pos < CHACHA20_POLY1305_AEAD_AAD_LEN)
+        return nCopy;
+
+    // decrypt the payload length; it is authenticated together with the payload
+    m_aead.GetLength(&m_message_size, m_seq_num_aad, m_aad_pos, (const uint8_t*)vRecv.data());
+
+    // reject payloads larger than the command and the largest allowed message
+    if (m_message_size > MAX_PROTOCOL_MESSAGE_LENGTH + CMessageHeader::COMMAND_SIZE + 1) {
+        return -1;
+    }
+
+    // switch state to reading the payload and tag
+    m_in_data = true;
+
+    return nCopy;
+}
+
+int V2TransportDeserializer::readData(const char *pch, unsigned int nBytes)
+{
+    const unsigned int packet_size = m_message_size + POLY1305_TAGLEN;
+    unsigned int nRemaining = packet_size - m_data_pos;
+    unsigned int nCopy = std::min(nRemaining, nBytes);
+
+    if (vRecv.size() < CHACHA20_POLY1305_AEAD_AAD_LEN + m_data_pos + nCopy) {
+        // Allocate up to 256 KiB ahead, but never more than the total packet size.
+        vRecv.resize(CHACHA20_POLY1305_AEAD_AAD_LEN + std::min(packet_size, m_data_pos + nCopy + 256 * 1024));
+    }
+
+    memcpy(&vRecv[CHACHA20_POLY1305_AEAD_AAD_LEN + m_data_pos], pch, nCopy);
+    m_data_pos += nCopy;
+
+    if (Complete()) {
+        // verify the tag and decrypt the packet in place
+        if (!m_aead.Crypt(m_seq_num, m_seq_num_aad, m_aad_pos, (unsigned char*)vRecv.data(), vRecv.size(),
+                          (const unsigned char*)vRecv.data(), vRecv.size(), false)) {
+            return -1;
+        }
+        m_seq_num++;
+        m_aad_pos += CHACHA20_POLY1305_AEAD_AAD_LEN;
+        if (m_aad_pos + CHACHA20_POLY1305_AEAD_AAD_LEN > CHACHA20_ROUND_OUTPUT) {
+            m_aad_pos = 0;
+            m_seq_num_aad++;
+        }
+    }
+
+    return nCopy;
+}
+
+CNetMessage V2TransportDeserializer::GetMessage(const CMessageHeader::MessageStartChars& message_start, int64_t time)
+{
+    assert(Complete());
+
+    // We just received a message off the wire, harvest entropy from the time (and the tag)
+    RandAddEvent(ReadLE32((const unsigned char*)&vRecv[CHACHA20_POLY1305_AEAD_AAD_LEN + m_message_size]));
+
+    // drop the tag and the length, leaving the command and the message data
+    vRecv.resize(CHACHA20_POLY1305_AEAD_AAD_LEN + m_message_size);
+    vRecv.ignore(CHACHA20_POLY1305_AEAD_AAD_LEN);
+
+    // the tag authenticates the whole packet, so there is no separate network magic or checksum
+    std::string command;
+    bool valid_header = true;
+    try {
+        vRecv >> LIMITED_STRING(command, CMessageHeader::COMMAND_SIZE);
+    } catch (const std::exception&) {
+        valid_header = false;
+    }
+    valid_header = valid_header && !command.empty() &&
+                   std::all_of(command.begin(), command.end(), [](char c) { return c >= ' ' && c <= 0x7E; });
+
+    CNetMessage msg(std::move(vRecv));
+    msg.m_valid_netmagic = true;
+    msg.m_valid_header = valid_header;
+    msg.m_valid_checksum = true;
+    msg.m_command = command;
+    msg.m_message_size = msg.m_recv.size();
+    msg.m_raw_message_size = CHACHA20_POLY1305_AEAD_AAD_LEN + m_message_size + POLY1305_TAGLEN;
+    msg.m_time = time;
+
+    // reset the network deserializer (prepare for the next message)
+    Reset();
+    return msg;
+}
+
+void V2TransportSerializer::prepareForTransport(CSerializedNetMsg& msg, std::vector<unsigned char>& header)
+{
+    // prefix the message data with the payload length and the command
+    std::vector<unsigned char> prefix(CHACHA20_POLY1305_AEAD_AAD_LEN);
+    CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, prefix, CHACHA20_POLY1305_AEAD_AAD_LEN, msg.m_type};
+    const uint32_t payload_size = prefix.size() - CHACHA20_POLY1305_AEAD_AAD_LEN + msg.data.size();
+    assert(payload_size < (1 << 24));
+    prefix[0] = payload_size;
+    prefix[1] = payload_size >> 8;
+    prefix[2] = payload_size >> 16;
+    msg.data.insert(msg.data.begin(), prefix.begin(), prefix.end());
+
+    // encrypt the packet in place and append the tag
+    const size_t plaintext_size = msg.data.size();
+    msg.data.resize(plaintext_size + POLY1305_TAGLEN);
+    bool ret = m_aead.Crypt(m_seq_num, m_seq_num_aad, m_aad_pos, msg.data.data(), msg.data.size(), msg.data.data(), plaintext_size, true);
+    assert(ret);
+    m_seq_num++;
+    m_aad_pos += CHACHA20_POLY1305_AEAD_AAD_LEN;
+    if (m_aad_pos + CHACHA20_POLY1305_AEAD_AAD_LEN > CHACHA20_ROUND_OUTPUT) {
+        m_aad_pos = 0;
+        m_seq_num_aad++;
+    }
+    header.clear();
+}
@@ -5,6 +5,8 @@
 #ifndef BITCOIN_TEST_UTIL_NET_H
 #define BITCOIN_TEST_UTIL_NET_H
 
+#include <crypto/chacha_poly_aead.h>
+#include <crypto/poly1305.h>
 #include <net.h>
 
 struct ConnmanTestMsg : public CConnman {
@@ -30,4 +32,71 @@ struct ConnmanTestMsg : public CConnman {
     bool ReceiveMsgFrom(CNode& node, CSerializedNetMsg& ser_msg) const;
 };
 
+// The V2 transport below has no key exchange yet, so it is not used by
+// connections and only lives here to be tested.
+
+/** The V2TransportDeserializer authenticates and decrypts messages encrypted
+ * with ChaCha20Poly1305AEAD. A packet consists of the 3-byte encrypted payload
+ * length, the encrypted payload (the message command as a string, followed by
+ * the message data) and a 16-byte Poly1305 tag over both.
+ */
+class V2TransportDeserializer final : public TransportDeserializer
+{
+private:
+    ChaCha20Poly1305AEAD m_aead;
+    bool m_in_data{false};          // parsing the length (false) or the payload and tag (true)
+    uint32_t m_message_size{0};     // size of the payload, excluding the tag
+    unsigned int m_hdr_pos{0};
+    unsigned int m_data_pos{0};
+    uint64_t m_seq_num{0};          // sequence number of the payload
+    uint64_t m_seq_num_aad{0};      // sequence number of the length keystream
+    int m_aad_pos{0};               // position of the length in the length keystream
+    CDataStream vRecv;              // received packet, decrypted in place once complete
+
+    int readHeader(const char *pch, unsigned int nBytes);
+    int readData(const char *pch, unsigned int nBytes);
+
+    void Reset() {
+        vRecv.clear();
+        vRecv.resize(CHACHA20_POLY1305_AEAD_AAD_LEN);
+        m_in_data = false;
+        m_message_size = 0;
+        m_hdr_pos = 0;
+        m_data_pos = 0;
+    }
+
+public:
+    V2TransportDeserializer(int nTypeIn, int nVersionIn, const unsigned char* k1, size_t k1_len, const unsigned char* k2, size_t k2_len) : m_aead(k1, k1_len, k2, k2_len), vRecv(nTypeIn, nVersionIn) {
+        Reset();
+    }
+
+    bool Complete() const override
+    {
+        return m_in_data && m_data_pos == m_message_size + POLY1305_TAGLEN;
+    }
+    void SetVersion(int nVersionIn) override
+    {
+        vRecv.SetVersion(nVersionIn);
+    }
+    // returns -1 once a packet fails authentication; the stream cannot be resynchronized after that
+    int Read(const char *pch, unsigned int nBytes) override {
+        return m_in_data ? readData(pch, nBytes) : readHeader(pch, nBytes);
+    }
+    CNetMessage GetMessage(const CMessageHeader::MessageStartChars& message_start, int64_t time) override;
+};
+
+/** Encrypts messages into the packets read by V2TransportDeserializer. The
+ * whole packet is written to msg.data and the header is left empty. */
+class V2TransportSerializer : public TransportSerializer {
+private:
+    ChaCha20Poly1305AEAD m_aead;
+    uint64_t m_seq_num{0};
+    uint64_t m_seq_num_aad{0};
+    int m_aad_pos{0};
+
+public:
+    V2TransportSerializer(const unsigned char* k1, size_t k1_len, const unsigned char* k2, size_t k2_len) : m_aead(k1, k1_len, k2, k2_len) {}
+    void prepareForTransport(CSerializedNetMsg& msg, std::vector<unsigned char>& header) override;
+};
+
 #endif // BITCOIN_TEST_UTIL_NET_H
@@ -9,6 +9,8 @@
 #include <consensus/consensus.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
+#include <crypto/chacha20.h>
+#include <crypto/poly1305.h>
 #include <crypto/sha256.h>
 #include <init.h>
 #include <miner.h>
@@ -99,6 +101,8 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName, const std::ve
     AppInitParameterInteraction();
     LogInstance().StartLogging();
     SHA256AutoDetect();
+    ChaCha20AutoDetect();
+    Poly1305AutoDetect();
     ECC_Start();
     SetupEnvironment();
     SetupNetworking();
@@ -142,7 +146,8 @@ TestingSetup::TestingSetup(const std::string& chainName, const std::vector<const
     ::ChainstateActive().InitCoinsDB(
         /* cache_size_bytes */ 1 << 23, /* in_memory */ true, /* should_wipe */ false);
     assert(!::ChainstateActive().CanFlushToDisk());
-    ::ChainstateActive().InitCoinsCache();
+    m_node.chainman->m_total_coinstip_cache = 1 << 23;
+    ::ChainstateActive().InitCoinsCache(1 << 23);
     assert(::ChainstateActive().CanFlushToDisk());
     if (!LoadGenesisBlock(chainparams)) {
         throw std::runtime_error("LoadGenesisBlock failed.");
@@ -160,6 +165,17 @@ TestingSetup::TestingSetup(const std::string& chainName, const std::vector<const
     }
     g_parallel_script_checks = true;
 
+    // Start input prefetch threads, so blocks connected in tests exercise the prefetcher.
+    constexpr int input_prefetch_threads = 2;
+    for (int i = 0; i < input_prefetch_threads; ++i) {
+        threadGroup.create_thread([i]() { return ThreadInputPrefetch(i); });
+    }
+    g_parallel_input_prefetch = true;
+
+    // Start block precheck threads, so blocks connected in tests exercise the prechecker.
+    StartBlockPrecheckThreads(2);
+    g_parallel_block_precheck = true;
+
     m_node.mempool = &::mempool;
     m_node.mempool->setSanityCheck(1.0);
     m_node.banman = MakeUnique<BanMan>(GetDataDir() / "banlist.dat", nullptr, DEFAULT_MISBEHAVING_BANTIME);
@@ -177,6 +193,7 @@ TestingSetup::~TestingSetup()
     if (m_node.scheduler) m_node.scheduler->stop();
     threadGroup.interrupt_all();
     threadGroup.join_all();
+    StopBlockPrecheckThreads();
     GetMainSignals().FlushBackgroundCallbacks();
     GetMainSignals().UnregisterBackgroundSignalScheduler();
     m_node.connman.reset();
@@ -190,7 +207,7 @@ TestingSetup::~TestingSetup()
     pblocktree.reset();
 }
 
-TestChain100Setup::TestChain100Setup()
+TestChain100Setup::TestChain100Setup(const std::vector<unsigned char>& coinbase_key_data)
 {
     // CreateAndProcessBlock() does not support building SegWit blocks, so don't activate in these tests.
     // TODO: fix the code to support SegWit blocks.
@@ -199,7 +216,11 @@ TestChain100Setup::TestChain100Setup()
     SelectParams(CBaseChainParams::REGTEST);
 
     // Generate a 100-block chain:
-    coinbaseKey.MakeNewKey(true);
+    if (coinbase_key_data.empty()) {
+        coinbaseKey.MakeNewKey(true);
+    } else {
+        coinbaseKey.Set(coinbase_key_data.begin(), coinbase_key_data.end(), true);
+    }
     CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
     for (int i = 0; i < COINBASE_MATURITY; i++)
     {
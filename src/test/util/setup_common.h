@@ -16,6 +16,7 @@
 #include <util/string.h>
 
 #include <type_traits>
+#include <vector>
 
 #include <boost/thread/thread.hpp>
 
@@ -107,7 +108,11 @@ class CScript;
 // 100-block REGTEST-mode block chain
 //
 struct TestChain100Setup : public RegTestingSetup {
-    TestChain100Setup();
+    /**
+     * Pay the coinbases to the key with the given secret, so that the chain
+     * has the same UTXO set on every run, or to a new key if it is empty.
+     */
+    explicit TestChain100Setup(const std::vector<unsigned char>& coinbase_key_data = {});
 
     // Create a new block with just given transactions, coinbase paying to
     // scriptPubKey, and try to add it to the current chain.
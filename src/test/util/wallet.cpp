@@ -36,4 +36,20 @@ void importaddress(CWallet& wallet, const std::string& address)
     if (!spk_man->AddWatchOnly(script, 0 /* nCreateTime */)) assert(false);
     wallet.SetAddressBook(dest, /* label */ "", "receive");
 }
+
+void AddSpentTransactions(CWallet& wallet, const std::string& address, int count)
+{
+    const CScript script = GetScriptForDestination(DecodeDestination(address));
+    const CWalletTx::Confirmation confirm = WITH_LOCK(wallet.cs_wallet,
+        return CWalletTx::Confirmation(CWalletTx::Status::CONFIRMED, wallet.GetLastBlockHeight(), wallet.GetLastBlockHash(), 0));
+    uint256 prev_hash;
+    for (int i = 0; i < count; ++i) {
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(prev_hash, 0);
+        mtx.vout.emplace_back(COIN, script);
+        const CTransactionRef tx = MakeTransactionRef(std::move(mtx));
+        if (!wallet.AddToWallet(tx, confirm)) assert(false);
+        prev_hash = tx->GetHash();
+    }
+}
 #endif // ENABLE_WALLET
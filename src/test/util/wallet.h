@@ -20,5 +20,14 @@ void importaddress(CWallet& wallet, const std::string& address);
 /** Returns a new address from the wallet */
 std::string getnewaddress(CWallet& w);
 
+// Wallet state //
+
+/**
+ * Add count transactions paying to the address to the wallet, confirmed in its
+ * last processed block. Each spends the one before, so only the last one has
+ * an unspent output.
+ */
+void AddSpentTransactions(CWallet& wallet, const std::string& address, int count);
+
 
 #endif // BITCOIN_TEST_UTIL_WALLET_H
@@ -4,10 +4,14 @@
 //
 #include <chainparams.h>
 #include <consensus/validation.h>
+#include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <random.h>
+#include <streams.h>
 #include <sync.h>
 #include <test/util/setup_common.h>
 #include <uint256.h>
+#include <util/time.h>
 #include <validation.h>
 #include <validationinterface.h>
 
@@ -34,7 +38,7 @@ BOOST_AUTO_TEST_CASE(chainstatemanager)
     chainstates.push_back(&c1);
     c1.InitCoinsDB(
         /* cache_size_bytes */ 1 << 23, /* in_memory */ true, /* should_wipe */ false);
-    WITH_LOCK(::cs_main, c1.InitCoinsCache());
+    WITH_LOCK(::cs_main, c1.InitCoinsCache(1 << 23));
 
     BOOST_CHECK(!manager.IsSnapshotActive());
     BOOST_CHECK(!manager.IsSnapshotValidated());
@@ -62,7 +66,7 @@ BOOST_AUTO_TEST_CASE(chainstatemanager)
     chainstates.push_back(&c2);
     c2.InitCoinsDB(
         /* cache_size_bytes */ 1 << 23, /* in_memory */ true, /* should_wipe */ false);
-    WITH_LOCK(::cs_main, c2.InitCoinsCache());
+    WITH_LOCK(::cs_main, c2.InitCoinsCache(1 << 23));
     // Unlike c1, which doesn't have any blocks. Gets us different tip, height.
     c2.LoadGenesisBlock(chainparams);
     BlockValidationState _;
@@ -104,4 +108,283 @@ BOOST_AUTO_TEST_CASE(chainstatemanager)
     WITH_LOCK(::cs_main, manager.Unload());
 }
 
+//! Write a UTXO snapshot of `chainstate` the way dumptxoutset does, letting
+//! `malleate` modify the metadata and coins before they are written.
+template <typename F>
+static fs::path WriteSnapshot(CChainState& chainstate, const std::string& name, F malleate)
+{
+    chainstate.ForceFlushStateToDisk();
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    SnapshotMetadata metadata;
+    {
+        LOCK(::cs_main);
+        std::unique_ptr<CCoinsViewCursor> cursor(chainstate.CoinsDB().Cursor());
+        for (; cursor->Valid(); cursor->Next()) {
+            COutPoint outpoint;
+            Coin coin;
+            BOOST_REQUIRE(cursor->GetKey(outpoint) && cursor->GetValue(coin));
+            coins.emplace_back(outpoint, std::move(coin));
+        }
+        const CBlockIndex* tip = chainstate.m_chain.Tip();
+        metadata = SnapshotMetadata{tip->GetBlockHash(), coins.size(), tip->nChainTx};
+    }
+    malleate(metadata, coins);
+
+    const fs::path path = GetDataDir() / name;
+    CAutoFile file{fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION};
+    file << metadata;
+    for (const auto& entry : coins) {
+        file << entry.first << entry.second;
+    }
+    return path;
+}
+
+//! Disconnect the blocks of `chainstate` above `height`, leaving them valid,
+//! so that a snapshot of the current tip is ahead of it.
+static void RewindChainstate(CChainState& chainstate, int height)
+{
+    CBlockIndex* first = WITH_LOCK(::cs_main, return chainstate.m_chain[height + 1]);
+    BlockValidationState state;
+    BOOST_REQUIRE(chainstate.InvalidateBlock(state, Params(), first));
+    WITH_LOCK(::cs_main, chainstate.ResetBlockFailureFlags(first));
+    BOOST_REQUIRE_EQUAL(chainstate.m_chain.Height(), height);
+}
+
+//! Builds the test chain on a fixed coinbase key, so that its UTXO set at
+//! height 110 matches the regtest assumeutxo data.
+struct SnapshotTestingSetup : public TestChain100Setup {
+    SnapshotTestingSetup() : TestChain100Setup(std::vector<unsigned char>(32, 1)) {}
+};
+
+static bool LoadSnapshot(ChainstateManager& manager, const fs::path& path)
+{
+    CAutoFile file{fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION};
+    SnapshotMetadata metadata;
+    file >> metadata;
+    return manager.ActivateSnapshot(file, metadata, Params(), /* in_memory */ true);
+}
+
+//! Load a snapshot of the test chain into a snapshot chainstate.
+BOOST_FIXTURE_TEST_CASE(chainstatemanager_activate_snapshot, SnapshotTestingSetup)
+{
+    ChainstateManager& manager = *m_node.chainman;
+    const CScript script_pub_key = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // Mine up to the height of the regtest assumeutxo data.
+    for (int i = 0; i < 10; ++i) {
+        CreateAndProcessBlock({}, script_pub_key);
+    }
+    CChainState& ibd_chainstate = manager.ActiveChainstate();
+    BOOST_CHECK_EQUAL(manager.ActiveHeight(), 110);
+    const AssumeutxoData* au_data = ExpectedAssumeutxo(110, Params());
+    BOOST_REQUIRE(au_data);
+    BOOST_CHECK(!ExpectedAssumeutxo(109, Params()));
+    {
+        ibd_chainstate.ForceFlushStateToDisk();
+        CCoinsView* coins_view = WITH_LOCK(::cs_main, return &ibd_chainstate.CoinsDB());
+        CCoinsStats stats;
+        BOOST_CHECK(GetUTXOStats(coins_view, stats, CoinStatsHashType::MUHASH, [] {}));
+        BOOST_CHECK_EQUAL(stats.hashSerialized, au_data->muhash);
+    }
+
+    const auto no_change = [](SnapshotMetadata&, std::vector<std::pair<COutPoint, Coin>>&) {};
+
+    // Snapshots that must be rejected.
+    std::vector<fs::path> bad_snapshots;
+    bad_snapshots.push_back(WriteSnapshot(ibd_chainstate, "unknown_base", [](SnapshotMetadata& metadata, std::vector<std::pair<COutPoint, Coin>>&) {
+        metadata.m_base_blockhash = InsecureRand256();
+    }));
+    bad_snapshots.push_back(WriteSnapshot(ibd_chainstate, "bad_value", [](SnapshotMetadata&, std::vector<std::pair<COutPoint, Coin>>& coins) {
+        coins.back().second.out.nValue += 1;
+    }));
+    bad_snapshots.push_back(WriteSnapshot(ibd_chainstate, "bad_height", [](SnapshotMetadata&, std::vector<std::pair<COutPoint, Coin>>& coins) {
+        coins.back().second.nHeight = 111;
+    }));
+    bad_snapshots.push_back(WriteSnapshot(ibd_chainstate, "unsorted", [](SnapshotMetadata&, std::vector<std::pair<COutPoint, Coin>>& coins) {
+        std::swap(coins.front(), coins.back());
+    }));
+    bad_snapshots.push_back(WriteSnapshot(ibd_chainstate, "duplicate", [](SnapshotMetadata& metadata, std::vector<std::pair<COutPoint, Coin>>& coins) {
+        coins.push_back(coins.back());
+        ++metadata.m_coins_count;
+    }));
+    bad_snapshots.push_back(WriteSnapshot(ibd_chainstate, "truncated", [](SnapshotMetadata& metadata, std::vector<std::pair<COutPoint, Coin>>&) {
+        ++metadata.m_coins_count;
+    }));
+    bad_snapshots.push_back(WriteSnapshot(ibd_chainstate, "trailing", [](SnapshotMetadata& metadata, std::vector<std::pair<COutPoint, Coin>>&) {
+        --metadata.m_coins_count;
+    }));
+    const fs::path snapshot_path = WriteSnapshot(ibd_chainstate, "good", no_change);
+
+    // A snapshot that is not ahead of the chain is of no use.
+    BOOST_CHECK(!LoadSnapshot(manager, snapshot_path));
+    RewindChainstate(ibd_chainstate, 105);
+
+    for (const fs::path& path : bad_snapshots) {
+        BOOST_CHECK(!LoadSnapshot(manager, path));
+    }
+    BOOST_CHECK(!manager.IsSnapshotActive());
+
+    BOOST_REQUIRE(LoadSnapshot(manager, snapshot_path));
+    BOOST_CHECK(manager.IsSnapshotActive());
+    BOOST_CHECK(manager.IsBackgroundIBD(&ibd_chainstate));
+    BOOST_CHECK(!LoadSnapshot(manager, snapshot_path));
+
+    CChainState& snapshot_chainstate = manager.ActiveChainstate();
+    BOOST_CHECK(&snapshot_chainstate != &ibd_chainstate);
+    BOOST_CHECK_EQUAL(manager.ActiveHeight(), 110);
+    BOOST_CHECK_EQUAL(ibd_chainstate.m_chain.Height(), 105);
+    {
+        LOCK(::cs_main);
+        BOOST_CHECK_EQUAL(snapshot_chainstate.CoinsTip().GetBestBlock(), manager.ActiveTip()->GetBlockHash());
+        BOOST_CHECK_EQUAL(manager.ActiveTip()->nChainTx, au_data->nChainTx);
+        for (const auto& tx : m_coinbase_txns) {
+            const COutPoint outpoint(tx->GetHash(), 0);
+            const Coin& coin = snapshot_chainstate.CoinsTip().AccessCoin(outpoint);
+            BOOST_CHECK(!coin.IsSpent());
+            BOOST_CHECK(coin.out == ibd_chainstate.CoinsTip().AccessCoin(outpoint).out);
+        }
+    }
+
+    // Blocks building on the snapshot are connected to it.
+    const CBlock block = CreateAndProcessBlock({}, script_pub_key);
+    BOOST_CHECK_EQUAL(manager.ActiveHeight(), 111);
+    BOOST_CHECK_EQUAL(manager.ActiveTip()->GetBlockHash(), block.GetHash());
+    BOOST_CHECK_EQUAL(ibd_chainstate.m_chain.Height(), 105);
+    BOOST_CHECK(WITH_LOCK(::cs_main, return snapshot_chainstate.CoinsTip().HaveCoin(COutPoint(block.vtx[0]->GetHash(), 0))));
+}
+
+//! Only fully loaded snapshot chainstates are picked up again after a restart,
+//! and only as long as the chain below them is still being validated.
+BOOST_FIXTURE_TEST_CASE(chainstatemanager_detect_snapshot, TestingSetup)
+{
+    const fs::path ibd_dir = GetDataDir() / "chainstate";
+    fs::create_directories(ibd_dir);
+    BOOST_CHECK(!DetectSnapshotChainstate(/* discard */ false));
+
+    const uint256 base_blockhash = InsecureRand256();
+    const fs::path loaded_dir = GetDataDir() / ("chainstate_" + base_blockhash.ToString());
+    const fs::path incomplete_dir = GetDataDir() / ("chainstate_" + InsecureRand256().ToString());
+    fs::create_directories(loaded_dir);
+    fs::create_directories(incomplete_dir);
+    {
+        CAutoFile file{fsbridge::fopen(loaded_dir / "base_blockhash", "wb"), SER_DISK, CLIENT_VERSION};
+        file << base_blockhash;
+    }
+
+    Optional<uint256> detected = DetectSnapshotChainstate(/* discard */ false);
+    BOOST_REQUIRE(detected);
+    BOOST_CHECK_EQUAL(*detected, base_blockhash);
+    BOOST_CHECK(fs::exists(loaded_dir));
+    BOOST_CHECK(!fs::exists(incomplete_dir));
+
+    BOOST_CHECK(!DetectSnapshotChainstate(/* discard */ true));
+    BOOST_CHECK(!fs::exists(loaded_dir));
+
+    // Once the background chainstate has been removed, the snapshot chainstate
+    // takes its place.
+    fs::create_directories(loaded_dir);
+    {
+        CAutoFile file{fsbridge::fopen(loaded_dir / "base_blockhash", "wb"), SER_DISK, CLIENT_VERSION};
+        file << base_blockhash;
+    }
+    fs::remove_all(ibd_dir);
+    fs::create_directories(GetDataDir() / "chainstate_todelete");
+    BOOST_CHECK(!DetectSnapshotChainstate(/* discard */ false));
+    BOOST_CHECK(!fs::exists(loaded_dir));
+    BOOST_CHECK(!fs::exists(GetDataDir() / "chainstate_todelete"));
+    BOOST_CHECK(fs::exists(ibd_dir));
+    BOOST_CHECK(!fs::exists(ibd_dir / "base_blockhash"));
+}
+
+//! Validate the chain below a snapshot in the background until the snapshot
+//! base is reached and the snapshot is found to be valid.
+BOOST_FIXTURE_TEST_CASE(chainstatemanager_background_validation, SnapshotTestingSetup)
+{
+    ChainstateManager& manager = *m_node.chainman;
+    const CChainParams& chainparams = Params();
+    const CScript script_pub_key = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    for (int i = 0; i < 10; ++i) {
+        CreateAndProcessBlock({}, script_pub_key);
+    }
+    CChainState& ibd_chainstate = manager.ActiveChainstate();
+    const fs::path snapshot_path = WriteSnapshot(ibd_chainstate, "background", [](SnapshotMetadata&, std::vector<std::pair<COutPoint, Coin>>&) {});
+
+    // Leave the IBD chainstate a few blocks behind the snapshot base.
+    CBlockIndex* base = manager.ActiveTip();
+    CBlockIndex* rewind_to = base->GetAncestor(105);
+    RewindChainstate(ibd_chainstate, 105);
+
+    // Without a snapshot, there is nothing to do in the background.
+    BOOST_CHECK(!manager.IsBackgroundValidationActive());
+    BOOST_CHECK(!manager.BackgroundValidationStep(chainparams));
+    BOOST_CHECK_EQUAL(ibd_chainstate.m_chain.Tip(), rewind_to);
+
+    BOOST_REQUIRE(LoadSnapshot(manager, snapshot_path));
+    CChainState& snapshot_chainstate = manager.ActiveChainstate();
+    BOOST_CHECK(manager.IsBackgroundValidationActive());
+    BOOST_CHECK_EQUAL(manager.ActiveTip(), base);
+
+    // The snapshot chainstate is synced, so the background chainstate gets
+    // most of the cache.
+    const size_t total_cache = manager.m_total_coinstip_cache;
+    BOOST_CHECK(!snapshot_chainstate.IsInitialBlockDownload());
+    BOOST_CHECK_EQUAL(snapshot_chainstate.m_coinstip_cache_size_bytes, total_cache * 5 / 100);
+    BOOST_CHECK_EQUAL(ibd_chainstate.m_coinstip_cache_size_bytes, total_cache - total_cache * 5 / 100);
+
+    // The remaining blocks fit into a single step, after which the snapshot
+    // base is reached and checked.
+    BOOST_CHECK(manager.BackgroundValidationStep(chainparams));
+    BOOST_CHECK_EQUAL(ibd_chainstate.m_chain.Tip(), base);
+    BOOST_CHECK_EQUAL(manager.ActiveTip(), base);
+    BOOST_CHECK(!manager.IsSnapshotValidated());
+    BOOST_CHECK(!manager.BackgroundValidationStep(chainparams));
+    BOOST_CHECK(manager.IsSnapshotValidated());
+    BOOST_CHECK(!manager.IsBackgroundValidationActive());
+    BOOST_CHECK_EQUAL(&manager.ValidatedChainstate(), &snapshot_chainstate);
+
+    // The background chainstate is gone and its cache goes to the snapshot
+    // chainstate.
+    BOOST_CHECK_EQUAL(snapshot_chainstate.m_coinstip_cache_size_bytes, total_cache);
+    auto all = manager.GetAll();
+    BOOST_CHECK_EQUAL(all.size(), 1U);
+    BOOST_CHECK_EQUAL(all.front(), &snapshot_chainstate);
+    BOOST_CHECK(!manager.BackgroundValidationStep(chainparams));
+
+    CreateAndProcessBlock({}, script_pub_key);
+    BOOST_CHECK_EQUAL(manager.ActiveHeight(), 111);
+}
+
+//! The background validation thread only runs while there is a snapshot to
+//! validate.
+BOOST_FIXTURE_TEST_CASE(chainstatemanager_background_thread, SnapshotTestingSetup)
+{
+    ChainstateManager& manager = *m_node.chainman;
+    const CChainParams& chainparams = Params();
+    const CScript script_pub_key = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    for (int i = 0; i < 10; ++i) {
+        CreateAndProcessBlock({}, script_pub_key);
+    }
+    CChainState& ibd_chainstate = manager.ActiveChainstate();
+    const fs::path snapshot_path = WriteSnapshot(ibd_chainstate, "thread", [](SnapshotMetadata&, std::vector<std::pair<COutPoint, Coin>>&) {});
+    RewindChainstate(ibd_chainstate, 105);
+
+    // Nothing to start without a snapshot.
+    manager.StartBackgroundValidation(chainparams);
+    BOOST_CHECK_EQUAL(manager.GetAll().size(), 1U);
+
+    BOOST_REQUIRE(LoadSnapshot(manager, snapshot_path));
+    manager.StartBackgroundValidation(chainparams);
+    for (int i = 0; i < 1000 && !WITH_LOCK(::cs_main, return manager.IsSnapshotValidated()); ++i) {
+        UninterruptibleSleep(std::chrono::milliseconds{10});
+    }
+    manager.StopBackgroundValidation();
+
+    LOCK(::cs_main);
+    BOOST_CHECK(manager.IsSnapshotValidated());
+    BOOST_CHECK(!manager.IsBackgroundValidationActive());
+    BOOST_CHECK_EQUAL(manager.GetAll().size(), 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,13 +3,23 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chainparams.h>
+#include <checkqueue.h>
+#include <consensus/validation.h>
+#include <core_memusage.h>
+#include <crypto/muhash.h>
+#include <key.h>
 #include <net.h>
+#include <node/blockprecheck.h>
+#include <node/coinstats.h>
+#include <script/standard.h>
+#include <undo.h>
 #include <validation.h>
 
 #include <test/util/setup_common.h>
 
 #include <boost/signals2/signal.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(validation_tests, TestingSetup)
 
@@ -58,9 +68,283 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test)
     BOOST_CHECK_EQUAL(nSum, CAmount{2099999997690000});
 }
 
+BOOST_AUTO_TEST_CASE(prefetch_block_inputs)
+{
+    CCoinsViewDB db("test_prefetch", 1 << 20, true, false);
+    std::vector<COutPoint> stored;
+    {
+        CCoinsViewCache writer(&db);
+        for (uint32_t i = 0; i < 100; ++i) {
+            const COutPoint outpoint(InsecureRand256(), i);
+            writer.AddCoin(outpoint, Coin(CTxOut(i + 1, CScript() << OP_TRUE), 1, false), false);
+            stored.push_back(outpoint);
+        }
+        writer.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(writer.Flush());
+    }
+
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.emplace_back(50 * COIN, CScript() << OP_TRUE);
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    CMutableTransaction spend;
+    for (const COutPoint& outpoint : stored) spend.vin.emplace_back(outpoint);
+    const COutPoint missing(InsecureRand256(), 0);
+    spend.vin.emplace_back(missing);
+    spend.vout.emplace_back(1, CScript() << OP_TRUE);
+    block.vtx.push_back(MakeTransactionRef(spend));
+    CMutableTransaction child;
+    child.vin.emplace_back(block.vtx[1]->GetHash(), 0);
+    block.vtx.push_back(MakeTransactionRef(child));
+
+    CCheckQueue<CInputPrefetchCheck> queue(4);
+    boost::thread_group workers;
+    for (int i = 0; i < 2; ++i) {
+        workers.create_thread([&] { queue.Thread(); });
+    }
+    for (CCheckQueue<CInputPrefetchCheck>* q : {&queue, (CCheckQueue<CInputPrefetchCheck>*)nullptr}) {
+        CCoinsViewCache cache(&db);
+        PrefetchBlockInputs(block, cache, db, q);
+        BOOST_CHECK_EQUAL(cache.GetCacheSize(), stored.size());
+        for (size_t i = 0; i < stored.size(); ++i) {
+            BOOST_CHECK(cache.HaveCoinInCache(stored[i]));
+            BOOST_CHECK_EQUAL(cache.AccessCoin(stored[i]).out.nValue, CAmount(i + 1));
+        }
+        BOOST_CHECK(!cache.HaveCoinInCache(missing));
+        BOOST_CHECK(!cache.HaveCoinInCache(child.vin[0].prevout));
+    }
+    workers.interrupt_all();
+    workers.join_all();
+}
+
+BOOST_FIXTURE_TEST_CASE(rolling_utxo_hash, TestChain100Setup)
+{
+    CChainState& chainstate = ::ChainstateActive();
+    const auto scanned_hash = [&] {
+        chainstate.ForceFlushStateToDisk();
+        CCoinsView* coins_view = WITH_LOCK(cs_main, return &chainstate.CoinsDB());
+        CCoinsStats stats;
+        BOOST_CHECK(GetUTXOStats(coins_view, stats, CoinStatsHashType::MUHASH, [] {}));
+        return stats.hashSerialized;
+    };
+    const auto rolling_hash = [&] {
+        LOCK(cs_main);
+        uint256 out;
+        MuHash3072 utxo_hash = *chainstate.m_utxo_hash;
+        utxo_hash.Finalize(out);
+        return out;
+    };
+
+    // Not maintained by default; when enabled it starts out from a scan.
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(!chainstate.m_utxo_hash);
+        BOOST_CHECK(chainstate.LoadUTXOHash());
+    }
+    const uint256 initial_hash = rolling_hash();
+    BOOST_CHECK_EQUAL(initial_hash, scanned_hash());
+
+    // A block spending a coinbase, with an unspendable output and an output
+    // which is spent again in the same block.
+    const CScript p2pk = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const auto sign = [&](CMutableTransaction& tx) {
+        std::vector<unsigned char> sig;
+        const uint256 sighash = SignatureHash(p2pk, tx, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(coinbaseKey.Sign(sighash, sig));
+        sig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig = CScript() << sig;
+    };
+    CMutableTransaction parent;
+    parent.vin.emplace_back(m_coinbase_txns[0]->GetHash(), 0);
+    parent.vout.emplace_back(20 * COIN, p2pk);
+    parent.vout.emplace_back(20 * COIN, p2pk);
+    parent.vout.emplace_back(0, CScript() << OP_RETURN);
+    sign(parent);
+    CMutableTransaction child;
+    child.vin.emplace_back(parent.GetHash(), 1);
+    child.vout.emplace_back(10 * COIN, p2pk);
+    sign(child);
+    const CBlock block = CreateAndProcessBlock({parent, child}, p2pk);
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return ::ChainActive().Tip()->GetBlockHash()), block.GetHash());
+    BOOST_CHECK(rolling_hash() != initial_hash);
+    BOOST_CHECK_EQUAL(rolling_hash(), scanned_hash());
+
+    // The stored hash is reloaded instead of recomputed.
+    const uint256 connected_hash = rolling_hash();
+    {
+        LOCK(cs_main);
+        chainstate.m_utxo_hash = nullopt;
+        MuHash3072 stored;
+        BOOST_CHECK(chainstate.CoinsDB().GetUTXOHash(stored));
+        BOOST_CHECK(chainstate.LoadUTXOHash());
+    }
+    BOOST_CHECK_EQUAL(rolling_hash(), connected_hash);
+
+    // Disconnecting the block restores the previous hash.
+    BlockValidationState state;
+    CBlockIndex* pindex = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    BOOST_CHECK(chainstate.InvalidateBlock(state, Params(), pindex));
+    BOOST_CHECK_EQUAL(rolling_hash(), initial_hash);
+    BOOST_CHECK_EQUAL(rolling_hash(), scanned_hash());
+
+    WITH_LOCK(cs_main, chainstate.ResetBlockFailureFlags(pindex));
+    BOOST_CHECK(chainstate.ActivateBestChain(state, Params(), nullptr));
+    BOOST_CHECK_EQUAL(rolling_hash(), connected_hash);
+
+    // An unclean disconnect that overwrites an unspent coin replaces it in the
+    // hash with the restored one.
+    {
+        LOCK(cs_main);
+        CBlock connected_block;
+        BOOST_CHECK(ReadBlockFromDisk(connected_block, pindex, Params().GetConsensus()));
+        CCoinsViewCache view(&chainstate.CoinsTip());
+        MuHash3072 utxo_hash = *chainstate.m_utxo_hash;
+        const COutPoint outpoint(m_coinbase_txns[0]->GetHash(), 0);
+        const Coin coin(CTxOut(COIN, p2pk), 1, false);
+        view.AddCoin(outpoint, Coin(coin), false);
+        ApplyCoinHash(utxo_hash, outpoint, coin);
+        BOOST_CHECK(chainstate.DisconnectBlock(connected_block, pindex, view, &utxo_hash) == DISCONNECT_UNCLEAN);
+        uint256 out;
+        utxo_hash.Finalize(out);
+        BOOST_CHECK_EQUAL(out, initial_hash);
+    }
+
+    // A flush that does not carry the hash keeps the stored one, which is
+    // only returned while it describes the best block.
+    {
+        LOCK(cs_main);
+        chainstate.ForceFlushStateToDisk();
+        chainstate.m_utxo_hash = nullopt;
+        BOOST_CHECK(chainstate.CoinsTip().Flush());
+        MuHash3072 stored;
+        BOOST_CHECK(chainstate.CoinsDB().GetUTXOHash(stored));
+        uint256 out;
+        stored.Finalize(out);
+        BOOST_CHECK_EQUAL(out, connected_hash);
+    }
+    CreateAndProcessBlock({}, p2pk);
+    {
+        LOCK(cs_main);
+        chainstate.ForceFlushStateToDisk();
+        MuHash3072 stored;
+        BOOST_CHECK(!chainstate.CoinsDB().GetUTXOHash(stored));
+    }
+}
+
 static bool ReturnFalse() { return false; }
 static bool ReturnTrue() { return true; }
 
+BOOST_FIXTURE_TEST_CASE(read_blocks_from_mapped_files, TestChain100Setup)
+{
+    // Blocks and undo data read through memory mapped files match the ones read with stdio.
+    SetBlockFileMapLimit(1);
+    for (const CBlockIndex* pindex = ::ChainActive().Tip(); pindex->pprev; pindex = pindex->pprev) {
+        CBlock block;
+        CBlockUndo blockundo;
+        std::vector<uint8_t> raw_block;
+        BOOST_CHECK(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+        BOOST_CHECK(UndoReadFromDisk(blockundo, pindex));
+        BOOST_CHECK(ReadRawBlockFromDisk(raw_block, pindex, Params().MessageStart()));
+
+        SetBlockFileMapLimit(0);
+        CBlock file_block;
+        CBlockUndo file_blockundo;
+        std::vector<uint8_t> file_raw_block;
+        BOOST_CHECK(ReadBlockFromDisk(file_block, pindex, Params().GetConsensus()));
+        BOOST_CHECK(UndoReadFromDisk(file_blockundo, pindex));
+        BOOST_CHECK(ReadRawBlockFromDisk(file_raw_block, pindex, Params().MessageStart()));
+        SetBlockFileMapLimit(1);
+
+        BOOST_CHECK_EQUAL(block.ToString(), file_block.ToString());
+        BOOST_CHECK(SerializeHash(blockundo) == SerializeHash(file_blockundo));
+        BOOST_CHECK(raw_block == file_raw_block);
+    }
+    SetBlockFileMapLimit(0);
+}
+
+BOOST_FIXTURE_TEST_CASE(block_precheck, TestChain100Setup)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+
+    // Blocks from the tip down.
+    std::vector<const CBlockIndex*> blocks;
+    {
+        LOCK(cs_main);
+        for (const CBlockIndex* pindex = ::ChainActive().Tip(); pindex->pprev; pindex = pindex->pprev) {
+            blocks.push_back(pindex);
+        }
+    }
+    const auto read_block = [&](const CBlockIndex* pindex) {
+        std::shared_ptr<CBlock> block = std::make_shared<CBlock>();
+        BOOST_CHECK(ReadBlockFromDisk(*block, pindex, params));
+        BlockValidationState state;
+        BOOST_CHECK(CheckBlock(*block, state, params));
+        return std::shared_ptr<const CBlock>(std::move(block));
+    };
+
+    // Leave room for the 16 blocks closest to the tip.
+    constexpr size_t kept_blocks = 16;
+    std::vector<size_t> usage;
+    size_t max_usage = 0;
+    for (auto it = blocks.rbegin(); usage.size() < kept_blocks; ++it) {
+        usage.push_back(RecursiveDynamicUsage(read_block(*it)));
+        max_usage += usage.back();
+    }
+    BlockPrechecker prechecker(max_usage);
+
+    // Scheduled blocks are only read once a worker picks them up. The last one
+    // cannot be read from the given position.
+    for (auto it = blocks.rbegin(); std::next(it) != blocks.rend(); ++it) {
+        prechecker.Schedule((*it)->GetBlockHash(), (*it)->nHeight, (*it)->GetBlockPos());
+    }
+    prechecker.Schedule(blocks[0]->GetBlockHash(), blocks[0]->nHeight, blocks[1]->GetBlockPos());
+    BOOST_CHECK_EQUAL(prechecker.Size(), blocks.size());
+    BOOST_CHECK_EQUAL(prechecker.DynamicMemoryUsage(), 0U);
+
+    // Workers drain the queue before they stop.
+    prechecker.StartWorkers(2, params);
+    prechecker.StopWorkers();
+
+    // Whatever order the workers finished in, the blocks closest to the tip are kept.
+    BOOST_CHECK_EQUAL(prechecker.Size(), blocks.size());
+    BOOST_CHECK_EQUAL(prechecker.DynamicMemoryUsage(), max_usage);
+
+    // Lowering the limit drops the block furthest from the tip.
+    prechecker.SetMaxUsage(max_usage - usage.back());
+    BOOST_CHECK_EQUAL(prechecker.DynamicMemoryUsage(), max_usage - usage.back());
+
+    for (size_t i = 0; i < kept_blocks - 1; ++i) {
+        const CBlockIndex* pindex = blocks[blocks.size() - 1 - i];
+        std::shared_ptr<const CBlock> block = prechecker.Take(pindex->GetBlockHash());
+        BOOST_REQUIRE(block);
+        BOOST_CHECK(block->fChecked);
+        BOOST_CHECK(block->GetHash() == pindex->GetBlockHash());
+    }
+    BOOST_CHECK(!prechecker.Take(blocks[blocks.size() - kept_blocks]->GetBlockHash()));
+    BOOST_CHECK(!prechecker.Take(blocks[0]->GetBlockHash()));
+    // Blocks at or below the height of a taken block are forgotten.
+    BOOST_CHECK_EQUAL(prechecker.Size(), 0U);
+    BOOST_CHECK_EQUAL(prechecker.DynamicMemoryUsage(), 0U);
+
+    // Blocks checked elsewhere are held on to as they are.
+    std::shared_ptr<const CBlock> tip_block = read_block(blocks[0]);
+    prechecker.Add(tip_block, blocks[0]->nHeight);
+    BOOST_CHECK(prechecker.Take(blocks[0]->GetBlockHash()) == tip_block);
+
+    // A block closer to the tip makes room by dropping the one further from it,
+    // but not the other way around.
+    std::shared_ptr<const CBlock> prev_block = read_block(blocks[1]);
+    prechecker.SetMaxUsage(std::max(RecursiveDynamicUsage(tip_block), RecursiveDynamicUsage(prev_block)));
+    prechecker.Add(tip_block, blocks[0]->nHeight);
+    prechecker.Add(prev_block, blocks[1]->nHeight);
+    BOOST_CHECK_EQUAL(prechecker.Size(), 1U);
+    prechecker.Add(tip_block, blocks[0]->nHeight);
+    BOOST_CHECK_EQUAL(prechecker.Size(), 1U);
+    BOOST_CHECK(prechecker.Take(blocks[1]->GetBlockHash()) == prev_block);
+    BOOST_CHECK(!prechecker.Take(blocks[0]->GetBlockHash()));
+}
+
 BOOST_AUTO_TEST_CASE(test_combiner_all)
 {
     boost::signals2::signal<bool (), CombinerAll> Test;
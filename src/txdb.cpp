@@ -26,6 +26,7 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_UTXO_HASH = 'U';
 
 namespace {
 
@@ -39,7 +40,7 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe) : db(ldb_path, nCacheSize, fMemory, fWipe, true)
+CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe) : db(ldb_path, nCacheSize, fMemory, fWipe, true, "chainstate")
 {
 }
 
@@ -120,6 +121,10 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     // In the last batch, mark the database as consistent with hashBlock again.
     batch.Erase(DB_HEAD_BLOCKS);
     batch.Write(DB_BEST_BLOCK, hashBlock);
+    if (m_pending_utxo_hash) {
+        batch.Write(DB_UTXO_HASH, std::make_pair(hashBlock, *m_pending_utxo_hash));
+        m_pending_utxo_hash = nullopt;
+    }
 
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
@@ -127,12 +132,37 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return ret;
 }
 
+bool CCoinsViewDB::WriteCoins(const std::vector<std::pair<COutPoint, Coin>>& coins) {
+    CDBBatch batch(db);
+    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    for (const auto& entry : coins) {
+        batch.Write(CoinEntry(&entry.first), entry.second);
+        if (batch.SizeEstimate() > batch_size) {
+            LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
+            if (!db.WriteBatch(batch)) return false;
+            batch.Clear();
+        }
+    }
+    LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
+    return db.WriteBatch(batch);
+}
+
+bool CCoinsViewDB::GetUTXOHash(MuHash3072& hash) const {
+    std::pair<uint256, MuHash3072> stored;
+    if (!db.Read(DB_UTXO_HASH, stored)) return false;
+    // The hash is only rewritten by flushes that carry one, so it may
+    // describe an older best block.
+    if (stored.first != GetBestBlock()) return false;
+    hash = stored.second;
+    return true;
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, "blockindex") {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
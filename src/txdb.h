@@ -7,8 +7,10 @@
 #define BITCOIN_TXDB_H
 
 #include <coins.h>
+#include <crypto/muhash.h>
 #include <dbwrapper.h>
 #include <chain.h>
+#include <optional.h>
 #include <primitives/block.h>
 
 #include <memory>
@@ -36,6 +38,8 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxTxIndexCache = 1024;
 //! Max memory allocated to all block filter index caches combined in MiB.
 static const int64_t max_filter_index_cache = 1024;
+//! Max memory allocated to blocks checked ahead of the tip, if -blockprecheck (MiB)
+static const int64_t nMaxBlockPrecheckCache = 64;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
 
@@ -44,6 +48,8 @@ class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+    //! Rolling UTXO set hash to be written with the next BatchWrite
+    Optional<MuHash3072> m_pending_utxo_hash;
 public:
     /**
      * @param[in] ldb_path    Location in the filesystem where leveldb data will be stored.
@@ -59,6 +65,24 @@ public:
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
+
+    /**
+     * Stage the rolling hash of the coins about to be flushed, to be written
+     * atomically with the next BatchWrite, along with the best block it
+     * describes. A BatchWrite without a staged hash leaves the stored one
+     * alone; it is no longer returned once the best block moves on.
+     */
+    void SetUTXOHash(const MuHash3072& hash) { m_pending_utxo_hash = hash; }
+    /**
+     * Write coins straight to the database, bypassing any cache and leaving
+     * the best block untouched. Meant for bulk loading an empty database
+     * (e.g. from a UTXO snapshot): existing entries are not checked, and
+     * LevelDB handles the writes best when they arrive in key order.
+     */
+    bool WriteCoins(const std::vector<std::pair<COutPoint, Coin>>& coins);
+
+    //! Read the rolling UTXO set hash, if one is stored for the current best block.
+    bool GetUTXOHash(MuHash3072& hash) const;
     size_t EstimateSize() const override;
 };
 
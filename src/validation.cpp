@@ -20,6 +20,9 @@
 #include <index/txindex.h>
 #include <logging.h>
 #include <logging/timer.h>
+#include <node/blockprecheck.h>
+#include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <node/ui_interface.h>
 #include <optional.h>
 #include <policy/fees.h>
@@ -33,6 +36,7 @@
 #include <script/script.h>
 #include <script/sigcache.h>
 #include <shutdown.h>
+#include <streams.h>
 #include <timedata.h>
 #include <tinyformat.h>
 #include <txdb.h>
@@ -132,6 +136,8 @@ Mutex g_best_block_mutex;
 std::condition_variable g_best_block_cv;
 uint256 g_best_block;
 bool g_parallel_script_checks{false};
+bool g_parallel_input_prefetch{false};
+bool g_parallel_block_precheck{false};
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fHavePruned = false;
@@ -1153,18 +1159,49 @@ static bool WriteBlockToDisk(const CBlock& block, FlatFilePos& pos, const CMessa
     return true;
 }
 
+/** Memory mappings of recently read blk and rev files, used when -blockfilemaps is set. */
+static FlatFileMapPool g_block_file_maps;
+static FlatFileMapPool g_undo_file_maps;
+
+void SetBlockFileMapLimit(size_t max_files)
+{
+    g_block_file_maps.SetMaxMaps(max_files);
+    g_undo_file_maps.SetMaxMaps(max_files);
+}
+
+/**
+ * Get a mapping covering the record at pos of a blk or rev file, using the size
+ * written before it. trailer_size bytes following the record are included.
+ */
+static std::shared_ptr<const MappedFlatFile> MapFileRecord(FlatFileMapPool& maps, const FlatFileSeq& seq, const FlatFilePos& pos, size_t trailer_size)
+{
+    if (pos.nPos < sizeof(uint32_t)) return nullptr;
+    const FlatFilePos size_pos(pos.nFile, pos.nPos - sizeof(uint32_t));
+    std::shared_ptr<const MappedFlatFile> mapping = maps.Map(seq, size_pos, sizeof(uint32_t));
+    if (!mapping) return nullptr;
+    const size_t record_size = ReadLE32(mapping->Data().data() + size_pos.nPos) + trailer_size;
+    if (mapping->Data().size() - pos.nPos < record_size) {
+        mapping = maps.Map(seq, pos, record_size);
+    }
+    return mapping;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
-
     // Read block
     try {
-        filein >> block;
+        if (const auto mapping = MapFileRecord(g_block_file_maps, BlockFileSeq(), pos, 0)) {
+            SpanReader filein(SER_DISK, CLIENT_VERSION, mapping->Data().subspan(pos.nPos));
+            filein >> block;
+        } else {
+            // Open history file to read
+            CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull())
+                return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+            filein >> block;
+        }
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
@@ -1193,15 +1230,9 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
-bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start)
+template <typename Stream>
+static bool ReadRawBlockFromStream(std::vector<uint8_t>& block, Stream& filein, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start)
 {
-    FlatFilePos hpos = pos;
-    hpos.nPos -= 8; // Seek back 8 bytes for meta header
-    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
-    }
-
     try {
         CMessageHeader::MessageStartChars blk_start;
         unsigned int blk_size;
@@ -1228,6 +1259,24 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, c
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start)
+{
+    FlatFilePos hpos = pos;
+    hpos.nPos -= 8; // Seek back 8 bytes for meta header
+    if (pos.nPos >= 8) {
+        if (const auto mapping = MapFileRecord(g_block_file_maps, BlockFileSeq(), pos, 0)) {
+            SpanReader filein(SER_DISK, CLIENT_VERSION, mapping->Data().subspan(hpos.nPos));
+            return ReadRawBlockFromStream(block, filein, pos, message_start);
+        }
+    }
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+    }
+
+    return ReadRawBlockFromStream(block, filein, pos, message_start);
+}
+
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
 {
     FlatFilePos block_pos;
@@ -1281,14 +1330,52 @@ void CChainState::InitCoinsDB(
 
     m_coins_views = MakeUnique<CoinsViews>(
         leveldb_name, cache_size_bytes, in_memory, should_wipe);
+    m_coinsdb_cache_size_bytes = cache_size_bytes;
 }
 
-void CChainState::InitCoinsCache()
+void CChainState::InitCoinsCache(size_t cache_size_bytes)
 {
     assert(m_coins_views != nullptr);
+    m_coinstip_cache_size_bytes = cache_size_bytes;
     m_coins_views->InitCache();
 }
 
+bool CChainState::LoadUTXOHash()
+{
+    AssertLockHeld(cs_main);
+    MuHash3072 utxo_hash;
+    if (CoinsDB().GetUTXOHash(utxo_hash)) {
+        m_utxo_hash = utxo_hash;
+        return true;
+    }
+
+    if (CoinsTip().GetBestBlock().IsNull()) {
+        // Nothing connected yet, start from the empty set.
+        m_utxo_hash = utxo_hash;
+        return true;
+    }
+
+    // The stored hash is missing or stale, recompute it from the coins on
+    // disk. Write out the cache first so the database holds the full set.
+    LogPrintf("Computing rolling UTXO set hash, this may take a while...\n");
+    if (!CoinsTip().Flush()) return false;
+    std::unique_ptr<CCoinsViewCursor> pcursor(CoinsDB().Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        if (ShutdownRequested()) return false;
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+            return error("%s: unable to read value", __func__);
+        }
+        ApplyCoinHash(utxo_hash, key, coin);
+    }
+    m_utxo_hash = utxo_hash;
+
+    // Persist it right away, so this is not repeated on the next start.
+    CoinsDB().SetUTXOHash(utxo_hash);
+    return CoinsTip().Flush();
+}
+
 // Note that though this is marked const, we may end up modifying `m_cached_finished_ibd`, which
 // is a performance-related implementation detail. This function must be marked
 // `const` so that `CValidationInterface` clients (which are given a `const CChainState*`)
@@ -1622,21 +1709,12 @@ static bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const
     return true;
 }
 
-bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
+template <typename Stream>
+static bool UndoReadFromStream(Stream& filein, CBlockUndo& blockundo, const CBlockIndex* pindex)
 {
-    FlatFilePos pos = pindex->GetUndoPos();
-    if (pos.IsNull()) {
-        return error("%s: no undo data available", __func__);
-    }
-
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s: OpenUndoFile failed", __func__);
-
     // Read block
     uint256 hashChecksum;
-    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
+    CHashVerifier<Stream> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
     try {
         verifier << pindex->pprev->GetBlockHash();
         verifier >> blockundo;
@@ -1653,6 +1731,26 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
     return true;
 }
 
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    FlatFilePos pos = pindex->GetUndoPos();
+    if (pos.IsNull()) {
+        return error("%s: no undo data available", __func__);
+    }
+
+    if (const auto mapping = MapFileRecord(g_undo_file_maps, UndoFileSeq(), pos, sizeof(uint256))) {
+        SpanReader filein(SER_DISK, CLIENT_VERSION, mapping->Data().subspan(pos.nPos));
+        return UndoReadFromStream(filein, blockundo, pindex);
+    }
+
+    // Open history file to read
+    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenUndoFile failed", __func__);
+
+    return UndoReadFromStream(filein, blockundo, pindex);
+}
+
 /** Abort with a message */
 static bool AbortNode(const std::string& strMessage, bilingual_str user_message = bilingual_str())
 {
@@ -1709,7 +1807,7 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  When FAILED is returned, view is left in an indeterminate state. */
-DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view)
+DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, MuHash3072* utxo_hash)
 {
     bool fClean = true;
 
@@ -1740,6 +1838,7 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
                 if (!is_spent || tx.vout[o] != coin.out || pindex->nHeight != coin.nHeight || is_coinbase != coin.fCoinBase) {
                     fClean = false; // transaction output mismatch
                 }
+                if (is_spent && utxo_hash) RemoveCoinHash(*utxo_hash, out, coin);
             }
         }
 
@@ -1752,9 +1851,15 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
             }
             for (unsigned int j = tx.vin.size(); j-- > 0;) {
                 const COutPoint &out = tx.vin[j].prevout;
+                if (utxo_hash) {
+                    // An unclean undo overwrites an unspent coin, which leaves the hash with it.
+                    const Coin& overwritten = view.AccessCoin(out);
+                    if (!overwritten.IsSpent()) RemoveCoinHash(*utxo_hash, out, overwritten);
+                }
                 int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
+                if (utxo_hash) ApplyCoinHash(*utxo_hash, out, view.AccessCoin(out));
             }
             // At this point, all of txundo.vprevout should have been moved out.
         }
@@ -1772,6 +1877,8 @@ static void FlushUndoFile(int block_file, bool finalize = false)
     if (!UndoFileSeq().Flush(undo_pos_old, finalize)) {
         AbortNode("Flushing undo file to disk failed. This is likely the result of an I/O error.");
     }
+    // A mapping must not extend past the end of a truncated file
+    if (finalize) g_undo_file_maps.Invalidate(undo_pos_old);
 }
 
 static void FlushBlockFile(bool fFinalize = false, bool finalize_undo = false)
@@ -1781,6 +1888,7 @@ static void FlushBlockFile(bool fFinalize = false, bool finalize_undo = false)
     if (!BlockFileSeq().Flush(block_pos_old, fFinalize)) {
         AbortNode("Flushing block file to disk failed. This is likely the result of an I/O error.");
     }
+    if (fFinalize) g_block_file_maps.Invalidate(block_pos_old);
     // we do not always flush the undo file, as the chain tip may be lagging behind the incoming blocks,
     // e.g. during IBD or a sync after a node going offline
     if (!fFinalize || finalize_undo) FlushUndoFile(nLastBlockFile, finalize_undo);
@@ -1822,6 +1930,81 @@ void ThreadScriptCheck(int worker_num) {
     scriptcheckqueue.Thread();
 }
 
+void EnableScriptCheckWorkStealing(int worker_threads) {
+    scriptcheckqueue.EnableWorkStealing(worker_threads);
+}
+
+static CCheckQueue<CInputPrefetchCheck> inputprefetchqueue(16);
+
+void ThreadInputPrefetch(int worker_num) {
+    util::ThreadRename(strprintf("prefetch.%i", worker_num));
+    inputprefetchqueue.Thread();
+}
+
+static BlockPrechecker blockprechecker(nMaxBlockPrecheckCache << 20);
+
+void StartBlockPrecheckThreads(int threads)
+{
+    blockprechecker.StartWorkers(threads, Params().GetConsensus());
+}
+
+void StopBlockPrecheckThreads()
+{
+    blockprechecker.StopWorkers();
+}
+
+void SetBlockPrecheckCacheSize(size_t max_usage)
+{
+    blockprechecker.SetMaxUsage(max_usage);
+}
+
+bool CInputPrefetchCheck::operator()() {
+    if (!m_base->GetCoin(*m_outpoint, *m_coin)) {
+        m_coin->Clear();
+    }
+    return true;
+}
+
+void PrefetchBlockInputs(const CBlock& block, CCoinsViewCache& cache, const CCoinsView& base, CCheckQueue<CInputPrefetchCheck>* queue)
+{
+    std::set<uint256> block_txids;
+    for (const auto& tx : block.vtx) {
+        block_txids.insert(tx->GetHash());
+    }
+
+    std::vector<COutPoint> outpoints;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase()) continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (block_txids.count(txin.prevout.hash) || cache.HaveCoinInCache(txin.prevout)) continue;
+            outpoints.push_back(txin.prevout);
+        }
+    }
+    if (outpoints.empty()) return;
+
+    // Both vectors are sized up front: the checks hold pointers into them
+    // until the control has waited for the workers.
+    std::vector<Coin> coins(outpoints.size());
+    {
+        CCheckQueueControl<CInputPrefetchCheck> control(queue);
+        std::vector<CInputPrefetchCheck> vChecks;
+        vChecks.reserve(outpoints.size());
+        for (size_t i = 0; i < outpoints.size(); ++i) {
+            vChecks.emplace_back(base, outpoints[i], coins[i]);
+        }
+        if (queue) {
+            control.Add(vChecks);
+        } else {
+            for (CInputPrefetchCheck& check : vChecks) check();
+        }
+        control.Wait();
+    }
+
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        cache.WarmCoin(outpoints[i], std::move(coins[i]));
+    }
+}
+
 VersionBitsCache versionbitscache GUARDED_BY(cs_main);
 
 int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
@@ -1936,7 +2119,7 @@ static int64_t nBlocksTotal = 0;
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
 bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state, CBlockIndex* pindex,
-                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck)
+                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck, MuHash3072* utxo_hash)
 {
     AssertLockHeld(cs_main);
     assert(pindex);
@@ -2196,7 +2379,28 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
         }
+        if (utxo_hash && tx.IsCoinBase()) {
+            // Coinbases may overwrite an unspent duplicate (see BIP30), which
+            // then leaves the UTXO set.
+            for (size_t o = 0; o < tx.vout.size(); o++) {
+                const COutPoint out(tx.GetHash(), o);
+                const Coin& coin = view.AccessCoin(out);
+                if (!coin.IsSpent()) RemoveCoinHash(*utxo_hash, out, coin);
+            }
+        }
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
+        if (utxo_hash) {
+            if (i > 0) {
+                const CTxUndo& txundo = blockundo.vtxundo.back();
+                for (size_t j = 0; j < tx.vin.size(); j++) {
+                    RemoveCoinHash(*utxo_hash, tx.vin[j].prevout, txundo.vprevout[j]);
+                }
+            }
+            for (size_t o = 0; o < tx.vout.size(); o++) {
+                if (tx.vout[o].scriptPubKey.IsUnspendable()) continue;
+                ApplyCoinHash(*utxo_hash, COutPoint(tx.GetHash(), o), Coin(tx.vout[o], pindex->nHeight, tx.IsCoinBase()));
+            }
+        }
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
@@ -2240,10 +2444,12 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
 
 CoinsCacheSizeState CChainState::GetCoinsCacheSizeState(const CTxMemPool& tx_pool)
 {
+    // The mempool belongs to the active chainstate; a background chainstate
+    // has to make do with its own share of the cache.
     return this->GetCoinsCacheSizeState(
         tx_pool,
-        nCoinCacheUsage,
-        gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
+        m_coinstip_cache_size_bytes,
+        g_chainman.IsBackgroundIBD(this) ? 0 : gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
 }
 
 CoinsCacheSizeState CChainState::GetCoinsCacheSizeState(
@@ -2383,14 +2589,16 @@ bool CChainState::FlushStateToDisk(
             if (!CheckDiskSpace(GetDataDir(), 48 * 2 * 2 * CoinsTip().GetCacheSize())) {
                 return AbortNode(state, "Disk space is too low!", _("Disk space is too low!"));
             }
-            // Flush the chainstate (which may refer to block index entries).
+            // Flush the chainstate (which may refer to block index entries),
+            // along with the rolling hash of the coins being written.
+            if (m_utxo_hash) CoinsDB().SetUTXOHash(*m_utxo_hash);
             if (!CoinsTip().Flush())
                 return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
             full_flush_completed = true;
         }
     }
-    if (full_flush_completed) {
+    if (full_flush_completed && !g_chainman.IsBackgroundIBD(this)) {
         // Update best block in wallet (so we can detect restored wallets).
         GetMainSignals().ChainStateFlushed(m_chain.GetLocator());
     }
@@ -2408,6 +2616,29 @@ void CChainState::ForceFlushStateToDisk() {
     }
 }
 
+bool CChainState::ResizeCoinsCache(size_t coinstip_size)
+{
+    AssertLockHeld(cs_main);
+    if (coinstip_size == m_coinstip_cache_size_bytes) return true;
+
+    const size_t old_coinstip_size = m_coinstip_cache_size_bytes;
+    m_coinstip_cache_size_bytes = coinstip_size;
+    LogPrintf("[%s] resized coinstip cache to %.1f MiB\n",
+        this->ToString(), coinstip_size * (1.0 / 1024 / 1024));
+
+    BlockValidationState state;
+    const CChainParams& chainparams = Params();
+    if (coinstip_size > old_coinstip_size) {
+        // Nothing to release, just flush if the cache is still too large.
+        return FlushStateToDisk(chainparams, state, FlushStateMode::IF_NEEDED);
+    }
+    // Write the coins out and give back the memory of the coins map, which
+    // clearing it does not.
+    bool ret = FlushStateToDisk(chainparams, state, FlushStateMode::ALWAYS);
+    if (CoinsTip().GetCacheSize() == 0) CoinsTip().ReallocateCache();
+    return ret;
+}
+
 void CChainState::PruneAndFlush() {
     BlockValidationState state;
     fCheckForPruning = true;
@@ -2436,9 +2667,20 @@ static void AppendWarning(bilingual_str& res, const bilingual_str& warn)
 }
 
 /** Check warning conditions and do some notifications on new chain tip set. */
-void static UpdateTip(const CBlockIndex* pindexNew, const CChainParams& chainParams)
+void static UpdateTip(const CBlockIndex* pindexNew, const CChainParams& chainParams, CChainState& chainstate)
     EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
 {
+    // The tip of a background chainstate is neither the best block nor a
+    // reason to warn about anything.
+    if (g_chainman.IsBackgroundIBD(&chainstate)) {
+        LogPrintf("[background validation] %s: new best=%s height=%d version=0x%08x log2_work=%f tx=%lu date='%s' cache=%.1fMiB(%utxo)\n", __func__,
+          pindexNew->GetBlockHash().ToString(), pindexNew->nHeight, pindexNew->nVersion,
+          log(pindexNew->nChainWork.getdouble())/log(2.0), (unsigned long)pindexNew->nChainTx,
+          FormatISO8601DateTime(pindexNew->GetBlockTime()),
+          chainstate.CoinsTip().DynamicMemoryUsage() * (1.0 / (1<<20)), chainstate.CoinsTip().GetCacheSize());
+        return;
+    }
+
     // New best block
     mempool.AddTransactionsUpdated(1);
 
@@ -2480,7 +2722,7 @@ void static UpdateTip(const CBlockIndex* pindexNew, const CChainParams& chainPar
       pindexNew->GetBlockHash().ToString(), pindexNew->nHeight, pindexNew->nVersion,
       log(pindexNew->nChainWork.getdouble())/log(2.0), (unsigned long)pindexNew->nChainTx,
       FormatISO8601DateTime(pindexNew->GetBlockTime()),
-      GuessVerificationProgress(chainParams.TxData(), pindexNew), ::ChainstateActive().CoinsTip().DynamicMemoryUsage() * (1.0 / (1<<20)), ::ChainstateActive().CoinsTip().GetCacheSize(),
+      GuessVerificationProgress(chainParams.TxData(), pindexNew), chainstate.CoinsTip().DynamicMemoryUsage() * (1.0 / (1<<20)), chainstate.CoinsTip().GetCacheSize(),
       !warning_messages.empty() ? strprintf(" warning='%s'", warning_messages.original) : "");
 
 }
@@ -2509,10 +2751,12 @@ bool CChainState::DisconnectTip(BlockValidationState& state, const CChainParams&
     {
         CCoinsViewCache view(&CoinsTip());
         assert(view.GetBestBlock() == pindexDelete->GetBlockHash());
-        if (DisconnectBlock(block, pindexDelete, view) != DISCONNECT_OK)
+        Optional<MuHash3072> utxo_hash = m_utxo_hash;
+        if (DisconnectBlock(block, pindexDelete, view, utxo_hash ? utxo_hash.get_ptr() : nullptr) != DISCONNECT_OK)
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         bool flushed = view.Flush();
         assert(flushed);
+        m_utxo_hash = std::move(utxo_hash);
     }
     LogPrint(BCLog::BENCH, "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * MILLI);
     // Write the chain state to disk, if necessary.
@@ -2534,14 +2778,17 @@ bool CChainState::DisconnectTip(BlockValidationState& state, const CChainParams&
 
     m_chain.SetTip(pindexDelete->pprev);
 
-    UpdateTip(pindexDelete->pprev, chainparams);
+    UpdateTip(pindexDelete->pprev, chainparams, *this);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
-    GetMainSignals().BlockDisconnected(pblock, pindexDelete);
+    if (!g_chainman.IsBackgroundIBD(this)) {
+        GetMainSignals().BlockDisconnected(pblock, pindexDelete);
+    }
     return true;
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2600,10 +2847,15 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
     int64_t nTime1 = GetTimeMicros();
     std::shared_ptr<const CBlock> pthisBlock;
     if (!pblock) {
-        std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
-        if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
-            return AbortNode(state, "Failed to read block");
-        pthisBlock = pblockNew;
+        // A block checked ahead of time only needs its UTXO-dependent checks in ConnectBlock.
+        if (g_parallel_block_precheck) pthisBlock = blockprechecker.Take(pindexNew->GetBlockHash());
+        if (!pthisBlock) {
+            std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
+            pblockNew->m_tx_arena = std::make_shared<MonotonicArena>();
+            if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
+                return AbortNode(state, "Failed to read block");
+            pthisBlock = pblockNew;
+        }
     } else {
         pthisBlock = pblock;
     }
@@ -2612,9 +2864,16 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    if (g_parallel_input_prefetch) {
+        PrefetchBlockInputs(blockConnecting, CoinsTip(), CoinsErrorCatcher(), &inputprefetchqueue);
+        int64_t nTimePrefetchEnd = GetTimeMicros(); nTimePrefetch += nTimePrefetchEnd - nTime2;
+        LogPrint(BCLog::BENCH, "  - Prefetch inputs: %.2fms [%.2fs]\n", (nTimePrefetchEnd - nTime2) * MILLI, nTimePrefetch * MICRO);
+        nTime2 = nTimePrefetchEnd;
+    }
     {
         CCoinsViewCache view(&CoinsTip());
-        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
+        Optional<MuHash3072> utxo_hash = m_utxo_hash;
+        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams, false, utxo_hash ? utxo_hash.get_ptr() : nullptr);
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -2626,6 +2885,7 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
         LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
         bool flushed = view.Flush();
         assert(flushed);
+        m_utxo_hash = std::move(utxo_hash);
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
     LogPrint(BCLog::BENCH, "  - Flush: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime4 - nTime3) * MILLI, nTimeFlush * MICRO, nTimeFlush * MILLI / nBlocksTotal);
@@ -2635,11 +2895,13 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
     LogPrint(BCLog::BENCH, "  - Writing chainstate: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime5 - nTime4) * MILLI, nTimeChainState * MICRO, nTimeChainState * MILLI / nBlocksTotal);
     // Remove conflicting transactions from the mempool.;
-    mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
-    disconnectpool.removeForBlock(blockConnecting.vtx);
+    if (!g_chainman.IsBackgroundIBD(this)) {
+        mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
+        disconnectpool.removeForBlock(blockConnecting.vtx);
+    }
     // Update m_chain & related variables.
     m_chain.SetTip(pindexNew);
-    UpdateTip(pindexNew, chainparams);
+    UpdateTip(pindexNew, chainparams, *this);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
@@ -2732,12 +2994,14 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, const CChai
 
     const CBlockIndex *pindexOldTip = m_chain.Tip();
     const CBlockIndex *pindexFork = m_chain.FindFork(pindexMostWork);
+    // A background chainstate has nothing to do with the mempool.
+    const bool is_background = g_chainman.IsBackgroundIBD(this);
 
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
     DisconnectedBlockTransactions disconnectpool;
     while (m_chain.Tip() && m_chain.Tip() != pindexFork) {
-        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+        if (!DisconnectTip(state, chainparams, is_background ? nullptr : &disconnectpool)) {
             // This is likely a fatal error, but keep the mempool consistent,
             // just in case. Only remove from the mempool in this case.
             UpdateMempoolForReorg(disconnectpool, false);
@@ -2768,6 +3032,14 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, const CChai
         }
         nHeight = nTargetHeight;
 
+        // Have the blocks after the first one read and checked while the ones before them are connected.
+        if (g_parallel_block_precheck) {
+            for (auto it = std::next(vpindexToConnect.rbegin()); it != vpindexToConnect.rend(); ++it) {
+                if (*it == pindexMostWork && pblock) continue;
+                blockprechecker.Schedule((*it)->GetBlockHash(), (*it)->nHeight, (*it)->GetBlockPos());
+            }
+        }
+
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
@@ -2798,6 +3070,8 @@ bool CChainState::ActivateBestChainStep(BlockValidationState& state, const CChai
         }
     }
 
+    if (is_background) return true;
+
     if (fBlocksDisconnected) {
         // If any blocks were disconnected, disconnectpool may be non empty.  Add
         // any disconnected transactions back to the mempool.
@@ -2867,6 +3141,11 @@ bool CChainState::ActivateBestChain(BlockValidationState &state, const CChainPar
     CBlockIndex *pindexMostWork = nullptr;
     CBlockIndex *pindexNewTip = nullptr;
     int nStopAtHeight = gArgs.GetArg("-stopatheight", DEFAULT_STOPATHEIGHT);
+    // Blocks connected to a background chainstate are old news to the rest
+    // of the node, so none of the notifications below are sent for them.
+    const bool is_background = WITH_LOCK(cs_main, return g_chainman.IsBackgroundIBD(this));
+    const bool was_in_ibd = IsInitialBlockDownload();
+    bool exited_ibd{false};
     do {
         // Block until the validation queue drains. This should largely
         // never happen in normal operation, however may happen during
@@ -2910,17 +3189,18 @@ bool CChainState::ActivateBestChain(BlockValidationState &state, const CChainPar
 
                 for (const PerBlockConnectTrace& trace : connectTrace.GetBlocksConnected()) {
                     assert(trace.pblock && trace.pindex);
-                    GetMainSignals().BlockConnected(trace.pblock, trace.pindex);
+                    if (!is_background) GetMainSignals().BlockConnected(trace.pblock, trace.pindex);
                 }
             } while (!m_chain.Tip() || (starting_tip && CBlockIndexWorkComparator()(m_chain.Tip(), starting_tip)));
             if (!blocks_connected) return true;
 
             const CBlockIndex* pindexFork = m_chain.FindFork(starting_tip);
             bool fInitialDownload = IsInitialBlockDownload();
+            if (was_in_ibd && !fInitialDownload) exited_ibd = true;
 
             // Notify external listeners about the new tip.
             // Enqueue while holding cs_main to ensure that UpdatedBlockTip is called in the order in which blocks are connected
-            if (pindexFork != pindexNewTip) {
+            if (pindexFork != pindexNewTip && !is_background) {
                 // Notify ValidationInterface subscribers
                 GetMainSignals().UpdatedBlockTip(pindexNewTip, pindexFork, fInitialDownload);
 
@@ -2930,7 +3210,7 @@ bool CChainState::ActivateBestChain(BlockValidationState &state, const CChainPar
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
 
-        if (nStopAtHeight && pindexNewTip && pindexNewTip->nHeight >= nStopAtHeight) StartShutdown();
+        if (nStopAtHeight && pindexNewTip && pindexNewTip->nHeight >= nStopAtHeight && !is_background) StartShutdown();
 
         // We check shutdown only after giving ActivateBestChainStep a chance to run once so that we
         // never shutdown before connecting the genesis block during LoadChainTip(). Previously this
@@ -2940,6 +3220,13 @@ bool CChainState::ActivateBestChain(BlockValidationState &state, const CChainPar
     } while (pindexNewTip != pindexMostWork);
     CheckBlockIndex(chainparams.GetConsensus());
 
+    if (exited_ibd) {
+        // The chainstate that left initial block download no longer needs
+        // the larger share of the coins cache.
+        LOCK(cs_main);
+        g_chainman.MaybeRebalanceCaches();
+    }
+
     // Write changes periodically to disk, after relay.
     if (!FlushStateToDisk(chainparams, state, FlushStateMode::PERIODIC)) {
         return false;
@@ -3198,11 +3485,45 @@ CBlockIndex* BlockManager::AddToBlockIndex(const CBlockHeader& block)
     return pindexNew;
 }
 
+void CChainState::LinkSnapshotBase(CBlockIndex* base, unsigned int nchaintx)
+{
+    AssertLockHeld(cs_main);
+    assert(base->GetBlockHash() == m_from_snapshot_blockhash);
+    if (base->HaveTxsDownloaded()) {
+        // All the blocks below the base are in already.
+        setBlockIndexCandidates.insert(base);
+        return;
+    }
+    base->nChainTx = nchaintx;
+    setBlockIndexCandidates.insert(base);
+
+    // Link the blocks building on the base whose data we already have.
+    std::deque<CBlockIndex*> queue;
+    queue.push_back(base);
+    while (!queue.empty()) {
+        CBlockIndex* pindex = queue.front();
+        queue.pop_front();
+        auto range = m_blockman.m_blocks_unlinked.equal_range(pindex);
+        while (range.first != range.second) {
+            CBlockIndex* child = range.first->second;
+            child->nChainTx = pindex->nChainTx + child->nTx;
+            if (m_chain.Tip() == nullptr || !setBlockIndexCandidates.value_comp()(child, m_chain.Tip())) {
+                setBlockIndexCandidates.insert(child);
+            }
+            queue.push_back(child);
+            range.first = m_blockman.m_blocks_unlinked.erase(range.first);
+        }
+    }
+}
+
 /** Mark a block as having its data received and checked (up to BLOCK_VALID_TRANSACTIONS). */
 void CChainState::ReceivedBlockTransactions(const CBlock& block, CBlockIndex* pindexNew, const FlatFilePos& pos, const Consensus::Params& consensusParams)
 {
     pindexNew->nTx = block.vtx.size();
-    pindexNew->nChainTx = 0;
+    // The base of a snapshot keeps its assumed count until its parents are in.
+    if (pindexNew->GetBlockHash() != m_from_snapshot_blockhash) {
+        pindexNew->nChainTx = 0;
+    }
     pindexNew->nFile = pos.nFile;
     pindexNew->nDataPos = pos.nPos;
     pindexNew->nUndoPos = 0;
@@ -3840,9 +4161,24 @@ bool ChainstateManager::ProcessNewBlock(const CChainParams& chainparams, const s
 {
     AssertLockNotHeld(cs_main);
 
+    // Keep background validation from competing for cs_main until this block
+    // has been dealt with, then let it know that there may be a new block for
+    // it to connect.
+    struct ProcessingGuard {
+        ChainstateManager& m_chainman;
+        explicit ProcessingGuard(ChainstateManager& chainman) : m_chainman(chainman) { ++m_chainman.m_blocks_processing; }
+        ~ProcessingGuard()
+        {
+            --m_chainman.m_blocks_processing;
+            m_chainman.NotifyBackgroundValidation();
+        }
+    } processing_guard{*this};
+
+    CBlockIndex *pindex = nullptr;
+    bool new_block = false;
+    if (!fNewBlock) fNewBlock = &new_block;
     {
-        CBlockIndex *pindex = nullptr;
-        if (fNewBlock) *fNewBlock = false;
+        *fNewBlock = false;
         BlockValidationState state;
 
         // CheckBlock() does not support multi-threaded block validation because CBlock::fChecked can cause data race.
@@ -3868,6 +4204,17 @@ bool ChainstateManager::ProcessNewBlock(const CChainParams& chainparams, const s
     if (!::ChainstateActive().ActivateBestChain(state, chainparams, pblock))
         return error("%s: ActivateBestChain failed (%s)", __func__, state.ToString());
 
+    // A block received ahead of the tip has been checked already; keep it
+    // around so that it need not be read and checked again once connected.
+    // Only a block stored by this call passed the contextual checks: a copy of
+    // a block we already have may carry a malleated witness.
+    if (g_parallel_block_precheck && *fNewBlock && pindex) {
+        LOCK(cs_main);
+        if (pindex->nHeight > ::ChainActive().Height() && (pindex->nStatus & BLOCK_HAVE_DATA) && !(pindex->nStatus & BLOCK_FAILED_MASK)) {
+            blockprechecker.Add(pblock, pindex->nHeight);
+        }
+    }
+
     return true;
 }
 
@@ -3949,6 +4296,8 @@ void ChainstateManager::PruneOneBlockFile(const int fileNumber)
 
 void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
+    g_block_file_maps.Clear();
+    g_undo_file_maps.Clear();
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         FlatFilePos pos(*it, 0);
         fs::remove(BlockFileSeq().FileName(pos));
@@ -4297,6 +4646,11 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
         }
+        if (pindex->GetBlockHash() == ::ChainstateActive().m_from_snapshot_blockhash) {
+            // The UTXO set was loaded from a snapshot at this block.
+            LogPrintf("VerifyDB(): block verification stopping at height %d (snapshot base)\n", pindex->nHeight);
+            break;
+        }
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
@@ -4493,9 +4847,14 @@ bool CChainState::RewindBlockIndex(const CChainParams& params)
     // First erase all post-segwit blocks without witness not in the main chain,
     // as this can we done without costly DisconnectTip calls. Active
     // blocks will be dealt with below (releasing cs_main in between).
+    // The blocks up to the base of an active UTXO snapshot may not have been
+    // downloaded yet, which is not for a lack of witness data.
     {
         LOCK(cs_main);
+        const uint256& snapshot_blockhash = ::ChainstateActive().m_from_snapshot_blockhash;
+        const CBlockIndex* snapshot_base = snapshot_blockhash.IsNull() ? nullptr : LookupBlockIndex(snapshot_blockhash);
         for (const auto& entry : m_blockman.m_block_index) {
+            if (snapshot_base && snapshot_base->GetAncestor(entry.second->nHeight) == entry.second) continue;
             if (IsWitnessEnabled(entry.second->pprev, params.GetConsensus()) && !(entry.second->nStatus & BLOCK_OPT_WITNESS) && !m_chain.Contains(entry.second)) {
                 EraseBlockData(entry.second);
             }
@@ -4507,6 +4866,12 @@ bool CChainState::RewindBlockIndex(const CChainParams& params)
     int nHeight = 1;
     {
         LOCK(cs_main);
+        if (!m_from_snapshot_blockhash.IsNull()) {
+            // This chainstate was not built from the blocks up to its base.
+            const CBlockIndex* base = LookupBlockIndex(m_from_snapshot_blockhash);
+            assert(base);
+            nHeight = base->nHeight + 1;
+        }
         while (nHeight <= m_chain.Height()) {
             // Although SCRIPT_VERIFY_WITNESS is now generally enforced on all
             // blocks in ConnectBlock, we don't need to go back and
@@ -4623,6 +4988,15 @@ bool ChainstateManager::LoadBlockIndex(const CChainParams& chainparams)
         bool ret = LoadBlockIndexDB(*this, chainparams);
         if (!ret) return false;
         needs_init = m_blockman.m_block_index.empty();
+
+        if (m_snapshot_chainstate) {
+            CBlockIndex* base = LookupBlockIndex(m_snapshot_chainstate->m_from_snapshot_blockhash);
+            const AssumeutxoData* au_data = base ? ExpectedAssumeutxo(base->nHeight, chainparams) : nullptr;
+            if (!au_data) {
+                return error("%s: no assumeutxo data for snapshot base %s", __func__, m_snapshot_chainstate->m_from_snapshot_blockhash.ToString());
+            }
+            m_snapshot_chainstate->LinkSnapshotBase(base, au_data->nChainTx);
+        }
     }
 
     if (needs_init) {
@@ -4710,6 +5084,7 @@ void LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFi
                 blkdat.SetPos(nBlockPos);
                 std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
                 CBlock& block = *pblock;
+                block.m_tx_arena = std::make_shared<MonotonicArena>();
                 blkdat >> block;
                 nRewind = blkdat.GetPos();
 
@@ -4828,6 +5203,12 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
     CBlockIndex* pindexFirstNotTransactionsValid = nullptr; // Oldest ancestor of pindex which does not have BLOCK_VALID_TRANSACTIONS (regardless of being valid or not).
     CBlockIndex* pindexFirstNotChainValid = nullptr; // Oldest ancestor of pindex which does not have BLOCK_VALID_CHAIN (regardless of being valid or not).
     CBlockIndex* pindexFirstNotScriptsValid = nullptr; // Oldest ancestor of pindex which does not have BLOCK_VALID_SCRIPTS (regardless of being valid or not).
+    // The base of a UTXO snapshot is linked without the blocks below it, so
+    // for the blocks building on it only the blocks above the base count.
+    const CBlockIndex* snapshot_base = m_from_snapshot_blockhash.IsNull() ? nullptr : LookupBlockIndex(m_from_snapshot_blockhash);
+    CBlockIndex* pindexFirstMissingAboveBase = nullptr; // Oldest ancestor of pindex above the snapshot base which does not have BLOCK_HAVE_DATA.
+    CBlockIndex* pindexFirstNeverProcessedAboveBase = nullptr; // Oldest ancestor of pindex above the snapshot base for which nTx == 0.
+    CBlockIndex* pindexFirstNotTransactionsValidAboveBase = nullptr; // Oldest ancestor of pindex above the snapshot base which does not have BLOCK_VALID_TRANSACTIONS.
     while (pindex != nullptr) {
         nNodes++;
         if (pindexFirstInvalid == nullptr && pindex->nStatus & BLOCK_FAILED_VALID) pindexFirstInvalid = pindex;
@@ -4837,6 +5218,15 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
         if (pindex->pprev != nullptr && pindexFirstNotTransactionsValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TRANSACTIONS) pindexFirstNotTransactionsValid = pindex;
         if (pindex->pprev != nullptr && pindexFirstNotChainValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN) pindexFirstNotChainValid = pindex;
         if (pindex->pprev != nullptr && pindexFirstNotScriptsValid == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS) pindexFirstNotScriptsValid = pindex;
+        const bool linked_by_snapshot = snapshot_base && pindex->GetAncestor(snapshot_base->nHeight) == snapshot_base;
+        if (linked_by_snapshot && pindex != snapshot_base) {
+            if (pindexFirstMissingAboveBase == nullptr && !(pindex->nStatus & BLOCK_HAVE_DATA)) pindexFirstMissingAboveBase = pindex;
+            if (pindexFirstNeverProcessedAboveBase == nullptr && pindex->nTx == 0) pindexFirstNeverProcessedAboveBase = pindex;
+            if (pindexFirstNotTransactionsValidAboveBase == nullptr && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TRANSACTIONS) pindexFirstNotTransactionsValidAboveBase = pindex;
+        }
+        CBlockIndex* pindexFirstMissingLinked = linked_by_snapshot ? pindexFirstMissingAboveBase : pindexFirstMissing;
+        CBlockIndex* pindexFirstNeverProcessedLinked = linked_by_snapshot ? pindexFirstNeverProcessedAboveBase : pindexFirstNeverProcessed;
+        CBlockIndex* pindexFirstNotTransactionsValidLinked = linked_by_snapshot ? pindexFirstNotTransactionsValidAboveBase : pindexFirstNotTransactionsValid;
 
         // Begin: actual consistency checks.
         if (pindex->pprev == nullptr) {
@@ -4858,8 +5248,8 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
         if (pindex->nStatus & BLOCK_HAVE_UNDO) assert(pindex->nStatus & BLOCK_HAVE_DATA);
         assert(((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TRANSACTIONS) == (pindex->nTx > 0)); // This is pruning-independent.
         // All parents having had data (at some point) is equivalent to all parents being VALID_TRANSACTIONS, which is equivalent to HaveTxsDownloaded().
-        assert((pindexFirstNeverProcessed == nullptr) == pindex->HaveTxsDownloaded());
-        assert((pindexFirstNotTransactionsValid == nullptr) == pindex->HaveTxsDownloaded());
+        assert((pindexFirstNeverProcessedLinked == nullptr) == pindex->HaveTxsDownloaded());
+        assert((pindexFirstNotTransactionsValidLinked == nullptr) == pindex->HaveTxsDownloaded());
         assert(pindex->nHeight == nHeight); // nHeight must be consistent.
         assert(pindex->pprev == nullptr || pindex->nChainWork >= pindex->pprev->nChainWork); // For every block except the genesis block, the chainwork must be larger than the parent's.
         assert(nHeight < 2 || (pindex->pskip && (pindex->pskip->nHeight < nHeight))); // The pskip pointer must point back for all but the first 2 blocks.
@@ -4871,13 +5261,13 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
             // Checks for not-invalid blocks.
             assert((pindex->nStatus & BLOCK_FAILED_MASK) == 0); // The failed mask cannot be set for blocks without invalid parents.
         }
-        if (!CBlockIndexWorkComparator()(pindex, m_chain.Tip()) && pindexFirstNeverProcessed == nullptr) {
+        if (!CBlockIndexWorkComparator()(pindex, m_chain.Tip()) && pindexFirstNeverProcessedLinked == nullptr) {
             if (pindexFirstInvalid == nullptr) {
                 // If this block sorts at least as good as the current tip and
                 // is valid and we have all data for its parents, it must be in
                 // setBlockIndexCandidates.  m_chain.Tip() must also be there
                 // even if some data has been pruned.
-                if (pindexFirstMissing == nullptr || pindex == m_chain.Tip()) {
+                if (pindexFirstMissingLinked == nullptr || pindex == m_chain.Tip()) {
                     assert(setBlockIndexCandidates.count(pindex));
                 }
                 // If some parent is missing, then it could be that this block was in
@@ -4898,13 +5288,13 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
             }
             rangeUnlinked.first++;
         }
-        if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessed != nullptr && pindexFirstInvalid == nullptr) {
+        if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessedLinked != nullptr && pindexFirstInvalid == nullptr) {
             // If this block has block data available, some parent was never received, and has no invalid parents, it must be in m_blocks_unlinked.
             assert(foundInUnlinked);
         }
         if (!(pindex->nStatus & BLOCK_HAVE_DATA)) assert(!foundInUnlinked); // Can't be in m_blocks_unlinked if we don't HAVE_DATA
         if (pindexFirstMissing == nullptr) assert(!foundInUnlinked); // We aren't missing data for any parent -- cannot be in m_blocks_unlinked.
-        if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessed == nullptr && pindexFirstMissing != nullptr) {
+        if (pindex->pprev && (pindex->nStatus & BLOCK_HAVE_DATA) && pindexFirstNeverProcessedLinked == nullptr && pindexFirstMissingLinked != nullptr) {
             // We HAVE_DATA for this block, have received data for all parents at some point, but we're currently missing data for some parent.
             assert(fHavePruned); // We must have pruned.
             // This block may have entered m_blocks_unlinked if:
@@ -4944,6 +5334,9 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
             if (pindex == pindexFirstNotTransactionsValid) pindexFirstNotTransactionsValid = nullptr;
             if (pindex == pindexFirstNotChainValid) pindexFirstNotChainValid = nullptr;
             if (pindex == pindexFirstNotScriptsValid) pindexFirstNotScriptsValid = nullptr;
+            if (pindex == pindexFirstMissingAboveBase) pindexFirstMissingAboveBase = nullptr;
+            if (pindex == pindexFirstNeverProcessedAboveBase) pindexFirstNeverProcessedAboveBase = nullptr;
+            if (pindex == pindexFirstNotTransactionsValidAboveBase) pindexFirstNotTransactionsValidAboveBase = nullptr;
             // Find our parent.
             CBlockIndex* pindexPar = pindex->pprev;
             // Find which child we just visited.
@@ -5284,3 +5677,523 @@ void ChainstateManager::Reset()
     m_active_chainstate = nullptr;
     m_snapshot_validated = false;
 }
+
+//! Number of coins read from a UTXO snapshot before they are written out.
+static constexpr size_t SNAPSHOT_LOAD_BATCH_COINS{100000};
+
+//! The part of the coins database key that orders the coins, which is also
+//! the order dumptxoutset writes them in. Outpoints compare differently, as
+//! the output index is stored as a VARINT.
+static std::vector<unsigned char> SerializeCoinsDBKey(const COutPoint& outpoint)
+{
+    std::vector<unsigned char> key;
+    CVectorWriter(SER_DISK, CLIENT_VERSION, key, 0) << outpoint.hash << VARINT(outpoint.n);
+    return key;
+}
+
+//! Share of the coins cache, in percent, left to the chainstate that is not in
+//! initial block download while the other one is.
+static constexpr int BACKGROUND_VALIDATION_MIN_CACHE_PERCENT{5};
+
+void ChainstateManager::MaybeRebalanceCaches()
+{
+    AssertLockHeld(::cs_main);
+    if (!IsBackgroundValidationActive()) {
+        ActiveChainstate().ResizeCoinsCache(m_total_coinstip_cache);
+        return;
+    }
+
+    // Whichever chainstate is still catching up gets most of the cache. The
+    // smaller share is applied first so the total stays within the budget.
+    const size_t small_share = m_total_coinstip_cache * BACKGROUND_VALIDATION_MIN_CACHE_PERCENT / 100;
+    const bool snapshot_in_ibd = m_snapshot_chainstate->IsInitialBlockDownload();
+    CChainState& shrink = snapshot_in_ibd ? *m_ibd_chainstate : *m_snapshot_chainstate;
+    CChainState& grow = snapshot_in_ibd ? *m_snapshot_chainstate : *m_ibd_chainstate;
+    LogPrintf("[snapshot] allocating most of the coins cache to %s\n", grow.ToString());
+    shrink.ResizeCoinsCache(small_share);
+    grow.ResizeCoinsCache(m_total_coinstip_cache - small_share);
+}
+
+bool ChainstateManager::BackgroundValidationStep(const CChainParams& chainparams)
+{
+    CChainState* background;
+    bool at_base;
+    {
+        LOCK(::cs_main);
+        if (!IsBackgroundValidationActive()) return false;
+        background = m_ibd_chainstate.get();
+        CBlockIndex* base = LookupBlockIndex(m_snapshot_chainstate->m_from_snapshot_blockhash);
+        assert(base);
+
+        at_base = background->m_chain.Tip() == base;
+        if (!at_base) {
+            // Only the blocks leading up to the snapshot base are of interest;
+            // drop whatever else the chainstate was working towards before the
+            // snapshot was loaded.
+            auto& candidates = background->setBlockIndexCandidates;
+            for (auto it = candidates.begin(); it != candidates.end();) {
+                if (base->GetAncestor((*it)->nHeight) != *it) {
+                    it = candidates.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            // Work towards the last of the next few blocks whose data is
+            // available, so that ::cs_main is regularly released to the
+            // active chainstate.
+            const CBlockIndex* fork = background->m_chain.FindFork(base);
+            const int start_height = fork ? fork->nHeight + 1 : 0;
+            const int end_height = std::min(start_height + BACKGROUND_VALIDATION_STEP_BLOCKS - 1, base->nHeight);
+            CBlockIndex* target = nullptr;
+            for (int height = start_height; height <= end_height; ++height) {
+                CBlockIndex* index = base->GetAncestor(height);
+                if (index->nStatus & BLOCK_FAILED_MASK) {
+                    // The snapshot builds on an invalid chain.
+                    AbortNode(strprintf("Block %s below the snapshot base is invalid", index->GetBlockHash().ToString()),
+                        _("The loaded UTXO snapshot is invalid. Restart to continue syncing without it."));
+                    return false;
+                }
+                if (!(index->nStatus & BLOCK_HAVE_DATA)) break;
+                target = index;
+            }
+            // Wait for more blocks to be downloaded.
+            if (!target) return false;
+            candidates.insert(target);
+        }
+    }
+
+    if (at_base) {
+        CompleteSnapshotValidation(chainparams);
+        return false;
+    }
+
+    BlockValidationState state;
+    if (!background->ActivateBestChain(state, chainparams, nullptr)) {
+        LogPrintf("[snapshot] background validation failed (%s)\n", state.ToString());
+        return false;
+    }
+    return true;
+}
+
+void ChainstateManager::ThreadBackgroundValidation(const CChainParams& chainparams)
+{
+    ScheduleBatchPriority();
+    while (!ShutdownRequested()) {
+        {
+            // Blocks for the active chainstate go first.
+            WAIT_LOCK(m_background_mutex, lock);
+            m_background_cv.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_background_mutex) {
+                return m_background_stop || (m_background_wake && m_blocks_processing == 0);
+            });
+            if (m_background_stop) return;
+            m_background_wake = false;
+        }
+        if (BackgroundValidationStep(chainparams)) {
+            // There may be more blocks to connect right away.
+            WITH_LOCK(m_background_mutex, m_background_wake = true);
+        } else if (!WITH_LOCK(::cs_main, return IsBackgroundValidationActive())) {
+            // The snapshot has been validated (or found invalid).
+            return;
+        }
+        // Otherwise wait for more blocks to arrive.
+    }
+}
+
+void ChainstateManager::StartBackgroundValidation(const CChainParams& chainparams)
+{
+    if (!WITH_LOCK(::cs_main, return IsBackgroundValidationActive())) return;
+
+    LOCK(m_background_mutex);
+    m_background_wake = true;
+    if (m_background_thread.joinable()) {
+        m_background_cv.notify_one();
+        return;
+    }
+    m_background_stop = false;
+    m_background_thread = std::thread(&TraceThread<std::function<void()>>, "bgvalid", [this, &chainparams] { ThreadBackgroundValidation(chainparams); });
+}
+
+void ChainstateManager::NotifyBackgroundValidation()
+{
+    // Taking the mutex ensures the thread is either waiting already or will
+    // see the flag before it does.
+    WITH_LOCK(m_background_mutex, m_background_wake = true);
+    m_background_cv.notify_one();
+}
+
+void ChainstateManager::InterruptBackgroundValidation()
+{
+    WITH_LOCK(m_background_mutex, m_background_stop = true);
+    m_background_cv.notify_one();
+}
+
+void ChainstateManager::StopBackgroundValidation()
+{
+    InterruptBackgroundValidation();
+    if (m_background_thread.joinable()) m_background_thread.join();
+}
+
+//! Name the coins directory of a background chainstate is given while it is
+//! being removed after the snapshot has been validated.
+static const char* const SNAPSHOT_TODELETE_DIRNAME = "chainstate_todelete";
+
+bool ChainstateManager::CompleteSnapshotValidation(const CChainParams& chainparams)
+{
+    CChainState* background;
+    CCoinsViewDB* coins_db;
+    int base_height;
+    Optional<MuHash3072> rolling_hash;
+    {
+        LOCK(::cs_main);
+        background = m_ibd_chainstate.get();
+        coins_db = &background->CoinsDB();
+        base_height = background->m_chain.Height();
+        rolling_hash = background->m_utxo_hash;
+        if (!rolling_hash) {
+            // The hash is computed from the coins database, which must be
+            // brought up to the base block first.
+            background->ForceFlushStateToDisk();
+        }
+    }
+
+    // The snapshot was only accepted with assumeutxo data for its base.
+    const AssumeutxoData* au_data = ExpectedAssumeutxo(base_height, chainparams);
+    assert(au_data);
+
+    uint256 utxo_hash;
+    if (rolling_hash) {
+        rolling_hash->Finalize(utxo_hash);
+    } else {
+        // Nothing else writes to the background chainstate, so its coins
+        // database can be scanned without holding ::cs_main.
+        LogPrintf("[snapshot] computing UTXO set hash at the snapshot base\n");
+        CCoinsStats stats;
+        try {
+            const auto interruption_point = [this] {
+                if (m_background_stop) throw std::runtime_error("background validation interrupted");
+            };
+            if (!GetUTXOStats(coins_db, stats, CoinStatsHashType::MUHASH, interruption_point)) {
+                LogPrintf("[snapshot] failed to compute the UTXO set hash at the snapshot base\n");
+                return false;
+            }
+        } catch (const std::runtime_error&) {
+            return false;
+        }
+        utxo_hash = stats.hashSerialized;
+    }
+
+    if (utxo_hash != au_data->muhash) {
+        LogPrintf("[snapshot] !!! UTXO set hash at height %d is %s, expected %s from the snapshot\n",
+            base_height, utxo_hash.ToString(), au_data->muhash.ToString());
+        AbortNode(strprintf("UTXO set hash mismatch at snapshot base height %d", base_height),
+            _("The loaded UTXO snapshot is invalid. Restart to continue syncing without it."));
+        return false;
+    }
+
+    {
+        LOCK(::cs_main);
+        m_snapshot_validated = true;
+        LogPrintf("[snapshot] snapshot validated by background validation (UTXO set hash %s at height %d)\n",
+            utxo_hash.ToString(), base_height);
+        // The background chainstate is no longer needed; its cache goes to
+        // the snapshot chainstate.
+        m_ibd_chainstate.reset();
+        MaybeRebalanceCaches();
+    }
+
+    // With its database closed, the coins directory of the background
+    // chainstate can go too. It is moved out of the way first so that
+    // DetectSnapshotChainstate() can tell an interrupted removal apart.
+    const fs::path ibd_dir = GetDataDir() / "chainstate";
+    const fs::path todelete_dir = GetDataDir() / SNAPSHOT_TODELETE_DIRNAME;
+    try {
+        if (fs::exists(ibd_dir)) {
+            fs::rename(ibd_dir, todelete_dir);
+            fs::remove_all(todelete_dir);
+            LogPrintf("[snapshot] removed the background chainstate directory\n");
+        }
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("[snapshot] failed to remove the background chainstate directory: %s\n", fsbridge::get_filesystem_error_message(e));
+    }
+    return true;
+}
+
+//! Name of the file that a snapshot chainstate's base block hash is written
+//! to, in its coins directory, once the snapshot is fully loaded.
+static const char* const SNAPSHOT_BLOCKHASH_FILENAME = "base_blockhash";
+
+static fs::path SnapshotChainstateDir(const uint256& base_blockhash)
+{
+    return GetDataDir() / ("chainstate_" + base_blockhash.ToString());
+}
+
+static bool WriteSnapshotBaseBlockhash(const uint256& base_blockhash)
+{
+    const fs::path path = SnapshotChainstateDir(base_blockhash) / SNAPSHOT_BLOCKHASH_FILENAME;
+    CAutoFile file{fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION};
+    if (file.IsNull()) {
+        return error("%s: failed to open %s", __func__, path.string());
+    }
+    file << base_blockhash;
+    if (!FileCommit(file.Get())) {
+        return error("%s: failed to commit %s", __func__, path.string());
+    }
+    return true;
+}
+
+Optional<uint256> DetectSnapshotChainstate(bool discard)
+{
+    const fs::path todelete_dir = GetDataDir() / SNAPSHOT_TODELETE_DIRNAME;
+    if (fs::exists(todelete_dir)) {
+        LogPrintf("[snapshot] removing leftover background chainstate directory\n");
+        fs::remove_all(todelete_dir);
+    }
+
+    const std::string prefix = "chainstate_";
+    std::vector<fs::path> dirs;
+    for (fs::directory_iterator it(GetDataDir()); it != fs::directory_iterator(); ++it) {
+        const std::string name = it->path().filename().string();
+        if (fs::is_directory(it->path()) && name.size() == prefix.size() + 64 &&
+                name.compare(0, prefix.size(), prefix) == 0 && IsHex(name.substr(prefix.size()))) {
+            dirs.push_back(it->path());
+        }
+    }
+
+    Optional<uint256> snapshot_blockhash;
+    for (const fs::path& dir : dirs) {
+        uint256 base_blockhash;
+        bool loaded{false};
+        {
+            CAutoFile file{fsbridge::fopen(dir / SNAPSHOT_BLOCKHASH_FILENAME, "rb"), SER_DISK, CLIENT_VERSION};
+            try {
+                if (!file.IsNull()) {
+                    file >> base_blockhash;
+                    loaded = dir == SnapshotChainstateDir(base_blockhash);
+                }
+            } catch (const std::ios_base::failure&) {
+            }
+        }
+        if (loaded && !discard && !snapshot_blockhash) {
+            const fs::path ibd_dir = GetDataDir() / "chainstate";
+            if (!fs::exists(ibd_dir)) {
+                // The snapshot was validated and the background chainstate
+                // removed, so this is now the only chainstate.
+                LogPrintf("[snapshot] using validated snapshot chainstate for base %s as the chainstate\n", base_blockhash.ToString());
+                fs::remove(dir / SNAPSHOT_BLOCKHASH_FILENAME);
+                fs::rename(dir, ibd_dir);
+                discard = true;
+                continue;
+            }
+            LogPrintf("[snapshot] found snapshot chainstate for base %s\n", base_blockhash.ToString());
+            snapshot_blockhash = base_blockhash;
+            continue;
+        }
+        LogPrintf("[snapshot] removing %s snapshot chainstate directory %s\n",
+            loaded ? "discarded" : "incomplete", dir.filename().string());
+        fs::remove_all(dir);
+    }
+    return snapshot_blockhash;
+}
+
+const AssumeutxoData* ExpectedAssumeutxo(const int height, const CChainParams& chainparams)
+{
+    const MapAssumeutxo& valid_assumeutxos_map = chainparams.Assumeutxo();
+    const auto assumeutxo_found = valid_assumeutxos_map.find(height);
+
+    if (assumeutxo_found != valid_assumeutxos_map.end()) {
+        return &assumeutxo_found->second;
+    }
+    return nullptr;
+}
+
+bool ChainstateManager::ActivateSnapshot(
+        CAutoFile& coins_file,
+        const SnapshotMetadata& metadata,
+        const CChainParams& chainparams,
+        bool in_memory)
+{
+    const uint256& base_blockhash = metadata.m_base_blockhash;
+
+    std::unique_ptr<CChainState> snapshot_chainstate;
+    {
+        LOCK(::cs_main);
+        if (m_snapshot_chainstate) {
+            LogPrintf("[snapshot] can't activate a snapshot-based chainstate more than once\n");
+            return false;
+        }
+
+        if (fPruneMode) {
+            // The blocks below the snapshot base are needed to validate it.
+            LogPrintf("[snapshot] can't activate a snapshot-based chainstate while pruning\n");
+            return false;
+        }
+
+        const CBlockIndex* base = LookupBlockIndex(base_blockhash);
+        if (base && base->nHeight <= ActiveHeight()) {
+            // The snapshot would not save any work.
+            LogPrintf("[snapshot] snapshot base %s at height %d is not ahead of the active chain (height %d)\n",
+                base_blockhash.ToString(), base->nHeight, ActiveHeight());
+            return false;
+        }
+
+        snapshot_chainstate = MakeUnique<CChainState>(m_blockman, base_blockhash);
+        // Wipe any leftovers of an earlier, interrupted attempt.
+        snapshot_chainstate->InitCoinsDB(
+            this->ActiveChainstate().m_coinsdb_cache_size_bytes, in_memory, /* should_wipe */ true);
+        // The coins are loaded without going through the cache, so it stays
+        // empty until the caches are rebalanced below.
+        snapshot_chainstate->InitCoinsCache(this->ActiveChainstate().m_coinstip_cache_size_bytes);
+    }
+
+    if (!this->PopulateAndValidateSnapshot(*snapshot_chainstate, coins_file, metadata, chainparams)) {
+        return false;
+    }
+
+    // Mark the snapshot as complete, so that it is used again after a restart.
+    if (!in_memory && !WriteSnapshotBaseBlockhash(base_blockhash)) {
+        return false;
+    }
+
+    LOCK(::cs_main);
+    assert(!m_snapshot_chainstate);
+    m_snapshot_chainstate.swap(snapshot_chainstate);
+    m_active_chainstate = m_snapshot_chainstate.get();
+
+    LogPrintf("[snapshot] successfully activated snapshot %s\n", base_blockhash.ToString());
+    LogPrintf("Switching active chainstate to %s\n", m_active_chainstate->ToString());
+
+    // The chain below the snapshot is now validated in the background.
+    this->MaybeRebalanceCaches();
+    return true;
+}
+
+bool ChainstateManager::PopulateAndValidateSnapshot(
+        CChainState& snapshot_chainstate,
+        CAutoFile& coins_file,
+        const SnapshotMetadata& metadata,
+        const CChainParams& chainparams)
+{
+    // Nothing else knows about snapshot_chainstate yet, so its views can be
+    // used without holding cs_main.
+    CCoinsViewDB& coins_db = *WITH_LOCK(::cs_main, return &snapshot_chainstate.CoinsDB());
+    const uint256& base_blockhash = metadata.m_base_blockhash;
+
+    CBlockIndex* snapshot_start_block = WITH_LOCK(::cs_main, return LookupBlockIndex(base_blockhash));
+    if (!snapshot_start_block) {
+        LogPrintf("[snapshot] Did not find snapshot start blockheader %s\n", base_blockhash.ToString());
+        return false;
+    }
+
+    const int base_height = snapshot_start_block->nHeight;
+    const AssumeutxoData* au_data = ExpectedAssumeutxo(base_height, chainparams);
+    if (!au_data) {
+        LogPrintf("[snapshot] assumeutxo height in snapshot metadata not recognized (%d) - refusing to load snapshot\n", base_height);
+        return false;
+    }
+    if (metadata.m_nchaintx != au_data->nChainTx) {
+        LogPrintf("[snapshot] bad snapshot metadata: expected nChainTx %d, got %d\n", au_data->nChainTx, metadata.m_nchaintx);
+        return false;
+    }
+
+    // The coins are read in the order of the coins database they were dumped
+    // from, which lets them go straight to LevelDB in large sorted batches
+    // instead of through a coins cache. Requiring that order also rules out
+    // duplicates, which would otherwise count twice towards the hash.
+    const uint64_t coins_count = metadata.m_coins_count;
+    std::vector<std::pair<COutPoint, Coin>> batch;
+    batch.reserve(SNAPSHOT_LOAD_BATCH_COINS);
+    MuHash3072 muhash;
+    std::vector<unsigned char> prev_key;
+    uint64_t coins_processed{0};
+    int64_t nStart = GetTimeMillis();
+
+    LogPrintf("[snapshot] loading coins from snapshot %s\n", base_blockhash.ToString());
+    while (coins_processed < coins_count) {
+        COutPoint outpoint;
+        Coin coin;
+        try {
+            coins_file >> outpoint;
+            coins_file >> coin;
+        } catch (const std::ios_base::failure&) {
+            LogPrintf("[snapshot] bad snapshot format or truncated snapshot after deserializing %d coins\n", coins_processed);
+            return false;
+        }
+
+        if (coin.nHeight > (uint32_t)base_height || coin.IsSpent()) {
+            LogPrintf("[snapshot] bad snapshot data after deserializing %d coins\n", coins_processed);
+            return false;
+        }
+        std::vector<unsigned char> key = SerializeCoinsDBKey(outpoint);
+        if (coins_processed > 0 && !(prev_key < key)) {
+            LogPrintf("[snapshot] bad snapshot - coins not in database order after deserializing %d coins\n", coins_processed);
+            return false;
+        }
+        prev_key.swap(key);
+
+        ApplyCoinHash(muhash, outpoint, coin);
+        batch.emplace_back(std::move(outpoint), std::move(coin));
+        ++coins_processed;
+
+        if (batch.size() == SNAPSHOT_LOAD_BATCH_COINS) {
+            if (!coins_db.WriteCoins(batch)) {
+                LogPrintf("[snapshot] failed to write coins to the database\n");
+                return false;
+            }
+            batch.clear();
+            if (ShutdownRequested()) return false;
+        }
+        if (coins_processed % 1000000 == 0) {
+            LogPrintf("[snapshot] %d coins loaded (%.2f%%)\n",
+                coins_processed, static_cast<float>(coins_processed) * 100 / static_cast<float>(coins_count));
+        }
+    }
+    if (!coins_db.WriteCoins(batch)) {
+        LogPrintf("[snapshot] failed to write coins to the database\n");
+        return false;
+    }
+
+    bool out_of_coins{false};
+    try {
+        COutPoint outpoint;
+        coins_file >> outpoint;
+    } catch (const std::ios_base::failure&) {
+        // We expect an exception since we should be out of coins.
+        out_of_coins = true;
+    }
+    if (!out_of_coins) {
+        LogPrintf("[snapshot] bad snapshot - coins left over after deserializing %d coins\n", coins_count);
+        return false;
+    }
+    LogPrintf("[snapshot] loaded %d coins from snapshot %s in %dms\n",
+        coins_count, base_blockhash.ToString(), GetTimeMillis() - nStart);
+
+    // Check the contents before marking the database as consistent with the
+    // base block: an unchecked UTXO set must never be picked up.
+    uint256 snapshot_hash;
+    MuHash3072 final_muhash{muhash};
+    final_muhash.Finalize(snapshot_hash);
+    if (snapshot_hash != au_data->muhash) {
+        LogPrintf("[snapshot] bad snapshot content hash: expected %s, got %s\n",
+            au_data->muhash.ToString(), snapshot_hash.ToString());
+        return false;
+    }
+
+    LOCK(::cs_main);
+    if (gArgs.GetBoolArg("-rollingutxohash", DEFAULT_ROLLING_UTXO_HASH)) {
+        snapshot_chainstate.m_utxo_hash = muhash;
+        coins_db.SetUTXOHash(muhash);
+    }
+    CCoinsViewCache& coins_cache = snapshot_chainstate.CoinsTip();
+    coins_cache.SetBestBlock(base_blockhash);
+    if (!coins_cache.Flush()) {
+        LogPrintf("[snapshot] failed to write the snapshot base block\n");
+        return false;
+    }
+
+    snapshot_chainstate.m_chain.SetTip(snapshot_start_block);
+    snapshot_chainstate.LinkSnapshotBase(snapshot_start_block, au_data->nChainTx);
+
+    LogPrintf("[snapshot] validated snapshot (hash %s)\n", snapshot_hash.ToString());
+    return true;
+}
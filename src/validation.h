@@ -25,16 +25,19 @@
 #include <serialize.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <map>
 #include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 class CChainState;
 class BlockValidationState;
+class CAutoFile;
 class CBlockIndex;
 class CBlockTreeDB;
 class CBlockUndo;
@@ -42,16 +45,22 @@ class CChainParams;
 class CInv;
 class CConnman;
 class CScriptCheck;
+class CInputPrefetchCheck;
 class CBlockPolicyEstimator;
 class CTxMemPool;
 class ChainstateManager;
+class SnapshotMetadata;
 class TxValidationState;
+struct AssumeutxoData;
 struct ChainTxData;
 
 struct DisconnectedBlockTransactions;
 struct PrecomputedTransactionData;
 struct LockPoints;
 
+template <typename T>
+class CCheckQueue;
+
 /** Default for -minrelaytxfee, minimum relay fee for transactions */
 static const unsigned int DEFAULT_MIN_RELAY_TX_FEE = 1000;
 /** Default for -limitancestorcount, max number of in-mempool ancestors */
@@ -70,9 +79,27 @@ static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 15;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Default for -parworksteal */
+static const bool DEFAULT_SCRIPTCHECK_WORK_STEALING = false;
+/** Maximum number of dedicated input prefetch threads allowed */
+static const int MAX_INPUT_PREFETCH_THREADS = 32;
+/** -inputprefetch default (number of input prefetch threads, 0 = disabled) */
+static const int DEFAULT_INPUT_PREFETCH_THREADS = 4;
+/** Maximum number of dedicated block precheck threads allowed */
+static const int MAX_BLOCK_PRECHECK_THREADS = 16;
+/** -blockprecheck default (number of block precheck threads, 0 = disabled) */
+static const int DEFAULT_BLOCK_PRECHECK_THREADS = 2;
+/** Maximum number of blk and rev files each kept memory mapped */
+static const int MAX_BLOCK_FILE_MAPS = 256;
+/** -blockfilemaps default (number of blk and rev files each kept memory mapped, 0 = disabled) */
+static const int DEFAULT_BLOCK_FILE_MAPS = 0;
 static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = false;
+/** Default for -rollingutxohash */
+static const bool DEFAULT_ROLLING_UTXO_HASH = false;
+/** Maximum number of blocks connected to a background chainstate in one go, before blocks for the active chainstate are let through */
+static const int BACKGROUND_VALIDATION_STEP_BLOCKS = 16;
 static const char* const DEFAULT_BLOCKFILTERINDEX = "0";
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
@@ -125,6 +152,10 @@ extern std::atomic_bool fReindex;
  * False indicates all script checking is done on the main threadMessageHandler thread.
  */
 extern bool g_parallel_script_checks;
+/** Whether there are dedicated threads prefetching block inputs from the coins database. */
+extern bool g_parallel_input_prefetch;
+/** Whether there are dedicated threads checking blocks ahead of the tip. */
+extern bool g_parallel_block_precheck;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
@@ -165,6 +196,16 @@ bool LoadGenesisBlock(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck(int worker_num);
+/** Give each script checking thread its own queue to steal work from. Must be called before they are started. */
+void EnableScriptCheckWorkStealing(int worker_threads);
+/** Run an instance of the input prefetch thread */
+void ThreadInputPrefetch(int worker_num);
+/** Start the block precheck threads */
+void StartBlockPrecheckThreads(int threads);
+/** Stop the block precheck threads */
+void StopBlockPrecheckThreads();
+/** Set how much memory, in bytes, blocks checked ahead of the tip may use */
+void SetBlockPrecheckCacheSize(size_t max_usage);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransactionRef& tx, const Consensus::Params& params, uint256& hashBlock, const CBlockIndex* const blockIndex = nullptr);
 /**
@@ -273,6 +314,42 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Closure representing one coin lookup on behalf of the input prefetcher.
+ * The result is written to a slot owned by the caller, so checks for
+ * different outpoints can run concurrently.
+ */
+class CInputPrefetchCheck
+{
+private:
+    const CCoinsView* m_base;
+    const COutPoint* m_outpoint;
+    Coin* m_coin;
+
+public:
+    CInputPrefetchCheck() : m_base(nullptr), m_outpoint(nullptr), m_coin(nullptr) {}
+    CInputPrefetchCheck(const CCoinsView& base, const COutPoint& outpoint, Coin& coin) :
+        m_base(&base), m_outpoint(&outpoint), m_coin(&coin) { }
+
+    bool operator()();
+
+    void swap(CInputPrefetchCheck& check) {
+        std::swap(m_base, check.m_base);
+        std::swap(m_outpoint, check.m_outpoint);
+        std::swap(m_coin, check.m_coin);
+    }
+};
+
+/**
+ * Load the coins spent by a block from `base` into `cache` before the block is
+ * connected, so that ConnectBlock finds them in memory. Lookups are spread over
+ * the workers of `queue`, or run on the calling thread if it is nullptr.
+ * Outpoints already cached or created within the block itself are skipped.
+ * `base` must be safe to read from multiple threads and must be the view
+ * backing `cache`.
+ */
+void PrefetchBlockInputs(const CBlock& block, CCoinsViewCache& cache, const CCoinsView& base, CCheckQueue<CInputPrefetchCheck>* queue);
+
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
 
@@ -284,6 +361,8 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, c
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
+/** Set how many blk and rev files each ReadBlockFromDisk and UndoReadFromDisk may keep memory mapped, 0 to read them with stdio. */
+void SetBlockFileMapLimit(size_t max_files);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -506,6 +585,12 @@ private:
     std::unique_ptr<CoinsViews> m_coins_views;
 
 public:
+    //! The cache size of the on-disk coins view.
+    size_t m_coinsdb_cache_size_bytes{0};
+
+    //! The cache size of the in-memory coins view.
+    size_t m_coinstip_cache_size_bytes{0};
+
     explicit CChainState(BlockManager& blockman, uint256 from_snapshot_blockhash = uint256());
 
     /**
@@ -522,7 +607,17 @@ public:
 
     //! Initialize the in-memory coins cache (to be done after the health of the on-disk database
     //! is verified).
-    void InitCoinsCache() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+    void InitCoinsCache(size_t cache_size_bytes) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    //! Resize the in-memory coins cache. Shrinking it flushes the coins to
+    //! disk and releases the memory held by the cache.
+    //!
+    //! The on-disk view keeps the cache size it was opened with: it is capped
+    //! at a few MiB (see nMaxCoinsDBCache) and cannot be reopened while
+    //! cursors on it may be in use.
+    //!
+    //! @returns false if flushing to disk failed.
+    bool ResizeCoinsCache(size_t coinstip_size) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
     //! @returns whether or not the CoinsViews object has been fully initialized and we can
     //!          safely flush this object to disk.
@@ -530,6 +625,19 @@ public:
         return m_coins_views && m_coins_views->m_cacheview;
     }
 
+    /**
+     * Rolling MuHash3072 of the UTXO set in CoinsTip(), updated on every
+     * ConnectTip()/DisconnectTip() and persisted along with the coins on
+     * each flush. Unset unless -rollingutxohash is enabled.
+     */
+    Optional<MuHash3072> m_utxo_hash GUARDED_BY(::cs_main);
+
+    //! Load the rolling UTXO set hash from the coins database, computing it
+    //! from a full scan of the UTXO set if it was not stored.
+    //!
+    //! @returns false if the scan was interrupted or failed.
+    bool LoadUTXOHash() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
     //! The current chain of blockheaders we consult and build on.
     //! @see CChain, CBlockIndex.
     CChain m_chain;
@@ -616,10 +724,11 @@ public:
 
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, BlockValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const FlatFilePos* dbp, bool* fNewBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
-    // Block (dis)connection on a given view:
-    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view);
+    // Block (dis)connection on a given view. If utxo_hash is non-null, the
+    // changes to the UTXO set are also applied to it.
+    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, MuHash3072* utxo_hash = nullptr);
     bool ConnectBlock(const CBlock& block, BlockValidationState& state, CBlockIndex* pindex,
-                      CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+                      CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false, MuHash3072* utxo_hash = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Apply the effects of a block disconnection on the UTXO set.
     bool DisconnectTip(BlockValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions* disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::mempool.cs);
@@ -653,6 +762,8 @@ public:
 
     //! Dictates whether we need to flush the cache to disk or not.
     //!
+    //! Only the active chainstate may use the unused space of the mempool.
+    //!
     //! @return the state of the size of the coins cache.
     CoinsCacheSizeState GetCoinsCacheSizeState(const CTxMemPool& tx_pool)
         EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
@@ -672,6 +783,15 @@ private:
     CBlockIndex* FindMostWorkChain() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     void ReceivedBlockTransactions(const CBlock& block, CBlockIndex* pindexNew, const FlatFilePos& pos, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /**
+     * Give the base of the snapshot this chainstate was created from the
+     * transaction count `nchaintx` of its assumeutxo data, which it would get
+     * anyway once the blocks below it are in, and make it and the blocks
+     * building on it candidates for connection. The blocks below the base
+     * are left alone, as the background chainstate still has to connect them.
+     */
+    void LinkSnapshotBase(CBlockIndex* base, unsigned int nchaintx) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     bool RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs, const CChainParams& params) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     //! Mark a block as not having block data
@@ -732,16 +852,12 @@ private:
     //! The chainstate used under normal operation (i.e. "regular" IBD) or, if
     //! a snapshot is in use, for background validation.
     //!
-    //! Its contents (including on-disk data) will be deleted *upon shutdown*
-    //! after background validation of the snapshot has completed. We do not
-    //! free the chainstate contents immediately after it finishes validation
-    //! to cautiously avoid a case where some other part of the system is still
-    //! using this pointer (e.g. net_processing).
-    //!
-    //! Once this pointer is set to a corresponding chainstate, it will not
-    //! be reset until init.cpp:Shutdown(). This means it is safe to acquire
-    //! the contents of this pointer with ::cs_main held, release the lock,
-    //! and then use the reference without concern of it being deconstructed.
+    //! Once background validation of the snapshot has completed, this
+    //! chainstate and its coins database are destroyed (under ::cs_main) by
+    //! the background validation thread, the only user of a background
+    //! chainstate outside of ::cs_main. Until then it is safe to acquire the
+    //! contents of this pointer with ::cs_main held, release the lock, and
+    //! then use the reference without concern of it being deconstructed.
     //!
     //! This is especially important when, e.g., calling ActivateBestChain()
     //! on all chainstates because we are not able to hold ::cs_main going into
@@ -778,6 +894,37 @@ private:
     //! by the background validation chainstate.
     bool m_snapshot_validated{false};
 
+    //! Number of ProcessNewBlock() calls in progress. Background validation
+    //! holds back while this is non-zero so that new blocks for the active
+    //! chainstate never queue up behind historical ones on ::cs_main.
+    std::atomic<int> m_blocks_processing{0};
+
+    //! Runs ThreadBackgroundValidation() once a snapshot has been activated.
+    std::thread m_background_thread;
+
+    Mutex m_background_mutex;
+    //! Signalled when the background validation thread may have work to do
+    //! or has to stop.
+    std::condition_variable m_background_cv;
+    //! Whether there may be blocks for the background chainstate to connect.
+    bool m_background_wake GUARDED_BY(m_background_mutex){false};
+    //! Set, with m_background_mutex held, to stop the thread.
+    std::atomic<bool> m_background_stop{false};
+
+    //! Body of the background validation thread, which runs at batch priority
+    //! and calls BackgroundValidationStep() whenever it is woken up, until the
+    //! snapshot has been validated or it is stopped.
+    void ThreadBackgroundValidation(const CChainParams& chainparams);
+
+    //! Compare the UTXO set of the background chainstate, which must be at
+    //! the snapshot base, against the assumeutxo hash of the snapshot. On a
+    //! match the snapshot chainstate is marked as validated and the
+    //! background chainstate is destroyed along with its coins database;
+    //! otherwise the node is shut down.
+    //!
+    //! @returns true if the snapshot was found to be valid.
+    bool CompleteSnapshotValidation(const CChainParams& chainparams) LOCKS_EXCLUDED(::cs_main);
+
     // For access to m_active_chainstate.
     friend CChainState& ChainstateActive();
     friend CChain& ChainActive();
@@ -787,6 +934,12 @@ public:
     //! chainstate to avoid duplicating block metadata.
     BlockManager m_blockman GUARDED_BY(::cs_main);
 
+    //! The total number of bytes available for the in-memory coins caches,
+    //! split across the chainstates in use by MaybeRebalanceCaches().
+    size_t m_total_coinstip_cache{0};
+
+    ~ChainstateManager() { StopBackgroundValidation(); }
+
     //! Instantiate a new chainstate and assign it based upon whether it is
     //! from a snapshot.
     //!
@@ -820,6 +973,13 @@ public:
     //!          snapshot in the background.
     bool IsBackgroundIBD(CChainState* chainstate) const;
 
+    //! @returns true if the chain below an active snapshot is still being
+    //!          validated in the background.
+    bool IsBackgroundValidationActive() const
+    {
+        return m_snapshot_chainstate && m_ibd_chainstate && !m_snapshot_validated;
+    }
+
     //! Return the most-work chainstate that has been fully validated.
     //!
     //! During background validation of a snapshot, this is the IBD chain. After
@@ -875,11 +1035,89 @@ public:
 
     //! Clear (deconstruct) chainstate data.
     void Reset();
+
+    //! Split the in-memory coins cache budget across the chainstates in use.
+    //!
+    //! While background validation runs, whichever chainstate is still in
+    //! initial block download gets most of the cache and the other one is
+    //! left with a small share, which also throttles the background
+    //! chainstate while the snapshot chainstate catches up with the network.
+    void MaybeRebalanceCaches() EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    /**
+     * Connect the next blocks below the snapshot base, if they are available,
+     * to the background chainstate and check the snapshot once the base is
+     * reached. At most BACKGROUND_VALIDATION_STEP_BLOCKS are connected.
+     *
+     * @returns true if progress was made and more work may be pending.
+     */
+    bool BackgroundValidationStep(const CChainParams& chainparams) LOCKS_EXCLUDED(::cs_main);
+
+    //! Start the background validation thread if the chain below an active
+    //! snapshot has yet to be validated and the thread is not running yet.
+    void StartBackgroundValidation(const CChainParams& chainparams) LOCKS_EXCLUDED(::cs_main, m_background_mutex);
+
+    //! Wake the background validation thread, e.g. because blocks arrived.
+    void NotifyBackgroundValidation() LOCKS_EXCLUDED(m_background_mutex);
+
+    //! Ask the background validation thread to stop.
+    void InterruptBackgroundValidation() LOCKS_EXCLUDED(m_background_mutex);
+
+    //! Stop the background validation thread and wait for it to exit.
+    void StopBackgroundValidation() LOCKS_EXCLUDED(m_background_mutex);
+
+    /**
+     * Construct and activate a snapshot chainstate from the coins in
+     * `coins_file`, which must hold the coins of a UTXO set in key order, as
+     * written by the dumptxoutset RPC after `metadata`.
+     *
+     * The coins are written straight to a fresh coins database in large
+     * batches, and the resulting UTXO set is only used if its MuHash3072
+     * matches the assumeutxo data of `chainparams` at the snapshot height.
+     *
+     * @returns true if the snapshot chainstate is now the active chainstate.
+     */
+    bool ActivateSnapshot(
+        CAutoFile& coins_file,
+        const SnapshotMetadata& metadata,
+        const CChainParams& chainparams,
+        bool in_memory) LOCKS_EXCLUDED(::cs_main);
+
+private:
+    //! Write the coins of `coins_file` to the database of `snapshot_chainstate`
+    //! and check them against the expected assumeutxo hash.
+    bool PopulateAndValidateSnapshot(
+        CChainState& snapshot_chainstate,
+        CAutoFile& coins_file,
+        const SnapshotMetadata& metadata,
+        const CChainParams& chainparams) LOCKS_EXCLUDED(::cs_main);
 };
 
 /** DEPRECATED! Please use node.chainman instead. May only be used in validation.cpp internally */
 extern ChainstateManager g_chainman GUARDED_BY(::cs_main);
 
+/**
+ * Return the expected assumeutxo value for a given height, if one exists.
+ *
+ * @param height[in] Get the assumeutxo value for this height.
+ *
+ * @returns empty if no assumeutxo configuration exists for the given height.
+ */
+const AssumeutxoData* ExpectedAssumeutxo(const int height, const CChainParams& params);
+
+/**
+ * Find the snapshot chainstate that was loaded by ActivateSnapshot() before
+ * the last shutdown. The coins directories of snapshot chainstates that were
+ * never fully loaded are removed. A snapshot chainstate whose background
+ * chainstate was removed after validating it becomes the regular chainstate.
+ *
+ * @param discard[in] Remove the snapshot chainstate as well, e.g. because the
+ *                    chainstate is being rebuilt.
+ *
+ * @returns the base block hash of the snapshot, if one is to be used.
+ */
+Optional<uint256> DetectSnapshotChainstate(bool discard);
+
 /** Please prefer the identical ChainstateManager::ActiveChainstate */
 CChainState& ChainstateActive();
 
@@ -0,0 +1,151 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/rescan.h>
+
+#include <interfaces/chain.h>
+#include <tinyformat.h>
+#include <util/memory.h>
+#include <util/threadnames.h>
+#include <wallet/ismine.h>
+#include <wallet/scriptpubkeyman.h>
+
+#include <algorithm>
+
+RescanPrefetcher::RescanPrefetcher(interfaces::Chain& chain, const uint256& end_hash, int start_height, int end_height, int threads, std::set<ScriptPubKeyMan*> spk_mans)
+    : m_chain(chain), m_end_hash(end_hash), m_end_height(end_height), m_use_block_filter(chain.hasBlockFilterIndex(BlockFilterType::BASIC)), m_next_read(start_height), m_next_take(start_height)
+{
+    SetScriptPubKeyMans(std::move(spk_mans));
+    threads = std::min(threads, MAX_RESCAN_THREADS);
+    for (int i = 0; i < threads; ++i) {
+        m_threads.emplace_back([this, i] {
+            util::ThreadRename(strprintf("rescan.%i", i));
+            Thread();
+        });
+    }
+}
+
+RescanPrefetcher::~RescanPrefetcher()
+{
+    WITH_LOCK(m_mutex, m_stop = true);
+    m_work_cond.notify_all();
+    for (std::thread& thread : m_threads) thread.join();
+}
+
+void RescanPrefetcher::SetScriptPubKeyMans(std::set<ScriptPubKeyMan*> spk_mans)
+{
+    // Descriptor managers only match the scriptPubKeys their descriptors were
+    // expanded to, so earlier matches stay valid while the ranges don't grow.
+    Optional<std::map<ScriptPubKeyMan*, int32_t>> range_ends = std::map<ScriptPubKeyMan*, int32_t>();
+    for (ScriptPubKeyMan* spk_man : spk_mans) {
+        const auto desc_spk_man = dynamic_cast<DescriptorScriptPubKeyMan*>(spk_man);
+        if (!desc_spk_man) {
+            range_ends = nullopt;
+            break;
+        }
+        range_ends->emplace(spk_man, desc_spk_man->GetEndRange());
+    }
+
+    {
+        LOCK(m_mutex);
+        if (range_ends && m_range_ends == range_ends && m_spk_mans == spk_mans) return;
+    }
+
+    std::shared_ptr<GCSFilter::ElementSet> filter_elements;
+    if (m_use_block_filter && range_ends) {
+        filter_elements = std::make_shared<GCSFilter::ElementSet>();
+        for (ScriptPubKeyMan* spk_man : spk_mans) {
+            for (const CScript& script : static_cast<DescriptorScriptPubKeyMan*>(spk_man)->GetScriptPubKeys()) {
+                filter_elements->emplace(script.begin(), script.end());
+            }
+        }
+    }
+
+    LOCK(m_mutex);
+    m_spk_mans = std::move(spk_mans);
+    m_range_ends = std::move(range_ends);
+    m_filter_elements = std::move(filter_elements);
+    ++m_generation;
+}
+
+bool RescanPrefetcher::UsesBlockFilter()
+{
+    LOCK(m_mutex);
+    return m_filter_elements != nullptr;
+}
+
+bool RescanPrefetcher::FilteredOut(const uint256& block_hash)
+{
+    return FilteredOut(block_hash, WITH_LOCK(m_mutex, return m_filter_elements).get());
+}
+
+bool RescanPrefetcher::FilteredOut(const uint256& block_hash, const GCSFilter::ElementSet* filter_elements)
+{
+    if (!filter_elements) return false;
+    const Optional<bool> matches = m_chain.blockFilterMatchesAny(BlockFilterType::BASIC, block_hash, *filter_elements);
+    return matches && !*matches;
+}
+
+void RescanPrefetcher::Thread()
+{
+    while (true) {
+        int height;
+        std::set<ScriptPubKeyMan*> spk_mans;
+        std::shared_ptr<const GCSFilter::ElementSet> filter_elements;
+        auto block = MakeUnique<Block>();
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_work_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+                return m_stop || (m_next_read <= m_end_height && m_next_read < m_next_take + MAX_RESCAN_PREFETCH_BLOCKS);
+            });
+            if (m_stop) return;
+            height = m_next_read++;
+            spk_mans = m_spk_mans;
+            filter_elements = m_filter_elements;
+            block->generation = m_generation;
+        }
+
+        if (!m_chain.findAncestorByHeight(m_end_hash, height, interfaces::FoundBlock().hash(block->hash))) {
+            block.reset();
+        } else if (FilteredOut(block->hash, filter_elements.get())) {
+            block->filtered_out = true;
+        } else if (!m_chain.findBlock(block->hash, interfaces::FoundBlock().data(block->block)) || block->block.IsNull()) {
+            block.reset();
+        } else {
+            // Only the outputs are matched here. Whether a transaction spends
+            // from the wallet depends on the transactions committed before it.
+            block->pays_to_us.reserve(block->block.vtx.size());
+            for (const CTransactionRef& tx : block->block.vtx) {
+                bool pays_to_us = false;
+                for (const CTxOut& txout : tx->vout) {
+                    pays_to_us = std::any_of(spk_mans.begin(), spk_mans.end(), [&](ScriptPubKeyMan* spk_man) {
+                        return spk_man->IsMine(txout.scriptPubKey) != ISMINE_NO;
+                    });
+                    if (pays_to_us) break;
+                }
+                block->pays_to_us.push_back(pays_to_us);
+            }
+        }
+
+        WITH_LOCK(m_mutex, m_blocks.emplace(height, std::move(block)));
+        m_done_cond.notify_all();
+    }
+}
+
+std::unique_ptr<RescanPrefetcher::Block> RescanPrefetcher::Take(int height)
+{
+    if (m_threads.empty()) return nullptr;
+    std::unique_ptr<Block> block;
+    {
+        WAIT_LOCK(m_mutex, lock);
+        if (height != m_next_take || height > m_end_height) return nullptr;
+        m_done_cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_blocks.count(height) != 0; });
+        auto it = m_blocks.find(height);
+        block = std::move(it->second);
+        m_blocks.erase(it);
+        ++m_next_take;
+    }
+    m_work_cond.notify_all();
+    return block;
+}
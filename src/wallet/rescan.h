@@ -0,0 +1,117 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_RESCAN_H
+#define BITCOIN_WALLET_RESCAN_H
+
+#include <blockfilter.h>
+#include <optional.h>
+#include <primitives/block.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class ScriptPubKeyMan;
+namespace interfaces {
+class Chain;
+} // namespace interfaces
+
+/** Maximum number of threads reading and matching blocks ahead of a rescan */
+static const int MAX_RESCAN_THREADS = 16;
+/** Default number of threads reading and matching blocks ahead of a rescan, 0 = scan on the rescanning thread only */
+static const int DEFAULT_RESCAN_THREADS = 2;
+/** Maximum number of blocks read ahead of the block being scanned */
+static const int MAX_RESCAN_PREFETCH_BLOCKS = 32;
+
+/**
+ * Reads blocks ahead of a wallet rescan and matches their outputs against the
+ * wallet's scriptPubKeys on worker threads.
+ *
+ * The rescanning thread takes the blocks in order of height and only has to
+ * look at the transactions that pay to the wallet or touch wallet
+ * transactions, which it commits in order. Matching a transaction that pays to
+ * the wallet can mark keys as used and top up the keypool, so the rescanning
+ * thread calls SetScriptPubKeyMans afterwards; blocks matched before that
+ * have a stale generation and must be matched again by the caller.
+ *
+ * When the node has a basic block filter index and all of the wallet's
+ * scriptPubKeys come from descriptors, blocks whose filter matches none of
+ * them are not read at all. Basic filters contain the scriptPubKeys of the
+ * outputs spent by a block too, so spends from the wallet are not missed.
+ */
+class RescanPrefetcher
+{
+public:
+    struct Block {
+        uint256 hash;
+        CBlock block;
+        //! Whether the block filter showed the block has nothing for the wallet, so it was not read
+        bool filtered_out{false};
+        //! For every transaction, whether one of its outputs pays to the wallet
+        std::vector<bool> pays_to_us;
+        //! The generation of scriptPubKey managers pays_to_us and filtered_out were computed with
+        uint64_t generation;
+    };
+
+    /** Start worker threads reading the ancestors of end_hash from start_height up to end_height. */
+    RescanPrefetcher(interfaces::Chain& chain, const uint256& end_hash, int start_height, int end_height, int threads, std::set<ScriptPubKeyMan*> spk_mans);
+    ~RescanPrefetcher();
+
+    /**
+     * Match further blocks against the given scriptPubKey managers, starting a
+     * new generation unless they are the same descriptor managers with the
+     * same ranges as before.
+     */
+    void SetScriptPubKeyMans(std::set<ScriptPubKeyMan*> spk_mans);
+
+    uint64_t Generation() const { return m_generation; }
+
+    /** Whether blocks are tested against the block filter index before they are read. */
+    bool UsesBlockFilter();
+
+    /** Whether the block filter of the block shows it has nothing for the wallet. */
+    bool FilteredOut(const uint256& block_hash);
+
+    /**
+     * Take the block at the given height, waiting for a worker that is reading
+     * it. Heights must be taken in order. Returns nullptr if there are no
+     * workers, the height is out of range or the block could not be read; the
+     * caller then has to read the block itself.
+     */
+    std::unique_ptr<Block> Take(int height);
+
+private:
+    void Thread();
+    bool FilteredOut(const uint256& block_hash, const GCSFilter::ElementSet* filter_elements);
+
+    interfaces::Chain& m_chain;
+    const uint256 m_end_hash;
+    const int m_end_height;
+    const bool m_use_block_filter;
+    std::vector<std::thread> m_threads;
+
+    Mutex m_mutex;
+    std::condition_variable m_work_cond;
+    std::condition_variable m_done_cond;
+    std::map<int, std::unique_ptr<Block>> m_blocks GUARDED_BY(m_mutex);
+    std::set<ScriptPubKeyMan*> m_spk_mans GUARDED_BY(m_mutex);
+    //! Range ends of m_spk_mans if they are all descriptor managers
+    Optional<std::map<ScriptPubKeyMan*, int32_t>> m_range_ends GUARDED_BY(m_mutex);
+    //! scriptPubKeys of m_spk_mans if blocks are tested against the block filter index
+    std::shared_ptr<const GCSFilter::ElementSet> m_filter_elements GUARDED_BY(m_mutex);
+    int m_next_read GUARDED_BY(m_mutex);
+    int m_next_take GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::atomic<uint64_t> m_generation{0};
+};
+
+#endif // BITCOIN_WALLET_RESCAN_H
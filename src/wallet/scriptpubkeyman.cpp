@@ -9,12 +9,65 @@
 #include <util/bip32.h>
 #include <util/strencodings.h>
 #include <util/string.h>
+#include <util/system.h>
+#include <util/threadnames.h>
 #include <util/translation.h>
 #include <wallet/scriptpubkeyman.h>
 
+#include <algorithm>
+#include <thread>
+
 //! Value for the first BIP 32 hardened derivation. Can be used as a bit mask and as a value. See BIP 32 for more details.
 const uint32_t BIP32_HARDENED_KEY_LIMIT = 0x80000000;
 
+//! Maximum number of threads expanding a range of descriptor indexes
+static const int MAX_DESCRIPTOR_EXPAND_THREADS = 8;
+//! Minimum number of descriptor indexes each expanding thread is given
+static const int32_t MIN_DESCRIPTOR_EXPAND_BATCH = 500;
+
+namespace {
+//! The scriptPubKeys and public keys one descriptor index expands to
+struct ExpandedIndex {
+    bool expanded{false};
+    std::vector<CScript> scripts;
+    FlatSigningProvider out_keys;
+};
+
+/**
+ * Expand the indexes [start, end) of a descriptor from the cached xpubs.
+ * Indexes that cannot be expanded from the cache are left unexpanded. Large
+ * ranges are split over worker threads, each deriving a contiguous part of
+ * the range from the cached parent xpubs.
+ */
+std::vector<ExpandedIndex> ExpandRangeFromCache(const Descriptor& descriptor, const DescriptorCache& cache, int32_t start, int32_t end)
+{
+    std::vector<ExpandedIndex> expanded(std::max(end - start, 0));
+    const auto expand_batch = [&](int32_t batch_start, int32_t batch_end) {
+        for (int32_t i = batch_start; i < batch_end; ++i) {
+            ExpandedIndex& index = expanded[i - start];
+            index.expanded = descriptor.ExpandFromCache(i, cache, index.scripts, index.out_keys);
+        }
+    };
+
+    const int32_t size = expanded.size();
+    const int threads = std::min<int32_t>({GetNumCores(), MAX_DESCRIPTOR_EXPAND_THREADS, size / MIN_DESCRIPTOR_EXPAND_BATCH});
+    if (threads < 2) {
+        expand_batch(start, end);
+        return expanded;
+    }
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            util::ThreadRename(strprintf("descexpand.%i", t));
+            expand_batch(start + (int64_t)size * t / threads, start + (int64_t)size * (t + 1) / threads);
+        });
+    }
+    expand_batch(start, start + size / threads);
+    for (std::thread& worker : workers) worker.join();
+    return expanded;
+}
+} // namespace
+
 bool LegacyScriptPubKeyMan::GetNewDestination(const OutputType type, CTxDestination& dest, std::string& error)
 {
     LOCK(cs_KeyStore);
@@ -1753,20 +1806,31 @@ bool DescriptorScriptPubKeyMan::TopUp(unsigned int size)
     provider.keys = GetKeys();
 
     WalletBatch batch(m_storage.GetDatabase());
-    uint256 id = GetID();
+    // Expand as much of the range as possible from the cached xpubs first, in parallel
+    std::vector<ExpandedIndex> expanded = ExpandRangeFromCache(*m_wallet_descriptor.descriptor, m_wallet_descriptor.cache, m_max_cached_index + 1, new_range_end);
+    int32_t expanded_start = m_max_cached_index + 1;
     for (int32_t i = m_max_cached_index + 1; i < new_range_end; ++i) {
-        FlatSigningProvider out_keys;
-        std::vector<CScript> scripts_temp;
-        DescriptorCache temp_cache;
-        // Maybe we have a cached xpub and we can expand from the cache first
-        if (!m_wallet_descriptor.descriptor->ExpandFromCache(i, m_wallet_descriptor.cache, scripts_temp, out_keys)) {
-            if (!m_wallet_descriptor.descriptor->Expand(i, provider, scripts_temp, out_keys, &temp_cache)) return false;
+        ExpandedIndex& index = expanded[i - expanded_start];
+        if (!index.expanded) {
+            // Derive this index, caching the xpubs needed to derive it again without private keys
+            DescriptorCache temp_cache;
+            index = ExpandedIndex();
+            if (!m_wallet_descriptor.descriptor->Expand(i, provider, index.scripts, index.out_keys, &temp_cache)) return false;
+            const size_t parent_xpubs = m_wallet_descriptor.cache.GetCachedParentExtPubKeys().size();
+            WriteDescriptorCacheWithDB(batch, temp_cache);
+            // A newly cached parent xpub may let the rest of the range be expanded from the cache
+            if (m_wallet_descriptor.cache.GetCachedParentExtPubKeys().size() != parent_xpubs && i + 1 < new_range_end) {
+                std::vector<ExpandedIndex> rest = ExpandRangeFromCache(*m_wallet_descriptor.descriptor, m_wallet_descriptor.cache, i + 1, new_range_end);
+                expanded.resize(i + 1 - expanded_start);
+                std::move(rest.begin(), rest.end(), std::back_inserter(expanded));
+            }
         }
+        const ExpandedIndex& added = expanded[i - expanded_start];
         // Add all of the scriptPubKeys to the scriptPubKey set
-        for (const CScript& script : scripts_temp) {
+        for (const CScript& script : added.scripts) {
             m_map_script_pub_keys[script] = i;
         }
-        for (const auto& pk_pair : out_keys.pubkeys) {
+        for (const auto& pk_pair : added.out_keys.pubkeys) {
             const CPubKey& pubkey = pk_pair.second;
             if (m_map_pubkeys.count(pubkey) != 0) {
                 // We don't need to give an error here.
@@ -1775,35 +1839,6 @@ bool DescriptorScriptPubKeyMan::TopUp(unsigned int size)
             }
             m_map_pubkeys[pubkey] = i;
         }
-        // Write the cache
-        for (const auto& parent_xpub_pair : temp_cache.GetCachedParentExtPubKeys()) {
-            CExtPubKey xpub;
-            if (m_wallet_descriptor.cache.GetCachedParentExtPubKey(parent_xpub_pair.first, xpub)) {
-                if (xpub != parent_xpub_pair.second) {
-                    throw std::runtime_error(std::string(__func__) + ": New cached parent xpub does not match already cached parent xpub");
-                }
-                continue;
-            }
-            if (!batch.WriteDescriptorParentCache(parent_xpub_pair.second, id, parent_xpub_pair.first)) {
-                throw std::runtime_error(std::string(__func__) + ": writing cache item failed");
-            }
-            m_wallet_descriptor.cache.CacheParentExtPubKey(parent_xpub_pair.first, parent_xpub_pair.second);
-        }
-        for (const auto& derived_xpub_map_pair : temp_cache.GetCachedDerivedExtPubKeys()) {
-            for (const auto& derived_xpub_pair : derived_xpub_map_pair.second) {
-                CExtPubKey xpub;
-                if (m_wallet_descriptor.cache.GetCachedDerivedExtPubKey(derived_xpub_map_pair.first, derived_xpub_pair.first, xpub)) {
-                    if (xpub != derived_xpub_pair.second) {
-                        throw std::runtime_error(std::string(__func__) + ": New cached derived xpub does not match already cached derived xpub");
-                    }
-                    continue;
-                }
-                if (!batch.WriteDescriptorDerivedCache(derived_xpub_pair.second, id, derived_xpub_map_pair.first, derived_xpub_pair.first)) {
-                    throw std::runtime_error(std::string(__func__) + ": writing cache item failed");
-                }
-                m_wallet_descriptor.cache.CacheDerivedExtPubKey(derived_xpub_map_pair.first, derived_xpub_pair.first, derived_xpub_pair.second);
-            }
-        }
         m_max_cached_index++;
     }
     m_wallet_descriptor.range_end = new_range_end;
@@ -1816,6 +1851,40 @@ bool DescriptorScriptPubKeyMan::TopUp(unsigned int size)
     return true;
 }
 
+void DescriptorScriptPubKeyMan::WriteDescriptorCacheWithDB(WalletBatch& batch, const DescriptorCache& temp_cache)
+{
+    AssertLockHeld(cs_desc_man);
+    uint256 id = GetID();
+    for (const auto& parent_xpub_pair : temp_cache.GetCachedParentExtPubKeys()) {
+        CExtPubKey xpub;
+        if (m_wallet_descriptor.cache.GetCachedParentExtPubKey(parent_xpub_pair.first, xpub)) {
+            if (xpub != parent_xpub_pair.second) {
+                throw std::runtime_error(std::string(__func__) + ": New cached parent xpub does not match already cached parent xpub");
+            }
+            continue;
+        }
+        if (!batch.WriteDescriptorParentCache(parent_xpub_pair.second, id, parent_xpub_pair.first)) {
+            throw std::runtime_error(std::string(__func__) + ": writing cache item failed");
+        }
+        m_wallet_descriptor.cache.CacheParentExtPubKey(parent_xpub_pair.first, parent_xpub_pair.second);
+    }
+    for (const auto& derived_xpub_map_pair : temp_cache.GetCachedDerivedExtPubKeys()) {
+        for (const auto& derived_xpub_pair : derived_xpub_map_pair.second) {
+            CExtPubKey xpub;
+            if (m_wallet_descriptor.cache.GetCachedDerivedExtPubKey(derived_xpub_map_pair.first, derived_xpub_pair.first, xpub)) {
+                if (xpub != derived_xpub_pair.second) {
+                    throw std::runtime_error(std::string(__func__) + ": New cached derived xpub does not match already cached derived xpub");
+                }
+                continue;
+            }
+            if (!batch.WriteDescriptorDerivedCache(derived_xpub_pair.second, id, derived_xpub_map_pair.first, derived_xpub_pair.first)) {
+                throw std::runtime_error(std::string(__func__) + ": writing cache item failed");
+            }
+            m_wallet_descriptor.cache.CacheDerivedExtPubKey(derived_xpub_map_pair.first, derived_xpub_pair.first, derived_xpub_pair.second);
+        }
+    }
+}
+
 void DescriptorScriptPubKeyMan::MarkUnusedAddresses(const CScript& script)
 {
     LOCK(cs_desc_man);
@@ -2177,20 +2246,20 @@ void DescriptorScriptPubKeyMan::SetCache(const DescriptorCache& cache)
 {
     LOCK(cs_desc_man);
     m_wallet_descriptor.cache = cache;
+    const std::vector<ExpandedIndex> expanded = ExpandRangeFromCache(*m_wallet_descriptor.descriptor, m_wallet_descriptor.cache, m_wallet_descriptor.range_start, m_wallet_descriptor.range_end);
     for (int32_t i = m_wallet_descriptor.range_start; i < m_wallet_descriptor.range_end; ++i) {
-        FlatSigningProvider out_keys;
-        std::vector<CScript> scripts_temp;
-        if (!m_wallet_descriptor.descriptor->ExpandFromCache(i, m_wallet_descriptor.cache, scripts_temp, out_keys)) {
+        const ExpandedIndex& index = expanded[i - m_wallet_descriptor.range_start];
+        if (!index.expanded) {
             throw std::runtime_error("Error: Unable to expand wallet descriptor from cache");
         }
         // Add all of the scriptPubKeys to the scriptPubKey set
-        for (const CScript& script : scripts_temp) {
+        for (const CScript& script : index.scripts) {
             if (m_map_script_pub_keys.count(script) != 0) {
                 throw std::runtime_error(strprintf("Error: Already loaded script at index %d as being at index %d", i, m_map_script_pub_keys[script]));
             }
             m_map_script_pub_keys[script] = i;
         }
-        for (const auto& pk_pair : out_keys.pubkeys) {
+        for (const auto& pk_pair : index.out_keys.pubkeys) {
             const CPubKey& pubkey = pk_pair.second;
             if (m_map_pubkeys.count(pubkey) != 0) {
                 // We don't need to give an error here.
@@ -2252,3 +2321,9 @@ const std::vector<CScript> DescriptorScriptPubKeyMan::GetScriptPubKeys() const
     }
     return script_pub_keys;
 }
+
+int32_t DescriptorScriptPubKeyMan::GetEndRange() const
+{
+    LOCK(cs_desc_man);
+    return m_wallet_descriptor.range_end;
+}
@@ -534,6 +534,8 @@ private:
     bool m_decryption_thoroughly_checked = false;
 
     bool AddDescriptorKeyWithDB(WalletBatch& batch, const CKey& key, const CPubKey &pubkey);
+    //! Add the xpubs of temp_cache that are not cached yet to the descriptor cache and write them to the database
+    void WriteDescriptorCacheWithDB(WalletBatch& batch, const DescriptorCache& temp_cache) EXCLUSIVE_LOCKS_REQUIRED(cs_desc_man);
 
     KeyMap GetKeys() const EXCLUSIVE_LOCKS_REQUIRED(cs_desc_man);
 
@@ -613,6 +615,7 @@ public:
 
     const WalletDescriptor GetWalletDescriptor() const EXCLUSIVE_LOCKS_REQUIRED(cs_desc_man);
     const std::vector<CScript> GetScriptPubKeys() const;
+    int32_t GetEndRange() const;
 };
 
 #endif // BITCOIN_WALLET_SCRIPTPUBKEYMAN_H
@@ -0,0 +1,627 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <wallet/sqlite.h>
+
+#include <chainparams.h>
+#include <crypto/common.h>
+#include <logging.h>
+#include <sync.h>
+#include <util/memory.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+#include <util/translation.h>
+#include <wallet/db.h>
+
+#include <set>
+#include <stdint.h>
+
+static const char* const DATABASE_FILENAME = "wallet.dat";
+//! Version of the layout of the tables, stored as the user_version of the database
+static const int32_t WALLET_SCHEMA_VERSION = 0;
+
+namespace {
+Mutex g_sqlite_mutex;
+//! Data files of the SQLite databases currently in use
+std::set<std::string> g_sqlite_files GUARDED_BY(g_sqlite_mutex);
+
+int32_t ApplicationId()
+{
+    return static_cast<int32_t>(ReadBE32(Params().MessageStart()));
+}
+
+//! Execute a statement that returns no rows
+int ExecStatement(sqlite3* db, const std::string& sql)
+{
+    int res = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    if (res != SQLITE_OK) {
+        LogPrintf("SQLiteDatabase: Failed to execute statement \"%s\": %s\n", sql, sqlite3_errstr(res));
+    }
+    return res;
+}
+
+//! Read an integer from a PRAGMA statement
+bool ReadPragmaInt(sqlite3* db, const std::string& key, int& value)
+{
+    sqlite3_stmt* stmt{nullptr};
+    int res = sqlite3_prepare_v2(db, ("PRAGMA " + key).c_str(), -1, &stmt, nullptr);
+    if (res == SQLITE_OK) {
+        res = sqlite3_step(stmt);
+        if (res == SQLITE_ROW) value = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return res == SQLITE_ROW;
+}
+
+//! Bind a serialized key or value to a statement parameter
+bool BindBlob(sqlite3_stmt* stmt, int index, const CDataStream& blob, const char* description)
+{
+    int res = sqlite3_bind_blob(stmt, index, blob.data(), blob.size(), SQLITE_STATIC);
+    if (res != SQLITE_OK) {
+        LogPrintf("Unable to bind %s to statement: %s\n", description, sqlite3_errstr(res));
+        sqlite3_clear_bindings(stmt);
+        sqlite3_reset(stmt);
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+bool IsSQLiteWalletLoaded(const fs::path& wallet_path)
+{
+    LOCK(g_sqlite_mutex);
+    return g_sqlite_files.count(WalletDataFilePath(wallet_path).string()) != 0;
+}
+
+std::string SQLiteDatabaseVersion()
+{
+    return std::string(sqlite3_libversion());
+}
+
+SQLiteDatabase::SQLiteDatabase(const fs::path& dir_path, const fs::path& file_path)
+    : WalletDatabase(), m_dir_path(dir_path.string()), m_file_path(file_path.string())
+{
+    if (!sqlite3_threadsafe()) {
+        throw std::runtime_error("SQLiteDatabase: SQLite was compiled without thread safety, which the wallet requires");
+    }
+
+    LOCK(g_sqlite_mutex);
+    auto inserted = g_sqlite_files.insert(m_file_path);
+    assert(inserted.second);
+}
+
+SQLiteDatabase::~SQLiteDatabase()
+{
+    {
+        LOCK(m_db_mutex);
+        if (m_db) {
+            CommitImplicitTxn();
+            Close();
+        }
+    }
+
+    LOCK(g_sqlite_mutex);
+    g_sqlite_files.erase(m_file_path);
+}
+
+void SQLiteDatabase::Open()
+{
+    if (m_db) return;
+
+    TryCreateDirectories(m_dir_path);
+    int res = sqlite3_open_v2(m_file_path.c_str(), &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, nullptr);
+    if (res != SQLITE_OK) {
+        sqlite3_close(m_db);
+        m_db = nullptr;
+        throw std::runtime_error(strprintf("SQLiteDatabase: Failed to open database %s: %s", m_file_path, sqlite3_errstr(res)));
+    }
+
+    auto fail = [&](const std::string& error) {
+        sqlite3_close(m_db);
+        m_db = nullptr;
+        throw std::runtime_error(strprintf("SQLiteDatabase: %s", error));
+    };
+
+    if (sqlite3_db_readonly(m_db, "main") != 0) {
+        fail(strprintf("Database %s is read-only", m_file_path));
+    }
+
+    // Hold an exclusive lock for as long as the database is open. It is taken
+    // before switching to WAL mode, so that no shared memory index is needed
+    // for the write-ahead log.
+    if (ExecStatement(m_db, "PRAGMA locking_mode = exclusive") != SQLITE_OK) {
+        fail("Unable to change database locking mode to exclusive");
+    }
+    if (ExecStatement(m_db, "BEGIN EXCLUSIVE TRANSACTION") != SQLITE_OK) {
+        fail(strprintf("Unable to obtain an exclusive lock on the database %s, is it being used by another %s?", m_file_path, PACKAGE_NAME));
+    }
+    if (ExecStatement(m_db, "COMMIT") != SQLITE_OK) {
+        fail("Unable to end exclusive lock transaction");
+    }
+
+    // Overwrite deleted records, so that rewriting the database after
+    // encrypting it does not leave unencrypted keys in free pages
+    if (ExecStatement(m_db, "PRAGMA secure_delete = true") != SQLITE_OK) {
+        fail("Unable to enable secure delete");
+    }
+
+    sqlite3_stmt* check_main_stmt{nullptr};
+    res = sqlite3_prepare_v2(m_db, "SELECT name FROM sqlite_master WHERE type='table' AND name='main'", -1, &check_main_stmt, nullptr);
+    bool table_exists = res == SQLITE_OK && sqlite3_step(check_main_stmt) == SQLITE_ROW;
+    sqlite3_finalize(check_main_stmt);
+    if (res != SQLITE_OK) {
+        fail(strprintf("Failed to prepare statement to check table existence: %s", sqlite3_errstr(res)));
+    }
+
+    if (!table_exists) {
+        // Create the table and identify the file while still in rollback
+        // journal mode, so the header is written to the data file right away
+        // and IsSQLiteFile recognizes it even before the first checkpoint.
+        if (ExecStatement(m_db, "CREATE TABLE main(key BLOB PRIMARY KEY NOT NULL, value BLOB NOT NULL)") != SQLITE_OK) {
+            fail("Failed to create new database");
+        }
+        if (ExecStatement(m_db, strprintf("PRAGMA application_id = %d", ApplicationId())) != SQLITE_OK) {
+            fail("Failed to set the application id");
+        }
+        if (ExecStatement(m_db, strprintf("PRAGMA user_version = %d", WALLET_SCHEMA_VERSION)) != SQLITE_OK) {
+            fail("Failed to set the wallet schema version");
+        }
+    }
+
+    if (ExecStatement(m_db, "PRAGMA journal_mode = WAL") != SQLITE_OK) {
+        fail("Unable to change database journal mode to WAL");
+    }
+}
+
+void SQLiteDatabase::Close()
+{
+    if (!m_db) return;
+    int res = sqlite3_close(m_db);
+    if (res != SQLITE_OK) {
+        LogPrintf("SQLiteDatabase: Failed to close database %s: %s\n", m_file_path, sqlite3_errstr(res));
+        return;
+    }
+    m_db = nullptr;
+}
+
+bool SQLiteDatabase::CommitImplicitTxn() const
+{
+    if (!m_implicit_txn) return true;
+    m_implicit_txn = false;
+    if (ExecStatement(m_db, "COMMIT TRANSACTION") != SQLITE_OK) {
+        LogPrintf("SQLiteDatabase: Failed to commit batched writes to %s\n", m_file_path);
+        return false;
+    }
+    return true;
+}
+
+bool SQLiteDatabase::Verify(bilingual_str& error)
+{
+    LogPrintf("Using SQLite Version %s\n", SQLiteDatabaseVersion());
+    LogPrintf("Using wallet %s\n", m_dir_path);
+
+    // Also return true if the file does not exist yet
+    if (!fs::exists(m_file_path)) return true;
+
+    LOCK(m_db_mutex);
+    try {
+        Open();
+    } catch (const std::runtime_error& e) {
+        error = Untranslated(e.what());
+        return false;
+    }
+
+    int app_id;
+    if (!ReadPragmaInt(m_db, "application_id", app_id)) {
+        error = Untranslated("SQLiteDatabase: Failed to read the application id");
+        return false;
+    }
+    if (app_id != ApplicationId()) {
+        error = strprintf(_("SQLiteDatabase: Unexpected application id. Expected %u, got %u"), static_cast<uint32_t>(ApplicationId()), static_cast<uint32_t>(app_id));
+        return false;
+    }
+
+    int user_ver;
+    if (!ReadPragmaInt(m_db, "user_version", user_ver)) {
+        error = Untranslated("SQLiteDatabase: Failed to read the wallet schema version");
+        return false;
+    }
+    if (user_ver != WALLET_SCHEMA_VERSION) {
+        error = strprintf(_("SQLiteDatabase: Unknown sqlite wallet schema version %d. Only version %d is supported"), user_ver, WALLET_SCHEMA_VERSION);
+        return false;
+    }
+
+    sqlite3_stmt* stmt{nullptr};
+    int ret = sqlite3_prepare_v2(m_db, "PRAGMA integrity_check", -1, &stmt, nullptr);
+    if (ret != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        error = strprintf(_("SQLiteDatabase: Failed to prepare statement to verify database: %s"), sqlite3_errstr(ret));
+        return false;
+    }
+    while (true) {
+        ret = sqlite3_step(stmt);
+        if (ret == SQLITE_DONE) {
+            break;
+        }
+        if (ret != SQLITE_ROW) {
+            error = strprintf(_("SQLiteDatabase: Failed to execute statement to verify database: %s"), sqlite3_errstr(ret));
+            break;
+        }
+        const char* msg = (const char*)sqlite3_column_text(stmt, 0);
+        if (!msg) {
+            error = strprintf(_("SQLiteDatabase: Failed to read database verification error: %s"), sqlite3_errstr(ret));
+            break;
+        }
+        std::string str_msg(msg);
+        if (str_msg == "ok") {
+            continue;
+        }
+        if (error.empty()) {
+            error = _("Failed to verify database") + Untranslated("\n");
+        }
+        error += Untranslated(strprintf("%s\n", str_msg));
+    }
+    sqlite3_finalize(stmt);
+    return error.empty();
+}
+
+bool SQLiteDatabase::Rewrite(const char* pszSkip)
+{
+    LOCK(m_db_mutex);
+    try {
+        Open();
+    } catch (const std::runtime_error& e) {
+        LogPrintf("SQLiteDatabase::Rewrite: %s\n", e.what());
+        return false;
+    }
+    if (!CommitImplicitTxn()) return false;
+    // An explicit transaction is still open
+    if (!sqlite3_get_autocommit(m_db)) return false;
+
+    if (pszSkip) {
+        sqlite3_stmt* stmt{nullptr};
+        int res = sqlite3_prepare_v2(m_db, "DELETE FROM main WHERE substr(key, 1, ?) = ?", -1, &stmt, nullptr);
+        if (res == SQLITE_OK) res = sqlite3_bind_int(stmt, 1, strlen(pszSkip));
+        if (res == SQLITE_OK) res = sqlite3_bind_blob(stmt, 2, pszSkip, strlen(pszSkip), SQLITE_STATIC);
+        if (res == SQLITE_OK) res = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        if (res != SQLITE_DONE) {
+            LogPrintf("SQLiteDatabase::Rewrite: Failed to erase skipped records from %s: %s\n", m_file_path, sqlite3_errstr(res));
+            return false;
+        }
+    }
+
+    LogPrintf("SQLiteDatabase::Rewrite: Rewriting %s...\n", m_file_path);
+    if (ExecStatement(m_db, "VACUUM") != SQLITE_OK) return false;
+    // Move everything into the data file and empty the write-ahead log, which
+    // still holds the pages as they were before the rewrite
+    int res = sqlite3_wal_checkpoint_v2(m_db, nullptr, SQLITE_CHECKPOINT_TRUNCATE, nullptr, nullptr);
+    if (res != SQLITE_OK) {
+        LogPrintf("SQLiteDatabase::Rewrite: Failed to checkpoint %s: %s\n", m_file_path, sqlite3_errstr(res));
+        return false;
+    }
+    return true;
+}
+
+bool SQLiteDatabase::Backup(const std::string& dest) const
+{
+    fs::path path_dest(dest);
+    if (fs::is_directory(path_dest)) path_dest /= DATABASE_FILENAME;
+
+    LOCK(m_db_mutex);
+    try {
+        if (fs::exists(path_dest)) {
+            if (fs::equivalent(m_file_path, path_dest)) {
+                LogPrintf("cannot backup to wallet source file %s\n", path_dest.string());
+                return false;
+            }
+            fs::remove(path_dest);
+        }
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("error backing up %s to %s - %s\n", m_file_path, path_dest.string(), fsbridge::get_filesystem_error_message(e));
+        return false;
+    }
+
+    // Back up through the open connection, so that writes in the write-ahead
+    // log are included. A closed database is read from the file.
+    sqlite3* src = m_db;
+    sqlite3* src_closed{nullptr};
+    if (src) {
+        if (!CommitImplicitTxn()) return false;
+    } else {
+        if (!fs::exists(m_file_path)) return false;
+        int res = sqlite3_open_v2(m_file_path.c_str(), &src_closed, SQLITE_OPEN_READONLY, nullptr);
+        if (res != SQLITE_OK) {
+            LogPrintf("error backing up %s: failed to open database: %s\n", m_file_path, sqlite3_errstr(res));
+            sqlite3_close(src_closed);
+            return false;
+        }
+        src = src_closed;
+    }
+
+    sqlite3* db_copy{nullptr};
+    int res = sqlite3_open(path_dest.string().c_str(), &db_copy);
+    if (res == SQLITE_OK) {
+        sqlite3_backup* backup = sqlite3_backup_init(db_copy, "main", src, "main");
+        if (!backup) {
+            res = sqlite3_errcode(db_copy);
+        } else {
+            // Copy all of the pages in one step
+            res = sqlite3_backup_step(backup, -1);
+            if (res == SQLITE_DONE) res = SQLITE_OK;
+            int finish_res = sqlite3_backup_finish(backup);
+            if (res == SQLITE_OK) res = finish_res;
+        }
+    }
+    sqlite3_close(db_copy);
+    sqlite3_close(src_closed);
+
+    if (res != SQLITE_OK) {
+        LogPrintf("error backing up %s to %s - %s\n", m_file_path, path_dest.string(), sqlite3_errstr(res));
+        return false;
+    }
+    LogPrintf("copied %s to %s\n", m_file_path, path_dest.string());
+    return true;
+}
+
+void SQLiteDatabase::Flush(bool shutdown)
+{
+    LOCK(m_db_mutex);
+    if (!m_db) return;
+    CommitImplicitTxn();
+    if (shutdown) Close();
+}
+
+bool SQLiteDatabase::PeriodicFlush()
+{
+    // Don't flush if we can't acquire the lock.
+    TRY_LOCK(m_db_mutex, lock);
+    if (!lock) return false;
+    if (!m_db) return true;
+
+    // Commit the writes of batches that are still open. With WAL, SQLite
+    // checkpoints the log into the data file by itself.
+    return CommitImplicitTxn();
+}
+
+std::unique_ptr<DatabaseBatch> SQLiteDatabase::MakeBatch(const char* mode, bool flush_on_close)
+{
+    return MakeUnique<SQLiteBatch>(*this, mode, flush_on_close);
+}
+
+SQLiteBatch::SQLiteBatch(SQLiteDatabase& database, const char* mode, bool flush_on_close)
+    : m_database(database)
+{
+    m_read_only = (!strchr(mode, '+') && !strchr(mode, 'w'));
+
+    LOCK(m_database.m_db_mutex);
+    m_database.Open();
+    SetupSQLStatements();
+}
+
+void SQLiteBatch::SetupSQLStatements()
+{
+    const std::vector<std::pair<sqlite3_stmt**, const char*>> statements{
+        {&m_read_stmt, "SELECT value FROM main WHERE key = ?"},
+        {&m_insert_stmt, "INSERT INTO main VALUES(?, ?)"},
+        {&m_overwrite_stmt, "INSERT or REPLACE into main values(?, ?)"},
+        {&m_delete_stmt, "DELETE FROM main WHERE key = ?"},
+        {&m_cursor_stmt, "SELECT key, value FROM main"},
+    };
+
+    for (const auto& statement : statements) {
+        int res = sqlite3_prepare_v2(m_database.m_db, statement.second, -1, statement.first, nullptr);
+        if (res != SQLITE_OK) {
+            throw std::runtime_error(strprintf("SQLiteBatch: Failed to setup SQL statements: %s", sqlite3_errstr(res)));
+        }
+    }
+}
+
+void SQLiteBatch::Flush()
+{
+    LOCK(m_database.m_db_mutex);
+    if (m_txn) return;
+    m_database.CommitImplicitTxn();
+}
+
+void SQLiteBatch::Close()
+{
+    if (!m_read_stmt) return;
+
+    // Like BerkeleyBatch, abort an explicit transaction that was not committed
+    if (m_txn) {
+        LogPrintf("SQLiteBatch: Batch closed with an open transaction, aborting it\n");
+        TxnAbort();
+    }
+    WITH_LOCK(m_database.m_db_mutex, m_database.CommitImplicitTxn());
+
+    for (sqlite3_stmt** stmt : {&m_read_stmt, &m_insert_stmt, &m_overwrite_stmt, &m_delete_stmt, &m_cursor_stmt}) {
+        sqlite3_finalize(*stmt);
+        *stmt = nullptr;
+    }
+}
+
+bool SQLiteBatch::ReadKey(CDataStream&& key, CDataStream& value)
+{
+    LOCK(m_database.m_db_mutex);
+    if (!m_database.m_db) return false;
+    assert(m_read_stmt);
+
+    if (!BindBlob(m_read_stmt, 1, key, "key")) return false;
+    int res = sqlite3_step(m_read_stmt);
+    if (res != SQLITE_ROW) {
+        if (res != SQLITE_DONE) {
+            // SQLITE_DONE means "not found", don't log an error in that case.
+            LogPrintf("%s: Unable to execute statement: %s\n", __func__, sqlite3_errstr(res));
+        }
+        sqlite3_clear_bindings(m_read_stmt);
+        sqlite3_reset(m_read_stmt);
+        return false;
+    }
+    // Leftmost column in result is index 0
+    const char* data = reinterpret_cast<const char*>(sqlite3_column_blob(m_read_stmt, 0));
+    int data_size = sqlite3_column_bytes(m_read_stmt, 0);
+    value.write(data, data_size);
+
+    sqlite3_clear_bindings(m_read_stmt);
+    sqlite3_reset(m_read_stmt);
+    return true;
+}
+
+bool SQLiteBatch::WaitForOtherTxn(DebugLock<Mutex>& lock)
+{
+    if (m_database.m_txn_batch && m_database.m_txn_batch != this && m_database.m_txn_thread == std::this_thread::get_id()) {
+        LogPrintf("SQLiteBatch: Cannot write while another batch of the same thread has a transaction open\n");
+        return false;
+    }
+    m_database.m_txn_cv.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_database.m_db_mutex) {
+        return !m_database.m_txn_batch || m_database.m_txn_batch == this;
+    });
+    return true;
+}
+
+bool SQLiteBatch::ExecWriteStatement(sqlite3_stmt* stmt)
+{
+    int res = SQLITE_MISUSE;
+    {
+        WAIT_LOCK(m_database.m_db_mutex, lock);
+        if (WaitForOtherTxn(lock) && m_database.m_db) {
+            // Batch the write into a transaction unless one is open already
+            if (!m_database.m_implicit_txn && sqlite3_get_autocommit(m_database.m_db)) {
+                m_database.m_implicit_txn = ExecStatement(m_database.m_db, "BEGIN TRANSACTION") == SQLITE_OK;
+            }
+            res = sqlite3_step(stmt);
+        }
+    }
+    sqlite3_clear_bindings(stmt);
+    sqlite3_reset(stmt);
+    if (res != SQLITE_DONE) {
+        LogPrintf("%s: Unable to execute statement: %s\n", __func__, sqlite3_errstr(res));
+    }
+    return res == SQLITE_DONE;
+}
+
+bool SQLiteBatch::WriteKey(CDataStream&& key, CDataStream&& value, bool overwrite)
+{
+    if (m_read_only) assert(!"Write called on database in read-only mode");
+    assert(m_insert_stmt && m_overwrite_stmt);
+
+    sqlite3_stmt* stmt = overwrite ? m_overwrite_stmt : m_insert_stmt;
+
+    // Bind: leftmost parameter in statement is index 1
+    if (!BindBlob(stmt, 1, key, "key")) return false;
+    if (!BindBlob(stmt, 2, value, "value")) return false;
+
+    return ExecWriteStatement(stmt);
+}
+
+bool SQLiteBatch::EraseKey(CDataStream&& key)
+{
+    if (m_read_only) assert(!"Erase called on database in read-only mode");
+    assert(m_delete_stmt);
+
+    if (!BindBlob(m_delete_stmt, 1, key, "key")) return false;
+
+    return ExecWriteStatement(m_delete_stmt);
+}
+
+bool SQLiteBatch::HasKey(CDataStream&& key)
+{
+    LOCK(m_database.m_db_mutex);
+    if (!m_database.m_db) return false;
+    assert(m_read_stmt);
+
+    if (!BindBlob(m_read_stmt, 1, key, "key")) return false;
+    int res = sqlite3_step(m_read_stmt);
+    sqlite3_clear_bindings(m_read_stmt);
+    sqlite3_reset(m_read_stmt);
+    return res == SQLITE_ROW;
+}
+
+bool SQLiteBatch::StartCursor()
+{
+    LOCK(m_database.m_db_mutex);
+    if (!m_database.m_db) return false;
+    assert(m_cursor_stmt);
+    sqlite3_reset(m_cursor_stmt);
+    return true;
+}
+
+bool SQLiteBatch::ReadAtCursor(CDataStream& ssKey, CDataStream& ssValue, bool& complete)
+{
+    complete = false;
+
+    LOCK(m_database.m_db_mutex);
+    if (!m_database.m_db) return false;
+
+    int res = sqlite3_step(m_cursor_stmt);
+    if (res == SQLITE_DONE) {
+        complete = true;
+        return true;
+    }
+    if (res != SQLITE_ROW) {
+        LogPrintf("SQLiteBatch::ReadAtCursor: Unable to execute cursor step: %s\n", sqlite3_errstr(res));
+        return false;
+    }
+
+    // Leftmost column in result is index 0
+    const char* key_data = reinterpret_cast<const char*>(sqlite3_column_blob(m_cursor_stmt, 0));
+    int key_data_size = sqlite3_column_bytes(m_cursor_stmt, 0);
+    ssKey.SetType(SER_DISK);
+    ssKey.clear();
+    ssKey.write(key_data, key_data_size);
+    const char* value_data = reinterpret_cast<const char*>(sqlite3_column_blob(m_cursor_stmt, 1));
+    int value_data_size = sqlite3_column_bytes(m_cursor_stmt, 1);
+    ssValue.SetType(SER_DISK);
+    ssValue.clear();
+    ssValue.write(value_data, value_data_size);
+    return true;
+}
+
+void SQLiteBatch::CloseCursor()
+{
+    LOCK(m_database.m_db_mutex);
+    if (m_cursor_stmt) sqlite3_reset(m_cursor_stmt);
+}
+
+bool SQLiteBatch::TxnBegin()
+{
+    WAIT_LOCK(m_database.m_db_mutex, lock);
+    if (m_txn || !WaitForOtherTxn(lock) || !m_database.m_db) return false;
+    // Writes batched so far don't belong to the new transaction
+    if (!m_database.CommitImplicitTxn()) return false;
+    if (!sqlite3_get_autocommit(m_database.m_db)) return false;
+    if (ExecStatement(m_database.m_db, "BEGIN TRANSACTION") != SQLITE_OK) return false;
+    m_txn = true;
+    m_database.m_txn_batch = this;
+    m_database.m_txn_thread = std::this_thread::get_id();
+    return true;
+}
+
+void SQLiteBatch::EndTxn()
+{
+    m_txn = false;
+    m_database.m_txn_batch = nullptr;
+    m_database.m_txn_cv.notify_all();
+}
+
+bool SQLiteBatch::TxnCommit()
+{
+    LOCK(m_database.m_db_mutex);
+    if (!m_txn) return false;
+    EndTxn();
+    return m_database.m_db && ExecStatement(m_database.m_db, "COMMIT TRANSACTION") == SQLITE_OK;
+}
+
+bool SQLiteBatch::TxnAbort()
+{
+    LOCK(m_database.m_db_mutex);
+    if (!m_txn) return false;
+    EndTxn();
+    return m_database.m_db && ExecStatement(m_database.m_db, "ROLLBACK TRANSACTION") == SQLITE_OK;
+}
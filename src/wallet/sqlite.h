@@ -0,0 +1,138 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_SQLITE_H
+#define BITCOIN_WALLET_SQLITE_H
+
+#include <sync.h>
+#include <wallet/db.h>
+
+#include <sqlite3.h>
+
+#include <condition_variable>
+#include <thread>
+
+struct bilingual_str;
+class SQLiteDatabase;
+
+/** RAII class that provides access to a SQLiteDatabase
+ *
+ * Writes made outside of an explicit transaction are batched into a
+ * transaction that is committed when the batch is flushed or closed, or when
+ * the database is periodically flushed, so that a WalletBatch writing many
+ * records does not pay for a commit per record.
+ */
+class SQLiteBatch : public DatabaseBatch
+{
+private:
+    SQLiteDatabase& m_database;
+
+    bool m_read_only{false};
+    //! Whether this batch started the open explicit transaction
+    bool m_txn{false};
+
+    sqlite3_stmt* m_read_stmt{nullptr};
+    sqlite3_stmt* m_insert_stmt{nullptr};
+    sqlite3_stmt* m_overwrite_stmt{nullptr};
+    sqlite3_stmt* m_delete_stmt{nullptr};
+    sqlite3_stmt* m_cursor_stmt{nullptr};
+
+    void SetupSQLStatements() EXCLUSIVE_LOCKS_REQUIRED(m_database.m_db_mutex);
+
+    /**
+     * Wait for an explicit transaction of another batch to end. Fails if it was
+     * opened by this thread, as it would never end.
+     */
+    bool WaitForOtherTxn(DebugLock<Mutex>& lock) EXCLUSIVE_LOCKS_REQUIRED(m_database.m_db_mutex);
+
+    bool ReadKey(CDataStream&& key, CDataStream& value) override;
+    bool WriteKey(CDataStream&& key, CDataStream&& value, bool overwrite = true) override;
+    bool EraseKey(CDataStream&& key) override;
+    bool HasKey(CDataStream&& key) override;
+
+    /** Forget about the explicit transaction of this batch, which is being committed or rolled back. */
+    void EndTxn() EXCLUSIVE_LOCKS_REQUIRED(m_database.m_db_mutex);
+
+    /** Execute a write statement, batching it into a transaction if none is open. */
+    bool ExecWriteStatement(sqlite3_stmt* stmt);
+
+public:
+    explicit SQLiteBatch(SQLiteDatabase& database, const char* mode = "r+", bool flush_on_close = true);
+    ~SQLiteBatch() override { Close(); }
+
+    /** Commit the writes batched so far. Writes are also committed on Close, whether or not flush_on_close was set. */
+    void Flush() override;
+    void Close() override;
+
+    bool StartCursor() override;
+    bool ReadAtCursor(CDataStream& ssKey, CDataStream& ssValue, bool& complete) override;
+    void CloseCursor() override;
+    bool TxnBegin() override;
+    bool TxnCommit() override;
+    bool TxnAbort() override;
+};
+
+/** An instance of this class represents one SQLite3 database.
+ *
+ * The database is kept in a single file in WAL mode and opened with an
+ * exclusive lock, so every wallet has its own file and nothing is shared
+ * between loaded wallets.
+ **/
+class SQLiteDatabase : public WalletDatabase
+{
+    friend class SQLiteBatch;
+private:
+    const std::string m_dir_path;
+    const std::string m_file_path;
+
+    //! Guards the connection, and its transaction state shared by all batches
+    mutable Mutex m_db_mutex;
+    //! Whether the open transaction was started implicitly by a write
+    mutable bool m_implicit_txn GUARDED_BY(m_db_mutex){false};
+    //! Batch that has an explicit transaction open, if any, and the thread that opened it
+    const SQLiteBatch* m_txn_batch GUARDED_BY(m_db_mutex){nullptr};
+    std::thread::id m_txn_thread GUARDED_BY(m_db_mutex);
+    //! Notified when an explicit transaction ends
+    std::condition_variable m_txn_cv;
+
+    void Open() EXCLUSIVE_LOCKS_REQUIRED(m_db_mutex);
+    void Close() EXCLUSIVE_LOCKS_REQUIRED(m_db_mutex);
+
+    /** Commit the transaction writes were batched into, if any. */
+    bool CommitImplicitTxn() const EXCLUSIVE_LOCKS_REQUIRED(m_db_mutex);
+
+public:
+    SQLiteDatabase(const fs::path& dir_path, const fs::path& file_path);
+    ~SQLiteDatabase() override;
+
+    /** Rewrite the entire database on disk, with the exception of keys starting with pszSkip if non-zero */
+    bool Rewrite(const char* pszSkip = nullptr) override;
+
+    /** Back up the entire database to a file. */
+    bool Backup(const std::string& dest) const override;
+
+    /** Commit batched writes, and close the database on shutdown. */
+    void Flush(bool shutdown) override;
+    bool PeriodicFlush() override;
+
+    void IncrementUpdateCounter() override { ++nUpdateCounter; }
+    //! There is no shared environment to reload
+    void ReloadDbEnv() override {}
+
+    bool Verify(bilingual_str& error) override;
+
+    DatabaseFormat Format() const override { return DatabaseFormat::SQLITE; }
+
+    /** Make a SQLiteBatch connected to this database */
+    std::unique_ptr<DatabaseBatch> MakeBatch(const char* mode = "r+", bool flush_on_close = true) override;
+
+    sqlite3* m_db{nullptr};
+};
+
+/** Return whether a SQLite wallet database is currently loaded. */
+bool IsSQLiteWalletLoaded(const fs::path& wallet_path);
+
+std::string SQLiteDatabaseVersion();
+
+#endif // BITCOIN_WALLET_SQLITE_H
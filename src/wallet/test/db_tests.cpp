@@ -2,13 +2,23 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
 #include <memory>
+#include <thread>
 
 #include <boost/test/unit_test.hpp>
 
 #include <fs.h>
 #include <test/util/setup_common.h>
+#include <util/time.h>
+#include <util/translation.h>
 #include <wallet/bdb.h>
+#ifdef USE_SQLITE
+#include <wallet/sqlite.h>
+#endif
 
 
 BOOST_FIXTURE_TEST_SUITE(db_tests, BasicTestingSetup)
@@ -69,4 +79,102 @@ BOOST_AUTO_TEST_CASE(getwalletenv_g_dbenvs_free_instance)
     BOOST_CHECK(env_2_a == env_2_b);
 }
 
+#ifdef USE_SQLITE
+BOOST_AUTO_TEST_CASE(sqlite_read_write_erase)
+{
+    const fs::path dir = GetDataDir() / "sqlite_rw";
+    fs::create_directories(dir);
+    const fs::path file = dir / "wallet.dat";
+    {
+        SQLiteDatabase database(dir, file);
+        std::unique_ptr<DatabaseBatch> batch = database.MakeBatch();
+        BOOST_CHECK(batch->Write(std::string("key"), 1));
+        BOOST_CHECK(!batch->Write(std::string("key"), 2, /* fOverwrite */ false));
+        BOOST_CHECK(batch->Write(std::string("other"), 3));
+        int value = 0;
+        BOOST_CHECK(batch->Read(std::string("key"), value));
+        BOOST_CHECK_EQUAL(value, 1);
+        BOOST_CHECK(batch->Erase(std::string("other")));
+        BOOST_CHECK(!batch->Exists(std::string("other")));
+
+        // An aborted transaction leaves the batched writes before it in place
+        BOOST_CHECK(batch->TxnBegin());
+        BOOST_CHECK(batch->Write(std::string("aborted"), 4));
+        BOOST_CHECK(batch->TxnAbort());
+        BOOST_CHECK(!batch->Exists(std::string("aborted")));
+        BOOST_CHECK(batch->Exists(std::string("key")));
+    }
+    BOOST_CHECK(IsSQLiteFile(file));
+
+    SQLiteDatabase database(dir, file);
+    bilingual_str error;
+    BOOST_CHECK(database.Verify(error));
+    std::unique_ptr<DatabaseBatch> batch = database.MakeBatch("r");
+    int value = 0;
+    BOOST_CHECK(batch->Read(std::string("key"), value));
+    BOOST_CHECK_EQUAL(value, 1);
+}
+
+BOOST_AUTO_TEST_CASE(sqlite_cursor_rewrite_backup)
+{
+    const fs::path dir = GetDataDir() / "sqlite_cursor";
+    fs::create_directories(dir);
+    const fs::path backup = GetDataDir() / "sqlite_backup.dat";
+    SQLiteDatabase database(dir, dir / "wallet.dat");
+    {
+        std::unique_ptr<DatabaseBatch> batch = database.MakeBatch();
+        for (int i = 0; i < 100; ++i) {
+            BOOST_CHECK(batch->Write(std::make_pair(std::string(i % 2 ? "odd" : "even"), i), i));
+        }
+    }
+    BOOST_CHECK(database.Rewrite("\x03odd"));
+    BOOST_CHECK(database.Backup(backup.string()));
+    BOOST_CHECK(IsSQLiteFile(backup));
+
+    std::unique_ptr<DatabaseBatch> batch = database.MakeBatch();
+    BOOST_CHECK(batch->StartCursor());
+    int records = 0;
+    while (true) {
+        CDataStream key(SER_DISK, CLIENT_VERSION);
+        CDataStream value(SER_DISK, CLIENT_VERSION);
+        bool complete;
+        BOOST_CHECK(batch->ReadAtCursor(key, value, complete));
+        if (complete) break;
+        std::string type;
+        key >> type;
+        BOOST_CHECK_EQUAL(type, "even");
+        ++records;
+    }
+    batch->CloseCursor();
+    BOOST_CHECK_EQUAL(records, 50);
+}
+
+BOOST_AUTO_TEST_CASE(sqlite_txn_other_batch)
+{
+    const fs::path dir = GetDataDir() / "sqlite_txn";
+    fs::create_directories(dir);
+    SQLiteDatabase database(dir, dir / "wallet.dat");
+    std::unique_ptr<DatabaseBatch> txn_batch = database.MakeBatch();
+    std::unique_ptr<DatabaseBatch> other_batch = database.MakeBatch();
+
+    BOOST_CHECK(txn_batch->TxnBegin());
+    BOOST_CHECK(txn_batch->Write(std::string("aborted"), 1));
+    // Waiting for the transaction of this thread to end would never return
+    BOOST_CHECK(!other_batch->Write(std::string("same_thread"), 2));
+    BOOST_CHECK(!other_batch->TxnBegin());
+
+    // Writes of other threads wait for the transaction to end, so they are not rolled back with it
+    bool written = false;
+    std::thread writer([&] { written = other_batch->Write(std::string("other_thread"), 3); });
+    UninterruptibleSleep(std::chrono::milliseconds{100});
+    BOOST_CHECK(txn_batch->TxnAbort());
+    writer.join();
+    BOOST_CHECK(written);
+
+    BOOST_CHECK(!txn_batch->Exists(std::string("aborted")));
+    BOOST_CHECK(!txn_batch->Exists(std::string("same_thread")));
+    BOOST_CHECK(txn_batch->Exists(std::string("other_thread")));
+}
+#endif // USE_SQLITE
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <key.h>
+#include <script/descriptor.h>
 #include <script/standard.h>
 #include <test/util/setup_common.h>
 #include <wallet/scriptpubkeyman.h>
@@ -40,4 +41,45 @@ BOOST_AUTO_TEST_CASE(CanProvide)
     BOOST_CHECK(keyman.CanProvide(p2sh_script, data));
 }
 
+// Test that topping up a descriptor with a large range, which expands it on
+// several threads, and loading it from its xpub cache give the same
+// scriptPubKeys as expanding every index one at a time.
+BOOST_AUTO_TEST_CASE(DescriptorExpandRange)
+{
+    NodeContext node;
+    std::unique_ptr<interfaces::Chain> chain = interfaces::MakeChain(node);
+    CWallet wallet(chain.get(), WalletLocation(), CreateMockWalletDatabase());
+
+    const std::string desc_str = "wpkh(xpub661MyMwAqRbcFtXgS5sYJABqqG9YLmC4Q1Rdap9gSE8NqtwybGhePY2gZ29ESFjqJoCu1Rupje8YtGqsefD265TMg7usUDFdp6W1EGMcet8/0/*)";
+    const int32_t range = 3000;
+    const auto parse = [&] {
+        FlatSigningProvider keys;
+        std::string error;
+        std::unique_ptr<Descriptor> desc = Parse(desc_str, keys, error, /* require_checksum */ false);
+        BOOST_REQUIRE(desc);
+        return desc;
+    };
+
+    std::set<CScript> expected;
+    std::unique_ptr<Descriptor> desc = parse();
+    for (int32_t i = 0; i < range; ++i) {
+        std::vector<CScript> scripts;
+        FlatSigningProvider out;
+        BOOST_CHECK(desc->Expand(i, DUMMY_SIGNING_PROVIDER, scripts, out));
+        expected.insert(scripts.begin(), scripts.end());
+    }
+
+    WalletDescriptor w_desc(parse(), 0, 0, 1, 0);
+    DescriptorScriptPubKeyMan spk_man(wallet, w_desc);
+    BOOST_CHECK(spk_man.TopUp(range));
+    const std::vector<CScript> topped_up = spk_man.GetScriptPubKeys();
+    BOOST_CHECK(std::set<CScript>(topped_up.begin(), topped_up.end()) == expected);
+
+    WalletDescriptor loaded_desc(parse(), 0, 0, range, 0);
+    DescriptorScriptPubKeyMan loaded_spk_man(wallet, loaded_desc);
+    loaded_spk_man.SetCache(WITH_LOCK(spk_man.cs_desc_man, return spk_man.GetWalletDescriptor().cache));
+    const std::vector<CScript> loaded = loaded_spk_man.GetScriptPubKeys();
+    BOOST_CHECK(std::set<CScript>(loaded.begin(), loaded.end()) == expected);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,18 +7,22 @@
 #include <future>
 #include <memory>
 #include <stdint.h>
+#include <tuple>
 #include <vector>
 
 #include <interfaces/chain.h>
+#include <key_io.h>
 #include <node/context.h>
 #include <policy/policy.h>
 #include <rpc/server.h>
+#include <script/descriptor.h>
 #include <test/util/logging.h>
 #include <test/util/setup_common.h>
 #include <util/ref.h>
 #include <util/translation.h>
 #include <validation.h>
 #include <wallet/coincontrol.h>
+#include <wallet/rescan.h>
 #include <wallet/test/wallet_test_fixture.h>
 
 #include <boost/test/unit_test.hpp>
@@ -167,6 +171,194 @@ BOOST_FIXTURE_TEST_CASE(scan_for_wallet_transactions, TestChain100Setup)
     }
 }
 
+// Verify rescans reading and matching blocks ahead on worker threads find the
+// same transactions as rescans reading every block on the rescanning thread.
+BOOST_FIXTURE_TEST_CASE(scan_for_wallet_transactions_prefetch, TestChain100Setup)
+{
+    // Every block of the test chain pays to the coinbase key, so each of them
+    // starts a new generation and the rescanning thread matches it again. Mine
+    // more blocks than are read ahead that do not pay to the wallet around the
+    // ones that do, so those are matched by the workers.
+    const CScript other_script = CScript() << OP_TRUE;
+    const auto mine_other_blocks = [&]() {
+        for (int i = 0; i < MAX_RESCAN_PREFETCH_BLOCKS + 8; ++i) {
+            CreateAndProcessBlock({}, other_script);
+        }
+    };
+    mine_other_blocks();
+    // Spend a mature coinbase output back to the coinbase key, so the rescan
+    // has to commit a transaction spending a wallet transaction.
+    CMutableTransaction spend = TestSimpleSpend(*m_coinbase_txns[0], 0, coinbaseKey, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    CreateAndProcessBlock({spend}, other_script);
+    mine_other_blocks();
+
+    NodeContext node;
+    auto chain = interfaces::MakeChain(node);
+
+    auto scan = [&](int threads) {
+        gArgs.ForceSetArg("-rescanthreads", ToString(threads));
+        CWallet wallet(chain.get(), WalletLocation(), CreateDummyWalletDatabase());
+        {
+            LOCK(wallet.cs_wallet);
+            wallet.SetLastBlockProcessed(::ChainActive().Height(), ::ChainActive().Tip()->GetBlockHash());
+        }
+        AddKey(wallet, coinbaseKey);
+        WalletRescanReserver reserver(wallet);
+        reserver.reserve();
+        CWallet::ScanResult result = wallet.ScanForWalletTransactions(::ChainActive().Genesis()->GetBlockHash(), 0 /* start_height */, {} /* max_height */, reserver, false /* update */);
+        BOOST_CHECK_EQUAL(result.status, CWallet::ScanResult::SUCCESS);
+        BOOST_CHECK_EQUAL(result.last_scanned_block, ::ChainActive().Tip()->GetBlockHash());
+        BOOST_CHECK_EQUAL(*result.last_scanned_height, ::ChainActive().Height());
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK(wallet.mapWallet.count(spend.GetHash()));
+        const CWallet::Balance balance = wallet.GetBalance();
+        return std::make_tuple(wallet.mapWallet.size(), balance.m_mine_trusted, balance.m_mine_immature);
+    };
+
+    const auto expected = scan(0);
+    BOOST_CHECK_EQUAL(std::get<0>(expected), 101U);
+    BOOST_CHECK(expected == scan(1));
+    BOOST_CHECK(expected == scan(MAX_RESCAN_THREADS));
+    gArgs.ForceSetArg("-rescanthreads", ToString(DEFAULT_RESCAN_THREADS));
+}
+
+BOOST_FIXTURE_TEST_CASE(unspent_txs, TestChain100Setup)
+{
+    NodeContext node;
+    auto chain = interfaces::MakeChain(node);
+    CWallet wallet(chain.get(), WalletLocation(), CreateDummyWalletDatabase());
+    {
+        LOCK(wallet.cs_wallet);
+        wallet.SetLastBlockProcessed(::ChainActive().Height(), ::ChainActive().Tip()->GetBlockHash());
+    }
+    AddKey(wallet, coinbaseKey);
+    const CScript script = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    CMutableTransaction receive;
+    receive.vin.emplace_back(m_coinbase_txns[0]->GetHash(), 1);
+    receive.vout.emplace_back(COIN, script);
+    receive.vout.emplace_back(COIN, CScript() << OP_TRUE);
+    const CTransactionRef receive_tx = MakeTransactionRef(receive);
+    wallet.AddToWallet(receive_tx, {});
+
+    CMutableTransaction spend;
+    spend.vin.emplace_back(receive_tx->GetHash(), 0);
+    spend.vout.emplace_back(COIN, script);
+    const CTransactionRef spend_tx = MakeTransactionRef(spend);
+    wallet.AddToWallet(spend_tx, {});
+
+    LOCK(wallet.cs_wallet);
+    // Only the spending transaction has an unspent output of ours.
+    BOOST_CHECK(wallet.GetUnspentTxs() == std::set<uint256>({spend_tx->GetHash()}));
+
+    // Abandoning the spend makes the output it spent unspent again.
+    BOOST_CHECK(wallet.AbandonTransaction(spend_tx->GetHash()));
+    BOOST_CHECK(wallet.GetUnspentTxs() == std::set<uint256>({receive_tx->GetHash(), spend_tx->GetHash()}));
+
+    // Rebuilding from scratch gives the same transactions.
+    wallet.MarkDirty();
+    BOOST_CHECK(wallet.GetUnspentTxs() == std::set<uint256>({receive_tx->GetHash(), spend_tx->GetHash()}));
+}
+
+BOOST_FIXTURE_TEST_CASE(unspent_txs_zap, TestChain100Setup)
+{
+    NodeContext node;
+    auto chain = interfaces::MakeChain(node);
+    CWallet wallet(chain.get(), WalletLocation(), CreateMockWalletDatabase());
+    CWalletTx::Confirmation confirm;
+    {
+        LOCK(wallet.cs_wallet);
+        wallet.SetLastBlockProcessed(::ChainActive().Height(), ::ChainActive().Tip()->GetBlockHash());
+        confirm = CWalletTx::Confirmation(CWalletTx::Status::CONFIRMED, ::ChainActive().Height(), ::ChainActive().Tip()->GetBlockHash(), 0);
+    }
+    AddKey(wallet, coinbaseKey);
+    const CScript script = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    CMutableTransaction receive;
+    receive.vin.emplace_back(m_coinbase_txns[0]->GetHash(), 1);
+    receive.vout.emplace_back(2 * COIN, script);
+    const CTransactionRef receive_tx = MakeTransactionRef(receive);
+    wallet.AddToWallet(receive_tx, confirm);
+
+    CMutableTransaction spend;
+    spend.vin.emplace_back(receive_tx->GetHash(), 0);
+    spend.vout.emplace_back(COIN, script);
+    const CTransactionRef spend_tx = MakeTransactionRef(spend);
+    wallet.AddToWallet(spend_tx, confirm);
+
+    LOCK(wallet.cs_wallet);
+    BOOST_CHECK(wallet.GetUnspentTxs() == std::set<uint256>({spend_tx->GetHash()}));
+    BOOST_CHECK_EQUAL(wallet.GetBalance().m_mine_trusted, COIN);
+    BOOST_CHECK_EQUAL(wallet.mapWallet.at(receive_tx->GetHash()).GetAvailableCredit(), 0);
+
+    // Removing the spend leaves the output it spent as the only unspent one,
+    // which counts towards the balance again.
+    std::vector<uint256> hashes_in{spend_tx->GetHash()};
+    std::vector<uint256> hashes_out;
+    BOOST_CHECK(wallet.ZapSelectTx(hashes_in, hashes_out) == DBErrors::LOAD_OK);
+    BOOST_CHECK(hashes_out == std::vector<uint256>({spend_tx->GetHash()}));
+    BOOST_CHECK(wallet.GetUnspentTxs() == std::set<uint256>({receive_tx->GetHash()}));
+    BOOST_CHECK_EQUAL(wallet.mapWallet.at(receive_tx->GetHash()).GetAvailableCredit(), 2 * COIN);
+    BOOST_CHECK_EQUAL(wallet.GetBalance().m_mine_trusted, 2 * COIN);
+}
+
+// A descriptor imported after an output of a wallet transaction was spent can
+// make another output of it ours, so the transaction is unspent again.
+BOOST_FIXTURE_TEST_CASE(unspent_txs_import_descriptor, TestChain100Setup)
+{
+    NodeContext node;
+    auto chain = interfaces::MakeChain(node);
+    CWallet wallet(chain.get(), WalletLocation(), CreateDummyWalletDatabase());
+    wallet.SetWalletFlag(WALLET_FLAG_DESCRIPTORS);
+    CWalletTx::Confirmation confirm;
+    {
+        LOCK(wallet.cs_wallet);
+        wallet.SetLastBlockProcessed(::ChainActive().Height(), ::ChainActive().Tip()->GetBlockHash());
+        confirm = CWalletTx::Confirmation(CWalletTx::Status::CONFIRMED, ::ChainActive().Height(), ::ChainActive().Tip()->GetBlockHash(), 0);
+    }
+    const auto import_key = [&](const CKey& key) {
+        FlatSigningProvider keys;
+        std::string error;
+        std::unique_ptr<Descriptor> desc = Parse("pk(" + EncodeSecret(key) + ")", keys, error, /* require_checksum */ false);
+        BOOST_REQUIRE(desc);
+        WalletDescriptor w_desc(std::move(desc), 0, 0, 0, 0);
+        BOOST_CHECK(wallet.AddWalletDescriptor(w_desc, keys, ""));
+    };
+    CKey other_key;
+    other_key.MakeNewKey(true);
+    import_key(coinbaseKey);
+    const CScript script = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    CMutableTransaction receive;
+    receive.vin.emplace_back(m_coinbase_txns[0]->GetHash(), 1);
+    receive.vout.emplace_back(COIN, script);
+    receive.vout.emplace_back(COIN, GetScriptForRawPubKey(other_key.GetPubKey()));
+    const CTransactionRef receive_tx = MakeTransactionRef(receive);
+    wallet.AddToWallet(receive_tx, confirm);
+
+    CMutableTransaction spend;
+    spend.vin.emplace_back(receive_tx->GetHash(), 0);
+    spend.vout.emplace_back(COIN, script);
+    const CTransactionRef spend_tx = MakeTransactionRef(spend);
+    wallet.AddToWallet(spend_tx, confirm);
+
+    std::vector<COutput> coins;
+    {
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK(wallet.GetUnspentTxs() == std::set<uint256>({spend_tx->GetHash()}));
+        wallet.AvailableCoins(coins);
+        BOOST_CHECK_EQUAL(coins.size(), 1U);
+    }
+
+    // Importing the key of the second output makes it available.
+    import_key(other_key);
+    LOCK(wallet.cs_wallet);
+    BOOST_CHECK(wallet.GetUnspentTxs() == std::set<uint256>({receive_tx->GetHash(), spend_tx->GetHash()}));
+    wallet.AvailableCoins(coins);
+    BOOST_REQUIRE_EQUAL(coins.size(), 2U);
+    BOOST_CHECK(std::any_of(coins.begin(), coins.end(), [&](const COutput& coin) { return coin.tx->GetHash() == receive_tx->GetHash() && coin.i == 1; }));
+}
+
 BOOST_FIXTURE_TEST_CASE(importmulti_rescan, TestChain100Setup)
 {
     // Cap last block file size, and mine new block in a new block file.
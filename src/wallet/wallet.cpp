@@ -32,6 +32,7 @@
 #include <util/translation.h>
 #include <wallet/coincontrol.h>
 #include <wallet/fees.h>
+#include <wallet/rescan.h>
 
 #include <algorithm>
 #include <assert.h>
@@ -50,6 +51,15 @@ const std::map<uint64_t,std::string> WALLET_FLAG_CAVEATS{
 
 static const size_t OUTPUT_GROUP_MAX_ENTRIES = 10;
 
+//! Storage engine for a new wallet created with the given flags
+static DatabaseFormat NewWalletFormat(uint64_t wallet_creation_flags)
+{
+#ifdef USE_SQLITE
+    if (wallet_creation_flags & WALLET_FLAG_DESCRIPTORS) return DatabaseFormat::SQLITE;
+#endif
+    return DatabaseFormat::BERKELEY;
+}
+
 static RecursiveMutex cs_wallets;
 static std::vector<std::shared_ptr<CWallet>> vpwallets GUARDED_BY(cs_wallets);
 static std::list<LoadWalletFn> g_load_wallet_fns GUARDED_BY(cs_wallets);
@@ -206,7 +216,7 @@ WalletCreationStatus CreateWallet(interfaces::Chain& chain, const SecureString&
     }
 
     // Wallet::Verify will check if we're trying to create a wallet with a duplicate name.
-    if (!CWallet::Verify(chain, location, error, warnings)) {
+    if (!CWallet::Verify(chain, location, error, warnings, NewWalletFormat(wallet_creation_flags))) {
         error = Untranslated("Wallet file verification failed.") + Untranslated(" ") + error;
         return WalletCreationStatus::CREATION_FAILED;
     }
@@ -707,7 +717,48 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        m_unspent_txs_stale = true;
+    }
+}
+
+void CWallet::MarkUnspentTxsDirty(const CTransaction& tx)
+{
+    m_unspent_txs_dirty.insert(tx.GetHash());
+    if (tx.IsCoinBase()) return;
+    for (const CTxIn& txin : tx.vin) {
+        if (mapWallet.count(txin.prevout.hash)) m_unspent_txs_dirty.insert(txin.prevout.hash);
+    }
+}
+
+bool CWallet::HasUnspentOutputs(const CWalletTx& wtx) const
+{
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        if (IsMine(wtx.tx->vout[i]) != ISMINE_NO && !IsSpent(wtx.GetHash(), i)) return true;
     }
+    return false;
+}
+
+const std::set<uint256>& CWallet::GetUnspentTxs() const
+{
+    AssertLockHeld(cs_wallet);
+    if (m_unspent_txs_stale) {
+        m_unspent_txs.clear();
+        for (const auto& entry : mapWallet) {
+            if (HasUnspentOutputs(entry.second)) m_unspent_txs.insert(m_unspent_txs.end(), entry.first);
+        }
+        m_unspent_txs_dirty.clear();
+        m_unspent_txs_stale = false;
+    }
+    for (const uint256& hash : m_unspent_txs_dirty) {
+        const auto it = mapWallet.find(hash);
+        if (it != mapWallet.end() && HasUnspentOutputs(it->second)) {
+            m_unspent_txs.insert(hash);
+        } else {
+            m_unspent_txs.erase(hash);
+        }
+    }
+    m_unspent_txs_dirty.clear();
+    return m_unspent_txs;
 }
 
 bool CWallet::MarkReplaced(const uint256& originalHash, const uint256& newHash)
@@ -862,6 +913,7 @@ CWalletTx* CWallet::AddToWallet(CTransactionRef tx, const CWalletTx::Confirmatio
 
     // Break debit/credit balance caches:
     wtx.MarkDirty();
+    MarkUnspentTxsDirty(*wtx.tx);
 
     // Notify UI of new or updated transaction
     NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -929,6 +981,7 @@ bool CWallet::LoadToWallet(const uint256& hash, const UpdateWalletTxFn& fill_wtx
             }
         }
     }
+    MarkUnspentTxsDirty(*wtx.tx);
     return true;
 }
 
@@ -969,7 +1022,10 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, CWalletTx::Co
             }
 
             // Block disconnection override an abandoned tx as unconfirmed
-            // which means user may have to call abandontransaction again
+            // which means user may have to call abandontransaction again.
+            // The transaction is copied, so that a block transaction from
+            // the block's arena (see CBlock::m_tx_arena) does not keep the
+            // whole block in memory.
             return AddToWallet(MakeTransactionRef(tx), confirm, /* update_wtx= */ nullptr, /* fFlushOnClose= */ false);
         }
     }
@@ -989,6 +1045,7 @@ void CWallet::MarkInputsDirty(const CTransactionRef& tx)
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
             it->second.MarkDirty();
+            m_unspent_txs_dirty.insert(it->first);
         }
     }
 }
@@ -1305,6 +1362,16 @@ bool CWallet::IsMine(const CTransaction& tx) const
     return false;
 }
 
+bool CWallet::IsInvolvingWalletTx(const CTransaction& tx) const
+{
+    AssertLockHeld(cs_wallet);
+    if (mapWallet.count(tx.GetHash())) return true;
+    for (const CTxIn& txin : tx.vin) {
+        if (mapWallet.count(txin.prevout.hash) || mapTxSpends.count(txin.prevout)) return true;
+    }
+    return false;
+}
+
 bool CWallet::IsFromMe(const CTransaction& tx) const
 {
     return (GetDebit(tx, ISMINE_ALL) > 0);
@@ -1695,6 +1762,15 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
     double progress_end = chain().guessVerificationProgress(end_hash);
     double progress_current = progress_begin;
     int block_height = start_height;
+
+    // Read and match the blocks up to the tip known now on worker threads.
+    // Blocks past it, e.g. when the tip moves during the rescan, are read here.
+    int end_height = -1;
+    chain().findBlock(end_hash, FoundBlock().height(end_height));
+    size_t spk_man_count = WITH_LOCK(cs_wallet, return m_spk_managers.size());
+    RescanPrefetcher prefetcher(chain(), end_hash, start_height, end_height, gArgs.GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS), WITH_LOCK(cs_wallet, return GetAllScriptPubKeyMans()));
+    if (prefetcher.UsesBlockFilter()) WalletLogPrintf("Rescan skips blocks using the block filter index\n");
+
     while (!fAbortRescan && !chain().shutdownRequested()) {
         m_scanning_progress = (progress_current - progress_begin) / (progress_end - progress_begin);
         if (block_height % 100 == 0 && progress_end - progress_begin > 0.0) {
@@ -1705,11 +1781,25 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
             WalletLogPrintf("Still rescanning. At block %d. Progress=%f\n", block_height, progress_current);
         }
 
-        CBlock block;
+        std::unique_ptr<RescanPrefetcher::Block> prefetched = prefetcher.Take(block_height);
+        // Filter blocks again here if the keypool was topped up since.
+        if (prefetched && (prefetched->hash != block_hash || (prefetched->filtered_out && prefetched->generation != prefetcher.Generation()))) {
+            prefetched.reset();
+        }
+        const bool filtered_out = prefetched ? prefetched->filtered_out : prefetcher.FilteredOut(block_hash);
+        CBlock read_block;
+        const CBlock* block = nullptr;
+        if (filtered_out) {
+            // The block has nothing for the wallet and does not need to be read.
+        } else if (prefetched) {
+            block = &prefetched->block;
+        } else if (chain().findBlock(block_hash, FoundBlock().data(read_block)) && !read_block.IsNull()) {
+            block = &read_block;
+        }
         bool next_block;
         uint256 next_block_hash;
         bool reorg = false;
-        if (chain().findBlock(block_hash, FoundBlock().data(block)) && !block.IsNull()) {
+        if (block || filtered_out) {
             LOCK(cs_wallet);
             next_block = chain().findNextBlock(block_hash, block_height, FoundBlock().hash(next_block_hash), &reorg);
             if (reorg) {
@@ -1721,8 +1811,19 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
                 result.status = ScanResult::FAILURE;
                 break;
             }
-            for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                SyncTransaction(block.vtx[posInBlock], {CWalletTx::Status::CONFIRMED, block_height, block_hash, (int)posInBlock}, fUpdate);
+            if (m_spk_managers.size() != spk_man_count) {
+                spk_man_count = m_spk_managers.size();
+                prefetcher.SetScriptPubKeyMans(GetAllScriptPubKeyMans());
+            }
+            for (size_t posInBlock = 0; block && posInBlock < block->vtx.size(); ++posInBlock) {
+                const CTransactionRef& tx = block->vtx[posInBlock];
+                const bool matched = prefetched && prefetched->generation == prefetcher.Generation();
+                const bool pays_to_us = matched ? prefetched->pays_to_us[posInBlock] : IsMine(*tx);
+                if (!pays_to_us && !IsInvolvingWalletTx(*tx)) continue;
+                SyncTransaction(tx, {CWalletTx::Status::CONFIRMED, block_height, block_hash, (int)posInBlock}, fUpdate);
+                // Keys paid to are marked as used and the keypool is topped up,
+                // so blocks matched before may miss outputs to the new keys.
+                if (pays_to_us) prefetcher.SetScriptPubKeyMans(GetAllScriptPubKeyMans());
             }
             // scan succeeded, record block as most recent successfully scanned
             result.last_scanned_block = block_hash;
@@ -2063,9 +2164,10 @@ CWallet::Balance CWallet::GetBalance(const int min_depth, bool avoid_reuse) cons
     {
         LOCK(cs_wallet);
         std::set<uint256> trusted_parents;
-        for (const auto& entry : mapWallet)
+        // Transactions without unspent outputs have no available or immature credit.
+        for (const uint256& wtxid : GetUnspentTxs())
         {
-            const CWalletTx& wtx = entry.second;
+            const CWalletTx& wtx = mapWallet.at(wtxid);
             const bool is_trusted{wtx.IsTrusted(trusted_parents)};
             const int tx_depth{wtx.GetDepthInMainChain()};
             const CAmount tx_credit_mine{wtx.GetAvailableCredit(/* fUseCache */ true, ISMINE_SPENDABLE | reuse_filter)};
@@ -2113,10 +2215,9 @@ void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlySafe, const
     const int max_depth = {coinControl ? coinControl->m_max_depth : DEFAULT_MAX_DEPTH};
 
     std::set<uint256> trusted_parents;
-    for (const auto& entry : mapWallet)
+    for (const uint256& wtxid : GetUnspentTxs())
     {
-        const uint256& wtxid = entry.first;
-        const CWalletTx& wtx = entry.second;
+        const CWalletTx& wtx = mapWallet.at(wtxid);
 
         if (!chain().checkFinalTx(*wtx.tx)) {
             continue;
@@ -2177,17 +2278,17 @@ void CWallet::AvailableCoins(std::vector<COutput>& vCoins, bool fOnlySafe, const
 
         for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
             // Only consider selected coins if add_inputs is false
-            if (coinControl && !coinControl->m_add_inputs && !coinControl->IsSelected(COutPoint(entry.first, i))) {
+            if (coinControl && !coinControl->m_add_inputs && !coinControl->IsSelected(COutPoint(wtxid, i))) {
                 continue;
             }
 
             if (wtx.tx->vout[i].nValue < nMinimumAmount || wtx.tx->vout[i].nValue > nMaximumAmount)
                 continue;
 
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(entry.first, i)))
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
                 continue;
 
-            if (IsLockedCoin(entry.first, i))
+            if (IsLockedCoin(wtxid, i))
                 continue;
 
             if (IsSpent(wtxid, i))
@@ -3123,6 +3224,9 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
     for (uint256 hash : vHashOut) {
         const auto& it = mapWallet.find(hash);
         wtxOrdered.erase(it->second.m_it_wtxOrdered);
+        // Drop the transaction from m_unspent_txs, and recheck the ones it spent.
+        // MarkDirty() below is skipped if erasing some of them failed.
+        MarkUnspentTxsDirty(*it->second.tx);
         mapWallet.erase(it);
         NotifyTransactionChanged(this, hash, CT_DELETED);
     }
@@ -3700,7 +3804,7 @@ std::vector<std::string> CWallet::GetDestValues(const std::string& prefix) const
     return values;
 }
 
-bool CWallet::Verify(interfaces::Chain& chain, const WalletLocation& location, bilingual_str& error_string, std::vector<bilingual_str>& warnings)
+bool CWallet::Verify(interfaces::Chain& chain, const WalletLocation& location, bilingual_str& error_string, std::vector<bilingual_str>& warnings, DatabaseFormat format)
 {
     // Do some checking on wallet path. It should be either a:
     //
@@ -3728,8 +3832,15 @@ bool CWallet::Verify(interfaces::Chain& chain, const WalletLocation& location, b
         return false;
     }
 
+#ifndef USE_SQLITE
+    if (IsSQLiteFile(WalletDataFilePath(wallet_path))) {
+        error_string = Untranslated(strprintf("Error loading wallet %s. Wallet is stored in SQLite, but %s was built without SQLite support.", location.GetName(), PACKAGE_NAME));
+        return false;
+    }
+#endif
+
     // Keep same database environment instance across Verify/Recover calls below.
-    std::unique_ptr<WalletDatabase> database = CreateWalletDatabase(wallet_path);
+    std::unique_ptr<WalletDatabase> database = CreateWalletDatabase(wallet_path, format);
 
     try {
         return database->Verify(error_string);
@@ -3763,7 +3874,7 @@ std::shared_ptr<CWallet> CWallet::CreateWalletFromFile(interfaces::Chain& chain,
     bool fFirstRun = true;
     // TODO: Can't use std::make_shared because we need a custom deleter but
     // should be possible to use std::allocate_shared.
-    std::shared_ptr<CWallet> walletInstance(new CWallet(&chain, location, CreateWalletDatabase(location.GetPath())), ReleaseWallet);
+    std::shared_ptr<CWallet> walletInstance(new CWallet(&chain, location, CreateWalletDatabase(location.GetPath(), NewWalletFormat(wallet_creation_flags))), ReleaseWallet);
     DBErrors nLoadWalletRet = walletInstance->LoadWallet(fFirstRun);
     if (nLoadWalletRet != DBErrors::LOAD_OK) {
         if (nLoadWalletRet == DBErrors::CORRUPT) {
@@ -4530,5 +4641,8 @@ ScriptPubKeyMan* CWallet::AddWalletDescriptor(WalletDescriptor& desc, const Flat
     // Save the descriptor to DB
     ret->WriteDescriptor();
 
+    // Outputs of existing transactions may be ours now
+    MarkDirty();
+
     return ret;
 }
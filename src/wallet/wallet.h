@@ -650,6 +650,21 @@ private:
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void AddToSpends(const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /**
+     * Wallet transactions with outputs that are ours and not spent, the only
+     * ones AvailableCoins and GetBalance have to look at. Transactions whose
+     * outputs may have been spent or unspent since are queued in
+     * m_unspent_txs_dirty and rechecked by GetUnspentTxs, as are transactions
+     * removed from mapWallet. MarkDirty() makes it rebuild the whole set, as
+     * IsMine may have changed for any output.
+     */
+    mutable std::set<uint256> m_unspent_txs GUARDED_BY(cs_wallet);
+    mutable std::set<uint256> m_unspent_txs_dirty GUARDED_BY(cs_wallet);
+    mutable bool m_unspent_txs_stale GUARDED_BY(cs_wallet){true};
+    /** Queue tx and the wallet transactions it spends to be rechecked for unspent outputs */
+    void MarkUnspentTxsDirty(const CTransaction& tx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    bool HasUnspentOutputs(const CWalletTx& wtx) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /**
      * Add a transaction to the wallet, or update it.  pIndex and posInBlock should
      * be set when the transaction was known to be included in a block.  When
@@ -798,6 +813,9 @@ public:
     //! check whether we are allowed to upgrade (or already support) to the named feature
     bool CanSupportFeature(enum WalletFeature wf) const override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet) { AssertLockHeld(cs_wallet); return nWalletMaxVersion >= wf; }
 
+    /** Return the hashes of the wallet transactions with unspent outputs that are ours. */
+    const std::set<uint256>& GetUnspentTxs() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /**
      * populate vCoins with vector of available COutputs.
      */
@@ -1054,6 +1072,8 @@ public:
     bool IsMine(const CTransaction& tx) const;
     /** should probably be renamed to IsRelevantToMe */
     bool IsFromMe(const CTransaction& tx) const;
+    /** Whether tx is a wallet transaction, spends from one or conflicts with one */
+    bool IsInvolvingWalletTx(const CTransaction& tx) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     CAmount GetDebit(const CTransaction& tx, const isminefilter& filter) const;
     /** Returns whether all of the inputs match the filter */
     bool IsAllFromMe(const CTransaction& tx, const isminefilter& filter) const;
@@ -1137,10 +1157,11 @@ public:
     /** Mark a transaction as replaced by another transaction (e.g., BIP 125). */
     bool MarkReplaced(const uint256& originalHash, const uint256& newHash);
 
-    //! Verify wallet naming and perform salvage on the wallet if required
-    static bool Verify(interfaces::Chain& chain, const WalletLocation& location, bilingual_str& error_string, std::vector<bilingual_str>& warnings);
+    //! Verify wallet naming and perform salvage on the wallet if required. A wallet that does not exist yet is verified as a new database of the given format.
+    static bool Verify(interfaces::Chain& chain, const WalletLocation& location, bilingual_str& error_string, std::vector<bilingual_str>& warnings, DatabaseFormat format = DatabaseFormat::BERKELEY);
 
-    /* Initializes the wallet, returns a new CWallet instance or a null pointer in case of an error */
+    /* Initializes the wallet, returns a new CWallet instance or a null pointer in case of an error.
+     * New descriptor wallets are stored in SQLite if it is compiled in, other new wallets in BerkeleyDB. */
     static std::shared_ptr<CWallet> CreateWalletFromFile(interfaces::Chain& chain, const WalletLocation& location, bilingual_str& error, std::vector<bilingual_str>& warnings, uint64_t wallet_creation_flags = 0);
 
     /**
@@ -6,6 +6,9 @@
 #include <util/system.h>
 #include <util/translation.h>
 #include <wallet/salvage.h>
+#ifdef USE_SQLITE
+#include <wallet/sqlite.h>
+#endif
 #include <wallet/wallet.h>
 #include <wallet/walletutil.h>
 
@@ -21,14 +24,14 @@ static void WalletToolReleaseWallet(CWallet* wallet)
     delete wallet;
 }
 
-static std::shared_ptr<CWallet> CreateWallet(const std::string& name, const fs::path& path)
+static std::shared_ptr<CWallet> CreateWallet(const std::string& name, const fs::path& path, DatabaseFormat format)
 {
     if (fs::exists(path)) {
         tfm::format(std::cerr, "Error: File exists already\n");
         return nullptr;
     }
     // dummy chain interface
-    std::shared_ptr<CWallet> wallet_instance(new CWallet(nullptr /* chain */, WalletLocation(name), CreateWalletDatabase(path)), WalletToolReleaseWallet);
+    std::shared_ptr<CWallet> wallet_instance(new CWallet(nullptr /* chain */, WalletLocation(name), CreateWalletDatabase(path, format)), WalletToolReleaseWallet);
     LOCK(wallet_instance->cs_wallet);
     bool first_run = true;
     DBErrors load_wallet_ret = wallet_instance->LoadWallet(first_run);
@@ -97,6 +100,7 @@ static void WalletShowInfo(CWallet* wallet_instance)
     LOCK(wallet_instance->cs_wallet);
 
     tfm::format(std::cout, "Wallet info\n===========\n");
+    tfm::format(std::cout, "Format: %s\n", wallet_instance->GetDatabase().Format() == DatabaseFormat::SQLITE ? "sqlite" : "bdb");
     tfm::format(std::cout, "Encrypted: %s\n", wallet_instance->IsCrypted() ? "yes" : "no");
     tfm::format(std::cout, "HD (hd seed available): %s\n", wallet_instance->IsHDEnabled() ? "yes" : "no");
     tfm::format(std::cout, "Keypool Size: %u\n", wallet_instance->GetKeyPoolSize());
@@ -109,6 +113,11 @@ static bool SalvageWallet(const fs::path& path)
     // Create a Database handle to allow for the db to be initialized before recovery
     std::unique_ptr<WalletDatabase> database = CreateWalletDatabase(path);
 
+    if (database->Format() != DatabaseFormat::BERKELEY) {
+        tfm::format(std::cerr, "Error: Salvage is only supported for BerkeleyDB wallets\n");
+        return false;
+    }
+
     // Initialize the environment before recovery
     bilingual_str error_string;
     try {
@@ -125,17 +134,109 @@ static bool SalvageWallet(const fs::path& path)
     return RecoverDatabaseFile(path);
 }
 
+#ifdef USE_SQLITE
+static bool MigrateWallet(const std::string& name, const fs::path& path)
+{
+    if (!fs::is_directory(path)) {
+        tfm::format(std::cerr, "Error: Only wallets in their own directory can be migrated, %s is a data file that may share its directory with other wallets\n", name);
+        return false;
+    }
+    const fs::path data_file = WalletDataFilePath(path);
+    if (!fs::exists(data_file)) {
+        tfm::format(std::cerr, "Error: no wallet file at %s\n", data_file.string());
+        return false;
+    }
+    if (IsSQLiteFile(data_file)) {
+        tfm::format(std::cerr, "Error: Wallet %s is stored in SQLite already\n", name);
+        return false;
+    }
+    const fs::path migrate_file = path / "wallet.dat.migrate";
+    const fs::path backup_file = path / "wallet.dat.bdb";
+    for (const fs::path& file : {migrate_file, backup_file}) {
+        if (fs::exists(file)) {
+            tfm::format(std::cerr, "Error: %s exists already, remove it before migrating\n", file.string());
+            return false;
+        }
+    }
+
+    size_t records = 0;
+    bool success = true;
+    {
+        std::unique_ptr<WalletDatabase> source = CreateWalletDatabase(path);
+        bilingual_str error;
+        if (!source->Verify(error)) {
+            tfm::format(std::cerr, "Error: Failed to open wallet for migration: %s\n", error.original);
+            return false;
+        }
+
+        SQLiteDatabase dest(path, migrate_file);
+        {
+            std::unique_ptr<DatabaseBatch> source_batch = source->MakeBatch("r");
+            std::unique_ptr<DatabaseBatch> dest_batch = dest.MakeBatch();
+            // Copy everything in a single transaction, committed only if all records were copied
+            success = source_batch->StartCursor() && dest_batch->TxnBegin();
+            while (success) {
+                CDataStream ss_key(SER_DISK, CLIENT_VERSION);
+                CDataStream ss_value(SER_DISK, CLIENT_VERSION);
+                bool complete;
+                bool ret = source_batch->ReadAtCursor(ss_key, ss_value, complete);
+                if (complete) break;
+                // Keys and values are copied byte for byte, serializing a stream appends its contents
+                success = ret && dest_batch->Write(ss_key, ss_value, false /* fOverwrite */);
+                ++records;
+            }
+            source_batch->CloseCursor();
+            success = success && dest_batch->TxnCommit();
+        }
+        // Move the BerkeleyDB log data into the data file, so the kept file is self-contained
+        source->Flush(true);
+        dest.Flush(true);
+    }
+
+    if (success) {
+        try {
+            fs::rename(data_file, backup_file);
+            fs::rename(migrate_file, data_file);
+        } catch (const fs::filesystem_error& e) {
+            tfm::format(std::cerr, "Error: Failed to replace %s - %s\n", data_file.string(), fsbridge::get_filesystem_error_message(e));
+            return false;
+        }
+    } else {
+        fs::remove(migrate_file);
+        tfm::format(std::cerr, "Error: Failed to copy the records of %s, the wallet was not changed\n", name);
+        return false;
+    }
+
+    tfm::format(std::cout, "Migrated %u records to SQLite. The BerkeleyDB data file was kept as %s\n", records, backup_file.string());
+    return true;
+}
+#endif
+
 bool ExecuteWalletToolFunc(const std::string& command, const std::string& name)
 {
     fs::path path = fs::absolute(name, GetWalletDir());
 
     if (command == "create") {
-        std::shared_ptr<CWallet> wallet_instance = CreateWallet(name, path);
+        const std::string format_name = gArgs.GetArg("-format", "bdb");
+        DatabaseFormat format;
+        if (format_name == "bdb") {
+            format = DatabaseFormat::BERKELEY;
+        } else if (format_name == "sqlite") {
+#ifndef USE_SQLITE
+            tfm::format(std::cerr, "Error: %s was built without SQLite support\n", PACKAGE_NAME);
+            return false;
+#endif
+            format = DatabaseFormat::SQLITE;
+        } else {
+            tfm::format(std::cerr, "Invalid wallet format: %s\n", format_name);
+            return false;
+        }
+        std::shared_ptr<CWallet> wallet_instance = CreateWallet(name, path, format);
         if (wallet_instance) {
             WalletShowInfo(wallet_instance.get());
             wallet_instance->Flush(true);
         }
-    } else if (command == "info" || command == "salvage") {
+    } else if (command == "info" || command == "salvage" || command == "migrate") {
         if (!fs::exists(path)) {
             tfm::format(std::cerr, "Error: no wallet file at %s\n", name);
             return false;
@@ -148,6 +249,17 @@ bool ExecuteWalletToolFunc(const std::string& command, const std::string& name)
             wallet_instance->Flush(true);
         } else if (command == "salvage") {
             return SalvageWallet(path);
+        } else if (command == "migrate") {
+#ifdef USE_SQLITE
+            if (!MigrateWallet(name, path)) return false;
+            std::shared_ptr<CWallet> wallet_instance = LoadWallet(name, path);
+            if (!wallet_instance) return false;
+            WalletShowInfo(wallet_instance.get());
+            wallet_instance->Flush(true);
+#else
+            tfm::format(std::cerr, "Error: %s was built without SQLite support\n", PACKAGE_NAME);
+            return false;
+#endif
         }
     } else {
         tfm::format(std::cerr, "Invalid command: %s\n", command);
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test block download from peers of different speeds over a mock network.
+
+node0 mines a chain, which P2PBlockServer peers then serve to node1 over
+simulated links:
+- two fast peers
+- one slow peer, with a narrow link
+- one peer that never answers block requests
+
+Check that node1 syncs the whole chain, that the fast peers deliver most of
+the blocks and get more requests in flight than a peer starts out with,
+that the blocks held up by the unresponsive peer are reassigned, and that the
+unresponsive peer is disconnected once it doesn't deliver a block after
+stalling. The sync time is logged, so this also serves as a reproducible block download
+benchmark.
+"""
+
+import time
+
+from test_framework.messages import CBlock, FromHex
+from test_framework.mininode import P2PBlockServer
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    wait_until,
+)
+
+# More than the block download window, so that the unresponsive peer stalls it
+NUM_BLOCKS = 1200
+# Number of blocks a peer may initially have in flight
+MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16
+# Seconds a peer has to deliver a block again after stalling
+BLOCK_STALLING_RECOVERY_TIMEOUT = 60
+
+
+class BlockDownloadTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def run_test(self):
+        self.log.info("Mine {} blocks on node0".format(NUM_BLOCKS))
+        self.nodes[0].generatetoaddress(NUM_BLOCKS, self.nodes[0].get_deterministic_priv_key().address)
+        blocks = []
+        for height in range(1, NUM_BLOCKS + 1):
+            block = FromHex(CBlock(), self.nodes[0].getblock(self.nodes[0].getblockhash(height), 0))
+            block.rehash()
+            blocks.append(block)
+
+        node = self.nodes[1]
+        # Connect the unresponsive peer first, so that it is asked for the first blocks.
+        unresponsive = P2PBlockServer(latency=None)
+        slow = P2PBlockServer(latency=0.2, bandwidth=2500)
+        fast = [P2PBlockServer(latency=0.01), P2PBlockServer(latency=0.01)]
+        peers = [unresponsive, slow] + fast
+        for peer in peers:
+            node.add_p2p_connection(peer)
+            peer.add_blocks(blocks)
+
+        self.log.info("Announce the chain to node1 and wait for it to sync")
+        start = time.time()
+        with node.assert_debug_log(expected_msgs=["is stalling block download, reassigning"], timeout=300):
+            for peer in peers:
+                peer.announce_blocks(blocks)
+            wait_until(lambda: node.getbestblockhash() == blocks[-1].hash, timeout=300)
+        elapsed = time.time() - start
+        self.log.info("Synced {} blocks in {:.1f}s ({:.0f} blocks/s)".format(NUM_BLOCKS, elapsed, NUM_BLOCKS / elapsed))
+        self.log.info("Blocks served: fast {}, slow {}, unresponsive 0 of {} requested".format(
+            [peer.blocks_served for peer in fast], slow.blocks_served, len(unresponsive.getdata_requests)))
+
+        self.log.info("Check that the fast peers delivered most blocks with more requests in flight")
+        assert sum(peer.blocks_served for peer in fast) > slow.blocks_served
+        assert max(peer.max_blocks_outstanding for peer in fast) > MAX_BLOCKS_IN_TRANSIT_PER_PEER
+        assert_equal(node.getblockcount(), NUM_BLOCKS)
+
+        self.log.info("Check that the unresponsive peer is disconnected once it doesn't deliver a block after stalling")
+        with node.assert_debug_log(expected_msgs=["did not deliver a block after stalling block download, disconnecting"]):
+            node.setmocktime(int(time.time()) + BLOCK_STALLING_RECOVERY_TIMEOUT + 1)
+            unresponsive.wait_for_disconnect()
+        assert all(peer.is_connected for peer in [slow] + fast)
+
+
+if __name__ == '__main__':
+    BlockDownloadTest().main()
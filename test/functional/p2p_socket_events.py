@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the epoll and poll socket event backends and multiple socket threads.
+
+- node0 waits for socket events with epoll, node1 with poll (-epoll=0) and
+  node2 spreads its peers over several socket threads (-socketthreads).
+- Open many idle connections to each node and log the CPU time the node
+  spends per idle connection while nothing happens on them.
+- Check that every connection is still serviced afterwards.
+- Check that blocks still propagate between the nodes.
+"""
+
+import os
+import time
+
+from test_framework.mininode import P2PInterface
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    connect_nodes,
+)
+
+NUM_IDLE_PEERS = 100
+MEASURE_SECONDS = 5
+
+
+def cpu_seconds(pid):
+    """Return the user and system CPU time used by a process, or None when it cannot be read."""
+    try:
+        with open('/proc/{}/stat'.format(pid), encoding='utf8') as f:
+            # The command name may contain spaces, so split after its closing parenthesis.
+            fields = f.read().rsplit(')', 1)[1].split()
+    except OSError:
+        return None
+    return (int(fields[11]) + int(fields[12])) / os.sysconf('SC_CLK_TCK')
+
+
+class SocketEventsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 3
+        self.extra_args = [
+            ["-epoll=1", "-maxconnections={}".format(NUM_IDLE_PEERS + 20)],
+            ["-epoll=0", "-maxconnections={}".format(NUM_IDLE_PEERS + 20)],
+            ["-socketthreads=4", "-maxconnections={}".format(NUM_IDLE_PEERS + 20)],
+        ]
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def run_test(self):
+        for node in self.nodes:
+            self.log.info("Open {} idle connections to node{}".format(NUM_IDLE_PEERS, node.index))
+            peers = [node.add_p2p_connection(P2PInterface()) for _ in range(NUM_IDLE_PEERS)]
+            assert_equal(len(node.getpeerinfo()), NUM_IDLE_PEERS)
+
+            start = cpu_seconds(node.process.pid)
+            time.sleep(MEASURE_SECONDS)
+            end = cpu_seconds(node.process.pid)
+            if start is not None and end is not None:
+                self.log.info("node{} ({}) used {:.3f} ms of CPU per idle connection per second".format(
+                    node.index, self.extra_args[node.index][0],
+                    (end - start) * 1000 / MEASURE_SECONDS / NUM_IDLE_PEERS))
+
+            self.log.info("Check that all idle connections are still serviced")
+            for peer in peers:
+                peer.sync_with_ping()
+            node.disconnect_p2ps()
+
+        self.log.info("Check that blocks propagate between the nodes")
+        connect_nodes(self.nodes[0], 1)
+        connect_nodes(self.nodes[1], 2)
+        connect_nodes(self.nodes[2], 0)
+        for node in self.nodes:
+            node.generate(10)
+            self.sync_blocks()
+
+
+if __name__ == '__main__':
+    SocketEventsTest().main()
@@ -58,6 +58,7 @@ class BlockchainTest(BitcoinTestFramework):
         self._test_getblockchaininfo()
         self._test_getchaintxstats()
         self._test_gettxoutsetinfo()
+        self._test_getdbstats()
         self._test_getblockheader()
         self._test_getdifficulty()
         self._test_getnetworkhashps()
@@ -252,6 +253,45 @@ class BlockchainTest(BitcoinTestFramework):
         res5 = node.gettxoutsetinfo(hash_type='none')
         assert 'hash_serialized_2' not in res5
 
+        # hash_type muhash should return a different UTXO set hash.
+        res6 = node.gettxoutsetinfo(hash_type='muhash')
+        assert 'muhash' in res6
+        assert res['hash_serialized_2'] != res6['muhash']
+
+        # The rolling hash should match the one computed by scanning the UTXO set.
+        self.restart_node(0, ['-stopatheight=207', '-prune=1', '-rollingutxohash'])
+        res7 = node.gettxoutsetinfo(hash_type='muhash')
+        assert_equal(res7['muhash'], res6['muhash'])
+        assert 'txouts' not in res7
+        self.restart_node(0, ['-stopatheight=207', '-prune=1'])
+
+    def _test_getdbstats(self):
+        self.log.info("Test getdbstats")
+        node = self.nodes[0]
+        stats = {db['profile']: db for db in node.getdbstats()}
+        assert_equal(sorted(stats), ['blockindex', 'chainstate'])
+        chainstate = stats['chainstate']
+        assert_equal(chainstate['name'], 'chainstate')
+        assert_equal(chainstate['compression'], 'none')
+        assert_equal(chainstate['bloom_bits'], 10)
+        assert_equal(chainstate['block_size'], 4096)
+        assert chainstate['disk_size'] > 6400
+        # The best block and head blocks are looked up on startup.
+        assert chainstate['lookups'] > 0
+        assert 'table_reads_per_lookup' in chainstate
+
+        self.log.info("Test -dbprofile")
+        self.stop_node(0)
+        node.assert_start_raises_init_error(['-dbprofile=utxos:bloombits=12'], 'Error: Unknown database in -dbprofile=utxos:bloombits=12')
+        node.assert_start_raises_init_error(['-dbprofile=chainstate:bloombits=64'], "Error: Invalid option 'bloombits=64' in -dbprofile=chainstate:bloombits=64")
+        self.start_node(0, ['-stopatheight=207', '-prune=1', '-dbprofile=chainstate:bloombits=12,blocksize=8192', '-dbprofile=chainstate:blockcache=60'])
+        chainstate = next(db for db in node.getdbstats() if db['profile'] == 'chainstate')
+        assert_equal(chainstate['bloom_bits'], 12)
+        assert_equal(chainstate['block_size'], 8192)
+        # 60% of the cache goes to the block cache and 20% to each write buffer.
+        assert abs(chainstate['block_cache_size'] - 3 * chainstate['write_buffer_size']) < 200
+        self.restart_node(0, ['-stopatheight=207', '-prune=1'])
+
     def _test_getblockheader(self):
         node = self.nodes[0]
 
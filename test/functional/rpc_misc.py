@@ -54,6 +54,13 @@ class RpcMiscTest(BitcoinTestFramework):
 
         assert_raises_rpc_error(-8, "unknown mode foobar", node.getmemoryinfo, mode="foobar")
 
+        self.log.info("test getsigcacheinfo")
+        sigcache = node.getsigcacheinfo()
+        assert_equal(len(sigcache['shards']), 16)
+        for key in ['capacity', 'hits', 'misses', 'inserts', 'evictions']:
+            assert_equal(sigcache[key], sum(shard[key] for shard in sigcache['shards']))
+        assert_greater_than(sigcache['capacity'], 0)
+
         self.log.info("test logging")
         assert_equal(node.logging()['qt'], True)
         node.logging(exclude=['qt'])
@@ -644,6 +644,59 @@ class P2PDataStore(P2PInterface):
                 for tx in txs:
                     assert tx.hash not in raw_mempool, "{} tx found in mempool".format(tx.hash)
 
+class P2PBlockServer(P2PDataStore):
+    """A P2PDataStore that serves blocks over a simulated link.
+
+    Block requests are answered after a fixed latency, and blocks are sent one
+    after another at a limited bandwidth. Several of these with different link
+    properties make up a reproducible mock network for measuring how a node
+    downloads blocks. A latency of None makes the peer ignore block requests."""
+
+    def __init__(self, *, latency=0, bandwidth=None):
+        super().__init__()
+        self.latency = latency
+        # bytes per second, or None for an unlimited link
+        self.bandwidth = bandwidth
+        self.link_busy_until = 0
+        self.blocks_served = 0
+        self.blocks_outstanding = 0
+        self.max_blocks_outstanding = 0
+
+    def add_blocks(self, blocks):
+        """Add a chain of blocks to the block store, the last one being the tip."""
+        with mininode_lock:
+            for block in blocks:
+                self.block_store[block.sha256] = block
+                self.last_block_hash = block.sha256
+
+    def announce_blocks(self, blocks):
+        """Announce (up to MAX_HEADERS_RESULTS) blocks to the node with a headers message."""
+        self.send_message(msg_headers([CBlockHeader(block) for block in blocks[:MAX_HEADERS_RESULTS]]))
+
+    def on_getdata(self, message):
+        loop = NetworkThread.network_event_loop
+        for inv in message.inv:
+            if (inv.type & MSG_TYPE_MASK) != MSG_BLOCK or inv.hash not in self.block_store:
+                super().on_getdata(msg_getdata([inv]))
+                continue
+            self.getdata_requests.append(inv.hash)
+            self.blocks_outstanding += 1
+            self.max_blocks_outstanding = max(self.max_blocks_outstanding, self.blocks_outstanding)
+            if self.latency is None:
+                continue
+            block = self.block_store[inv.hash]
+            start = max(loop.time() + self.latency, self.link_busy_until)
+            self.link_busy_until = start + (len(block.serialize()) / self.bandwidth if self.bandwidth else 0)
+            loop.call_at(self.link_busy_until, self._send_block, block)
+
+    def _send_block(self, block):
+        with mininode_lock:
+            self.blocks_outstanding -= 1
+            self.blocks_served += 1
+        if self.is_connected:
+            self.send_message(msg_block(block))
+
+
 class P2PTxInvStore(P2PInterface):
     """A P2PInterface which stores a count of how many times each txid has been announced."""
     def __init__(self):
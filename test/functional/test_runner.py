@@ -99,6 +99,8 @@ BASE_SCRIPTS = [
     'wallet_labels.py --descriptors',
     'p2p_segwit.py',
     'p2p_timeouts.py',
+    'p2p_socket_events.py',
+    'p2p_block_download.py',
     'p2p_tx_download.py',
     'mempool_updatefromblock.py',
     'wallet_dump.py',
@@ -200,6 +202,7 @@ BASE_SCRIPTS = [
     'wallet_import_rescan.py',
     'wallet_import_with_label.py',
     'wallet_importdescriptors.py',
+    'wallet_fast_rescan.py',
     'wallet_upgradewallet.py',
     'rpc_bind.py --ipv4',
     'rpc_bind.py --ipv6',
@@ -96,6 +96,7 @@ class ToolWalletTest(BitcoinTestFramework):
         out = textwrap.dedent('''\
             Wallet info
             ===========
+            Format: bdb
             Encrypted: no
             HD (hd seed available): yes
             Keypool Size: 2
@@ -135,6 +136,7 @@ class ToolWalletTest(BitcoinTestFramework):
         out = textwrap.dedent('''\
             Wallet info
             ===========
+            Format: bdb
             Encrypted: no
             HD (hd seed available): yes
             Keypool Size: 2
@@ -162,6 +164,7 @@ class ToolWalletTest(BitcoinTestFramework):
             Topping up keypool...
             Wallet info
             ===========
+            Format: bdb
             Encrypted: no
             HD (hd seed available): yes
             Keypool Size: 2000
@@ -210,6 +213,45 @@ class ToolWalletTest(BitcoinTestFramework):
 
         self.assert_tool_output('', '-wallet=salvage', 'salvage')
 
+    def test_sqlite(self):
+        self.log.info('Check create -format=sqlite and migrate')
+        self.assert_raises_tool_error('Invalid wallet format: foo', '-wallet=badformat', '-format=foo', 'create')
+        out = textwrap.dedent('''\
+            Topping up keypool...
+            Wallet info
+            ===========
+            Format: sqlite
+            Encrypted: no
+            HD (hd seed available): yes
+            Keypool Size: 2000
+            Transactions: 0
+            Address Book: 0
+        ''')
+        self.assert_tool_output(out, '-wallet=sqlite', '-format=sqlite', 'create')
+        sqlite_path = os.path.join(self.nodes[0].datadir, self.chain, 'wallets', 'sqlite', 'wallet.dat')
+        with open(sqlite_path, 'rb') as f:
+            assert_equal(f.read(16), b'SQLite format 3\x00')
+        self.assert_raises_tool_error('Error: Wallet sqlite is stored in SQLite already', '-wallet=sqlite', 'migrate')
+
+        self.start_node(0, ['-wallet=migrate'])
+        address = self.nodes[0].getnewaddress()
+        self.nodes[0].generatetoaddress(1, address)
+        balance = self.nodes[0].getbalances()['mine']['immature']
+        self.stop_node(0)
+
+        p = self.bitcoin_wallet_process('-wallet=migrate', 'migrate')
+        stdout, stderr = p.communicate()
+        assert_equal(p.poll(), 0)
+        assert_equal(stderr, '')
+        assert 'Format: sqlite' in stdout
+        migrate_dir = os.path.join(self.nodes[0].datadir, self.chain, 'wallets', 'migrate')
+        assert os.path.exists(os.path.join(migrate_dir, 'wallet.dat.bdb'))
+
+        self.start_node(0, ['-wallet=migrate'])
+        assert_equal(self.nodes[0].getaddressinfo(address)['ismine'], True)
+        assert_equal(self.nodes[0].getbalances()['mine']['immature'], balance)
+        self.stop_node(0)
+
     def run_test(self):
         self.wallet_path = os.path.join(self.nodes[0].datadir, self.chain, 'wallets', 'wallet.dat')
         self.test_invalid_tool_commands_and_args()
@@ -219,6 +261,8 @@ class ToolWalletTest(BitcoinTestFramework):
         self.test_tool_wallet_create_on_existing_wallet()
         self.test_getwalletinfo_on_different_wallet()
         self.test_salvage()
+        if self.is_sqlite_compiled():
+            self.test_sqlite()
 
 if __name__ == '__main__':
     ToolWalletTest().main()
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test wallet rescans using the block filter index to skip blocks.
+
+Funds are sent to addresses beyond the initial keypool of a descriptor wallet,
+so a rescan of the same descriptor has to top up its keypool and match later
+blocks against the new scriptPubKeys. Rescans with and without the block filter
+index, and with and without rescan threads, have to find the same transactions."""
+
+from test_framework.address import ADDRESS_BCRT1_UNSPENDABLE
+from test_framework.descriptors import descsum_create
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+KEYPOOL_SIZE = 10
+XPRIV = "tprv8ZgxMBicQKsPeuVhWwi6wuMQGfPKi9Li5GtX35jVNknACgqe3CY4g5xgkfDDJcmtF7o1QnxWDRYw4H5P26PXq7sbcUkEqeR4fg3Kxp2tigg"
+FILTER_LOG_MSG = "Rescan skips blocks using the block filter index"
+
+
+class WalletFastRescanTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-keypool={}'.format(KEYPOOL_SIZE), '-blockfilterindex=1']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def get_wallet_txids(self, wallet_name):
+        w = self.nodes[0].get_wallet_rpc(wallet_name)
+        return sorted(tx['txid'] for tx in w.listtransactions('*', 1000))
+
+    def rescan_wallet(self, wallet_name, desc, uses_filter):
+        node = self.nodes[0]
+        node.createwallet(wallet_name=wallet_name, descriptors=True, blank=True)
+        w = node.get_wallet_rpc(wallet_name)
+        msgs = ([FILTER_LOG_MSG], []) if uses_filter else ([], [FILTER_LOG_MSG])
+        with node.assert_debug_log(expected_msgs=msgs[0], unexpected_msgs=msgs[1]):
+            result = w.importdescriptors([{'desc': desc, 'timestamp': 0, 'active': True, 'range': [0, KEYPOOL_SIZE - 1]}])
+        assert result[0]['success']
+        return self.get_wallet_txids(wallet_name)
+
+    def run_test(self):
+        node = self.nodes[0]
+        desc = descsum_create("wpkh({}/0/*)".format(XPRIV))
+
+        node.createwallet(wallet_name='topup_test', descriptors=True, blank=True)
+        w = node.get_wallet_rpc('topup_test')
+        result = w.importdescriptors([{'desc': desc, 'timestamp': 'now', 'active': True, 'range': [0, KEYPOOL_SIZE - 1]}])
+        assert result[0]['success']
+
+        self.log.info("Mine blocks to addresses beyond the initial keypool, with blocks for others in between")
+        for _ in range(4 * KEYPOOL_SIZE):
+            node.generatetoaddress(1, w.getnewaddress(address_type='bech32'))
+            node.generatetoaddress(2, ADDRESS_BCRT1_UNSPENDABLE)
+        txids = self.get_wallet_txids('topup_test')
+        assert_equal(len(txids), 4 * KEYPOOL_SIZE)
+
+        self.log.info("Rescan using the block filter index on rescan threads")
+        assert_equal(self.rescan_wallet('rescan_fast', desc, uses_filter=True), txids)
+
+        self.log.info("Rescan using the block filter index on the rescanning thread")
+        self.restart_node(0, self.extra_args[0] + ['-rescanthreads=0'])
+        assert_equal(self.rescan_wallet('rescan_fast_serial', desc, uses_filter=True), txids)
+
+        self.log.info("Rescan without the block filter index")
+        self.restart_node(0, ['-keypool={}'.format(KEYPOOL_SIZE), '-blockfilterindex=0'])
+        assert_equal(self.rescan_wallet('rescan_slow', desc, uses_filter=False), txids)
+
+
+if __name__ == '__main__':
+    WalletFastRescanTest().main()